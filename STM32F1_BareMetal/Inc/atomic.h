@@ -0,0 +1,133 @@
+/**
+ ******************************************************************************
+ * @file           : atomic.h
+ * @brief          : Lock-free read-modify-write on 32-bit words
+ ******************************************************************************
+ * @attention
+ *
+ * LDREX/STREX loops: an interrupt taken between the two clears the
+ * exclusive monitor (exception entry and return do so on the Cortex-M3),
+ * the STREX fails and the loop retries, so these are safe between thread
+ * mode and any interrupt priority without masking anything.
+ *
+ * Off-target the same functions map to the GCC __atomic builtins, so code
+ * built on them can be exercised on the host.
+ *
+ ******************************************************************************
+ */
+
+#ifndef ATOMIC_H_
+#define ATOMIC_H_
+
+#include <stdint.h>
+
+#if defined(__arm__)
+#include "cmsis_compiler.h"
+#endif
+
+/* Functions */
+#if defined(__arm__)
+
+/**
+ * @brief  Order memory accesses before the barrier against those after it.
+ */
+static inline void atomic_fence(void)
+{
+  __DMB();
+}
+
+/**
+ * @brief  Store `desired` if *p still holds `expected`.
+ * @retval 1 if stored, 0 if *p had changed
+ */
+static inline uint32_t atomic_cas(volatile uint32_t *p, uint32_t expected,
+                                  uint32_t desired)
+{
+  do
+  {
+    if (__LDREXW(p) != expected)
+    {
+      __CLREX();
+      return 0U;
+    }
+  } while (__STREXW(desired, p) != 0U);
+  return 1U;
+}
+
+/**
+ * @brief  *p += v
+ * @retval Previous value
+ */
+static inline uint32_t atomic_add(volatile uint32_t *p, uint32_t v)
+{
+  uint32_t old;
+
+  do
+  {
+    old = __LDREXW(p);
+  } while (__STREXW(old + v, p) != 0U);
+  return old;
+}
+
+/**
+ * @brief  *p |= mask
+ * @retval Previous value
+ */
+static inline uint32_t atomic_or(volatile uint32_t *p, uint32_t mask)
+{
+  uint32_t old;
+
+  do
+  {
+    old = __LDREXW(p);
+  } while (__STREXW(old | mask, p) != 0U);
+  return old;
+}
+
+/**
+ * @brief  *p &= mask
+ * @retval Previous value
+ */
+static inline uint32_t atomic_and(volatile uint32_t *p, uint32_t mask)
+{
+  uint32_t old;
+
+  do
+  {
+    old = __LDREXW(p);
+  } while (__STREXW(old & mask, p) != 0U);
+  return old;
+}
+
+#else
+
+static inline void atomic_fence(void)
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atomic_cas(volatile uint32_t *p, uint32_t expected,
+                                  uint32_t desired)
+{
+  return __atomic_compare_exchange_n(p, &expected, desired, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? 1U : 0U;
+}
+
+static inline uint32_t atomic_add(volatile uint32_t *p, uint32_t v)
+{
+  return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atomic_or(volatile uint32_t *p, uint32_t mask)
+{
+  return __atomic_fetch_or(p, mask, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atomic_and(volatile uint32_t *p, uint32_t mask)
+{
+  return __atomic_fetch_and(p, mask, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
+#endif /* ATOMIC_H_ */
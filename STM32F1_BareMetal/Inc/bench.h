@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * @file           : bench.h
+ * @brief          : Benchmark harness on the DWT cycle counter
+ ******************************************************************************
+ * @attention
+ *
+ * A case is a function and a context pointer, in a bench_case_t the caller
+ * keeps (usually a static); bench_register() links it into the suite.
+ * bench_run() calls each case `warmup` times untimed, to fill the prefetch
+ * buffer and settle any state, then `repeats` times with PRIMASK set and
+ * CYCCNT read around the call. The samples are sorted and min, median and
+ * max stored in the case; the median is the figure to compare, the spread
+ * shows how stable it is. The cost of the call itself, measured the same
+ * way on an empty function, is subtracted.
+ *
+ *   static void copy_256(void *ctx) { memopt_memcpy(dst, src, 256); }
+ *   static bench_case_t copy_case = BENCH_CASE("copy_256", copy_256, 0);
+ *
+ *   bench_register(&copy_case);
+ *   bench_run(4U, 31U);
+ *
+ * Results also go out through __io_putchar(), the console transport that
+ * syscalls.c writes through, as one binary report (little-endian):
+ *
+ *   "BNCH" u8 version, u8 flags, u32 SYSTICK_CORE_HZ
+ *   per case: 'C', u8 name length, name, u16 repeats,
+ *             u32 min, u32 median, u32 max
+ *   'E', u16 cases, u32 CRC-32 (zlib, crc32_sw.h) of the report before it
+ *
+ * Tools/bench_diff.py finds the report in a console capture, checks the
+ * CRC and compares two runs case by case, flagging any median that grew
+ * by more than a threshold.
+ *
+ * Without hardware the suite runs in Renode, whose Cortex-M DWT counts
+ * executed instructions rather than cycles: good for regressions in code
+ * paths, not for wait states or bus contention. QEMU does not model CYCCNT
+ * at all; bench_run() finds it stopped and sets BENCH_FLAG_NO_CYCCNT, and
+ * every figure is then 0. In both, route __io_putchar() to the emulated
+ * USART or to semihosting.
+ *
+ ******************************************************************************
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+
+#ifndef BENCH_REPEATS_MAX
+#define BENCH_REPEATS_MAX   63U
+#endif
+
+#define BENCH_VERSION       1U
+#define BENCH_NAME_MAX      32U
+
+/* Report flags */
+#define BENCH_FLAG_NO_CYCCNT  0x01U
+
+typedef struct bench_case bench_case_t;
+
+struct bench_case
+{
+  const char *name;
+  void (*fn)(void *ctx);
+  void *ctx;
+  bench_case_t *next;
+  uint32_t min;             /* cycles, filled by bench_run() */
+  uint32_t median;
+  uint32_t max;
+};
+
+#define BENCH_CASE(name, fn, ctx) { (name), (fn), (ctx), 0, 0U, 0U, 0U }
+
+/**
+ * @brief  Add a case to the end of the suite. Register each case once.
+ */
+void bench_register(bench_case_t *c);
+
+/**
+ * @brief  Run every registered case and send the report.
+ * @param  warmup  Untimed calls first
+ * @param  repeats Timed calls, 1 .. BENCH_REPEATS_MAX
+ * @retval Number of cases run, -1 if repeats is out of range
+ */
+int bench_run(uint32_t warmup, uint32_t repeats);
+
+#endif /* BENCH_H_ */
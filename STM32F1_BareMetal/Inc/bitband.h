@@ -0,0 +1,90 @@
+/**
+ ******************************************************************************
+ * @file           : bitband.h
+ * @brief          : Cortex-M3 bit-band alias access for peripheral and SRAM
+ *                   bits
+ ******************************************************************************
+ * @attention
+ *
+ * Every bit of the first 1 MB of SRAM (0x20000000) and of the peripheral
+ * space (0x40000000) has a word alias: bit n of the word at A is
+ * BB_BASE + (A - BASE) * 32 + n * 4. A store to the alias sets or clears
+ * that single bit in one locked bus read-modify-write, so it cannot race
+ * with an interrupt touching other bits of the same word, and needs no
+ * interrupt masking. A load returns the bit as 0 or 1.
+ *
+ * With a register and bit known at compile time the alias address folds to
+ * a constant, and BB_PERIPH(RCC->APB1ENR, RCC_APB1ENR_TIM2EN_Pos) = 1 is a
+ * literal load plus one STR.
+ *
+ * Do not use aliases on registers with write-1-to-clear bits (EXTI->PR,
+ * CAN TSR/RF0R...): the bus writes the whole word back, clearing every
+ * other pending flag. Nor on rc_w0 flags (TIMx->SR, USART SR): the write
+ * back leaves flags that were set alone, but one the hardware sets between
+ * the bus's read and its write is written back as 0 and lost. Clear those
+ * with one store of the complement, TIMx->SR = ~TIM_SR_UIF. GPIO ODR bits
+ * are better served by BSRR/BRR, which are already single stores.
+ *
+ ******************************************************************************
+ */
+
+#ifndef BITBAND_H_
+#define BITBAND_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+/* Alias address of bit `bit` of the word at `addr` */
+#define BITBAND_PERIPH_ADDR(addr, bit) \
+  (PERIPH_BB_BASE + (((uint32_t)(addr) - PERIPH_BASE) << 5) + ((uint32_t)(bit) << 2))
+#define BITBAND_SRAM_ADDR(addr, bit) \
+  (SRAM_BB_BASE + (((uint32_t)(addr) - SRAM_BASE) << 5) + ((uint32_t)(bit) << 2))
+
+/* Bit `bit` of peripheral register `reg` (an lvalue) as a 0/1 word */
+#define BB_PERIPH(reg, bit) \
+  (*(__IO uint32_t *)BITBAND_PERIPH_ADDR(&(reg), (bit)))
+
+/* Bit `bit` of SRAM word `var` (an lvalue, in the first 1 MB) as a 0/1 word */
+#define BB_SRAM(var, bit) \
+  (*(__IO uint32_t *)BITBAND_SRAM_ADDR(&(var), (bit)))
+
+/**
+ * @brief  Alias word of bit `n` of a word-aligned SRAM bitmap.
+ */
+static inline __IO uint32_t *bitband_bitmap(const volatile uint32_t *map,
+                                            uint32_t n)
+{
+  return (__IO uint32_t *)(SRAM_BB_BASE +
+                           (((uint32_t)map - SRAM_BASE) << 5) + (n << 2));
+}
+
+static inline void bitband_bitmap_set(volatile uint32_t *map, uint32_t n)
+{
+  *bitband_bitmap(map, n) = 1U;
+}
+
+static inline void bitband_bitmap_clear(volatile uint32_t *map, uint32_t n)
+{
+  *bitband_bitmap(map, n) = 0U;
+}
+
+static inline uint32_t bitband_bitmap_test(const volatile uint32_t *map,
+                                           uint32_t n)
+{
+  return *bitband_bitmap(map, n);
+}
+
+typedef struct
+{
+  uint32_t rmw_masked;        /* PRIMASK save, cpsid, LDR/ORR/STR, restore */
+  uint32_t rmw;               /* unprotected LDR/ORR/STR */
+  uint32_t bitband;           /* alias STR */
+} bitband_bench_t;
+
+/**
+ * @brief  Measure the cost of setting and clearing one bit of an SRAM word
+ *         three ways, in DWT cycles per operation (loop overhead removed).
+ */
+void bitband_bench(bitband_bench_t *out);
+
+#endif /* BITBAND_H_ */
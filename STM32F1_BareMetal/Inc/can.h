@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * @file           : can.h
+ * @brief          : bxCAN (CAN1) driver
+ ******************************************************************************
+ * @attention
+ *
+ * Acceptance filtering is done entirely in the filter banks (see
+ * can_filter.h); each received frame carries the tag of the rule that
+ * accepted it. Received frames are queued per FIFO in single-producer,
+ * single-consumer rings filled from the RX0/RX1 interrupts. Frames to send
+ * wait in a priority queue ordered by arbitration value, equal values in
+ * submission order, and are fed to the three transmit mailboxes so the
+ * highest-priority frame is always among the pending ones; a lower-priority
+ * mailbox is aborted when needed to avoid priority inversion. Only one frame
+ * per identifier is in the mailboxes at a time, so segmented transfers on
+ * one identifier keep their order.
+ *
+ * Pins: PA11 = CAN_RX, PA12 = CAN_TX (no remap).
+ *
+ ******************************************************************************
+ */
+
+#ifndef CAN_H_
+#define CAN_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+#include "can_filter.h"
+#include "crit.h"
+
+#ifndef CAN_RX_QUEUE_LEN
+#define CAN_RX_QUEUE_LEN      16U   /* per FIFO, power of two */
+#endif
+
+#ifndef CAN_TX_QUEUE_LEN
+#define CAN_TX_QUEUE_LEN      16U
+#endif
+
+#ifndef CAN_IRQ_PRIO
+#define CAN_IRQ_PRIO          CRIT_LIB_PRIO   /* and ceiling, see crit.h */
+#endif
+
+#if (CAN_IRQ_PRIO < 1U) || (CAN_IRQ_PRIO > 15U)
+#error "CAN_IRQ_PRIO must be 1 to 15"
+#endif
+
+#define CAN_MODE_NORMAL       0U
+#define CAN_MODE_LOOPBACK     (1U << 0)
+#define CAN_MODE_SILENT       (1U << 1)
+
+typedef struct
+{
+  uint32_t id;
+  uint8_t ide;      /* 1 = extended identifier */
+  uint8_t rtr;      /* 1 = remote frame */
+  uint8_t dlc;
+  uint8_t tag;      /* rx: tag of the accepting filter rule */
+  uint16_t time;    /* rx: time stamp (TTCM only) */
+  uint8_t data[8];
+} can_frame_t;
+
+typedef struct
+{
+  uint32_t btr;                       /* CAN_BTR timing fields (BRP/TS1/TS2/SJW) */
+  uint32_t mode;                      /* CAN_MODE_* flags */
+  const can_filter_rule_t *rules;
+  uint32_t rule_count;
+} can_config_t;
+
+typedef struct
+{
+  uint32_t rx_frames[2];
+  uint32_t rx_dropped[2];   /* software queue full */
+  uint32_t rx_overrun[2];   /* hardware FIFO overrun */
+  uint32_t tx_frames;
+  uint32_t tx_aborted;      /* mailboxes preempted by a higher priority frame */
+  uint32_t tx_errors;
+  uint32_t bus_errors;
+  uint32_t esr;             /* last error status */
+} can_stats_t;
+
+/**
+ * @brief  Build a CAN_BTR value from the bit timing parameters.
+ * @param  prescaler Baud rate prescaler, 1..1024
+ * @param  ts1       Time segment 1 in quanta, 1..16
+ * @param  ts2       Time segment 2 in quanta, 1..8
+ * @param  sjw       Resynchronisation jump width, 1..4
+ */
+#define CAN_BTR(prescaler, ts1, ts2, sjw)                   \
+  ((((uint32_t)(prescaler) - 1U) << CAN_BTR_BRP_Pos) |      \
+   (((uint32_t)(ts1) - 1U) << CAN_BTR_TS1_Pos) |            \
+   (((uint32_t)(ts2) - 1U) << CAN_BTR_TS2_Pos) |            \
+   (((uint32_t)(sjw) - 1U) << CAN_BTR_SJW_Pos))
+
+int can_init(const can_config_t *cfg);
+int can_set_filters(const can_filter_rule_t *rules, uint32_t count);
+int can_transmit(const can_frame_t *frame);
+int can_receive(uint8_t fifo, can_frame_t *frame);
+uint32_t can_rx_pending(uint8_t fifo);
+const can_stats_t *can_get_stats(void);
+
+#endif /* CAN_H_ */
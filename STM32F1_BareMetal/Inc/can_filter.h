@@ -0,0 +1,96 @@
+/**
+ ******************************************************************************
+ * @file           : can_filter.h
+ * @brief          : bxCAN acceptance filter compiler
+ ******************************************************************************
+ * @attention
+ *
+ * Turns a list of wanted identifiers/masks into the smallest set of bxCAN
+ * filter banks, picking 16/32-bit scale and list/mask mode per bank. The
+ * compiler and the bank matcher only touch plain memory, so both build and
+ * run unchanged on the host, where can_filter_match() acts as a simulator of
+ * the hardware acceptance logic.
+ *
+ ******************************************************************************
+ */
+
+#ifndef CAN_FILTER_H_
+#define CAN_FILTER_H_
+
+#include <stdint.h>
+
+#define CAN_FILTER_BANKS      14U   /* filter banks on a single-CAN F1 part */
+#define CAN_FILTER_MAX_FMI    (CAN_FILTER_BANKS * 4U) /* per FIFO, 16-bit list */
+#define CAN_FILTER_MAX_RULES  64U
+#define CAN_FILTER_NO_TAG     0xFFU
+
+#define CAN_STD_ID_MASK       0x000007FFUL
+#define CAN_EXT_ID_MASK       0x1FFFFFFFUL
+
+/**
+ * One acceptance rule. A frame is accepted when its IDE and RTR bits equal
+ * the rule's and (frame_id & mask) == (id & mask). An exact identifier is a
+ * rule whose mask has every identifier bit set.
+ */
+typedef struct
+{
+  uint32_t id;    /* 11-bit (ide = 0) or 29-bit (ide = 1) identifier */
+  uint32_t mask;  /* identifier bits that must match */
+  uint8_t ide;    /* 0 = standard, 1 = extended frame */
+  uint8_t rtr;    /* 0 = data frame, 1 = remote frame */
+  uint8_t fifo;   /* receive FIFO, 0 or 1 */
+  uint8_t tag;    /* reported with every frame this rule accepts */
+} can_filter_rule_t;
+
+/**
+ * Register image of the filter banks plus the filter-match-index to tag
+ * lookup used by the receive path, so frames are dispatched without any
+ * software identifier comparison.
+ */
+typedef struct
+{
+  uint32_t fm1r;    /* bit n set: bank n in identifier list mode */
+  uint32_t fs1r;    /* bit n set: bank n in single 32-bit scale */
+  uint32_t ffa1r;   /* bit n set: bank n assigned to FIFO1 */
+  uint32_t fa1r;    /* bit n set: bank n active */
+  uint32_t fr[CAN_FILTER_BANKS][2];
+  uint8_t banks;    /* number of banks used */
+  uint8_t fmi_tag[2][CAN_FILTER_MAX_FMI];
+} can_filter_image_t;
+
+/**
+ * @brief  Compile acceptance rules into a filter bank image.
+ *
+ *         Rules of the same FIFO, frame type and tag that differ in a single
+ *         identifier bit are merged into one mask entry until no further
+ *         exact merge exists, so the accepted set is never widened. Entries
+ *         are then packed by cost: extended masks take a 32-bit mask bank,
+ *         extended IDs share 32-bit list banks, standard masks share 16-bit
+ *         mask banks and standard IDs fill any spare slot before taking
+ *         16-bit list banks.
+ * @param  rules Rule array
+ * @param  count Number of rules (at most CAN_FILTER_MAX_RULES)
+ * @param  img   Image to fill
+ * @retval Number of banks used, or -1 if the rules are invalid or need more
+ *         than CAN_FILTER_BANKS banks
+ */
+int can_filter_compile(const can_filter_rule_t *rules, uint32_t count,
+                       can_filter_image_t *img);
+
+/**
+ * @brief  Evaluate a frame against a bank image the way bxCAN does.
+ *
+ *         Implements the reference manual's priority rules: 32-bit filters
+ *         beat 16-bit ones, list mode beats mask mode, then the lower filter
+ *         number wins.
+ * @param  img  Compiled image
+ * @param  id   Frame identifier
+ * @param  ide  1 for an extended frame
+ * @param  rtr  1 for a remote frame
+ * @param  fifo Receives the FIFO the frame is stored in
+ * @retval Filter match index, or -1 if the frame is rejected
+ */
+int can_filter_match(const can_filter_image_t *img, uint32_t id, uint8_t ide,
+                     uint8_t rtr, uint8_t *fifo);
+
+#endif /* CAN_FILTER_H_ */
@@ -0,0 +1,168 @@
+/**
+ ******************************************************************************
+ * @file           : coro.h
+ * @brief          : Stackless coroutines on the event loop
+ ******************************************************************************
+ * @attention
+ *
+ * A coroutine is a function that can return in the middle and later be
+ * called again to carry on where it left off, protothread style: the
+ * CORO_* macros wrap its body in a switch on the line it last suspended
+ * at. It borrows the event loop's stack while it runs and keeps nothing on
+ * it across a suspension, so C locals do not survive one. State that must
+ * is kept in the coroutine's frame instead: CORO_FRAME_SIZE bytes in a
+ * fixed pool of CORO_POOL slots, filled from the arguments given to
+ * coro_spawn(). A slot costs CORO_FRAME_SIZE + 16 bytes, 48 by default.
+ *
+ *   typedef struct { coro_signal_t done; uint32_t ch; } xfer_t;
+ *
+ *   static int xfer(coro_t *c)
+ *   {
+ *     xfer_t *f = CORO_FRAME(c, xfer_t);
+ *
+ *     CORO_BEGIN(c);
+ *     dma_claim(f->ch, coro_signal_cb, &f->done);
+ *     ... start the transfer ...
+ *     CORO_WAIT(c, &f->done);         // c->value holds the DMA_EVT_* flags
+ *     CORO_SLEEP(c, 10);
+ *     dma_release(f->ch);
+ *     CORO_END(c);
+ *   }
+ *
+ * Waits are on signals: 32-bit words that interrupts OR flags into with
+ * coro_signal_raise(). coro_signal_cb() has the DMA and TIM callback
+ * signature and coro_signal_done() the dma_memcpy() one, each raising the
+ * signal passed as ctx; an EXTI handler calls coro_signal_raise() itself.
+ * A signal has at most one waiting coroutine, and flags raised while no
+ * one waits are kept for the next CORO_WAIT. Sleeps count SysTick ticks
+ * (see systick.h).
+ *
+ * Coroutines that are ready run from one event at priority CORO_EVENT_PRIO
+ * (see event.h), lowest pool slot first. At most one such event is queued
+ * at a time, so that level cannot overflow if nothing else uses it.
+ *
+ * Nothing here depends on the target: with event.c and a stand-in for
+ * systick_ticks() the module runs on the host, driven by calls to
+ * coro_signal_raise() and coro_tick() in place of interrupts.
+ *
+ ******************************************************************************
+ */
+
+#ifndef CORO_H_
+#define CORO_H_
+
+#include <stdint.h>
+
+#include "event.h"
+
+#ifndef CORO_POOL
+#define CORO_POOL           8U
+#endif
+
+#ifndef CORO_FRAME_SIZE
+#define CORO_FRAME_SIZE     32U     /* bytes */
+#endif
+
+#ifndef CORO_EVENT_PRIO
+#define CORO_EVENT_PRIO     0U
+#endif
+
+#if (CORO_POOL < 1U) || (CORO_POOL > 32U)
+#error "CORO_POOL must be 1 to 32"
+#endif
+
+#if (CORO_FRAME_SIZE % 4U) != 0U
+#error "CORO_FRAME_SIZE must be a multiple of 4"
+#endif
+
+#if CORO_EVENT_PRIO >= EVENT_PRIOS
+#error "CORO_EVENT_PRIO must be below EVENT_PRIOS"
+#endif
+
+/* Coroutine function results */
+#define CORO_WAITING        0
+#define CORO_DONE           1
+
+typedef struct coro coro_t;
+typedef int (*coro_fn_t)(coro_t *c);
+
+struct coro
+{
+  coro_fn_t fn;
+  uint32_t wake;            /* tick to resume at while sleeping */
+  uint32_t value;           /* flags taken by the last CORO_WAIT */
+  uint16_t line;            /* where to resume, 0 at the start */
+  volatile uint8_t state;
+  uint8_t id;
+  uint32_t frame[CORO_FRAME_SIZE / 4U];
+};
+
+typedef struct
+{
+  volatile uint32_t bits;
+  volatile uint32_t waiter; /* coroutine id + 1, or 0 */
+} coro_signal_t;
+
+/* Body macros. Nothing between CORO_BEGIN and CORO_END may itself be a
+ * switch containing a suspension point. */
+#define CORO_FRAME(c, type) ((type *)(void *)(c)->frame)
+
+#define CORO_BEGIN(c)       switch ((c)->line) { case 0:
+
+#define CORO_END(c)         } (c)->line = 0U; return CORO_DONE
+
+/* Let the other ready coroutines and events of this level run */
+#define CORO_YIELD(c) \
+  do { (c)->line = __LINE__; coro_wake(c); return CORO_WAITING; \
+       case __LINE__:; } while (0)
+
+/* Suspend until flags are raised on sig; they are then in (c)->value */
+#define CORO_WAIT(c, sig) \
+  do { (c)->line = __LINE__; case __LINE__: \
+       if (coro_signal_take((sig), (c)) == 0U) { return CORO_WAITING; } \
+     } while (0)
+
+/* Suspend for `ticks` SysTick ticks; the first may be partial */
+#define CORO_SLEEP(c, ticks) \
+  do { coro_sleep((c), (ticks)); (c)->line = __LINE__; case __LINE__: \
+       if (coro_sleeping(c) != 0U) { return CORO_WAITING; } } while (0)
+
+/**
+ * @brief  Start fn in a free pool slot. Thread mode only.
+ * @param  args Copied to the start of the frame, the rest is zeroed; may
+ *              be 0 with size 0
+ * @param  size At most CORO_FRAME_SIZE bytes
+ * @retval 0 on success, -1 if the pool is full or size is too large
+ */
+int coro_spawn(coro_fn_t fn, const void *args, uint32_t size);
+
+/**
+ * @brief  OR non-zero flags into a signal and make its waiter ready.
+ *         Safe from any context.
+ */
+void coro_signal_raise(coro_signal_t *s, uint32_t bits);
+
+/* Adapters for driver callbacks, ctx being the coro_signal_t */
+void coro_signal_cb(uint32_t bits, void *ctx);
+void coro_signal_done(void *ctx);
+
+/**
+ * @brief  SysTick hook: make due sleepers ready.
+ */
+void coro_tick(void);
+
+/**
+ * @brief  Ticks that may pass before a sleeper falls due, for tickless
+ *         idle (see idle.h).
+ * @param  ticks Receives the count
+ * @retval 0 on success, -1 if no coroutine sleeps (ticks is left alone)
+ */
+int coro_next(uint32_t *ticks);
+
+/* Used by the macros */
+void coro_wake(coro_t *c);
+void coro_sleep(coro_t *c, uint32_t ticks);
+uint32_t coro_sleeping(const coro_t *c);
+uint32_t coro_signal_take(coro_signal_t *s, coro_t *c);
+
+#endif /* CORO_H_ */
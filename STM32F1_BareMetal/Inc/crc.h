@@ -0,0 +1,82 @@
+/**
+ ******************************************************************************
+ * @file           : crc.h
+ * @brief          : CRC calculation unit driver, CPU and DMA fed
+ ******************************************************************************
+ * @attention
+ *
+ * The CRC unit computes polynomial 0x04C11DB7 over 32-bit words, MSB first,
+ * from a reset value of 0xFFFFFFFF (crc32_sw.h describes the exact model).
+ * The F1 unit has no initial-value register; a CRC is resumed from any
+ * state by writing crc32_preimage(state) right after the reset.
+ *
+ * crc_words() and crc_words_dma() return the raw register ("native" CRC,
+ * as ST tools compute it). crc_words_dma() streams any number of words from
+ * memory with a memory-to-memory DMA transfer at low priority, in chunks of
+ * up to 65535 words, and reports the result from the DMA interrupt.
+ *
+ * crc_zlib() matches zlib's crc32(). The unit processes bits MSB first,
+ * zlib LSB first, so each word is bit-reversed with RBIT on the way in and
+ * the result reversed and inverted on the way out. DMA cannot reverse bits,
+ * so this mode is CPU fed; unaligned head and tail bytes, and short
+ * buffers, go through the table-driven crc32_sw().
+ *
+ * There is one unit: while a DMA job runs, the CPU functions fall back to
+ * software, and crc_words_dma() fails.
+ *
+ ******************************************************************************
+ */
+
+#ifndef CRC_H_
+#define CRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "stm32f1xx.h"
+#include "crc32_sw.h"
+
+#ifndef CRC_DMA_CHANNEL
+#define CRC_DMA_CHANNEL   4U    /* any free DMA1 channel */
+#endif
+
+#ifndef CRC_HW_MIN_LEN
+#define CRC_HW_MIN_LEN    32U   /* bytes; shorter zlib buffers use software */
+#endif
+
+typedef void (*crc_done_t)(int status, uint32_t state, void *ctx);
+
+/**
+ * @brief  Enable the CRC unit clock.
+ */
+void crc_init(void);
+
+/**
+ * @brief  Native CRC of `count` words, continuing from `state`
+ *         (CRC32_NATIVE_INIT to start).
+ * @retval New state
+ */
+uint32_t crc_words(uint32_t state, const uint32_t *words, size_t count);
+
+/**
+ * @brief  zlib-compatible CRC-32 of a byte buffer of any length and
+ *         alignment, continuing from `crc` (0 to start).
+ * @retval New CRC
+ */
+uint32_t crc_zlib(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief  Start a DMA-fed native CRC. The buffer must stay valid and
+ *         unchanged until `done` runs.
+ * @param  done Called from the DMA interrupt with status 0 and the new state,
+ *              or status -1 on a transfer error
+ * @retval 0 if started, -1 if the unit or the DMA channel is busy
+ */
+int crc_words_dma(uint32_t state, const uint32_t *words, size_t count,
+                  crc_done_t done, void *ctx);
+
+/**
+ * @brief  Non-zero while a DMA job owns the unit.
+ */
+int crc_busy(void);
+
+#endif /* CRC_H_ */
@@ -0,0 +1,40 @@
+/**
+ ******************************************************************************
+ * @file           : crc32_sw.h
+ * @brief          : Software CRC-32 (zlib) and STM32 CRC unit equivalent
+ ******************************************************************************
+ * @attention
+ *
+ * Hardware independent; builds on the host as well as the target.
+ *
+ * crc32_sw() is the zlib crc32(): reflected polynomial 0xEDB88320, initial
+ * value and final XOR 0xFFFFFFFF, chained by passing the previous result
+ * (start with 0).
+ *
+ * crc32_sw_words() reproduces the CRC peripheral: polynomial 0x04C11DB7 fed
+ * 32-bit words MSB first, no reflection, no final XOR, and the raw register
+ * as state (CRC32_NATIVE_INIT after a reset).
+ *
+ ******************************************************************************
+ */
+
+#ifndef CRC32_SW_H_
+#define CRC32_SW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC32_NATIVE_INIT     0xFFFFFFFFUL
+
+uint32_t crc32_sw(uint32_t crc, const void *buf, size_t len);
+
+uint32_t crc32_sw_words(uint32_t state, const uint32_t *words, size_t count);
+
+/**
+ * @brief  The word that, written to a freshly reset CRC unit, leaves its
+ *         register at `state`. The F1 unit cannot load an initial value;
+ *         this resumes a CRC across calls.
+ */
+uint32_t crc32_preimage(uint32_t state);
+
+#endif /* CRC32_SW_H_ */
@@ -0,0 +1,101 @@
+/**
+ ******************************************************************************
+ * @file           : crit.h
+ * @brief          : BASEPRI critical sections with per-resource ceilings
+ ******************************************************************************
+ * @attention
+ *
+ * PRIMASK (__disable_irq) holds off every interrupt. A critical section
+ * here raises BASEPRI instead, to the ceiling of the resource it guards:
+ * the NVIC priority of the most urgent interrupt that touches that
+ * resource. Interrupts at that priority and below (numerically at or
+ * above it) wait; more urgent ones, e.g. a motor control loop at priority
+ * 0..CRIT_LIB_PRIO - 1, are never held off by library code.
+ *
+ * The library's interrupts run at CRIT_LIB_PRIO unless a module's own
+ * <MODULE>_IRQ_PRIO overrides it, and the module sets its vectors to that
+ * priority when it enables them. Each module's ceiling is that same
+ * constant, checked at compile time to be 1 .. 15: BASEPRI cannot mask
+ * priority 0. The rule that follows: do not call a module from an
+ * interrupt more urgent than its ceiling.
+ *
+ * Sections nest. crit_enter() only ever raises BASEPRI (BASEPRI_MAX) and
+ * returns the previous value for crit_exit() to restore, so an inner
+ * section with a lower ceiling does not unmask anything.
+ *
+ * Sleeping with WFI stays on PRIMASK (see event.c): it must hold off every
+ * wake-up source between the last check and the WFI.
+ *
+ * Build with CRIT_ASSERT to time every outermost section with the DWT
+ * counter (call dwt_init() first): crit_get_stats() returns the longest,
+ * with the address it was left from, and the number of sections entered
+ * from an interrupt more urgent than the ceiling, which the ceiling cannot
+ * protect.
+ *
+ ******************************************************************************
+ */
+
+#ifndef CRIT_H_
+#define CRIT_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+#ifndef CRIT_LIB_PRIO
+#define CRIT_LIB_PRIO       8U
+#endif
+
+#if (CRIT_LIB_PRIO < 1U) || (CRIT_LIB_PRIO > 15U)
+#error "CRIT_LIB_PRIO must be 1 to 15"
+#endif
+
+/* NVIC priority to BASEPRI value: priority bits sit at the top of the byte */
+#define CRIT_BASEPRI(prio)  ((uint32_t)(prio) << (8U - __NVIC_PRIO_BITS))
+
+typedef uint32_t crit_t;
+
+#ifdef CRIT_ASSERT
+typedef struct
+{
+  uint32_t max_cycles;      /* longest outermost section */
+  uint32_t max_site;        /* address it was left from */
+  uint32_t violations;      /* entries from above the ceiling */
+} crit_stats_t;
+
+void crit_assert_enter(uint32_t ceiling);
+void crit_assert_exit(void);
+void crit_get_stats(crit_stats_t *out);
+void crit_reset_stats(void);
+#endif
+
+/* Functions */
+/**
+ * @brief  Mask interrupts of priority `ceiling` and below.
+ * @retval Previous state for crit_exit()
+ */
+static inline crit_t crit_enter(uint32_t ceiling)
+{
+  crit_t prev = __get_BASEPRI();
+
+  __set_BASEPRI_MAX(CRIT_BASEPRI(ceiling));
+#ifdef CRIT_ASSERT
+  if (prev == 0U)
+  {
+    crit_assert_enter(ceiling);
+  }
+#endif
+  return prev;
+}
+
+static inline void crit_exit(crit_t prev)
+{
+#ifdef CRIT_ASSERT
+  if (prev == 0U)
+  {
+    crit_assert_exit();
+  }
+#endif
+  __set_BASEPRI(prev);
+}
+
+#endif /* CRIT_H_ */
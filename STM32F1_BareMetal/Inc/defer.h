@@ -0,0 +1,123 @@
+/**
+ ******************************************************************************
+ * @file           : defer.h
+ * @brief          : Deferred interrupt work run from PendSV
+ ******************************************************************************
+ * @attention
+ *
+ * An interrupt handler does the urgent part of its job (reading the data
+ * register, clearing the flag) and hands the rest to defer_post(): a
+ * function, a 32-bit argument and one of DEFER_PRIOS priorities, higher
+ * numbers more urgent. Posting is lock-free, as in event.c: one MPSC ring
+ * (see ring.h) of DEFER_QUEUE_LEN items per priority, a CAS to claim a
+ * slot and no masking, so the top half stays at a few tens of cycles.
+ *
+ * The post pends PendSV, which runs at the lowest interrupt priority and
+ * so only once every other handler has returned. PendSV belongs to the
+ * kernel (kernel.c), which calls defer_run() before it switches tasks;
+ * without kernel_start() the switch part finds nothing to do. Items run
+ * most urgent priority first and in posting order within a priority, in
+ * handler mode on the main stack, with every other interrupt enabled.
+ * A PendSV runs at most DEFER_BATCH items and, if more are left, pends
+ * itself again, so a pending task switch is made between batches.
+ *
+ * Items may post further items and call what an interrupt at the lowest
+ * priority may call: kernel_sem_give(), event_post(), wheel_start() and
+ * so on. They must not block.
+ *
+ * Each item is stamped with the DWT counter when posted; defer_get_stats()
+ * gives per priority the largest queue delay (post to start) and run time,
+ * in cycles, with run and drop counts, and defer_trace() the last
+ * DEFER_TRACE_LEN items individually.
+ *
+ ******************************************************************************
+ */
+
+#ifndef DEFER_H_
+#define DEFER_H_
+
+#include <stdint.h>
+
+#ifndef DEFER_PRIOS
+#define DEFER_PRIOS         4U
+#endif
+
+#ifndef DEFER_QUEUE_LEN
+#define DEFER_QUEUE_LEN     8U
+#endif
+
+#ifndef DEFER_BATCH
+#define DEFER_BATCH         4U
+#endif
+
+#ifndef DEFER_TRACE_LEN
+#define DEFER_TRACE_LEN     16U
+#endif
+
+#if (DEFER_PRIOS < 1U) || (DEFER_PRIOS > 32U)
+#error "DEFER_PRIOS must be 1 to 32"
+#endif
+
+#if (DEFER_QUEUE_LEN < 2U) || ((DEFER_QUEUE_LEN & (DEFER_QUEUE_LEN - 1U)) != 0U)
+#error "DEFER_QUEUE_LEN must be a power of two, at least 2"
+#endif
+
+#if (DEFER_TRACE_LEN < 1U) || ((DEFER_TRACE_LEN & (DEFER_TRACE_LEN - 1U)) != 0U)
+#error "DEFER_TRACE_LEN must be a power of two"
+#endif
+
+#if (DEFER_BATCH < 1U)
+#error "DEFER_BATCH must be at least 1"
+#endif
+
+typedef void (*defer_fn_t)(uint32_t arg);
+
+typedef struct
+{
+  uint32_t runs;
+  uint32_t dropped;         /* posts refused: queue full */
+  uint32_t delay_max;       /* post to start, cycles */
+  uint32_t run_max;         /* cycles */
+} defer_stats_t;
+
+typedef struct
+{
+  defer_fn_t fn;
+  uint32_t prio;
+  uint32_t delay;           /* post to start, cycles */
+  uint32_t run;             /* cycles */
+} defer_record_t;
+
+/**
+ * @brief  Empty the queues, start the DWT counter and put PendSV at the
+ *         lowest priority. Call before enabling interrupts that post.
+ */
+void defer_init(void);
+
+/**
+ * @brief  Queue fn(arg) to run from PendSV. Safe from any context.
+ * @param  prio 0 .. DEFER_PRIOS - 1, higher runs first
+ * @retval 0 on success, -1 if the queue is full or prio is out of range
+ */
+int defer_post(uint32_t prio, defer_fn_t fn, uint32_t arg);
+
+/**
+ * @brief  PendSV hook: run up to DEFER_BATCH queued items.
+ */
+void defer_run(void);
+
+/**
+ * @brief  Copy one priority's statistics.
+ * @retval 0 on success, -1 if prio is out of range
+ */
+int defer_get_stats(uint32_t prio, defer_stats_t *out);
+
+void defer_reset_stats(void);
+
+/**
+ * @brief  Copy up to max of the most recent items, oldest first.
+ * @retval Number of records copied
+ */
+uint32_t defer_trace(defer_record_t *out, uint32_t max);
+
+#endif /* DEFER_H_ */
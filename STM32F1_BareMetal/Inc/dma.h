@@ -0,0 +1,60 @@
+/**
+ ******************************************************************************
+ * @file           : dma.h
+ * @brief          : DMA1 channel ownership and interrupt dispatch
+ ******************************************************************************
+ * @attention
+ *
+ * Every DMA1 channel has exactly one owner at a time. Drivers claim a channel
+ * together with a completion callback; this module owns the seven
+ * DMA1_ChannelN_IRQHandler vectors, clears the channel flags and forwards
+ * them to the owner. Channel numbers follow the reference manual (1..7).
+ *
+ ******************************************************************************
+ */
+
+#ifndef DMA_H_
+#define DMA_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+#include "crit.h"
+
+#define DMA_CHANNELS      7U
+
+#ifndef DMA_IRQ_PRIO
+#define DMA_IRQ_PRIO      CRIT_LIB_PRIO   /* and ceiling, see crit.h */
+#endif
+
+#if (DMA_IRQ_PRIO < 1U) || (DMA_IRQ_PRIO > 15U)
+#error "DMA_IRQ_PRIO must be 1 to 15"
+#endif
+
+/* Per-channel event flags passed to callbacks (DMA_ISR layout, shifted) */
+#define DMA_EVT_TC        (1U << 1)   /* transfer complete */
+#define DMA_EVT_HT        (1U << 2)   /* half transfer */
+#define DMA_EVT_TE        (1U << 3)   /* transfer error, channel disabled */
+
+typedef void (*dma_callback_t)(uint32_t events, void *ctx);
+
+static inline DMA_Channel_TypeDef *dma_channel(uint32_t ch)
+{
+  return (DMA_Channel_TypeDef *)(DMA1_Channel1_BASE + 0x14U * (ch - 1U));
+}
+
+/**
+ * @brief  Take ownership of a DMA1 channel and enable its interrupt.
+ *         Until released, the idle code keeps out of Stop (see idle.h).
+ * @param  ch  Channel number, 1..7
+ * @param  cb  Called from the channel interrupt with DMA_EVT_* flags
+ * @param  ctx Passed back to cb
+ * @retval 0 on success, -1 if the channel is invalid or already owned
+ */
+int dma_claim(uint32_t ch, dma_callback_t cb, void *ctx);
+
+/**
+ * @brief  Disable a channel and give up ownership.
+ */
+void dma_release(uint32_t ch);
+
+#endif /* DMA_H_ */
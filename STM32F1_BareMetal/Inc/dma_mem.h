@@ -0,0 +1,91 @@
+/**
+ ******************************************************************************
+ * @file           : dma_mem.h
+ * @brief          : DMA-offloaded memcpy/memset
+ ******************************************************************************
+ * @attention
+ *
+ * Jobs run in submission order on one reserved DMA1 channel in
+ * memory-to-memory mode, at low priority so peripheral DMA keeps precedence.
+ * No byte of a job is written before every earlier job has finished. When
+ * source and destination share their alignment, unaligned head and tail
+ * bytes are moved by the CPU as the job starts and the middle goes as
+ * 32-bit transfers; otherwise the DMA moves bytes, one bus transfer each.
+ *
+ * Below dma_mem_min_len bytes a job is done by the CPU: at once when the
+ * queue is idle, else from the DMA interrupt when its turn comes. The DMA
+ * path costs a fixed set-up and completion interrupt, which a short memcpy
+ * beats. The default is an estimate; dma_mem_calibrate() measures the
+ * crossover on the running clock configuration and stores it.
+ *
+ * Each submission returns a token for dma_mem_done(). The optional callback
+ * runs from the DMA interrupt, or from the caller for a short job submitted
+ * to an idle queue.
+ * Buffers must stay valid and untouched until the job is done. A transfer
+ * error (an invalid address) ends the job early.
+ *
+ ******************************************************************************
+ */
+
+#ifndef DMA_MEM_H_
+#define DMA_MEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef DMA_MEM_CHANNEL
+#define DMA_MEM_CHANNEL     6U
+#endif
+
+#ifndef DMA_MEM_QUEUE_LEN
+#define DMA_MEM_QUEUE_LEN   8U    /* power of two */
+#endif
+
+#ifndef DMA_MEM_MIN_LEN
+#define DMA_MEM_MIN_LEN     128U  /* initial crossover in bytes */
+#endif
+
+#define DMA_MEM_TOKEN_NONE  0U    /* submission failed, queue full */
+
+typedef uint32_t dma_mem_token_t;
+typedef void (*dma_mem_done_t)(void *ctx);
+
+extern size_t dma_mem_min_len;
+
+/**
+ * @brief  Claim the DMA channel.
+ * @retval 0 on success, -1 if the channel is owned by another driver
+ */
+int dma_mem_init(void);
+
+/**
+ * @brief  Queue a copy of `len` bytes. Regions must not overlap.
+ * @retval Token, or DMA_MEM_TOKEN_NONE if the queue is full
+ */
+dma_mem_token_t dma_memcpy(void *dst, const void *src, size_t len,
+                           dma_mem_done_t done, void *ctx);
+
+/**
+ * @brief  Queue a fill of `len` bytes with `value`.
+ * @retval Token, or DMA_MEM_TOKEN_NONE if the queue is full
+ */
+dma_mem_token_t dma_memset(void *dst, int value, size_t len,
+                           dma_mem_done_t done, void *ctx);
+
+/**
+ * @brief  Non-zero once the job of `token` has completed.
+ */
+int dma_mem_done(dma_mem_token_t token);
+
+/**
+ * @brief  Find the smallest power-of-two copy size, from 16 bytes up to half
+ *         of `scratch`, at which a DMA copy completes no later than memcpy,
+ *         timed with the DWT cycle counter, and store it in dma_mem_min_len.
+ *         Call with interrupts enabled and the queue idle.
+ * @param  scratch Word-aligned buffer, its contents are destroyed
+ * @retval The crossover in bytes, or 0 (dma_mem_min_len unchanged) if DMA
+ *         never won up to size / 2
+ */
+size_t dma_mem_calibrate(void *scratch, size_t size);
+
+#endif /* DMA_MEM_H_ */
@@ -0,0 +1,35 @@
+/**
+ ******************************************************************************
+ * @file           : dwt.h
+ * @brief          : DWT cycle counter
+ ******************************************************************************
+ * @attention
+ *
+ * CYCCNT counts core clock cycles and wraps every 2^32 cycles; take
+ * differences with unsigned subtraction. It stops while the core sleeps.
+ *
+ * dwt_init() only enables the counter and never resets it: other modules
+ * may hold stamps across the call. Take the count at the start of a
+ * measurement and subtract it, rather than counting from zero.
+ *
+ ******************************************************************************
+ */
+
+#ifndef DWT_H_
+#define DWT_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+static inline void dwt_init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t dwt_cycles(void)
+{
+  return DWT->CYCCNT;
+}
+
+#endif /* DWT_H_ */
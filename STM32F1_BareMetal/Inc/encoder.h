@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ * @file           : encoder.h
+ * @brief          : Quadrature encoder interface with 64-bit position and
+ *                   M/T velocity estimation
+ ******************************************************************************
+ * @attention
+ *
+ * The encoder timer (TIM1..TIM4) runs in encoder mode 3 (x4). Its 16-bit
+ * counter is extended to 64 bits by encoder_update(), which must run at
+ * least once per 32767 counts; it is the only writer, and readers in other
+ * contexts use encoder_position(), which retries on a sequence counter
+ * instead of masking interrupts. encoder_update() is one counter load, a
+ * 16-bit subtract, a 64-bit add and the sequence stores, well under 50
+ * cycles per axis.
+ *
+ * Velocity uses the M/T method without any per-edge interrupt: the encoder
+ * timer latches its count on every TI1 rising edge (CC1) and emits a
+ * compare pulse on TRGO; a second, free-running "timebase" timer captures
+ * its own counter on that trigger (IC1 mapped on TRC). Each sample then has
+ * the exact position and time of the last edge, and the velocity is
+ * Δposition / Δtime between edges. When no edge arrived since the previous
+ * sample, the estimate decays as the time since the last edge grows. Without
+ * a timebase timer the plain M method (Δposition per sample) is used.
+ *
+ * encoder_init() claims both timers through tim.h, without interrupts, so
+ * no other timer driver can reprogram them under a running encoder;
+ * encoder_stop() releases them. Each claim holds an idle_inhibit() (see
+ * idle.h): Stop mode would halt the counters and lose edges, so the idle
+ * code stays in Sleep until encoder_stop().
+ *
+ * Encoder inputs (reset state, floating): TIM1 PA8/PA9, TIM2 PA0/PA1,
+ * TIM3 PA6/PA7, TIM4 PB6/PB7.
+ *
+ ******************************************************************************
+ */
+
+#ifndef ENCODER_H_
+#define ENCODER_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+typedef struct
+{
+  TIM_TypeDef *tim;           /* encoder timer */
+  uint32_t filter;            /* ICxF input filter, 0..15 */
+  TIM_TypeDef *timebase;      /* edge time stamp timer, NULL for M method */
+  uint32_t timebase_psc;      /* timebase prescaler register value */
+  uint32_t timebase_hz;       /* timebase tick rate after the prescaler */
+  uint32_t sample_hz;         /* encoder_sample() rate, for the M method */
+} encoder_config_t;
+
+typedef struct
+{
+  TIM_TypeDef *tim;
+  TIM_TypeDef *timebase;
+  uint32_t timebase_hz;
+  uint32_t sample_hz;
+
+  volatile uint32_t seq;      /* odd while position is being written */
+  int64_t position;
+  uint16_t last_cnt;
+
+  uint16_t last_tb;           /* timebase counter at the previous sample */
+  uint32_t now;               /* extended timebase time */
+  uint32_t edge_time;         /* extended time of the last TI1 edge */
+  int64_t edge_pos;           /* position latched at that edge */
+  uint32_t edge_dt;           /* time between the last two edges */
+  uint8_t edge_valid;
+  int64_t sample_pos;         /* position at the previous sample */
+  int32_t velocity;           /* counts per second, Q24.8 */
+} encoder_t;
+
+int encoder_init(encoder_t *e, const encoder_config_t *cfg);
+void encoder_stop(encoder_t *e);
+
+/**
+ * @brief  Fold the hardware counter into the 64-bit position. Single writer.
+ * @retval Current position
+ */
+static inline int64_t encoder_update(encoder_t *e)
+{
+  uint16_t cnt = (uint16_t)e->tim->CNT;
+  int64_t pos = e->position + (int16_t)(uint16_t)(cnt - e->last_cnt);
+
+  e->last_cnt = cnt;
+  e->seq++;
+  __DMB();
+  e->position = pos;
+  __DMB();
+  e->seq++;
+  return pos;
+}
+
+/**
+ * @brief  Read the 64-bit position from any context.
+ */
+static inline int64_t encoder_position(const encoder_t *e)
+{
+  uint32_t seq;
+  int64_t pos;
+
+  do
+  {
+    seq = e->seq;
+    __DMB();
+    pos = e->position;
+    __DMB();
+  } while ((seq & 1U) || (seq != e->seq));
+  return pos;
+}
+
+/**
+ * @brief  Update position and velocity; call at a fixed rate (sample_hz)
+ *         shorter than one timebase counter period.
+ * @retval Velocity in counts per second, Q24.8
+ */
+int32_t encoder_sample(encoder_t *e);
+
+#endif /* ENCODER_H_ */
@@ -0,0 +1,95 @@
+/**
+ ******************************************************************************
+ * @file           : event.h
+ * @brief          : Cooperative run-to-completion event loop with priorities
+ ******************************************************************************
+ * @attention
+ *
+ * An event is a handler and a 32-bit argument. event_post() queues one at
+ * one of EVENT_PRIOS levels, higher numbers more urgent, from thread mode
+ * or any interrupt; event_run() takes over from main() and calls the
+ * handlers one at a time, each to completion, always the oldest event of
+ * the most urgent non-empty level. With nothing queued it sleeps in WFI.
+ *
+ * Each level is an MPSC ring (see ring.h) of EVENT_QUEUE_LEN slots.
+ * Posting claims a slot with a compare-and-swap on the head and publishes
+ * it with a sequence number, so producers never mask interrupts and a post
+ * from an ISR may preempt a post in progress. Only the loop consumes. A
+ * 32-bit word keeps one ready bit per level and the dispatcher picks the
+ * level with CLZ, so selection costs the same for any number of levels.
+ * Nothing is allocated; all state is static. event_init() sets the rings
+ * up and must run before anything posts.
+ *
+ * Handlers are never called from interrupt context, so they may take as
+ * long as they like, but everything else waits for them: split long work
+ * into events that re-post themselves.
+ *
+ * Estimated cost at -O2: a post about 30 cycles, dispatch from the loop to
+ * handler entry about 40, one empty check and the WFI when idle. Measure
+ * on the target with dwt_cycles() around event_dispatch() and an empty
+ * handler.
+ *
+ * Off-target (no __arm__) the atomics map to GCC builtins and the sleep
+ * and interrupt masking compile away, so the file builds with the host
+ * compiler for testing.
+ *
+ ******************************************************************************
+ */
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include <stdint.h>
+
+#ifndef EVENT_PRIOS
+#define EVENT_PRIOS         8U
+#endif
+
+#ifndef EVENT_QUEUE_LEN
+#define EVENT_QUEUE_LEN     8U
+#endif
+
+#if (EVENT_PRIOS < 1U) || (EVENT_PRIOS > 32U)
+#error "EVENT_PRIOS must be 1 to 32"
+#endif
+
+#if (EVENT_QUEUE_LEN < 2U) || ((EVENT_QUEUE_LEN & (EVENT_QUEUE_LEN - 1U)) != 0U)
+#error "EVENT_QUEUE_LEN must be a power of two, at least 2"
+#endif
+
+typedef void (*event_handler_t)(uint32_t arg);
+
+/**
+ * @brief  Empty every level. Call before enabling interrupts that post.
+ */
+void event_init(void);
+
+/**
+ * @brief  Queue fn(arg) at a priority level. Safe from any context.
+ * @param  prio 0 .. EVENT_PRIOS - 1, higher runs first
+ * @retval 0 on success, -1 if the level is full or prio is out of range
+ */
+int event_post(uint32_t prio, event_handler_t fn, uint32_t arg);
+
+/**
+ * @brief  Run the oldest event of the most urgent non-empty level.
+ *         Thread mode only.
+ * @retval 0 if a handler ran, -1 if nothing was queued
+ */
+int event_dispatch(void);
+
+/**
+ * @brief  Dispatch events forever, calling event_idle() when none are
+ *         queued.
+ */
+void event_run(void) __attribute__((noreturn));
+
+/**
+ * @brief  Called by event_run() with interrupts masked (PRIMASK) once the
+ *         queues are found empty; a pending interrupt still ends WFI and
+ *         is taken once the loop unmasks. Weak: the default executes WFI.
+ *         Override it to enter a deeper sleep mode.
+ */
+void event_idle(void);
+
+#endif /* EVENT_H_ */
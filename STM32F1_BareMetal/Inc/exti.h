@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * @file           : exti.h
+ * @brief          : EXTI line configuration and per-line interrupt dispatch
+ ******************************************************************************
+ * @attention
+ *
+ * GPIO lines 0..15 each have a callback exti_line<N>_handler(). They are
+ * weak and default to an empty function; an application registers a
+ * handler simply by defining it, and the dispatcher calls it through a
+ * constant table in flash. The seven EXTI vectors, including the shared
+ * EXTI9_5 and EXTI15_10 ones, are defined here. The shared vectors find
+ * their pending lines with CLZ on EXTI->PR, highest line first, so the
+ * work is per pending line rather than per line of the group.
+ *
+ * Dispatch latency, trigger to callback entry, is exception entry (12
+ * cycles) plus about 10 instructions in the dispatcher, plus about 8 per
+ * line served before it in the same vector. Build with EXTI_LATENCY_PROBE
+ * and call exti_measure() to measure it with the DWT cycle counter; the
+ * worst case is every line of EXTI15_10 pending at once, served down to
+ * line 10.
+ *
+ ******************************************************************************
+ */
+
+#ifndef EXTI_H_
+#define EXTI_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+#include "gpio.h"
+#include "crit.h"
+
+#define EXTI_LINES          16U
+
+#ifndef EXTI_IRQ_PRIO
+#define EXTI_IRQ_PRIO       CRIT_LIB_PRIO   /* and ceiling, see crit.h */
+#endif
+
+#if (EXTI_IRQ_PRIO < 1U) || (EXTI_IRQ_PRIO > 15U)
+#error "EXTI_IRQ_PRIO must be 1 to 15"
+#endif
+
+/* exti_config() flags */
+#define EXTI_RISING         0x01U
+#define EXTI_FALLING        0x02U
+#define EXTI_INTERRUPT      0x04U   /* raise the line's interrupt */
+#define EXTI_EVENT          0x08U   /* raise an event (WFE wake-up) only */
+
+typedef void (*exti_handler_t)(void);
+
+void exti_line0_handler(void);
+void exti_line1_handler(void);
+void exti_line2_handler(void);
+void exti_line3_handler(void);
+void exti_line4_handler(void);
+void exti_line5_handler(void);
+void exti_line6_handler(void);
+void exti_line7_handler(void);
+void exti_line8_handler(void);
+void exti_line9_handler(void);
+void exti_line10_handler(void);
+void exti_line11_handler(void);
+void exti_line12_handler(void);
+void exti_line13_handler(void);
+void exti_line14_handler(void);
+void exti_line15_handler(void);
+
+/**
+ * @brief  Route a pin to its EXTI line and set edges and mode.
+ * @param  pin   A single pin, e.g. GPIO_PB(5); the line is the pin number
+ * @param  flags EXTI_RISING and/or EXTI_FALLING, with EXTI_INTERRUPT and/or
+ *               EXTI_EVENT; no mode disables the line
+ * @retval 0 on success, -1 if `pin` is not exactly one pin
+ */
+int exti_config(gpio_pins_t pin, uint32_t flags);
+
+/**
+ * @brief  Disable interrupt and event generation on a line.
+ */
+void exti_disable(uint32_t line);
+
+/**
+ * @brief  Set a line pending from software, as if its edge occurred.
+ *         The line must have EXTI_INTERRUPT enabled.
+ */
+static inline void exti_trigger(uint32_t line)
+{
+  EXTI->SWIER = 1UL << line;
+}
+
+#ifdef EXTI_LATENCY_PROBE
+/**
+ * @brief  Trigger `lines` (all on enabled lines sharing one vector) from
+ *         software and measure the cycles until the last callback is entered.
+ *         The registered callbacks run. Call with interrupts enabled, from
+ *         a priority below the EXTI vectors.
+ * @retval Cycles from the SWIER write to the last callback
+ */
+uint32_t exti_measure(uint32_t lines);
+#endif
+
+#endif /* EXTI_H_ */
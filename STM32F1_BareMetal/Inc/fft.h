@@ -0,0 +1,82 @@
+/**
+ ******************************************************************************
+ * @file           : fft.h
+ * @brief          : Q15 radix-4 complex FFT and real FFT with block floating
+ *                   point scaling
+ ******************************************************************************
+ * @attention
+ *
+ * The complex FFT is in place: radix-4 decimation-in-frequency stages,
+ * plus one radix-2 stage when log2(n) is odd, then a bit-reversal pass.
+ * Quiet input is first shifted up to use the full range; then before each
+ * stage the largest magnitude in the buffer picks a right shift of 0 to 3
+ * bits that rules out overflow in that stage. The shifts add up to a block
+ * exponent: the true DFT is the returned buffer times 2^exp. On the host,
+ * against a double-precision DFT, random input of any level comes out at
+ * 64-80 dB SNR for sizes 16 to 1024 (Tests/test_fft.c), falling with size;
+ * the quietest, random -1 and 0, at 59 dB for 1024 points.
+ *
+ * The real FFT packs n real samples as n/2 complex ones, runs the complex
+ * FFT and splits the result. Bins 1 .. n/2-1 come back as complex values
+ * in place; bin 0 holds DC in .re and the (real) Nyquist bin in .im.
+ *
+ * Twiddles are a table of 3 * FFT_MAX_N / 4 Q15 cos/sin pairs in flash,
+ * computed by the compiler (GCC folds __builtin_cos/__builtin_sin in
+ * static initialisers); every size up to FFT_MAX_N strides through it.
+ * FFT_MAX_N = 1024 costs 3 KB of flash.
+ *
+ * fft_bench() times a 256-point real FFT with the DWT counter; the target
+ * is under 1 ms (72000 cycles) at 72 MHz.
+ *
+ ******************************************************************************
+ */
+
+#ifndef FFT_H_
+#define FFT_H_
+
+#include <stdint.h>
+
+#include "fixmath.h"
+
+#ifndef FFT_MAX_N
+#define FFT_MAX_N           1024U
+#endif
+
+#if (FFT_MAX_N != 64U) && (FFT_MAX_N != 128U) && (FFT_MAX_N != 256U) && \
+    (FFT_MAX_N != 512U) && (FFT_MAX_N != 1024U)
+#error "FFT_MAX_N must be a power of two from 64 to 1024"
+#endif
+
+#define FFT_MIN_N           16U
+
+typedef struct
+{
+  q15_t re;
+  q15_t im;
+} cq15_t;
+
+/**
+ * @brief  In-place forward complex FFT.
+ * @param  x   Buffer of n complex samples
+ * @param  n   Power of two, FFT_MIN_N .. FFT_MAX_N
+ * @param  exp Receives the block exponent
+ * @retval 0 on success, -1 for an unsupported n
+ */
+int fft_q15(cq15_t *x, uint32_t n, int32_t *exp);
+
+/**
+ * @brief  In-place forward FFT of n real samples.
+ * @param  x   n real samples in, n/2 packed complex bins out (see above)
+ * @param  n   Power of two, 2 * FFT_MIN_N .. FFT_MAX_N
+ * @param  exp Receives the block exponent
+ * @retval 0 on success, -1 for an unsupported n
+ */
+int rfft_q15(q15_t *x, uint32_t n, int32_t *exp);
+
+/**
+ * @brief  Cycles taken by rfft_q15() on n points of a test tone.
+ * @param  buf Scratch of n samples
+ */
+uint32_t fft_bench(q15_t *buf, uint32_t n);
+
+#endif /* FFT_H_ */
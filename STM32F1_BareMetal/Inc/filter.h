@@ -0,0 +1,190 @@
+/**
+ ******************************************************************************
+ * @file           : filter.h
+ * @brief          : Q15/Q31 FIR, decimating FIR and cascaded biquad filters
+ ******************************************************************************
+ * @attention
+ *
+ * Filters run on whole blocks. Every product goes into a 64-bit
+ * accumulator (SMLAL), so a sum cannot overflow before the single rounding
+ * and saturation at the output. The tap loop is unrolled FILTER_UNROLL
+ * times (1, 2 or 4).
+ *
+ * The processing functions are placed with FILTER_RAMFUNC, by default in
+ * .RamFunc, which the startup code copies to SRAM. SRAM has no wait states,
+ * but instruction fetches then share the S-bus with the data loads, so
+ * time both placements with dwt_cycles() at the clock in use. Define
+ * FILTER_RAMFUNC empty to keep them in flash.
+ *
+ * FIR state is a linear buffer of taps + block - 1 samples: the history,
+ * then room for one block of input. Coefficients are in natural order,
+ * b[0] weighting the newest sample. A decimating FIR computes one output
+ * per `decim` inputs and keeps its phase across calls, so blocks of any
+ * length may be fed.
+ *
+ * Biquads are Direct Form I with four state words per stage:
+ *
+ *   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] + a1 y[n-1] + a2 y[n-2]
+ *
+ * with a1 and a2 stored negated (as in CMSIS-DSP) so every term is a
+ * multiply-accumulate. Coefficients are scaled by 2^-shift to fit: shift 1
+ * covers any stable second-order section (|a1| < 2).
+ *
+ * The design macros below fold to constants in static initialisers (GCC
+ * evaluates __builtin_sin/__builtin_cos at compile time), so tables cost
+ * nothing at run time and need no float code:
+ *
+ *   static const q31_t lp[5] = { BIQUAD_LPF(BIQUAD_Q31, 0.02, 0.7071, 1) };
+ *   static const q15_t h[3] = { Q15(FIR_LPF_TAP(0, 3, 0.1)),
+ *                               Q15(FIR_LPF_TAP(1, 3, 0.1)),
+ *                               Q15(FIR_LPF_TAP(2, 3, 0.1)) };
+ *
+ * Frequencies are fractions of the sample rate, 0 to 0.5.
+ *
+ ******************************************************************************
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stdint.h>
+
+#include "fixmath.h"
+
+#ifndef FILTER_UNROLL
+#define FILTER_UNROLL       4
+#endif
+
+#if (FILTER_UNROLL != 1) && (FILTER_UNROLL != 2) && (FILTER_UNROLL != 4)
+#error "FILTER_UNROLL must be 1, 2 or 4"
+#endif
+
+#ifndef FILTER_RAMFUNC
+#define FILTER_RAMFUNC      __attribute__((section(".RamFunc"), noinline))
+#endif
+
+/* Compile-time design helpers */
+#define FILTER_PI           3.14159265358979323846
+
+/* Tap i of an n-tap (n >= 2) Hamming-windowed sinc low-pass with cutoff
+ * fc. The taps are not normalised: DC gain is within 1% of unity from
+ * about 3 / fc taps, lower for shorter filters. */
+#define FIR_SINC(t, fc)     (((t) == 0.0) ? 2.0 * (fc) : \
+                             __builtin_sin(2.0 * FILTER_PI * (fc) * (t)) / \
+                             (FILTER_PI * (t)))
+#define FIR_LPF_TAP(i, n, fc) \
+  (FIR_SINC((double)(i) - ((n) - 1) / 2.0, fc) * \
+   (0.54 - 0.46 * __builtin_cos(2.0 * FILTER_PI * (i) / ((n) - 1))))
+
+/* Coefficient formats for the biquad macros: value and shift */
+#define BIQUAD_Q31(v, shift) Q31((v) / (double)(1UL << (shift)))
+#define BIQUAD_Q15(v, shift) Q15((v) / (double)(1UL << (shift)))
+
+/* RBJ cookbook sections: f0 a fraction of fs, q the quality factor */
+#define BIQUAD_COS(f)       __builtin_cos(2.0 * FILTER_PI * (f))
+#define BIQUAD_ALPHA(f, q)  (__builtin_sin(2.0 * FILTER_PI * (f)) / (2.0 * (q)))
+
+#define BIQUAD_NORM(fmt, shift, b0, b1, b2, a0, a1, a2) \
+  fmt((b0) / (a0), shift), fmt((b1) / (a0), shift), \
+  fmt((b2) / (a0), shift), fmt(-(a1) / (a0), shift), \
+  fmt(-(a2) / (a0), shift)
+
+#define BIQUAD_LPF(fmt, f, q, shift) \
+  BIQUAD_NORM(fmt, shift, (1.0 - BIQUAD_COS(f)) / 2.0, 1.0 - BIQUAD_COS(f), \
+              (1.0 - BIQUAD_COS(f)) / 2.0, 1.0 + BIQUAD_ALPHA(f, q), \
+              -2.0 * BIQUAD_COS(f), 1.0 - BIQUAD_ALPHA(f, q))
+
+#define BIQUAD_HPF(fmt, f, q, shift) \
+  BIQUAD_NORM(fmt, shift, (1.0 + BIQUAD_COS(f)) / 2.0, \
+              -(1.0 + BIQUAD_COS(f)), (1.0 + BIQUAD_COS(f)) / 2.0, \
+              1.0 + BIQUAD_ALPHA(f, q), -2.0 * BIQUAD_COS(f), \
+              1.0 - BIQUAD_ALPHA(f, q))
+
+/* Band-pass with 0 dB peak gain */
+#define BIQUAD_BPF(fmt, f, q, shift) \
+  BIQUAD_NORM(fmt, shift, BIQUAD_ALPHA(f, q), 0.0, -BIQUAD_ALPHA(f, q), \
+              1.0 + BIQUAD_ALPHA(f, q), -2.0 * BIQUAD_COS(f), \
+              1.0 - BIQUAD_ALPHA(f, q))
+
+#define BIQUAD_NOTCH(fmt, f, q, shift) \
+  BIQUAD_NORM(fmt, shift, 1.0, -2.0 * BIQUAD_COS(f), 1.0, \
+              1.0 + BIQUAD_ALPHA(f, q), -2.0 * BIQUAD_COS(f), \
+              1.0 - BIQUAD_ALPHA(f, q))
+
+typedef struct
+{
+  const q15_t *coeffs;
+  q15_t *state;             /* taps + block - 1 samples */
+  uint16_t taps;
+  uint16_t block;
+  uint16_t decim;
+  uint16_t phase;
+} fir_q15_t;
+
+typedef struct
+{
+  const q31_t *coeffs;
+  q31_t *state;
+  uint16_t taps;
+  uint16_t block;
+  uint16_t decim;
+  uint16_t phase;
+} fir_q31_t;
+
+typedef struct
+{
+  const q15_t *coeffs;      /* 5 per stage: b0, b1, b2, -a1, -a2 */
+  q15_t *state;             /* 4 per stage */
+  uint8_t stages;
+  uint8_t shift;
+} biquad_q15_t;
+
+typedef struct
+{
+  const q31_t *coeffs;
+  q31_t *state;
+  uint8_t stages;
+  uint8_t shift;
+} biquad_q31_t;
+
+/**
+ * @brief  Set up a FIR and clear its history.
+ * @param  taps  Number of coefficients, at least 1
+ * @param  decim Decimation factor, 1 for a plain FIR
+ * @param  state taps + block - 1 samples
+ * @param  block Samples moved through the state per pass; larger blocks
+ *               amortise the history copy
+ * @retval 0 on success, -1 on invalid parameters
+ */
+int fir_q15_init(fir_q15_t *f, const q15_t *coeffs, uint16_t taps,
+                 uint16_t decim, q15_t *state, uint16_t block);
+int fir_q31_init(fir_q31_t *f, const q31_t *coeffs, uint16_t taps,
+                 uint16_t decim, q31_t *state, uint16_t block);
+
+/**
+ * @brief  Filter n samples. in and out may be the same buffer.
+ * @retval Number of outputs written: n for decim 1, otherwise n / decim
+ *         give or take one depending on the phase
+ */
+uint32_t fir_q15(fir_q15_t *f, const q15_t *in, q15_t *out, uint32_t n);
+uint32_t fir_q31(fir_q31_t *f, const q31_t *in, q31_t *out, uint32_t n);
+
+/**
+ * @brief  Set up a biquad cascade and clear its state.
+ * @param  coeffs 5 * stages values scaled by 2^-shift
+ * @param  state  4 * stages values
+ * @retval 0 on success, -1 on invalid parameters
+ */
+int biquad_q15_init(biquad_q15_t *f, const q15_t *coeffs, uint8_t stages,
+                    uint8_t shift, q15_t *state);
+int biquad_q31_init(biquad_q31_t *f, const q31_t *coeffs, uint8_t stages,
+                    uint8_t shift, q31_t *state);
+
+/**
+ * @brief  Filter n samples through every stage. in and out may be the
+ *         same buffer.
+ */
+void biquad_q15(biquad_q15_t *f, const q15_t *in, q15_t *out, uint32_t n);
+void biquad_q31(biquad_q31_t *f, const q31_t *in, q31_t *out, uint32_t n);
+
+#endif /* FILTER_H_ */
@@ -0,0 +1,251 @@
+/**
+ ******************************************************************************
+ * @file           : fixmath.h
+ * @brief          : Q15/Q31 fixed-point arithmetic, CORDIC trig, sqrt and
+ *                   log2/exp2
+ ******************************************************************************
+ * @attention
+ *
+ * Q15 is int16_t scaled by 2^15 and Q31 int32_t scaled by 2^31, both in
+ * [-1, 1). Results that do not fit saturate; nothing wraps. Angles are
+ * binary: a Q31 angle of 1.0 is pi, so the full int32_t range is one turn
+ * and wraps for free. log2/exp2 work in unsigned/signed Q16.16.
+ *
+ * The arithmetic maps onto SSAT, SMULL/SMLAL, UMULL and CLZ; the header
+ * falls back to plain C off-target so the library also builds on the host.
+ *
+ * Bounds below are the worst error seen on the host against double
+ * precision, in LSBs of the result format: every input for the one-argument
+ * Q15 functions, 10^7 random Q31 / Q16.16 inputs for the rest. Cycles are
+ * estimated from the instruction sequence with Cortex-M3 timings, zero wait
+ * states, call excluded; they have not been timed on the target, so check
+ * them with dwt_cycles() before relying on them.
+ *
+ *   function        cycles   error
+ *   q15_add/sub          2   exact (saturated)
+ *   q15_mul              3   0.5 (rounded)
+ *   q31_add/sub          5   exact (saturated)
+ *   q31_mul           9-11   0.5 (rounded)
+ *   q31_mac            4-7   exact (64-bit accumulator)
+ *   q31_recip           60   0.5 of the mantissa
+ *   q31_div             90   0.5
+ *   q31_sqrt            85   0.5
+ *   q15_sqrt            95   0.5
+ *   q31_sincos         290   41 (1.9e-8)
+ *   q15_sin/cos        300   0.5
+ *   q31_atan2          290   22 (1.0e-8 * pi)
+ *   q31_mag            300   50
+ *   fix_log2            35   0.62
+ *   fix_exp2            45   0.5 + 2^-28.8 relative
+ *
+ ******************************************************************************
+ */
+
+#ifndef FIXMATH_H_
+#define FIXMATH_H_
+
+#include <stdint.h>
+
+#if defined(__arm__)
+#include "cmsis_compiler.h"
+#endif
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+/* Compile-time constants: Q15(0.5), Q31(-0.25). The argument must be in
+ * [-1, 1); 1.0 is clamped to the largest positive value. */
+#define Q15(x)              ((q15_t)(((x) >= 1.0) ? 0x7FFF : \
+                             ((x) * 32768.0 + (((x) < 0) ? -0.5 : 0.5))))
+#define Q31(x)              ((q31_t)(((x) >= 1.0) ? 0x7FFFFFFF : \
+                             ((x) * 2147483648.0 + (((x) < 0) ? -0.5 : 0.5))))
+
+#define Q15_MAX             ((q15_t)0x7FFF)
+#define Q15_MIN             ((q15_t)-0x8000)
+#define Q31_MAX             ((q31_t)0x7FFFFFFF)
+#define Q31_MIN             ((q31_t)(-0x7FFFFFFF - 1))
+
+/* Binary angles */
+#define FIX_ANGLE_PI        Q31_MIN                 /* also -pi */
+#define FIX_ANGLE_PI_2      ((q31_t)0x40000000)
+
+#if defined(__arm__)
+#define FIX_SSAT16(x)       ((q15_t)__SSAT((x), 16))
+#define FIX_CLZ(x)          ((uint32_t)__CLZ(x))
+#else
+#define FIX_SSAT16(x)       ((q15_t)(((x) > 0x7FFF) ? 0x7FFF : \
+                             (((x) < -0x8000) ? -0x8000 : (x))))
+#define FIX_CLZ(x)          (((x) != 0U) ? (uint32_t)__builtin_clz(x) : 32U)
+#endif
+
+/* Inline even at -O0: filter.c calls these from RAM functions, which
+ * must not call back into flash */
+#define FIX_INLINE          static inline __attribute__((always_inline))
+
+/* Functions */
+FIX_INLINE q15_t q15_sat(int32_t x)
+{
+  return FIX_SSAT16(x);
+}
+
+FIX_INLINE q15_t q15_add(q15_t a, q15_t b)
+{
+  return FIX_SSAT16((int32_t)a + b);
+}
+
+FIX_INLINE q15_t q15_sub(q15_t a, q15_t b)
+{
+  return FIX_SSAT16((int32_t)a - b);
+}
+
+/**
+ * @brief  a * b rounded to nearest; -1 * -1 saturates.
+ */
+FIX_INLINE q15_t q15_mul(q15_t a, q15_t b)
+{
+  return FIX_SSAT16(((int32_t)a * b + 0x4000) >> 15);
+}
+
+FIX_INLINE q31_t q31_sat(int64_t x)
+{
+  if (x > Q31_MAX)
+  {
+    return Q31_MAX;
+  }
+  if (x < Q31_MIN)
+  {
+    return Q31_MIN;
+  }
+  return (q31_t)x;
+}
+
+FIX_INLINE q31_t q31_add(q31_t a, q31_t b)
+{
+  uint32_t sum = (uint32_t)a + (uint32_t)b;
+
+  /* Overflow only when both operands have the sign the sum lacks */
+  if ((int32_t)(((uint32_t)a ^ sum) & ((uint32_t)b ^ sum)) < 0)
+  {
+    return (a < 0) ? Q31_MIN : Q31_MAX;
+  }
+  return (q31_t)sum;
+}
+
+FIX_INLINE q31_t q31_sub(q31_t a, q31_t b)
+{
+  uint32_t diff = (uint32_t)a - (uint32_t)b;
+
+  if ((int32_t)(((uint32_t)a ^ (uint32_t)b) & ((uint32_t)a ^ diff)) < 0)
+  {
+    return (a < 0) ? Q31_MIN : Q31_MAX;
+  }
+  return (q31_t)diff;
+}
+
+/**
+ * @brief  a * b rounded to nearest (SMULL); -1 * -1 saturates.
+ */
+FIX_INLINE q31_t q31_mul(q31_t a, q31_t b)
+{
+  int64_t p = ((int64_t)a * b + 0x40000000) >> 31;
+
+  return (p > Q31_MAX) ? Q31_MAX : (q31_t)p;
+}
+
+/**
+ * @brief  acc + a * b in Q62 (SMLAL). Accumulate a dot product here and
+ *         convert once with q31_from_acc().
+ */
+FIX_INLINE int64_t q31_mac(int64_t acc, q31_t a, q31_t b)
+{
+  return acc + (int64_t)a * b;
+}
+
+FIX_INLINE q31_t q31_from_acc(int64_t acc)
+{
+  return q31_sat((acc + 0x40000000) >> 31);
+}
+
+FIX_INLINE q15_t q15_from_q31(q31_t x)
+{
+  return FIX_SSAT16((x >> 16) + ((x >> 15) & 1));
+}
+
+FIX_INLINE q31_t q31_from_q15(q15_t x)
+{
+  return (q31_t)((uint32_t)(int32_t)x << 16);
+}
+
+/**
+ * @brief  Reciprocal with a separate exponent: 1/x = r * 2^shift.
+ * @param  x     Divisor, any non-zero Q31
+ * @param  shift Receives 0..32
+ * @retval r, |r| in [0.5, 1), same sign as x. x = 0 returns Q31_MAX with a
+ *         shift of 32.
+ */
+q31_t q31_recip(q31_t x, int32_t *shift);
+
+/**
+ * @brief  a / b, correctly rounded; saturates when |a| >= |b|.
+ */
+q31_t q31_div(q31_t a, q31_t b);
+
+/**
+ * @brief  Square root, correctly rounded. Negative x returns 0.
+ */
+q31_t q31_sqrt(q31_t x);
+q15_t q15_sqrt(q15_t x);
+
+/**
+ * @brief  Sine and cosine of a binary angle (CORDIC, 30 iterations).
+ * @param  angle Q31, 1.0 = pi
+ * @param  s     Receives sin(angle), may be NULL
+ * @param  c     Receives cos(angle), may be NULL
+ */
+void q31_sincos(q31_t angle, q31_t *s, q31_t *c);
+
+/**
+ * @brief  Angle of the vector (x, y) as a binary angle, 1.0 = pi. The
+ *         origin returns 0.
+ */
+q31_t q31_atan2(q31_t y, q31_t x);
+
+/**
+ * @brief  sqrt(x^2 + y^2), saturated at Q31_MAX.
+ */
+q31_t q31_mag(q31_t x, q31_t y);
+
+/**
+ * @brief  log2 of an unsigned Q16.16 value, in signed Q16.16. x = 0
+ *         returns INT32_MIN.
+ */
+int32_t fix_log2(uint32_t x);
+
+/**
+ * @brief  2^x for a signed Q16.16 exponent, in unsigned Q16.16. Saturates
+ *         at 0xFFFFFFFF for x >= 16 and rounds to 0 below -17.
+ */
+uint32_t fix_exp2(int32_t x);
+
+FIX_INLINE q15_t q15_sin(q15_t angle)
+{
+  q31_t s;
+
+  q31_sincos(q31_from_q15(angle), &s, (q31_t *)0);
+  return q15_from_q31(s);
+}
+
+FIX_INLINE q15_t q15_cos(q15_t angle)
+{
+  q31_t c;
+
+  q31_sincos(q31_from_q15(angle), (q31_t *)0, &c);
+  return q15_from_q31(c);
+}
+
+FIX_INLINE q15_t q15_atan2(q15_t y, q15_t x)
+{
+  return q15_from_q31(q31_atan2(q31_from_q15(y), q31_from_q15(x)));
+}
+
+#endif /* FIXMATH_H_ */
@@ -0,0 +1,211 @@
+/**
+ ******************************************************************************
+ * @file           : gpio.h
+ * @brief          : GPIO pin sets with per-port folding of configuration and
+ *                   output writes
+ ******************************************************************************
+ * @attention
+ *
+ * A gpio_pins_t holds any set of pins on ports A..D, 16 bits per port
+ * (GPIOE is not bonded out on the F103C8). Pins are combined with `|`:
+ *
+ *   #define LED       GPIO_PC(13)
+ *   #define SPI_OUT   (GPIO_PA(5) | GPIO_PA(7))
+ *
+ *   gpio_enable(SPI_OUT | LED | GPIO_PA(4) | GPIO_PB(12));
+ *   gpio_config(SPI_OUT, GPIO_AF_PP_50MHZ);
+ *   gpio_write(GPIO_PA(4) | LED, GPIO_PB(12));
+ *
+ * gpio_enable() turns on the port clocks once, at start-up; the other
+ * calls leave RCC alone. With a constant set every test on an unused port
+ * is a constant, written so the optimiser can drop it and leave at most
+ * one CRL and one CRH read-modify-write per port for gpio_config(), and
+ * one BSRR (or BRR) store per port for gpio_set/clear/write(). That needs
+ * the optimiser (the Release -Os build); at -O0 the tests remain. Check
+ * the listing of the build in use before counting on single stores: the
+ * Thumb output has not been verified here.
+ *
+ * BSRR/BRR stores are atomic and may be used from any context. CRL/CRH
+ * updates are read-modify-write; configure pins from one context, normally
+ * at start-up.
+ *
+ ******************************************************************************
+ */
+
+#ifndef GPIO_H_
+#define GPIO_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+#include "bitband.h"
+
+typedef uint64_t gpio_pins_t;
+
+#define GPIO_PA(n)          ((gpio_pins_t)1U << (n))
+#define GPIO_PB(n)          ((gpio_pins_t)1U << (16U + (n)))
+#define GPIO_PC(n)          ((gpio_pins_t)1U << (32U + (n)))
+#define GPIO_PD(n)          ((gpio_pins_t)1U << (48U + (n)))
+
+/* Pin modes: CNF[1:0]:MODE[1:0] nibble, plus pull selection through ODR */
+#define GPIO_IN_ANALOG      0x0U
+#define GPIO_IN_FLOAT       0x4U
+#define GPIO_IN_PULLUP      0x18U
+#define GPIO_IN_PULLDOWN    0x28U
+#define GPIO_OUT_PP_10MHZ   0x1U
+#define GPIO_OUT_PP_2MHZ    0x2U
+#define GPIO_OUT_PP_50MHZ   0x3U
+#define GPIO_OUT_OD_10MHZ   0x5U
+#define GPIO_OUT_OD_2MHZ    0x6U
+#define GPIO_OUT_OD_50MHZ   0x7U
+#define GPIO_AF_PP_10MHZ    0x9U
+#define GPIO_AF_PP_2MHZ     0xAU
+#define GPIO_AF_PP_50MHZ    0xBU
+#define GPIO_AF_OD_10MHZ    0xDU
+#define GPIO_AF_OD_2MHZ     0xEU
+#define GPIO_AF_OD_50MHZ    0xFU
+
+#define GPIO_MODE_PULLUP    0x10U
+#define GPIO_MODE_PULLDOWN  0x20U
+
+static inline GPIO_TypeDef *gpio_port(uint32_t port)
+{
+  return (GPIO_TypeDef *)(GPIOA_BASE + (GPIOB_BASE - GPIOA_BASE) * port);
+}
+
+static inline uint32_t gpio_port_mask(gpio_pins_t pins, uint32_t port)
+{
+  return (uint32_t)(pins >> (16U * port)) & 0xFFFFU;
+}
+
+/* Bit i of an 8-bit pin mask to bit 4*i: one configuration nibble per pin */
+static inline uint32_t gpio_spread4(uint32_t m)
+{
+  m = (m | (m << 12)) & 0x000F000FUL;
+  m = (m | (m << 6)) & 0x03030303UL;
+  m = (m | (m << 3)) & 0x11111111UL;
+  return m;
+}
+
+__STATIC_FORCEINLINE void gpio_config_port(uint32_t port, uint32_t m,
+                                           uint32_t mode)
+{
+  GPIO_TypeDef *g = gpio_port(port);
+  uint32_t cnf = mode & 0xFU;
+
+  if (m == 0U)
+  {
+    return;
+  }
+  if (m & 0xFFU)
+  {
+    uint32_t s = gpio_spread4(m & 0xFFU);
+
+    g->CRL = (g->CRL & ~(s * 0xFU)) | (s * cnf);
+  }
+  if (m >> 8)
+  {
+    uint32_t s = gpio_spread4(m >> 8);
+
+    g->CRH = (g->CRH & ~(s * 0xFU)) | (s * cnf);
+  }
+  if (mode & GPIO_MODE_PULLUP)
+  {
+    g->BSRR = m;
+  }
+  else if (mode & GPIO_MODE_PULLDOWN)
+  {
+    g->BRR = m;
+  }
+}
+
+__STATIC_FORCEINLINE void gpio_enable_port(uint32_t port, uint32_t m)
+{
+  if (m != 0U)
+  {
+    BB_PERIPH(RCC->APB2ENR, RCC_APB2ENR_IOPAEN_Pos + port) = 1U;
+  }
+}
+
+/**
+ * @brief  Enable the clocks of the ports in a pin set, before configuring
+ *         any of them.
+ */
+__STATIC_FORCEINLINE void gpio_enable(gpio_pins_t pins)
+{
+  gpio_enable_port(0U, gpio_port_mask(pins, 0U));
+  gpio_enable_port(1U, gpio_port_mask(pins, 1U));
+  gpio_enable_port(2U, gpio_port_mask(pins, 2U));
+  gpio_enable_port(3U, gpio_port_mask(pins, 3U));
+  (void)RCC->APB2ENR;   /* let the enable settle before the first access */
+}
+
+/**
+ * @brief  Configure a set of pins to one mode. Their ports must be enabled
+ *         (gpio_enable()).
+ * @param  pins Pin set, GPIO_Px(n) values or'ed together
+ * @param  mode One of the GPIO_IN_*, GPIO_OUT_* or GPIO_AF_* values
+ */
+__STATIC_FORCEINLINE void gpio_config(gpio_pins_t pins, uint32_t mode)
+{
+  gpio_config_port(0U, gpio_port_mask(pins, 0U), mode);
+  gpio_config_port(1U, gpio_port_mask(pins, 1U), mode);
+  gpio_config_port(2U, gpio_port_mask(pins, 2U), mode);
+  gpio_config_port(3U, gpio_port_mask(pins, 3U), mode);
+}
+
+__STATIC_FORCEINLINE void gpio_write_port(uint32_t port, uint32_t set,
+                                          uint32_t clear)
+{
+  if (set != 0U)
+  {
+    gpio_port(port)->BSRR = set | (clear << 16);
+  }
+  else if (clear != 0U)
+  {
+    gpio_port(port)->BRR = clear;
+  }
+}
+
+/**
+ * @brief  Drive `set` high and `clear` low with one store per port. A pin in
+ *         both sets ends up high.
+ */
+__STATIC_FORCEINLINE void gpio_write(gpio_pins_t set, gpio_pins_t clear)
+{
+  gpio_write_port(0U, gpio_port_mask(set, 0U), gpio_port_mask(clear, 0U));
+  gpio_write_port(1U, gpio_port_mask(set, 1U), gpio_port_mask(clear, 1U));
+  gpio_write_port(2U, gpio_port_mask(set, 2U), gpio_port_mask(clear, 2U));
+  gpio_write_port(3U, gpio_port_mask(set, 3U), gpio_port_mask(clear, 3U));
+}
+
+__STATIC_FORCEINLINE void gpio_set(gpio_pins_t pins)
+{
+  gpio_write(pins, 0U);
+}
+
+__STATIC_FORCEINLINE void gpio_clear(gpio_pins_t pins)
+{
+  gpio_write(0U, pins);
+}
+
+__STATIC_FORCEINLINE gpio_pins_t gpio_read_port(gpio_pins_t pins,
+                                                uint32_t port)
+{
+  if (gpio_port_mask(pins, port) == 0U)
+  {
+    return 0U;
+  }
+  return (gpio_pins_t)(gpio_port(port)->IDR & 0xFFFFU) << (16U * port);
+}
+
+/**
+ * @brief  Sample the inputs of a pin set.
+ * @retval The subset of `pins` that read high
+ */
+__STATIC_FORCEINLINE gpio_pins_t gpio_read(gpio_pins_t pins)
+{
+  return (gpio_read_port(pins, 0U) | gpio_read_port(pins, 1U) |
+          gpio_read_port(pins, 2U) | gpio_read_port(pins, 3U)) & pins;
+}
+
+#endif /* GPIO_H_ */
@@ -0,0 +1,81 @@
+/**
+ ******************************************************************************
+ * @file           : icap.h
+ * @brief          : Frequency, period and duty measurement with timer input
+ *                   capture and DMA
+ ******************************************************************************
+ * @attention
+ *
+ * One measurement channel per timer (TIM2..TIM4). The input is captured on
+ * two channels: rising edges directly, falling edges through the indirect
+ * (paired) input. DMA writes every captured CCR value into a circular ring,
+ * so edges cost no CPU time. The timer update interrupt, once per counter
+ * period, extends only the newest time stamps to 32 bits and advances the
+ * reciprocal counter in icap_calc.h. The DMA transfer-complete interrupt,
+ * once per ICAP_RING_LEN captures, counts ring wraps.
+ *
+ * At high rates the input prescaler is switched between 1, 2, 4 and 8 edges
+ * per capture to keep the DMA load bounded; the window restarts on a switch.
+ *
+ *   Timer  Input          Rising (DMA1)   Falling (DMA1)
+ *   TIM2   PA0  (TI1)     CH1 (ch 5)      CH2 (ch 7)
+ *   TIM3   PB0  (TI3)     CH3 (ch 2)      CH4 (ch 3)
+ *   TIM4   PB6  (TI1)     CH1 (ch 1)      CH2 (ch 4)
+ *
+ * The input pins are used in their reset state (floating input).
+ *
+ ******************************************************************************
+ */
+
+#ifndef ICAP_H_
+#define ICAP_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+#include "icap_calc.h"
+
+#ifndef ICAP_RING_LEN
+#define ICAP_RING_LEN     64U   /* captures per ring, power of two */
+#endif
+
+typedef struct
+{
+  uint8_t ccr;                  /* timer channel, 1..4 */
+  uint8_t dma;                  /* DMA1 channel */
+  uint16_t ring[ICAP_RING_LEN];
+  volatile uint32_t wraps;      /* ring wraps, counted by DMA TC */
+  uint32_t last_total;
+} icap_chan_t;
+
+typedef struct
+{
+  TIM_TypeDef *tim;
+  icap_chan_t rise;
+  icap_chan_t fall;
+  uint16_t ovf;                 /* counter periods, extends time stamps */
+  uint8_t psc_log2;             /* input prescaler, edges = 1 << psc_log2 */
+  icap_calc_t calc;
+  volatile uint32_t seq;        /* odd while `result` is being written */
+  icap_result_t result;
+} icap_t;
+
+/**
+ * @brief  Start measuring on a timer.
+ * @param  c       Measurement state, must stay valid while running
+ * @param  tim     TIM2, TIM3 or TIM4
+ * @param  f_tick  Timer kernel clock in Hz (the counter runs unprescaled)
+ * @param  gate_us Minimum measurement window in microseconds
+ * @param  filter  Input filter, ICxF value 0..15
+ * @retval 0 on success, -1 if the timer or its DMA channels are unavailable
+ */
+int icap_start(icap_t *c, TIM_TypeDef *tim, uint32_t f_tick,
+               uint32_t gate_us, uint32_t filter);
+
+void icap_stop(icap_t *c);
+
+/**
+ * @brief  Copy the latest result; safe against the update interrupt.
+ */
+void icap_read(const icap_t *c, icap_result_t *out);
+
+#endif /* ICAP_H_ */
@@ -0,0 +1,95 @@
+/**
+ ******************************************************************************
+ * @file           : icap_calc.h
+ * @brief          : Reciprocal frequency/period/duty computation from
+ *                   input capture time stamps
+ ******************************************************************************
+ * @attention
+ *
+ * Hardware independent half of the input capture service (icap.h). It works
+ * on a running capture count and 32-bit extended time stamps, so it can be
+ * fed synthetic time stamp streams on the host.
+ *
+ * Reciprocal counting: over a gate window of at least `gate` ticks the
+ * frequency is edges * f_tick / (t_last - t_first), measured between two
+ * captured edges, so the resolution is one tick per window regardless of the
+ * signal frequency.
+ *
+ ******************************************************************************
+ */
+
+#ifndef ICAP_CALC_H_
+#define ICAP_CALC_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint64_t freq_mhz;      /* frequency in millihertz, 0 when no signal;
+                           * 32 bits would stop at 4.29 MHz */
+  uint32_t period_ns;     /* mean period over the window */
+  uint16_t duty_q16;      /* high time / period, 0..65535 */
+  uint32_t edges;         /* rising edges in the window */
+} icap_result_t;
+
+typedef struct
+{
+  uint32_t f_tick;        /* capture timer tick rate in Hz */
+  uint32_t gate;          /* minimum window length in ticks */
+  uint32_t timeout;       /* report 0 Hz after this many ticks without edge */
+  uint32_t div;           /* rising edges per capture (input prescaler) */
+
+  uint8_t win_open;
+  uint32_t win_count;     /* capture count at window start */
+  uint32_t win_time;      /* extended time stamp at window start */
+
+  uint8_t have_rise;
+  uint8_t have_fall;
+  uint32_t last_count;
+  uint32_t last_rise;
+  uint32_t last_fall;
+
+  icap_result_t result;
+} icap_calc_t;
+
+/**
+ * @brief  Extend a 16-bit capture to 32 bits.
+ * @param  cap Captured counter value
+ * @param  ovf Overflow count sampled together with `now`
+ * @param  now Counter value read after the capture was taken
+ * @note   Valid when the capture is less than one counter period older
+ *         than `now`.
+ */
+static inline uint32_t icap_extend(uint16_t cap, uint16_t ovf, uint16_t now)
+{
+  uint16_t epoch = (cap > now) ? (uint16_t)(ovf - 1U) : ovf;
+
+  return ((uint32_t)epoch << 16) | cap;
+}
+
+void icap_calc_init(icap_calc_t *c, uint32_t f_tick, uint32_t gate,
+                    uint32_t timeout);
+
+/**
+ * @brief  Record rising-edge progress.
+ * @param  count Total captures taken so far (free running, wraps)
+ * @param  ts    Extended time stamp of the latest capture
+ */
+void icap_calc_rise(icap_calc_t *c, uint32_t count, uint32_t ts);
+
+void icap_calc_fall(icap_calc_t *c, uint32_t ts);
+
+/**
+ * @brief  Close the window once the gate time has passed, or report 0 Hz
+ *         after the timeout. Call at least once per counter period.
+ * @param  now Extended current time
+ * @retval 1 if a new result was produced
+ */
+int icap_calc_poll(icap_calc_t *c, uint32_t now);
+
+/**
+ * @brief  Change the edges-per-capture ratio; restarts the window.
+ */
+void icap_calc_set_div(icap_calc_t *c, uint32_t div);
+
+#endif /* ICAP_CALC_H_ */
@@ -0,0 +1,124 @@
+/**
+ ******************************************************************************
+ * @file           : idle.h
+ * @brief          : Tickless idle in Sleep or Stop mode, timed by the RTC
+ ******************************************************************************
+ * @attention
+ *
+ * idle.c replaces the event loop's event_idle(). Until idle_init() has
+ * succeeded it executes WFI like the default. After that, each time the
+ * loop runs dry it asks the timing wheel (wheel_next()) and the sleeping
+ * coroutines (coro_next()) how many ticks may pass before something falls
+ * due:
+ *
+ *  - fewer than IDLE_STOP_MIN: Sleep mode, WFI with SysTick running;
+ *  - otherwise: Stop mode. SysTick is halted, the RTC alarm is set for the
+ *    deadline (at most IDLE_STOP_MAX ticks away) and SLEEPDEEP is set with
+ *    PWR_CR PDDS clear, so WFI stops every clock but the LSE. The alarm,
+ *    through EXTI line 17, or any other enabled EXTI interrupt ends it.
+ *
+ * Stop halts every peripheral clock, so a transfer in flight would be cut
+ * short. A driver holds idle_inhibit() while it has one, and releases it
+ * with idle_allow(); while any is held, the idle code stays in Sleep. The
+ * DMA and timer drivers hold one for each claimed channel or timer, so
+ * an encoder holds two, through its claims, until encoder_stop(); the CAN
+ * driver holds one from can_init() on.
+ *
+ * Stop mode leaves the core on the HSI, as after reset, so on waking the
+ * same SystemInit() that ran at reset sets the clocks up again (with none
+ * linked the tree runs on the HSI anyway). SysTick then restarts, and
+ * systick_advance() counts the ticks that passed.
+ *
+ * The tick count is anchored to the RTC: each time the loop goes idle,
+ * and after every Stop, the count is brought up to the anchor plus the
+ * RTC time since it, in LSE periods. The anchor moves on in whole units
+ * of the exact ratio of the two rates (125 ticks to 4096 LSE periods at
+ * 1 kHz), so nothing is rounded away and time does not drift against the
+ * LSE. The count is never set back: if the HSI-timed SysTick runs ahead,
+ * the anchor moves to it, and the RTC measures from there. An anchor
+ * older than half the range of the LSE count is replaced the same way.
+ *
+ * The RTC runs from a 32.768 kHz LSE crystal, prescaled to IDLE_RTC_HZ
+ * for the alarm. idle_init() leaves an RTC that is already running alone,
+ * so the count survives a reset. Kernel tasks (kernel.h) sleep in
+ * kernel_idle(), which stays on WFI.
+ *
+ * idle_get_stats() reports residency in each mode and the wake latency:
+ * the LSE periods (30.5 us) from the alarm to the first RTC read after
+ * waking, and the DWT cycles spent bringing clocks and tick back.
+ *
+ ******************************************************************************
+ */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include <stdint.h>
+#include "systick.h"
+
+#ifndef IDLE_LSE_HZ
+#define IDLE_LSE_HZ         32768UL
+#endif
+
+#ifndef IDLE_RTC_HZ
+#define IDLE_RTC_HZ         1024UL
+#endif
+
+#ifndef IDLE_STOP_MIN
+#define IDLE_STOP_MIN       10UL
+#endif
+
+#ifndef IDLE_STOP_MAX
+#define IDLE_STOP_MAX       (3600UL * SYSTICK_HZ)
+#endif
+
+/* 1: voltage regulator in low-power mode during Stop; slower to wake */
+#ifndef IDLE_LPDS
+#define IDLE_LPDS           1U
+#endif
+
+#if ((IDLE_LSE_HZ % IDLE_RTC_HZ) != 0UL) || \
+    ((IDLE_LSE_HZ / IDLE_RTC_HZ) > 0x100000UL)
+#error "IDLE_RTC_HZ must divide IDLE_LSE_HZ into a 20-bit prescaler"
+#endif
+
+#if ((IDLE_STOP_MIN * IDLE_RTC_HZ) / SYSTICK_HZ) < 2UL
+#error "IDLE_STOP_MIN must span at least two RTC periods"
+#endif
+
+typedef struct
+{
+  uint32_t sleeps;          /* Sleep mode entries */
+  uint32_t stops;           /* Stop mode entries */
+  uint32_t sleep_lse;       /* residency in Sleep, LSE periods */
+  uint32_t stop_lse;        /* residency in Stop, LSE periods */
+  uint32_t alarms;          /* Stops ended by the RTC alarm */
+  uint32_t inhibited;       /* Sleeps that would have been Stops */
+  uint32_t wake_lse_max;    /* alarm to RTC read, LSE periods */
+  uint32_t wake_lse_last;
+  uint32_t restore_max;     /* wake to tick running, cycles */
+} idle_stats_t;
+
+/**
+ * @brief  Start the LSE and RTC, unless the RTC already runs, and enable
+ *         the alarm wake-up. Call after systick_init().
+ * @retval 0 on success, -1 if the LSE did not start (idle stays on WFI)
+ */
+int idle_init(void);
+
+/**
+ * @brief  Keep the idle code out of Stop mode until the matching
+ *         idle_allow(). Nests; callable from interrupts.
+ */
+void idle_inhibit(void);
+
+void idle_allow(void);
+
+/**
+ * @brief  Copy the statistics; residency in Run is the rest of the time.
+ */
+void idle_get_stats(idle_stats_t *out);
+
+void idle_reset_stats(void);
+
+#endif /* IDLE_H_ */
@@ -0,0 +1,195 @@
+/**
+ ******************************************************************************
+ * @file           : kernel.h
+ * @brief          : Minimal preemptive priority kernel
+ ******************************************************************************
+ * @attention
+ *
+ * Tasks have fixed priorities 1 .. KERNEL_PRIOS - 1, higher numbers more
+ * urgent; priority 0 belongs to the kernel's idle task. The most urgent
+ * ready task always runs. Tasks of equal priority run in turn, each until
+ * it blocks or calls kernel_yield(); there is no time slicing.
+ *
+ * Task control blocks, stacks, mutexes and semaphores are all supplied by
+ * the caller, usually as statics; the kernel allocates nothing. A bitmap
+ * of non-empty ready lists is searched with CLZ, so choosing the next task
+ * is O(1) at any number of priorities.
+ *
+ * Switches happen in PendSV at the lowest interrupt priority, so they wait
+ * for every other handler to finish, and for deferred work (defer.h),
+ * which PendSV runs first. PendSV saves and restores only
+ * r4-r11 and the PSP: the hardware stacks r0-r3, r12, lr, pc and xPSR on
+ * exception entry. Tasks run in thread mode on the PSP; handlers keep the
+ * MSP, so task stacks need no room for interrupt nesting beyond the
+ * 8-word hardware frame. A task's stack needs at least 16 words, plus its
+ * own use.
+ *
+ * Mutexes use priority inheritance: while a task waits for a mutex, its
+ * owner (and the owner of any mutex that owner waits for, in turn) runs at
+ * no less than the waiter's priority, until it releases the mutex. Waiters
+ * are served highest priority first.
+ *
+ * Time is the SysTick tick (see systick.h); kernel_start() starts it. The
+ * idle task calls kernel_idle(), weak, which by default executes WFI.
+ * Override it to sleep deeper or to stop the tick while nothing is due.
+ *
+ * kernel_switch_bench() times a kernel_yield() between two tasks with the
+ * DWT counter: call, pend, PendSV entry, save, select, restore and return
+ * into the other task. The estimate is about 70 cycles at -O2, under 1 us
+ * at 72 MHz.
+ *
+ * The kernel's own critical sections and PendSV raise BASEPRI to
+ * KERNEL_CEILING (see crit.h), so interrupts more urgent than that are
+ * never delayed by it, but must not call into it either.
+ *
+ * Blocking calls (kernel_delay, kernel_mutex_lock, kernel_sem_take with a
+ * timeout) are for tasks only. kernel_sem_give() may be called from an
+ * interrupt at KERNEL_CEILING or less urgent.
+ *
+ ******************************************************************************
+ */
+
+#ifndef KERNEL_H_
+#define KERNEL_H_
+
+#include <stdint.h>
+#include "crit.h"
+
+#ifndef KERNEL_PRIOS
+#define KERNEL_PRIOS        8U
+#endif
+
+#if (KERNEL_PRIOS < 2U) || (KERNEL_PRIOS > 32U)
+#error "KERNEL_PRIOS must be 2 to 32"
+#endif
+
+#ifndef KERNEL_CEILING
+#define KERNEL_CEILING      CRIT_LIB_PRIO   /* see crit.h */
+#endif
+
+#if (KERNEL_CEILING < 1U) || (KERNEL_CEILING > 15U)
+#error "KERNEL_CEILING must be 1 to 15"
+#endif
+
+#ifndef KERNEL_IDLE_STACK
+#define KERNEL_IDLE_STACK   64U     /* words */
+#endif
+
+#define KERNEL_STACK_MIN    16U     /* words: both register frames */
+#define KERNEL_FOREVER      0xFFFFFFFFUL
+
+typedef struct kernel_task kernel_task_t;
+typedef struct kernel_mutex kernel_mutex_t;
+
+typedef struct
+{
+  kernel_task_t *head;
+  kernel_task_t *tail;
+} kernel_list_t;
+
+struct kernel_task
+{
+  uint32_t *sp;             /* saved PSP; PendSV relies on offset 0 */
+  kernel_task_t *next;      /* ready or wait list */
+  kernel_task_t *dnext;     /* delay list */
+  kernel_list_t *list;      /* list `next` belongs to, if any */
+  kernel_mutex_t *held;     /* mutexes owned, most recent first */
+  kernel_mutex_t *blocker;  /* mutex waited for, if any */
+  uint32_t wake;            /* tick to wake at while delayed */
+  int32_t result;           /* 0 woken, -1 timed out */
+  uint8_t prio;             /* effective, raised by inheritance */
+  uint8_t base;             /* assigned */
+  uint8_t state;
+  uint8_t delayed;
+};
+
+struct kernel_mutex
+{
+  kernel_task_t *owner;
+  kernel_mutex_t *next;     /* in the owner's held list */
+  kernel_list_t waiters;
+};
+
+typedef struct
+{
+  uint32_t count;
+  kernel_list_t waiters;
+} kernel_sem_t;
+
+/**
+ * @brief  Set up a task; it becomes ready at once, even once started.
+ * @param  t     Control block, which must stay valid while the task lives
+ * @param  fn    Entry; returning from it ends the task
+ * @param  stack Stack area, 8-byte aligned
+ * @param  words Stack size in words, at least KERNEL_STACK_MIN
+ * @param  prio  1 .. KERNEL_PRIOS - 1
+ * @retval 0 on success, -1 on invalid parameters
+ */
+int kernel_task_create(kernel_task_t *t, void (*fn)(void *), void *arg,
+                       uint32_t *stack, uint32_t words, uint32_t prio);
+
+/**
+ * @brief  Start the tick and switch to the most urgent task. Does not
+ *         return; interrupt handlers go on using main()'s stack (MSP).
+ */
+void kernel_start(void) __attribute__((noreturn));
+
+/**
+ * @brief  Let the other ready tasks of the same priority run first.
+ */
+void kernel_yield(void);
+
+/**
+ * @brief  Block until the tick count has advanced by `ticks`; the first
+ *         tick may come at once. 0 yields.
+ */
+void kernel_delay(uint32_t ticks);
+
+/**
+ * @brief  Running task, 0 before kernel_start().
+ */
+kernel_task_t *kernel_self(void);
+
+void kernel_mutex_init(kernel_mutex_t *m);
+
+/**
+ * @brief  Take a mutex, blocking while another task owns it.
+ * @retval 0 on success, -1 if the caller already owns it
+ */
+int kernel_mutex_lock(kernel_mutex_t *m);
+
+/**
+ * @brief  Release a mutex to its most urgent waiter.
+ * @retval 0 on success, -1 if the caller does not own it
+ */
+int kernel_mutex_unlock(kernel_mutex_t *m);
+
+void kernel_sem_init(kernel_sem_t *s, uint32_t count);
+
+/**
+ * @brief  Take a count, waiting up to `timeout` ticks (KERNEL_FOREVER: no
+ *         limit, 0: do not block; the only form for interrupts).
+ * @retval 0 on success, -1 on timeout
+ */
+int kernel_sem_take(kernel_sem_t *s, uint32_t timeout);
+
+/**
+ * @brief  Wake the most urgent waiter, or add a count if none. Also
+ *         callable from interrupts.
+ */
+void kernel_sem_give(kernel_sem_t *s);
+
+/**
+ * @brief  Called in a loop by the idle task. Weak: the default executes
+ *         WFI.
+ */
+void kernel_idle(void);
+
+/**
+ * @brief  Cycles for one kernel_yield() from one task into another of the
+ *         same priority, the least of `rounds` tries. Call from a running
+ *         task; it creates and ends a helper at its own priority.
+ */
+uint32_t kernel_switch_bench(uint32_t rounds);
+
+#endif /* KERNEL_H_ */
@@ -0,0 +1,117 @@
+/**
+ ******************************************************************************
+ * @file           : latency.h
+ * @brief          : Interrupt latency and jitter measurement under load
+ ******************************************************************************
+ * @attention
+ *
+ * A 16-bit timer (TIM2..TIM4, claimed through tim.h) counts core clocks
+ * and raises a compare interrupt every `period` cycles, plus a random
+ * 0 .. `dither` so the compares do not lock in step with a periodic load.
+ * The timer and the DWT counter run from the same clock, so the CYCCNT
+ * value each compare falls due at is known exactly; the callback reads
+ * CYCCNT on entry and the difference is the latency of that interrupt.
+ * Each compare is scheduled from the previous one, never from the time of
+ * the callback, so lateness does not carry over. The figures include the
+ * fixed cost of the path through tim.c into the callback, a few tens of
+ * cycles: the minimum with no load.
+ *
+ * The measuring interrupt takes each of up to LATENCY_LEVELS NVIC
+ * priorities in turn for `samples` samples, filling a histogram per level
+ * of LATENCY_BINS bins LATENCY_BIN_CYCLES wide, plus one for anything
+ * longer. Meanwhile latency_run() generates the background load:
+ *
+ *  - an interrupt from a second timer every `load_period` cycles at
+ *    `load_prio`, spinning for `load_cycles`;
+ *  - in thread mode, sections of `mask_cycles` with interrupts masked,
+ *    by PRIMASK or by BASEPRI at `mask_prio` (see crit.h), each followed
+ *    by as long unmasked.
+ *
+ * latency_get_report() gives per level the minimum, the 50th, 90th, 99th
+ * and 99.9th percentiles (to the bin's upper edge), the worst case, and
+ * where the worst case struck: the stacked pc of the code it interrupted,
+ * and that code's exception number, 0 for thread mode. Look the pc up in
+ * the map file, or with addr2line, to name the region that held it off.
+ *
+ * The timers are assumed to run at HCLK: APB1 prescaler 1 or 2 (the timer
+ * clock doubles when the prescaler is not 1), as with the HSI default.
+ *
+ ******************************************************************************
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+#ifndef LATENCY_LEVELS
+#define LATENCY_LEVELS      4U
+#endif
+
+#ifndef LATENCY_BINS
+#define LATENCY_BINS        64U
+#endif
+
+#ifndef LATENCY_BIN_CYCLES
+#define LATENCY_BIN_CYCLES  8U
+#endif
+
+#if (LATENCY_LEVELS < 1U) || (LATENCY_LEVELS > 16U)
+#error "LATENCY_LEVELS must be 1 to 16"
+#endif
+
+#if (LATENCY_BIN_CYCLES < 1U) || \
+    ((LATENCY_BIN_CYCLES & (LATENCY_BIN_CYCLES - 1U)) != 0U)
+#error "LATENCY_BIN_CYCLES must be a power of two"
+#endif
+
+#define LATENCY_PERIOD_MIN  64U
+#define LATENCY_PERIOD_MAX  0x7FFFU     /* period + dither */
+
+typedef struct
+{
+  TIM_TypeDef *tim;         /* measuring timer, TIM2..TIM4 */
+  uint32_t period;          /* cycles between compares */
+  uint32_t dither;          /* mask of random cycles added: 2^k - 1 */
+  const uint8_t *prios;     /* NVIC priorities to measure at, in turn */
+  uint32_t levels;          /* 1 .. LATENCY_LEVELS */
+  uint32_t samples;         /* per level, 1 .. 65535 */
+  TIM_TypeDef *load_tim;    /* background interrupt timer, or NULL */
+  uint32_t load_prio;
+  uint32_t load_period;     /* cycles, 2 .. 65536 */
+  uint32_t load_cycles;     /* spent in each load interrupt */
+  uint32_t mask_cycles;     /* thread mode masked sections, 0 for none */
+  uint32_t mask_prio;       /* 0: PRIMASK, else BASEPRI at this priority */
+} latency_config_t;
+
+typedef struct
+{
+  uint32_t prio;
+  uint32_t count;
+  uint32_t missed;          /* compares already past when set */
+  uint32_t min;             /* cycles */
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t p999;
+  uint32_t max;
+  uint32_t max_pc;          /* stacked pc at the worst case */
+  uint32_t max_exception;   /* exception it interrupted, 0 thread mode */
+} latency_report_t;
+
+/**
+ * @brief  Measure at every level in turn under the configured load, and
+ *         return when done. Thread mode, with interrupts enabled.
+ * @retval 0 on success, -1 if the configuration is invalid or a timer is
+ *         already claimed
+ */
+int latency_run(const latency_config_t *cfg);
+
+/**
+ * @brief  Summarise one level of the last run.
+ * @retval 0 on success, -1 if level was not measured
+ */
+int latency_get_report(uint32_t level, latency_report_t *out);
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ * @file           : memopt.h
+ * @brief          : Word and block optimised memcpy/memmove/memset/memcmp
+ ******************************************************************************
+ * @attention
+ *
+ * newlib-nano's mem* routines are size-optimised byte loops. These align
+ * the destination, then move 32 bytes per LDM/STM pair (eight registers),
+ * then single words, then the tail bytes. A source that is not congruent
+ * with the destination is read with unaligned LDRs, which the Cortex-M3
+ * handles in hardware for single-word loads. Buffers under 16 bytes take
+ * the byte loop directly.
+ *
+ * They are selected at link time, without touching any call site, by
+ * adding to the linker flags (MCU GCC Linker > Miscellaneous):
+ *
+ *   -Wl,--wrap=memcpy -Wl,--wrap=memmove -Wl,--wrap=memset -Wl,--wrap=memcmp
+ *
+ * Every reference to memcpy, including those inside newlib, then resolves
+ * to __wrap_memcpy, an alias of memopt_memcpy, and newlib's version stays
+ * reachable as __real_memcpy. Without the flags nothing changes and
+ * --gc-sections drops this code.
+ *
+ * The file builds on the host with C fallbacks for the LDM/STM blocks.
+ *
+ ******************************************************************************
+ */
+
+#ifndef MEMOPT_H_
+#define MEMOPT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MEMOPT_BENCH_SIZES  13U   /* 1, 2, 4 ... 4096 bytes */
+
+typedef void *(*memopt_copy_t)(void *dst, const void *src, size_t n);
+
+void *memopt_memcpy(void *dst, const void *src, size_t n);
+void *memopt_memmove(void *dst, const void *src, size_t n);
+void *memopt_memset(void *dst, int c, size_t n);
+int memopt_memcmp(const void *a, const void *b, size_t n);
+
+/**
+ * @brief  Time a copy function with the DWT cycle counter for sizes 1, 2,
+ *         4 ... 4096 bytes.
+ * @param  fn       Function under test, e.g. memopt_memcpy or __real_memcpy
+ * @param  scratch  Word-aligned buffer of at least 8200 bytes
+ * @param  misalign Source offset from word alignment, 0..3
+ * @param  cpb_q8   Cycles per byte, Q24.8, one entry per size
+ */
+void memopt_bench(memopt_copy_t fn, void *scratch, uint32_t misalign,
+                  uint32_t cpb_q8[MEMOPT_BENCH_SIZES]);
+
+#endif /* MEMOPT_H_ */
@@ -0,0 +1,188 @@
+/**
+ ******************************************************************************
+ * @file           : ring.h
+ * @brief          : Lock-free SPSC and MPSC ring buffer indices
+ ******************************************************************************
+ * @attention
+ *
+ * The rings manage indices only; the caller owns the element array, of any
+ * type, with a power-of-two length. That keeps one implementation for
+ * every element type and lets a DMA channel or a driver read and write
+ * ring memory in place: the span calls return an index and the number of
+ * contiguous elements available there (up to the end of the array), the
+ * caller fills or drains buf[index ..], then commits or releases that
+ * many. ring_*_push() and ring_*_pop() wrap the same calls with memcpy for
+ * bulk copies.
+ *
+ * SPSC: one producer and one consumer, e.g. an interrupt and the main
+ * loop. Each side writes only its own counter, so both are wait-free and
+ * nothing is masked.
+ *
+ * MPSC: any number of producers, in any mix of thread mode and interrupt
+ * priorities, and one consumer. A producer claims slots by
+ * compare-and-swap on the head (LDREX/STREX, see atomic.h) and publishes
+ * them through a per-slot sequence word, so a producer preempted between
+ * claim and publish never blocks the others; the consumer just stops at
+ * the first unpublished slot until it is. The sequence array is the
+ * caller's too, one uint32_t per element.
+ *
+ * Counters run freely and wrap; capacity is the array length.
+ *
+ ******************************************************************************
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+
+#include "atomic.h"
+
+typedef struct
+{
+  volatile uint32_t head;   /* written by the producer only */
+  volatile uint32_t tail;   /* written by the consumer only */
+  uint32_t mask;            /* length - 1 */
+} ring_spsc_t;
+
+/* Sequence word of the slot for position p, lap = p & ~mask: lap when
+ * free, lap + 1 once published, lap + length after release */
+typedef struct
+{
+  volatile uint32_t head;   /* next position to claim */
+  uint32_t tail;            /* next position to consume, consumer only */
+  uint32_t mask;
+  volatile uint32_t *seq;
+} ring_mpsc_t;
+
+/* Functions */
+/**
+ * @brief  Set up an empty ring.
+ * @param  len Element count of the caller's array, a power of two
+ * @retval 0 on success, -1 if len is not a power of two
+ */
+int ring_spsc_init(ring_spsc_t *r, uint32_t len);
+
+/**
+ * @param  seq len words, cleared here
+ */
+int ring_mpsc_init(ring_mpsc_t *r, volatile uint32_t *seq, uint32_t len);
+
+static inline uint32_t ring_spsc_count(const ring_spsc_t *r)
+{
+  return r->head - r->tail;
+}
+
+/**
+ * @brief  Producer: free elements from buf[*index] up to the array end.
+ */
+static inline uint32_t ring_spsc_write_span(const ring_spsc_t *r,
+                                            uint32_t *index)
+{
+  uint32_t head = r->head;
+  uint32_t room = r->mask + 1U - (head - r->tail);
+  uint32_t end = r->mask + 1U - (head & r->mask);
+
+  *index = head & r->mask;
+  return (room < end) ? room : end;
+}
+
+/**
+ * @brief  Producer: hand n written elements to the consumer.
+ */
+static inline void ring_spsc_commit(ring_spsc_t *r, uint32_t n)
+{
+  atomic_fence();
+  r->head += n;
+}
+
+/**
+ * @brief  Consumer: elements ready from buf[*index] up to the array end.
+ */
+static inline uint32_t ring_spsc_read_span(const ring_spsc_t *r,
+                                           uint32_t *index)
+{
+  uint32_t tail = r->tail;
+  uint32_t used = r->head - tail;
+  uint32_t end = r->mask + 1U - (tail & r->mask);
+
+  atomic_fence();
+  *index = tail & r->mask;
+  return (used < end) ? used : end;
+}
+
+/**
+ * @brief  Consumer: give n read elements back to the producer.
+ */
+static inline void ring_spsc_release(ring_spsc_t *r, uint32_t n)
+{
+  atomic_fence();
+  r->tail += n;
+}
+
+/**
+ * @brief  Producer: claim up to n free slots, contiguous in the array.
+ * @param  pos Receives the first position; its element is
+ *             buf[pos & mask]
+ * @retval Slots claimed, 0 if the ring is full; each must be published
+ */
+uint32_t ring_mpsc_claim(ring_mpsc_t *r, uint32_t n, uint32_t *pos);
+
+/**
+ * @brief  Producer: make n claimed slots from pos visible to the consumer.
+ */
+static inline void ring_mpsc_publish(ring_mpsc_t *r, uint32_t pos,
+                                     uint32_t n)
+{
+  atomic_fence();
+  for (uint32_t i = 0; i < n; i++, pos++)
+  {
+    r->seq[pos & r->mask] = (pos & ~r->mask) + 1U;
+  }
+}
+
+/**
+ * @brief  Consumer: non-zero if the oldest slot is published.
+ */
+static inline uint32_t ring_mpsc_ready(const ring_mpsc_t *r)
+{
+  uint32_t tail = r->tail;
+
+  return (r->seq[tail & r->mask] == (tail & ~r->mask) + 1U) ? 1U : 0U;
+}
+
+/**
+ * @brief  Consumer: published elements from buf[*index] up to the first
+ *         unpublished one or the array end.
+ */
+uint32_t ring_mpsc_read_span(const ring_mpsc_t *r, uint32_t *index);
+
+/**
+ * @brief  Consumer: free n read slots for the producers.
+ */
+static inline void ring_mpsc_release(ring_mpsc_t *r, uint32_t n)
+{
+  uint32_t tail = r->tail;
+
+  atomic_fence();
+  for (uint32_t i = 0; i < n; i++, tail++)
+  {
+    r->seq[tail & r->mask] = (tail & ~r->mask) + r->mask + 1U;
+  }
+  r->tail = tail;
+}
+
+/**
+ * @brief  Copy up to n elements of `size` bytes in or out of buf.
+ * @retval Elements copied, fewer than n if the ring filled or emptied
+ */
+uint32_t ring_spsc_push(ring_spsc_t *r, void *buf, uint32_t size,
+                        const void *src, uint32_t n);
+uint32_t ring_spsc_pop(ring_spsc_t *r, const void *buf, uint32_t size,
+                       void *dst, uint32_t n);
+uint32_t ring_mpsc_push(ring_mpsc_t *r, void *buf, uint32_t size,
+                        const void *src, uint32_t n);
+uint32_t ring_mpsc_pop(ring_mpsc_t *r, const void *buf, uint32_t size,
+                       void *dst, uint32_t n);
+
+#endif /* RING_H_ */
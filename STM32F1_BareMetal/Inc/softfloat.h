@@ -0,0 +1,95 @@
+/**
+ ******************************************************************************
+ * @file           : softfloat.h
+ * @brief          : Single-precision soft-float runtime using UMULL, UDIV and
+ *                   CLZ
+ ******************************************************************************
+ * @attention
+ *
+ * With -mfloat-abi=soft every float operation calls an __aeabi_f* helper.
+ * softfloat.c provides replacements, correctly rounded (round to nearest,
+ * ties to even) including subnormals, infinities and NaNs. A NaN operand
+ * comes back quieted; invalid operations return the default NaN 0x7FC00000.
+ * No exception flags are kept. Float-to-integer conversions saturate and
+ * turn NaN into 0.
+ *
+ * libgcc's ARM helpers are already hand-written assembly, and the gain is
+ * not uniform, so the helpers come in groups matching libgcc's objects
+ * (a group must replace a whole object, or the link sees two definitions):
+ *
+ *   SOFTFLOAT_MULDIV  fmul (UMULL), fdiv (three UDIV steps instead of a
+ *                     shift-subtract loop)                         default 1
+ *   SOFTFLOAT_SQRT    sqrtf: table and two Newton steps with UMULL, exact
+ *                     correction, instead of newlib's bit loop     default 1
+ *   SOFTFLOAT_ADDSUB  fadd, fsub, frsub, i2f, ui2f, l2f, ul2f      default 0
+ *   SOFTFLOAT_CMP     fcmp*, cfcmp*, __eqsf2 and relatives         default 0
+ *   SOFTFLOAT_FIX     f2iz, f2uiz                                  default 0
+ *
+ * Enable the others after timing them on the target against libgcc. The
+ * file is compiled at -O2 whatever the build configuration, so the Debug
+ * build does not pay -O0 code in every float operation.
+ *
+ * The arithmetic is plain C and also builds on the host for verification.
+ *
+ ******************************************************************************
+ */
+
+#ifndef SOFTFLOAT_H_
+#define SOFTFLOAT_H_
+
+#include <stdint.h>
+
+#ifndef SOFTFLOAT_MULDIV
+#define SOFTFLOAT_MULDIV    1
+#endif
+
+#ifndef SOFTFLOAT_SQRT
+#define SOFTFLOAT_SQRT      1
+#endif
+
+#ifndef SOFTFLOAT_ADDSUB
+#define SOFTFLOAT_ADDSUB    0
+#endif
+
+#ifndef SOFTFLOAT_CMP
+#define SOFTFLOAT_CMP       0
+#endif
+
+#ifndef SOFTFLOAT_FIX
+#define SOFTFLOAT_FIX       0
+#endif
+
+#if SOFTFLOAT_MULDIV
+float __aeabi_fmul(float a, float b);
+float __aeabi_fdiv(float a, float b);
+#endif
+
+#if SOFTFLOAT_SQRT
+float sqrtf(float x);
+#endif
+
+#if SOFTFLOAT_ADDSUB
+float __aeabi_fadd(float a, float b);
+float __aeabi_fsub(float a, float b);
+float __aeabi_frsub(float a, float b);
+float __aeabi_i2f(int32_t x);
+float __aeabi_ui2f(uint32_t x);
+float __aeabi_l2f(int64_t x);
+float __aeabi_ul2f(uint64_t x);
+#endif
+
+#if SOFTFLOAT_CMP
+int __aeabi_fcmpeq(float a, float b);
+int __aeabi_fcmplt(float a, float b);
+int __aeabi_fcmple(float a, float b);
+int __aeabi_fcmpge(float a, float b);
+int __aeabi_fcmpgt(float a, float b);
+int __aeabi_fcmpun(float a, float b);
+#endif
+
+#if SOFTFLOAT_FIX
+int32_t __aeabi_f2iz(float x);
+uint32_t __aeabi_f2uiz(float x);
+#endif
+
+#endif /* SOFTFLOAT_H_ */
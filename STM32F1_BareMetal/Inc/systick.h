@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * @file           : systick.h
+ * @brief          : SysTick time base and tick hooks
+ ******************************************************************************
+ * @attention
+ *
+ * SysTick interrupts SYSTICK_HZ times a second and counts ticks in a
+ * 32-bit word that wraps; compare tick values by signed difference.
+ * Nothing else in the tree sets up the clocks (SystemInit is the weak
+ * empty default), so the core runs from the 8 MHz HSI unless the
+ * application changes it and defines SYSTICK_CORE_HZ to match.
+ *
+ * Modules that need the tick define a hook below. The hooks are weak and
+ * default to an empty function, as in exti.c, and SysTick_Handler calls
+ * each of them after counting.
+ *
+ ******************************************************************************
+ */
+
+#ifndef SYSTICK_H_
+#define SYSTICK_H_
+
+#include <stdint.h>
+
+#ifndef SYSTICK_CORE_HZ
+#define SYSTICK_CORE_HZ     8000000UL
+#endif
+
+#ifndef SYSTICK_HZ
+#define SYSTICK_HZ          1000UL
+#endif
+
+#if ((SYSTICK_CORE_HZ / SYSTICK_HZ) < 2UL) || \
+    ((SYSTICK_CORE_HZ / SYSTICK_HZ) > 0x01000000UL)
+#error "SYSTICK_CORE_HZ / SYSTICK_HZ must fit the 24-bit reload"
+#endif
+
+/* Tick hooks, called from SysTick_Handler in this order */
+void kernel_tick(void);
+void coro_tick(void);
+void wheel_tick(void);
+
+/* Called by systick_advance() in place of wheel_tick() */
+void wheel_advance(uint32_t ticks);
+
+/**
+ * @brief  Start the tick at the lowest interrupt priority.
+ */
+void systick_init(void);
+
+/**
+ * @brief  Ticks since systick_init().
+ */
+uint32_t systick_ticks(void);
+
+/**
+ * @brief  Count ticks that passed with SysTick stopped, as in tickless idle
+ *         (see idle.h), and run the hooks once for all of them. Call with
+ *         interrupts masked or from SysTick's priority.
+ */
+void systick_advance(uint32_t ticks);
+
+#endif /* SYSTICK_H_ */
@@ -0,0 +1,63 @@
+/**
+ ******************************************************************************
+ * @file           : tim.h
+ * @brief          : TIM1..TIM4 interrupt ownership and dispatch
+ ******************************************************************************
+ * @attention
+ *
+ * Like dma.h for DMA channels: one driver claims a timer together with a
+ * callback, and this module owns the TIM1_UP, TIM1_CC and TIM2..TIM4
+ * vectors. Before the callback runs, the enabled status flags are cleared and
+ * passed in as `sr`. During the callback, tim_frame() gives the exception
+ * frame the interrupt stacked: r0-r3, r12, lr, pc and xPSR of the code it
+ * interrupted.
+ *
+ * The vectors run at TIM_IRQ_PRIO, which is also the ceiling of the
+ * ownership table (see crit.h). It defaults to the DMA priority: icap.c
+ * relies on its timer and DMA interrupts not preempting each other.
+ *
+ ******************************************************************************
+ */
+
+#ifndef TIM_H_
+#define TIM_H_
+
+#include <stdint.h>
+#include "crit.h"
+#include "stm32f1xx.h"
+
+#ifndef TIM_IRQ_PRIO
+#define TIM_IRQ_PRIO      CRIT_LIB_PRIO   /* and ceiling, see crit.h */
+#endif
+
+#if (TIM_IRQ_PRIO < 1U) || (TIM_IRQ_PRIO > 15U)
+#error "TIM_IRQ_PRIO must be 1 to 15"
+#endif
+
+typedef void (*tim_callback_t)(uint32_t sr, void *ctx);
+
+/**
+ * @brief  Enable the bus clock of TIM1..TIM4.
+ */
+void tim_enable_clock(const TIM_TypeDef *tim);
+
+/**
+ * @brief  Take ownership of a timer and its interrupt(s) and enable its
+ *         clock. Interrupt sources are selected by the caller through DIER;
+ *         a driver that needs none passes a NULL callback and the vector
+ *         stays disabled. Until released, the idle code keeps out of Stop
+ *         (see idle.h).
+ * @retval 0 on success, -1 if the timer is unsupported or already owned
+ */
+int tim_claim(TIM_TypeDef *tim, tim_callback_t cb, void *ctx);
+
+void tim_release(TIM_TypeDef *tim);
+
+/**
+ * @brief  From a timer's callback: the exception frame of the interrupt
+ *         being dispatched. frame[6] is where it was taken.
+ * @retval The frame, or NULL if the timer is unsupported
+ */
+const uint32_t *tim_frame(const TIM_TypeDef *tim);
+
+#endif /* TIM_H_ */
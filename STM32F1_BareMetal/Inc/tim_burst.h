@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * @file           : tim_burst.h
+ * @brief          : Timer DMA burst waveform engine (TIMx->DCR/DMAR)
+ ******************************************************************************
+ * @attention
+ *
+ * Streams precomputed frames of consecutive timer registers (typically
+ * CCR1..CCR4) through the DMA burst interface: on every update event the
+ * timer requests one burst and the DMA writes a whole frame into the preload
+ * registers, so outputs change together at the next period without CPU work.
+ *
+ * The frame buffer is split in two halves and the DMA runs circular; the
+ * fill callback is only invoked from the half/complete interrupt to produce
+ * the next half while the other one is output, so CPU cost is per block of
+ * frames, not per period.
+ *
+ * The timer itself (prescaler, period, PWM modes, pins) is configured by the
+ * caller, e.g. with tim_burst_pwm_setup(). Update DMA requests: TIM1 -> DMA1
+ * channel 5, TIM2 -> 2, TIM3 -> 3, TIM4 -> 7.
+ *
+ ******************************************************************************
+ */
+
+#ifndef TIM_BURST_H_
+#define TIM_BURST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+/* Register offset of the first register written by each burst */
+#define TIM_BURST_CCR1    ((uint32_t)offsetof(TIM_TypeDef, CCR1))
+
+/**
+ * Produce up to `frames` frames into `buf`. Returning fewer frames ends the
+ * stream: the rest of the buffer is zeroed, one full half of zero frames is
+ * output (e.g. the WS2812 latch period) and the engine stops.
+ */
+typedef uint32_t (*tim_burst_fill_t)(uint16_t *buf, uint32_t frames, void *ctx);
+
+typedef struct
+{
+  TIM_TypeDef *tim;
+  uint32_t dma_ch;
+  uint16_t *buf;              /* 2 * frames * regs halfwords */
+  uint16_t regs;              /* registers per frame, 1..18 */
+  uint16_t frames;            /* frames per half buffer */
+  tim_burst_fill_t fill;
+  void *ctx;
+  volatile uint8_t state;
+  uint8_t drain;
+  volatile uint32_t blocks;   /* half buffers produced */
+} tim_burst_t;
+
+/* WS2812 bitstream: one CCR value per data bit, MSB first */
+typedef struct
+{
+  const uint8_t *data;        /* GRB bytes */
+  uint32_t len;
+  uint32_t pos;
+  uint16_t t0h;               /* compare value for a 0 bit, ~0.4 us */
+  uint16_t t1h;               /* compare value for a 1 bit, ~0.8 us */
+} tim_burst_ws2812_t;
+
+/* Three-phase PWM: table lookup at 0, 120 and 240 degrees per frame */
+typedef struct
+{
+  const uint16_t *table;      /* one period of duty values */
+  uint32_t table_log2;        /* table length is 1 << table_log2 */
+  uint32_t phase;             /* 2^32 = one electrical period */
+  uint32_t step;              /* phase increment per frame */
+} tim_burst_pwm3_t;
+
+int tim_burst_init(tim_burst_t *b, TIM_TypeDef *tim, uint32_t first_reg,
+                   uint32_t regs, uint16_t *buf, uint32_t frames,
+                   tim_burst_fill_t fill, void *ctx);
+int tim_burst_start(tim_burst_t *b);
+void tim_burst_stop(tim_burst_t *b);
+int tim_burst_busy(const tim_burst_t *b);
+
+void tim_burst_pwm_setup(TIM_TypeDef *tim, uint32_t psc, uint32_t arr,
+                         uint32_t channels);
+
+uint32_t tim_burst_ws2812_fill(uint16_t *buf, uint32_t frames, void *ctx);
+uint32_t tim_burst_pwm3_fill(uint16_t *buf, uint32_t frames, void *ctx);
+
+#endif /* TIM_BURST_H_ */
@@ -0,0 +1,106 @@
+/**
+ ******************************************************************************
+ * @file           : vectors.h
+ * @brief          : Flash or RAM vector table, and unhandled interrupt capture
+ ******************************************************************************
+ * @attention
+ *
+ * Flash mode, the default: the startup file's g_pfnVectors is the table.
+ * Each entry is resolved when the program links: a driver that defines
+ * <name>_IRQHandler (as can.c, dma.c, exti.c and tim.c do) replaces the
+ * weak alias to Default_Handler. Nothing can change at run time, and the
+ * table costs no RAM.
+ *
+ * RAM mode, built with VECTORS_RAM: vectors_init() copies the flash table
+ * into an SRAM table aligned as VTOR requires, applies a table of
+ * {IRQ, handler} bindings kept in flash, and points SCB->VTOR at it.
+ * After that vectors_bind() replaces a handler at run time. The table
+ * takes VECTORS_COUNT words of RAM.
+ *
+ * The two differ in where the core fetches the vector on exception entry:
+ * from flash through the I-code bus, with the flash wait states, or from
+ * SRAM over the system bus, which the register stacking also uses.
+ * vectors_bench() times the first instruction of a handler after pending
+ * its IRQ, from each table in turn; the difference is the cost of the
+ * fetch on this part and clock.
+ *
+ * Default_Handler in the startup file passes to vectors_unhandled(), which
+ * records the exception number (IPSR) and the stacked pc and lr in
+ * vectors_fault, then, with a debugger attached, stops at a breakpoint,
+ * and otherwise loops as before. Read it from the debugger: irq is the
+ * IRQn_Type value, negative for the core exceptions.
+ *
+ ******************************************************************************
+ */
+
+#ifndef VECTORS_H_
+#define VECTORS_H_
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+/* Words in the startup file's g_pfnVectors: stack, 15 exceptions, 60 IRQs */
+#define VECTORS_COUNT       76U
+
+/* VTOR needs the table aligned to its size, rounded up to a power of two */
+#define VECTORS_ALIGN       512U
+
+typedef void (*vectors_handler_t)(void);
+
+typedef struct
+{
+  IRQn_Type irq;
+  vectors_handler_t handler;
+} vectors_binding_t;
+
+typedef struct
+{
+  uint32_t exception;       /* IPSR */
+  int32_t irq;              /* exception - 16 */
+  uint32_t pc;              /* stacked: where it was taken */
+  uint32_t lr;
+  uint32_t count;
+} vectors_fault_t;
+
+typedef struct
+{
+  uint32_t flash_min;       /* pend to handler, cycles */
+  uint32_t flash_max;
+  uint32_t ram_min;         /* 0 unless VTOR points at the RAM table */
+  uint32_t ram_max;
+} vectors_bench_t;
+
+extern volatile vectors_fault_t vectors_fault;
+
+#ifdef VECTORS_RAM
+/**
+ * @brief  Copy the flash table to SRAM, apply the bindings and relocate
+ *         VTOR. Call once, before enabling interrupts.
+ * @param  bindings Handlers to install, or 0
+ * @param  n        Number of bindings
+ * @retval 0 on success, -1 if a binding's IRQ is out of range (the
+ *         others are installed and VTOR is moved regardless)
+ */
+int vectors_init(const vectors_binding_t *bindings, uint32_t n);
+
+/**
+ * @brief  Replace the handler of an interrupt or core exception (irq < 0).
+ *         Disable the IRQ around the call if it may fire meanwhile.
+ * @retval Previous handler, or 0 if irq is out of range or the table is
+ *         not in use
+ */
+vectors_handler_t vectors_bind(IRQn_Type irq, vectors_handler_t handler);
+#endif
+
+/**
+ * @brief  Default_Handler's target: record the exception and halt.
+ */
+void vectors_unhandled(void);
+
+/**
+ * @brief  Time handler entry from the flash table and, if VTOR has been
+ *         moved to the RAM table, from that one.
+ */
+void vectors_bench(vectors_bench_t *out);
+
+#endif /* VECTORS_H_ */
@@ -0,0 +1,147 @@
+/**
+ ******************************************************************************
+ * @file           : wheel.h
+ * @brief          : Hierarchical timing wheel for software timers
+ ******************************************************************************
+ * @attention
+ *
+ * Timers are embedded in their users: a wheel_timer_t is four words and
+ * the wheel allocates nothing, so 1000 of them take 16 KB. Starting and
+ * stopping a timer are O(1), and so is expiry.
+ *
+ * There are four levels of 64 slots. A timer due within 64 ticks hangs in
+ * the level 0 slot of its tick, one due within 64^2 in the level 1 slot
+ * of its 64-tick span, and so on up to 2^24 ticks (about 4.6 hours at
+ * 1 kHz); farther deadlines wait in the last level 3 slot and are placed
+ * again when it comes round. Each tick looks at one level 0 slot; every
+ * 64th tick also moves one level 1 slot's timers down, every 4096th one
+ * of level 2 and so on, so each timer moves at most three times whatever
+ * the number of timers.
+ *
+ * The wheel advances by wheel_tick(), a SysTick hook (see systick.h). In
+ * tickless operation the idle code asks wheel_next() how many ticks can
+ * pass without a timer falling due, sleeps on a one-shot timer for that
+ * long and catches up with wheel_advance().
+ *
+ * A timer started with WHEEL_ISR runs its callback from the tick, in the
+ * SysTick handler; one started with WHEEL_THREAD runs it from the event
+ * loop (see event.h) at WHEEL_EVENT_PRIO. Callbacks may start or stop any
+ * timer, their own included. For a periodic timer, the callback calls
+ * wheel_forward(), which counts from the deadline just met rather than
+ * from now, so the period does not drift with callback latency.
+ *
+ * Timers may be started and stopped from thread mode or from interrupts at
+ * up to WHEEL_CEILING (see crit.h), which the wheel's short critical
+ * sections mask.
+ *
+ * wheel_bench() times starts, ticks and stops over a caller's array of
+ * timers. It counts DWT cycles on the target and nanoseconds on the host,
+ * where the file also builds. On the target SysTick is held off while it
+ * ticks the wheel itself, so the tick count loses the bench's run time,
+ * and the wheel is set back to where it started.
+ *
+ ******************************************************************************
+ */
+
+#ifndef WHEEL_H_
+#define WHEEL_H_
+
+#include <stdint.h>
+
+#ifndef WHEEL_EVENT_PRIO
+#define WHEEL_EVENT_PRIO    1U
+#endif
+
+/* wheel_start() contexts */
+#define WHEEL_ISR           0U
+#define WHEEL_THREAD        1U
+
+typedef struct wheel_timer wheel_timer_t;
+typedef void (*wheel_fn_t)(wheel_timer_t *t);
+
+struct wheel_timer
+{
+  wheel_timer_t *next;
+  uintptr_t link;           /* address of the pointer to us | context */
+  uint32_t expires;         /* tick due */
+  wheel_fn_t fn;
+};
+
+typedef struct
+{
+  uint32_t start;           /* per wheel_start(), average */
+  uint32_t tick;            /* per wheel_tick(), average */
+  uint32_t tick_max;
+  uint32_t stop;            /* per wheel_stop(), average */
+  uint32_t fired;           /* callbacks run during the ticks */
+} wheel_bench_t;
+
+/**
+ * @brief  Set up an idle timer. Call once, before the first start.
+ */
+void wheel_timer_init(wheel_timer_t *t, wheel_fn_t fn);
+
+/**
+ * @brief  (Re)start a timer to expire on the `delay`-th tick from now.
+ * @param  delay At least 1; 0 is taken as 1
+ * @param  ctx   WHEEL_ISR or WHEEL_THREAD
+ */
+void wheel_start(wheel_timer_t *t, uint32_t delay, uint32_t ctx);
+
+/**
+ * @brief  From its callback: restart a timer `period` ticks after the
+ *         deadline it just met, in the same context. A deadline already
+ *         passed expires on the next tick.
+ */
+void wheel_forward(wheel_timer_t *t, uint32_t period);
+
+/**
+ * @brief  Stop a timer; it will not run unless started again.
+ */
+void wheel_stop(wheel_timer_t *t);
+
+/**
+ * @brief  Non-zero while a timer is waiting to expire or to run.
+ */
+uint32_t wheel_pending(const wheel_timer_t *t);
+
+/**
+ * @brief  Ticks since the wheel started.
+ */
+uint32_t wheel_now(void);
+
+/**
+ * @brief  SysTick hook: advance one tick and run what falls due.
+ */
+void wheel_tick(void);
+
+/**
+ * @brief  Advance `ticks` ticks at once, after a tickless sleep. Runs
+ *         only the ticks that expire or cascade timers, so the cost does
+ *         not grow with the length of the sleep.
+ */
+void wheel_advance(uint32_t ticks);
+
+/**
+ * @brief  Ticks that may pass with no timer falling due: a lower bound,
+ *         as timers on the upper levels count from when their slot comes
+ *         down to the level below.
+ * @param  ticks Receives the count
+ * @retval 0 on success, -1 if no timer is running (ticks is left alone)
+ */
+int wheel_next(uint32_t *ticks);
+
+/**
+ * @brief  Set the tick count of an empty wheel.
+ * @retval 0 on success, -1 if a timer is running or waiting to run
+ */
+int wheel_set_now(uint32_t now);
+
+/**
+ * @brief  Start n timers at pseudo-random delays up to 60000 ticks, tick
+ *         1000 times, then stop them all.
+ * @param  timers n scratch timers; the wheel should hold no others
+ */
+void wheel_bench(wheel_timer_t *timers, uint32_t n, wheel_bench_t *out);
+
+#endif /* WHEEL_H_ */
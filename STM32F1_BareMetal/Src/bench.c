@@ -0,0 +1,172 @@
+/**
+ ******************************************************************************
+ * @file           : bench.c
+ * @brief          : Benchmark harness on the DWT cycle counter
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "bench.h"
+#include "crc32_sw.h"
+#include "dwt.h"
+#include "systick.h"
+
+/* Weak in syscalls.c too: supplied by the application's console */
+extern int __io_putchar(int ch) __attribute__((weak));
+
+/* Variables */
+static bench_case_t *bench_head;
+static uint32_t bench_samples[BENCH_REPEATS_MAX];
+static uint32_t bench_crc;
+
+/* Functions */
+static void bench_empty(void *ctx)
+{
+  (void)ctx;
+}
+
+static void bench_emit(const void *buf, uint32_t len)
+{
+  const uint8_t *p = buf;
+
+  bench_crc = crc32_sw(bench_crc, buf, len);
+  if (__io_putchar != 0)
+  {
+    for (uint32_t i = 0; i < len; i++)
+    {
+      (void)__io_putchar(p[i]);
+    }
+  }
+}
+
+static void bench_emit_u8(uint32_t v)
+{
+  uint8_t b = (uint8_t)v;
+
+  bench_emit(&b, 1U);
+}
+
+static void bench_emit_u16(uint32_t v)
+{
+  uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+
+  bench_emit(b, sizeof(b));
+}
+
+static void bench_emit_u32(uint32_t v)
+{
+  uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16),
+                   (uint8_t)(v >> 24) };
+
+  bench_emit(b, sizeof(b));
+}
+
+/**
+ * @brief  Time `repeats` calls with interrupts masked into bench_samples,
+ *         sorted ascending.
+ */
+static void bench_sample(void (*fn)(void *), void *ctx, uint32_t repeats,
+                         uint32_t overhead)
+{
+  for (uint32_t i = 0; i < repeats; i++)
+  {
+    uint32_t primask = __get_PRIMASK();
+    uint32_t t;
+    uint32_t j;
+
+    __disable_irq();
+    t = dwt_cycles();
+    fn(ctx);
+    t = dwt_cycles() - t;
+    __set_PRIMASK(primask);
+
+    t = (t > overhead) ? (t - overhead) : 0U;
+
+    /* Insertion sort as we go: at most BENCH_REPEATS_MAX samples */
+    j = i;
+    while ((j > 0U) && (bench_samples[j - 1U] > t))
+    {
+      bench_samples[j] = bench_samples[j - 1U];
+      j--;
+    }
+    bench_samples[j] = t;
+  }
+}
+
+void bench_register(bench_case_t *c)
+{
+  bench_case_t **pp = &bench_head;
+
+  while (*pp != 0)
+  {
+    pp = &(*pp)->next;
+  }
+  c->next = 0;
+  *pp = c;
+}
+
+int bench_run(uint32_t warmup, uint32_t repeats)
+{
+  uint32_t overhead;
+  uint32_t flags = 0U;
+  uint32_t count = 0U;
+  uint32_t t;
+
+  if ((repeats == 0U) || (repeats > BENCH_REPEATS_MAX))
+  {
+    return -1;
+  }
+
+  dwt_init();
+  t = dwt_cycles();
+  for (volatile uint32_t i = 0; i < 16U; i++)
+  {
+  }
+  if (dwt_cycles() == t)
+  {
+    flags |= BENCH_FLAG_NO_CYCCNT;
+  }
+
+  /* The fastest empty call is the cost of timing one */
+  bench_sample(bench_empty, 0, repeats, 0U);
+  overhead = bench_samples[0];
+
+  bench_crc = 0U;
+  bench_emit("BNCH", 4U);
+  bench_emit_u8(BENCH_VERSION);
+  bench_emit_u8(flags);
+  bench_emit_u32(SYSTICK_CORE_HZ);
+
+  for (bench_case_t *c = bench_head; c != 0; c = c->next)
+  {
+    uint32_t len = (uint32_t)strlen(c->name);
+
+    for (uint32_t i = 0; i < warmup; i++)
+    {
+      c->fn(c->ctx);
+    }
+    bench_sample(c->fn, c->ctx, repeats, overhead);
+    c->min = bench_samples[0];
+    c->median = bench_samples[repeats / 2U];
+    c->max = bench_samples[repeats - 1U];
+
+    if (len > BENCH_NAME_MAX)
+    {
+      len = BENCH_NAME_MAX;
+    }
+    bench_emit_u8('C');
+    bench_emit_u8(len);
+    bench_emit(c->name, len);
+    bench_emit_u16(repeats);
+    bench_emit_u32(c->min);
+    bench_emit_u32(c->median);
+    bench_emit_u32(c->max);
+    count++;
+  }
+
+  bench_emit_u8('E');
+  bench_emit_u16(count);
+  bench_emit_u32(bench_crc);
+  return (int)count;
+}
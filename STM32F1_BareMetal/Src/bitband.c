@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * @file           : bitband.c
+ * @brief          : Bit-band versus read-modify-write cycle comparison
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "dwt.h"
+#include "bitband.h"
+
+#define BENCH_LOOPS       64U
+#define BENCH_BIT         5U
+
+/* Variables */
+static volatile uint32_t bench_word;
+
+/* Functions */
+static uint32_t bench_per_op(uint32_t cycles, uint32_t overhead)
+{
+  cycles = (cycles > overhead) ? (cycles - overhead) : 0U;
+  return (cycles + BENCH_LOOPS) / (2U * BENCH_LOOPS);
+}
+
+void bitband_bench(bitband_bench_t *out)
+{
+  uint32_t primask;
+  uint32_t overhead;
+  uint32_t t;
+
+  dwt_init();
+
+  t = dwt_cycles();
+  for (uint32_t i = 0; i < BENCH_LOOPS; i++)
+  {
+    __asm volatile ("" ::: "memory");
+  }
+  overhead = dwt_cycles() - t;
+
+  t = dwt_cycles();
+  for (uint32_t i = 0; i < BENCH_LOOPS; i++)
+  {
+    primask = __get_PRIMASK();
+    __disable_irq();
+    bench_word |= 1UL << BENCH_BIT;
+    __set_PRIMASK(primask);
+    primask = __get_PRIMASK();
+    __disable_irq();
+    bench_word &= ~(1UL << BENCH_BIT);
+    __set_PRIMASK(primask);
+  }
+  out->rmw_masked = bench_per_op(dwt_cycles() - t, overhead);
+
+  t = dwt_cycles();
+  for (uint32_t i = 0; i < BENCH_LOOPS; i++)
+  {
+    bench_word |= 1UL << BENCH_BIT;
+    bench_word &= ~(1UL << BENCH_BIT);
+  }
+  out->rmw = bench_per_op(dwt_cycles() - t, overhead);
+
+  t = dwt_cycles();
+  for (uint32_t i = 0; i < BENCH_LOOPS; i++)
+  {
+    BB_SRAM(bench_word, BENCH_BIT) = 1U;
+    BB_SRAM(bench_word, BENCH_BIT) = 0U;
+  }
+  out->bitband = bench_per_op(dwt_cycles() - t, overhead);
+}
@@ -0,0 +1,501 @@
+/**
+ ******************************************************************************
+ * @file           : can.c
+ * @brief          : bxCAN (CAN1) driver
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include <string.h>
+#include "stm32f1xx.h"
+#include "gpio.h"
+#include "idle.h"
+#include "can.h"
+#include "ring.h"
+
+#define CAN_INAK_TIMEOUT      0x000FFFFFUL
+#define CAN_PIN_RX            GPIO_PA(11)
+#define CAN_PIN_TX            GPIO_PA(12)
+#define CAN_TX_HEAP_LEN       (CAN_TX_QUEUE_LEN + 3U) /* room to requeue aborts */
+#define MB_RQCP(m)            (CAN_TSR_RQCP0 << ((m) * 8U))
+#define MB_TXOK(m)            (CAN_TSR_TXOK0 << ((m) * 8U))
+#define MB_ABRQ(m)            (CAN_TSR_ABRQ0 << ((m) * 8U))
+#define MB_TME(m)             (CAN_TSR_TME0 << (m))
+
+#if (CAN_RX_QUEUE_LEN & (CAN_RX_QUEUE_LEN - 1U)) != 0U
+#error "CAN_RX_QUEUE_LEN must be a power of two"
+#endif
+
+/* Filled by the RX interrupt, drained by can_receive() */
+typedef struct
+{
+  can_frame_t buf[CAN_RX_QUEUE_LEN];
+  ring_spsc_t ring;
+} can_rx_ring_t;
+
+typedef struct
+{
+  uint32_t key;             /* arbitration value, lower wins the bus */
+  uint32_t seq;             /* submission order, among equal keys */
+  can_frame_t frame;
+} can_tx_entry_t;
+
+/* Variables */
+static can_filter_image_t can_filters;
+static can_rx_ring_t can_rx[2];
+static can_tx_entry_t can_tx_heap[CAN_TX_HEAP_LEN];
+static uint32_t can_tx_count;
+static can_tx_entry_t can_tx_mailbox[3];
+static uint8_t can_tx_busy;       /* bit m: mailbox m loaded by the driver */
+static uint8_t can_tx_aborting;   /* bit m: abort requested on mailbox m */
+static uint32_t can_tx_seq;
+static can_stats_t can_stats;
+static uint8_t can_started;      /* holds an idle inhibit */
+
+/* Functions */
+
+/**
+ * Arbitration order: base identifier, then IDE (standard before extended),
+ * then the extended identifier bits, then RTR (data before remote).
+ */
+static uint32_t tx_key(const can_frame_t *f)
+{
+  uint32_t base = f->ide ? (f->id >> 18) : f->id;
+  uint32_t ext = f->ide ? (f->id & 0x3FFFFUL) : 0U;
+
+  return (((((base << 1) | f->ide) << 18) | ext) << 1) | (f->rtr ? 1U : 0U);
+}
+
+/* Queue order: arbitration value, then submission order for equal ones */
+static int tx_before(const can_tx_entry_t *a, const can_tx_entry_t *b)
+{
+  if (a->key != b->key)
+  {
+    return a->key < b->key;
+  }
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static void heap_push(const can_tx_entry_t *e)
+{
+  uint32_t i = can_tx_count++;
+
+  while (i > 0U)
+  {
+    uint32_t parent = (i - 1U) / 2U;
+
+    if (!tx_before(e, &can_tx_heap[parent]))
+    {
+      break;
+    }
+    can_tx_heap[i] = can_tx_heap[parent];
+    i = parent;
+  }
+  can_tx_heap[i] = *e;
+}
+
+static void heap_pop(can_tx_entry_t *out)
+{
+  can_tx_entry_t last;
+  uint32_t i = 0;
+
+  *out = can_tx_heap[0];
+  last = can_tx_heap[--can_tx_count];
+  for (;;)
+  {
+    uint32_t child = 2U * i + 1U;
+
+    if (child >= can_tx_count)
+    {
+      break;
+    }
+    if ((child + 1U < can_tx_count) &&
+        tx_before(&can_tx_heap[child + 1U], &can_tx_heap[child]))
+    {
+      child++;
+    }
+    if (!tx_before(&can_tx_heap[child], &last))
+    {
+      break;
+    }
+    can_tx_heap[i] = can_tx_heap[child];
+    i = child;
+  }
+  can_tx_heap[i] = last;
+}
+
+static void tx_load(uint32_t m, const can_tx_entry_t *e)
+{
+  CAN_TxMailBox_TypeDef *mb = &CAN1->sTxMailBox[m];
+  const can_frame_t *f = &e->frame;
+  uint32_t tir;
+
+  if (f->ide)
+  {
+    tir = (f->id << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE;
+  }
+  else
+  {
+    tir = f->id << CAN_TI0R_STID_Pos;
+  }
+  if (f->rtr)
+  {
+    tir |= CAN_TI0R_RTR;
+  }
+
+  can_tx_mailbox[m] = *e;
+  can_tx_busy |= (uint8_t)(1U << m);
+  mb->TDTR = f->dlc & CAN_TDT0R_DLC;
+  mb->TDLR = (uint32_t)f->data[0] | ((uint32_t)f->data[1] << 8) |
+             ((uint32_t)f->data[2] << 16) | ((uint32_t)f->data[3] << 24);
+  mb->TDHR = (uint32_t)f->data[4] | ((uint32_t)f->data[5] << 8) |
+             ((uint32_t)f->data[6] << 16) | ((uint32_t)f->data[7] << 24);
+  mb->TIR = tir | CAN_TI0R_TXRQ;
+}
+
+/* Whether a frame with this arbitration value is loaded in a mailbox */
+static int tx_key_pending(uint32_t key)
+{
+  for (uint32_t m = 0; m < 3U; m++)
+  {
+    if ((can_tx_busy & (1U << m)) && (can_tx_mailbox[m].key == key))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Retire completed mailboxes and refill them from the priority queue. Runs
+ * from the TX interrupt, or from thread context with that interrupt masked.
+ */
+static void tx_service(void)
+{
+  uint32_t tsr = CAN1->TSR;
+
+  for (uint32_t m = 0; m < 3U; m++)
+  {
+    if (!(tsr & MB_RQCP(m)))
+    {
+      continue;
+    }
+    CAN1->TSR = MB_RQCP(m);
+    if (tsr & MB_TXOK(m))
+    {
+      can_stats.tx_frames++;
+    }
+    else if (can_tx_aborting & (1U << m))
+    {
+      heap_push(&can_tx_mailbox[m]);
+      can_stats.tx_aborted++;
+    }
+    else
+    {
+      can_stats.tx_errors++;
+    }
+    can_tx_busy &= (uint8_t)~(1U << m);
+    can_tx_aborting &= (uint8_t)~(1U << m);
+  }
+
+  while (can_tx_count > 0U)
+  {
+    uint32_t worst = 3U;
+    uint32_t m;
+
+    /* With TXFP = 0 bxCAN sends equal identifiers lowest mailbox first, not
+     * in load order: the next frame of an identifier waits, and so does
+     * everything queued behind it, until the previous one has left. */
+    if (tx_key_pending(can_tx_heap[0].key))
+    {
+      break;
+    }
+
+    for (m = 0; m < 3U; m++)
+    {
+      if (!(can_tx_busy & (1U << m)) && (CAN1->TSR & MB_TME(m)))
+      {
+        break;
+      }
+    }
+    if (m < 3U)
+    {
+      can_tx_entry_t e;
+
+      heap_pop(&e);
+      tx_load(m, &e);
+      continue;
+    }
+
+    /* All mailboxes busy: if the most urgent queued frame outranks the least
+     * urgent pending one, abort that mailbox and requeue it on completion. */
+    for (m = 0; m < 3U; m++)
+    {
+      if (!(can_tx_aborting & (1U << m)) &&
+          ((worst == 3U) || (can_tx_mailbox[m].key > can_tx_mailbox[worst].key)))
+      {
+        worst = m;
+      }
+    }
+    if ((worst < 3U) && (can_tx_heap[0].key < can_tx_mailbox[worst].key))
+    {
+      can_tx_aborting |= (uint8_t)(1U << worst);
+      CAN1->TSR = MB_ABRQ(worst);
+    }
+    break;
+  }
+}
+
+static void rx_service(uint8_t fifo)
+{
+  __IO uint32_t *rfr = fifo ? &CAN1->RF1R : &CAN1->RF0R;
+  CAN_FIFOMailBox_TypeDef *mb = &CAN1->sFIFOMailBox[fifo];
+  can_rx_ring_t *ring = &can_rx[fifo];
+
+  /* RF0R and RF1R share the same bit layout */
+  while (*rfr & CAN_RF0R_FMP0)
+  {
+    uint32_t rir = mb->RIR;
+    uint32_t rdtr = mb->RDTR;
+    uint32_t index;
+
+    if (ring_spsc_write_span(&ring->ring, &index) != 0U)
+    {
+      can_frame_t *f = &ring->buf[index];
+      uint32_t lo = mb->RDLR;
+      uint32_t hi = mb->RDHR;
+      uint32_t dlc = (rdtr & CAN_RDT0R_DLC) >> CAN_RDT0R_DLC_Pos;
+
+      f->ide = (rir & CAN_RI0R_IDE) ? 1U : 0U;
+      f->id = f->ide ? (rir >> CAN_RI0R_EXID_Pos) : (rir >> CAN_RI0R_STID_Pos);
+      f->rtr = (rir & CAN_RI0R_RTR) ? 1U : 0U;
+      f->dlc = (uint8_t)((dlc > 8U) ? 8U : dlc);
+      f->tag = can_filters.fmi_tag[fifo][((rdtr & CAN_RDT0R_FMI) >>
+                                          CAN_RDT0R_FMI_Pos) % CAN_FILTER_MAX_FMI];
+      f->time = (uint16_t)(rdtr >> CAN_RDT0R_TIME_Pos);
+      for (uint32_t i = 0; i < 4U; i++)
+      {
+        f->data[i] = (uint8_t)(lo >> (8U * i));
+        f->data[i + 4U] = (uint8_t)(hi >> (8U * i));
+      }
+      ring_spsc_commit(&ring->ring, 1U);
+      can_stats.rx_frames[fifo]++;
+    }
+    else
+    {
+      can_stats.rx_dropped[fifo]++;
+    }
+    *rfr = CAN_RF0R_RFOM0;
+  }
+
+  if (*rfr & CAN_RF0R_FOVR0)
+  {
+    can_stats.rx_overrun[fifo]++;
+    *rfr = CAN_RF0R_FOVR0 | CAN_RF0R_FULL0;
+  }
+}
+
+static int wait_inak(uint32_t set)
+{
+  uint32_t timeout = CAN_INAK_TIMEOUT;
+
+  while (((CAN1->MSR & CAN_MSR_INAK) != 0U) != (set != 0U))
+  {
+    if (--timeout == 0U)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static void load_filters(void)
+{
+  CAN1->FMR |= CAN_FMR_FINIT;
+  CAN1->FA1R = 0;
+  CAN1->FM1R = can_filters.fm1r;
+  CAN1->FS1R = can_filters.fs1r;
+  CAN1->FFA1R = can_filters.ffa1r;
+  for (uint32_t b = 0; b < can_filters.banks; b++)
+  {
+    CAN1->sFilterRegister[b].FR1 = can_filters.fr[b][0];
+    CAN1->sFilterRegister[b].FR2 = can_filters.fr[b][1];
+  }
+  CAN1->FA1R = can_filters.fa1r;
+  CAN1->FMR &= ~CAN_FMR_FINIT;
+}
+
+/**
+ * @brief  Initialise CAN1, its pins and the acceptance filters.
+ * @param  cfg Bit timing, mode and filter rules
+ * @retval 0 on success, -1 if the filters do not fit or the controller does
+ *         not acknowledge a mode change
+ */
+int can_init(const can_config_t *cfg)
+{
+  can_filter_image_t img;
+
+  if (can_filter_compile(cfg->rules, cfg->rule_count, &img) < 0)
+  {
+    return -1;
+  }
+
+  RCC->APB2ENR |= RCC_APB2ENR_AFIOEN;
+  RCC->APB1ENR |= RCC_APB1ENR_CAN1EN;
+
+  gpio_enable(CAN_PIN_RX | CAN_PIN_TX);
+  gpio_config(CAN_PIN_RX, GPIO_IN_PULLUP);
+  gpio_config(CAN_PIN_TX, GPIO_AF_PP_50MHZ);
+
+  CAN1->MCR &= ~CAN_MCR_SLEEP;
+  CAN1->MCR |= CAN_MCR_INRQ;
+  if (wait_inak(1U) != 0)
+  {
+    return -1;
+  }
+
+  /* Automatic bus-off recovery, mailbox order by identifier (TXFP = 0) */
+  CAN1->MCR = (CAN1->MCR & ~(CAN_MCR_TXFP | CAN_MCR_NART | CAN_MCR_RFLM |
+                             CAN_MCR_TTCM | CAN_MCR_AWUM)) | CAN_MCR_ABOM;
+  CAN1->BTR = (cfg->btr & (CAN_BTR_BRP | CAN_BTR_TS1 | CAN_BTR_TS2 | CAN_BTR_SJW)) |
+              ((cfg->mode & CAN_MODE_LOOPBACK) ? CAN_BTR_LBKM : 0U) |
+              ((cfg->mode & CAN_MODE_SILENT) ? CAN_BTR_SILM : 0U);
+
+  can_filters = img;
+  load_filters();
+
+  (void)ring_spsc_init(&can_rx[0].ring, CAN_RX_QUEUE_LEN);
+  (void)ring_spsc_init(&can_rx[1].ring, CAN_RX_QUEUE_LEN);
+  memset(&can_stats, 0, sizeof(can_stats));
+  can_tx_count = 0;
+  can_tx_busy = 0;
+  can_tx_aborting = 0;
+
+  CAN1->MCR &= ~CAN_MCR_INRQ;
+  if (wait_inak(0U) != 0)
+  {
+    return -1;
+  }
+
+  CAN1->IER = CAN_IER_TMEIE | CAN_IER_FMPIE0 | CAN_IER_FOVIE0 |
+              CAN_IER_FMPIE1 | CAN_IER_FOVIE1 | CAN_IER_ERRIE |
+              CAN_IER_LECIE | CAN_IER_BOFIE | CAN_IER_EPVIE;
+  NVIC_SetPriority(CAN1_TX_IRQn, CAN_IRQ_PRIO);
+  NVIC_SetPriority(CAN1_RX0_IRQn, CAN_IRQ_PRIO);
+  NVIC_SetPriority(CAN1_RX1_IRQn, CAN_IRQ_PRIO);
+  NVIC_SetPriority(CAN1_SCE_IRQn, CAN_IRQ_PRIO);
+  NVIC_EnableIRQ(CAN1_TX_IRQn);
+  NVIC_EnableIRQ(CAN1_RX0_IRQn);
+  NVIC_EnableIRQ(CAN1_RX1_IRQn);
+  NVIC_EnableIRQ(CAN1_SCE_IRQn);
+
+  /* Stop mode would halt the controller mid-frame */
+  if (can_started == 0U)
+  {
+    can_started = 1U;
+    idle_inhibit();
+  }
+  return 0;
+}
+
+/**
+ * @brief  Replace the acceptance filters at run time.
+ * @retval Number of banks used, or -1 if the rules do not fit
+ */
+int can_set_filters(const can_filter_rule_t *rules, uint32_t count)
+{
+  can_filter_image_t img;
+  int banks = can_filter_compile(rules, count, &img);
+
+  if (banks < 0)
+  {
+    return -1;
+  }
+  NVIC_DisableIRQ(CAN1_RX0_IRQn);
+  NVIC_DisableIRQ(CAN1_RX1_IRQn);
+  can_filters = img;
+  load_filters();
+  NVIC_EnableIRQ(CAN1_RX0_IRQn);
+  NVIC_EnableIRQ(CAN1_RX1_IRQn);
+  return banks;
+}
+
+/**
+ * @brief  Queue a frame for transmission in arbitration order.
+ * @retval 0 on success, -1 if the transmit queue is full
+ */
+int can_transmit(const can_frame_t *frame)
+{
+  can_tx_entry_t e;
+  crit_t crit;
+  int ret = -1;
+
+  e.frame = *frame;
+  e.frame.id &= e.frame.ide ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+  e.key = tx_key(&e.frame);
+
+  crit = crit_enter(CAN_IRQ_PRIO);
+  if (can_tx_count < CAN_TX_QUEUE_LEN)
+  {
+    e.seq = can_tx_seq++;
+    heap_push(&e);
+    tx_service();
+    ret = 0;
+  }
+  crit_exit(crit);
+  return ret;
+}
+
+/**
+ * @brief  Take the oldest frame from a receive FIFO queue.
+ * @retval 0 on success, -1 if the queue is empty
+ */
+int can_receive(uint8_t fifo, can_frame_t *frame)
+{
+  can_rx_ring_t *ring = &can_rx[fifo & 1U];
+  uint32_t index;
+
+  if (ring_spsc_read_span(&ring->ring, &index) == 0U)
+  {
+    return -1;
+  }
+  *frame = ring->buf[index];
+  ring_spsc_release(&ring->ring, 1U);
+  return 0;
+}
+
+uint32_t can_rx_pending(uint8_t fifo)
+{
+  can_rx_ring_t *ring = &can_rx[fifo & 1U];
+
+  return ring_spsc_count(&ring->ring);
+}
+
+const can_stats_t *can_get_stats(void)
+{
+  return &can_stats;
+}
+
+void USB_HP_CAN_TX_IRQHandler(void)
+{
+  tx_service();
+}
+
+void USB_LP_CAN_RX0_IRQHandler(void)
+{
+  rx_service(0);
+}
+
+void CAN_RX1_IRQHandler(void)
+{
+  rx_service(1);
+}
+
+void CAN_SCE_IRQHandler(void)
+{
+  can_stats.esr = CAN1->ESR;
+  can_stats.bus_errors++;
+  CAN1->ESR = 0;            /* clear LEC so the next error raises again */
+  CAN1->MSR = CAN_MSR_ERRI;
+}
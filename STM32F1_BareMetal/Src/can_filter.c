@@ -0,0 +1,473 @@
+/**
+ ******************************************************************************
+ * @file           : can_filter.c
+ * @brief          : bxCAN acceptance filter compiler and bank simulator
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "can_filter.h"
+
+/* Filter register encodings, RM0008 "Filter bank scale and mode" */
+#define F32_IDE   (1UL << 2)
+#define F32_RTR   (1UL << 1)
+#define F16_RTR   (1UL << 4)
+#define F16_IDE   (1UL << 3)
+
+#define CLASS_EM  0U  /* extended mask: one 32-bit mask bank */
+#define CLASS_EL  1U  /* extended id: half a 32-bit list bank */
+#define CLASS_SM  2U  /* standard mask: half a 16-bit mask bank */
+#define CLASS_SL  3U  /* standard id: a quarter of a 16-bit list bank */
+
+typedef struct
+{
+  can_filter_image_t *img;
+  uint8_t fifo;
+  uint8_t fmi;
+} bank_writer_t;
+
+/* Functions */
+static uint32_t id_bits(uint8_t ide)
+{
+  return ide ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+}
+
+static uint32_t popcount(uint32_t x)
+{
+  uint32_t n = 0;
+
+  while (x)
+  {
+    x &= x - 1U;
+    n++;
+  }
+  return n;
+}
+
+static int same_class(const can_filter_rule_t *a, const can_filter_rule_t *b)
+{
+  return (a->fifo == b->fifo) && (a->ide == b->ide) && (a->rtr == b->rtr) &&
+         (a->tag == b->tag);
+}
+
+static uint32_t classify(const can_filter_rule_t *r)
+{
+  int exact = (r->mask == id_bits(r->ide));
+
+  if (r->ide)
+  {
+    return exact ? CLASS_EL : CLASS_EM;
+  }
+  return exact ? CLASS_SL : CLASS_SM;
+}
+
+static uint32_t remove_rule(can_filter_rule_t *r, uint32_t n, uint32_t idx)
+{
+  r[idx] = r[n - 1U];
+  return n - 1U;
+}
+
+/**
+ * Merge rules until a fixed point: drop rules covered by another rule of the
+ * same class, and fold pairs that share a mask and differ in exactly one
+ * identifier bit. Both steps keep the accepted set identical.
+ */
+static uint32_t merge_rules(can_filter_rule_t *r, uint32_t n)
+{
+  int changed = 1;
+
+  while (changed)
+  {
+    changed = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      for (uint32_t j = 0; j < n; j++)
+      {
+        if ((i == j) || !same_class(&r[i], &r[j]))
+        {
+          continue;
+        }
+        if (((r[i].mask & ~r[j].mask) == 0U) &&
+            (((r[i].id ^ r[j].id) & r[i].mask) == 0U))
+        {
+          n = remove_rule(r, n, j);
+          changed = 1;
+          break;
+        }
+        if (r[i].mask == r[j].mask)
+        {
+          uint32_t diff = (r[i].id ^ r[j].id) & r[i].mask;
+
+          if (popcount(diff) == 1U)
+          {
+            r[i].mask &= ~diff;
+            r[i].id &= r[i].mask;
+            n = remove_rule(r, n, j);
+            changed = 1;
+            break;
+          }
+        }
+      }
+      if (changed)
+      {
+        break;
+      }
+    }
+  }
+  return n;
+}
+
+/* Banks one FIFO needs for the given class sizes */
+static uint32_t bank_cost(const uint32_t cnt[4])
+{
+  /* Spare list/mask slots left by an odd number of extended IDs or standard
+   * masks absorb standard IDs. */
+  uint32_t spare = (cnt[CLASS_EL] & 1U) + (cnt[CLASS_SM] & 1U);
+  uint32_t sl_left = (cnt[CLASS_SL] > spare) ? cnt[CLASS_SL] - spare : 0U;
+
+  return cnt[CLASS_EM] + (cnt[CLASS_EL] + 1U) / 2U +
+         (cnt[CLASS_SM] + 1U) / 2U + (sl_left + 3U) / 4U;
+}
+
+/**
+ * A mask with one free bit costs as much as its two exact identifiers, but
+ * identifiers can also fill spare slots. Extended ones always split back;
+ * of the standard ones, each FIFO splits as many as gives the fewest banks,
+ * since a split also takes the spare slot of an odd standard mask away.
+ */
+static uint32_t split_masks(can_filter_rule_t *r, uint32_t n)
+{
+  for (uint8_t fifo = 0; fifo < 2U; fifo++)
+  {
+    uint32_t cnt[4] = { 0 };
+    uint32_t pairs = 0U;
+    uint32_t split = 0U;
+    uint32_t best;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+      int one_free = (popcount(id_bits(r[i].ide) & ~r[i].mask) == 1U);
+
+      if (r[i].fifo != fifo)
+      {
+        continue;
+      }
+      if (one_free && r[i].ide)
+      {
+        cnt[CLASS_EL] += 2U;
+      }
+      else
+      {
+        cnt[classify(&r[i])]++;
+        pairs += one_free ? 1U : 0U;
+      }
+    }
+
+    best = bank_cost(cnt);
+    for (uint32_t k = 1; k <= pairs; k++)
+    {
+      cnt[CLASS_SM]--;
+      cnt[CLASS_SL] += 2U;
+      if (bank_cost(cnt) < best)
+      {
+        best = bank_cost(cnt);
+        split = k;
+      }
+    }
+
+    for (uint32_t i = 0, limit = n; i < limit; i++)
+    {
+      uint32_t free_bits = id_bits(r[i].ide) & ~r[i].mask;
+
+      if ((r[i].fifo != fifo) || (popcount(free_bits) != 1U) ||
+          (n == CAN_FILTER_MAX_RULES) || (!r[i].ide && (split == 0U)))
+      {
+        continue;
+      }
+      if (!r[i].ide)
+      {
+        split--;
+      }
+      r[i].mask |= free_bits;
+      r[n] = r[i];
+      r[n].id |= free_bits;
+      n++;
+    }
+  }
+  return n;
+}
+
+static uint32_t enc32(const can_filter_rule_t *r)
+{
+  if (r->ide)
+  {
+    return (r->id << 3) | F32_IDE | (r->rtr ? F32_RTR : 0U);
+  }
+  return (r->id << 21) | (r->rtr ? F32_RTR : 0U);
+}
+
+static uint32_t enc32_mask(const can_filter_rule_t *r)
+{
+  return (r->mask << (r->ide ? 3 : 21)) | F32_IDE | F32_RTR;
+}
+
+static uint32_t enc16(const can_filter_rule_t *r)
+{
+  return (r->id << 5) | (r->rtr ? F16_RTR : 0U);
+}
+
+static uint32_t enc16_mask(const can_filter_rule_t *r)
+{
+  return (r->mask << 5) | F16_RTR | F16_IDE;
+}
+
+/* Claim the next bank for the writer's FIFO and return its index */
+static uint32_t bank_open(bank_writer_t *w, int list, int scale32)
+{
+  can_filter_image_t *img = w->img;
+  uint32_t bank = img->banks++;
+
+  img->fa1r |= 1UL << bank;
+  if (list)
+  {
+    img->fm1r |= 1UL << bank;
+  }
+  if (scale32)
+  {
+    img->fs1r |= 1UL << bank;
+  }
+  if (w->fifo)
+  {
+    img->ffa1r |= 1UL << bank;
+  }
+  return bank;
+}
+
+static void bank_slot(bank_writer_t *w, uint8_t tag)
+{
+  w->img->fmi_tag[w->fifo][w->fmi++] = tag;
+}
+
+/**
+ * Pop the next rule of a class, or fall back to repeating the previous one so
+ * unused slots in a bank never widen the accepted set.
+ */
+static const can_filter_rule_t *take(const can_filter_rule_t ***list,
+                                     uint32_t *count,
+                                     const can_filter_rule_t *fallback)
+{
+  if (*count == 0U)
+  {
+    return fallback;
+  }
+  (*count)--;
+  return *(*list)++;
+}
+
+static int pack_fifo(can_filter_image_t *img, const can_filter_rule_t *r,
+                     uint32_t n, uint8_t fifo)
+{
+  const can_filter_rule_t *cls[4][CAN_FILTER_MAX_RULES];
+  uint32_t cnt[4] = { 0 };
+  const can_filter_rule_t **sl;
+  bank_writer_t w = { img, fifo, 0 };
+  uint32_t banks = 0;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (r[i].fifo == fifo)
+    {
+      uint32_t c = classify(&r[i]);
+      cls[c][cnt[c]++] = &r[i];
+    }
+  }
+
+  banks = bank_cost(cnt);
+  if (img->banks + banks > CAN_FILTER_BANKS)
+  {
+    return -1;
+  }
+
+  sl = cls[CLASS_SL];
+
+  for (uint32_t i = 0; i < cnt[CLASS_EM]; i++)
+  {
+    const can_filter_rule_t *e = cls[CLASS_EM][i];
+    uint32_t b = bank_open(&w, 0, 1);
+
+    img->fr[b][0] = enc32(e);
+    img->fr[b][1] = enc32_mask(e);
+    bank_slot(&w, e->tag);
+  }
+
+  for (uint32_t i = 0; i < cnt[CLASS_EL]; i += 2U)
+  {
+    const can_filter_rule_t *a = cls[CLASS_EL][i];
+    const can_filter_rule_t *b2;
+    uint32_t b = bank_open(&w, 1, 1);
+
+    if (i + 1U < cnt[CLASS_EL])
+    {
+      b2 = cls[CLASS_EL][i + 1U];
+    }
+    else
+    {
+      b2 = take(&sl, &cnt[CLASS_SL], a);
+    }
+    img->fr[b][0] = enc32(a);
+    img->fr[b][1] = enc32(b2);
+    bank_slot(&w, a->tag);
+    bank_slot(&w, b2->tag);
+  }
+
+  for (uint32_t i = 0; i < cnt[CLASS_SM]; i += 2U)
+  {
+    const can_filter_rule_t *a = cls[CLASS_SM][i];
+    const can_filter_rule_t *b2;
+    uint32_t b = bank_open(&w, 0, 0);
+
+    if (i + 1U < cnt[CLASS_SM])
+    {
+      b2 = cls[CLASS_SM][i + 1U];
+    }
+    else
+    {
+      b2 = take(&sl, &cnt[CLASS_SL], a);
+    }
+    img->fr[b][0] = (enc16_mask(a) << 16) | enc16(a);
+    img->fr[b][1] = (enc16_mask(b2) << 16) | enc16(b2);
+    bank_slot(&w, a->tag);
+    bank_slot(&w, b2->tag);
+  }
+
+  while (cnt[CLASS_SL] > 0U)
+  {
+    const can_filter_rule_t *s[4];
+    uint32_t b = bank_open(&w, 1, 0);
+
+    s[0] = take(&sl, &cnt[CLASS_SL], NULL);
+    s[1] = take(&sl, &cnt[CLASS_SL], s[0]);
+    s[2] = take(&sl, &cnt[CLASS_SL], s[1]);
+    s[3] = take(&sl, &cnt[CLASS_SL], s[2]);
+    img->fr[b][0] = (enc16(s[1]) << 16) | enc16(s[0]);
+    img->fr[b][1] = (enc16(s[3]) << 16) | enc16(s[2]);
+    for (uint32_t k = 0; k < 4U; k++)
+    {
+      bank_slot(&w, s[k]->tag);
+    }
+  }
+  return 0;
+}
+
+int can_filter_compile(const can_filter_rule_t *rules, uint32_t count,
+                       can_filter_image_t *img)
+{
+  can_filter_rule_t r[CAN_FILTER_MAX_RULES];
+  uint32_t n;
+
+  memset(img, 0, sizeof(*img));
+  memset(img->fmi_tag, CAN_FILTER_NO_TAG, sizeof(img->fmi_tag));
+  if (count > CAN_FILTER_MAX_RULES)
+  {
+    return -1;
+  }
+
+  for (n = 0; n < count; n++)
+  {
+    uint32_t bits = id_bits(rules[n].ide ? 1U : 0U);
+
+    if ((rules[n].id & ~bits) || (rules[n].fifo > 1U))
+    {
+      return -1;
+    }
+    r[n] = rules[n];
+    r[n].ide = rules[n].ide ? 1U : 0U;
+    r[n].rtr = rules[n].rtr ? 1U : 0U;
+    r[n].mask &= bits;
+    r[n].id &= r[n].mask;
+  }
+
+  n = split_masks(r, merge_rules(r, n));
+
+  if ((pack_fifo(img, r, n, 0) != 0) || (pack_fifo(img, r, n, 1) != 0))
+  {
+    return -1;
+  }
+  return img->banks;
+}
+
+int can_filter_match(const can_filter_image_t *img, uint32_t id, uint8_t ide,
+                     uint8_t rtr, uint8_t *fifo)
+{
+  uint32_t rir = ide ? ((id << 3) | F32_IDE) : (id << 21);
+  uint32_t f16;
+  uint8_t next_fmi[2] = { 0, 0 };
+  int best_fmi = -1;
+  uint32_t best_class = 4U;
+
+  if (rtr)
+  {
+    rir |= F32_RTR;
+  }
+  f16 = ((rir >> 21) << 5) | (rtr ? F16_RTR : 0U) | (ide ? F16_IDE : 0U) |
+        ((rir >> 18) & 0x7U);
+
+  for (uint32_t b = 0; b < CAN_FILTER_BANKS; b++)
+  {
+    uint32_t bit = 1UL << b;
+    uint8_t f = (img->ffa1r & bit) ? 1U : 0U;
+    int list = (img->fm1r & bit) != 0U;
+    int scale32 = (img->fs1r & bit) != 0U;
+    /* Hardware priority: 32-bit list, 32-bit mask, 16-bit list, 16-bit mask */
+    uint32_t cls = (scale32 ? 0U : 2U) + (list ? 0U : 1U);
+    uint32_t r1 = img->fr[b][0];
+    uint32_t r2 = img->fr[b][1];
+    uint8_t fmi = next_fmi[f];
+    int hit = -1;
+
+    if (scale32 && list)
+    {
+      hit = (rir == r1) ? 0 : ((rir == r2) ? 1 : -1);
+      next_fmi[f] += 2U;
+    }
+    else if (scale32)
+    {
+      hit = (((rir ^ r1) & r2) == 0U) ? 0 : -1;
+      next_fmi[f] += 1U;
+    }
+    else if (list)
+    {
+      uint32_t v[4] = { r1 & 0xFFFFU, r1 >> 16, r2 & 0xFFFFU, r2 >> 16 };
+
+      for (int k = 0; k < 4 && hit < 0; k++)
+      {
+        hit = (f16 == v[k]) ? k : -1;
+      }
+      next_fmi[f] += 4U;
+    }
+    else
+    {
+      if (((f16 ^ r1) & (r1 >> 16) & 0xFFFFU) == 0U)
+      {
+        hit = 0;
+      }
+      else if (((f16 ^ r2) & (r2 >> 16) & 0xFFFFU) == 0U)
+      {
+        hit = 1;
+      }
+      next_fmi[f] += 2U;
+    }
+
+    if ((img->fa1r & bit) && (hit >= 0) && (cls < best_class))
+    {
+      best_class = cls;
+      best_fmi = fmi + hit;
+      if (fifo != NULL)
+      {
+        *fifo = f;
+      }
+    }
+  }
+  return best_fmi;
+}
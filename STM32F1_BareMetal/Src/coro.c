@@ -0,0 +1,217 @@
+/**
+ ******************************************************************************
+ * @file           : coro.c
+ * @brief          : Stackless coroutines on the event loop
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "atomic.h"
+#include "coro.h"
+#include "systick.h"
+
+#define CORO_FREE           0U
+#define CORO_ACTIVE         1U
+#define CORO_ASLEEP         2U
+
+/* Variables */
+static coro_t coro_pool[CORO_POOL];
+static volatile uint32_t coro_ready;        /* one bit per pool slot */
+static volatile uint32_t coro_posted;       /* run event queued */
+
+/* Functions */
+static void coro_run(uint32_t arg)
+{
+  uint32_t ready;
+
+  (void)arg;
+  coro_posted = 0U;
+  ready = atomic_and(&coro_ready, 0U);
+  while (ready != 0U)
+  {
+    uint32_t id = (uint32_t)__builtin_ctz(ready);
+    coro_t *c = &coro_pool[id];
+
+    ready &= ready - 1U;
+    if ((c->state != CORO_FREE) && (c->fn(c) == CORO_DONE))
+    {
+      c->state = CORO_FREE;
+    }
+  }
+}
+
+/**
+ * @brief  Queue the run event unless it is queued already. If the event
+ *         level is full, coro_tick() tries again.
+ */
+static void coro_post(void)
+{
+  if ((atomic_cas(&coro_posted, 0U, 1U) != 0U) &&
+      (event_post(CORO_EVENT_PRIO, coro_run, 0U) != 0))
+  {
+    coro_posted = 0U;
+  }
+}
+
+/**
+ * @brief  Mark a slot ready and make sure a run is queued.
+ */
+static void coro_ready_id(uint32_t id)
+{
+  (void)atomic_or(&coro_ready, 1UL << id);
+  coro_post();
+}
+
+int coro_spawn(coro_fn_t fn, const void *args, uint32_t size)
+{
+  coro_t *c;
+  uint32_t id;
+
+  if ((fn == 0) || (size > CORO_FRAME_SIZE))
+  {
+    return -1;
+  }
+
+  for (id = 0; id < CORO_POOL; id++)
+  {
+    if (coro_pool[id].state == CORO_FREE)
+    {
+      break;
+    }
+  }
+  if (id == CORO_POOL)
+  {
+    return -1;
+  }
+
+  c = &coro_pool[id];
+  memset(c->frame, 0, sizeof(c->frame));
+  if (size != 0U)
+  {
+    memcpy(c->frame, args, size);
+  }
+  c->fn = fn;
+  c->line = 0U;
+  c->value = 0U;
+  c->id = (uint8_t)id;
+  c->state = CORO_ACTIVE;
+  coro_ready_id(id);
+  return 0;
+}
+
+void coro_wake(coro_t *c)
+{
+  coro_ready_id(c->id);
+}
+
+void coro_sleep(coro_t *c, uint32_t ticks)
+{
+  c->wake = systick_ticks() + ticks;
+  c->state = CORO_ASLEEP;
+}
+
+uint32_t coro_sleeping(const coro_t *c)
+{
+  return (c->state == CORO_ASLEEP) ? 1U : 0U;
+}
+
+void coro_tick(void)
+{
+  uint32_t now = systick_ticks();
+
+  for (uint32_t id = 0; id < CORO_POOL; id++)
+  {
+    coro_t *c = &coro_pool[id];
+
+    if ((c->state == CORO_ASLEEP) && ((int32_t)(now - c->wake) >= 0))
+    {
+      c->state = CORO_ACTIVE;
+      coro_ready_id(id);
+    }
+  }
+
+  /* Retried every tick if the event level was full */
+  if ((coro_ready != 0U) && (coro_posted == 0U))
+  {
+    coro_post();
+  }
+}
+
+int coro_next(uint32_t *ticks)
+{
+  uint32_t now = systick_ticks();
+  uint32_t n = 0xFFFFFFFFUL;
+
+  for (uint32_t id = 0; id < CORO_POOL; id++)
+  {
+    const coro_t *c = &coro_pool[id];
+
+    if (c->state == CORO_ASLEEP)
+    {
+      /* Due once the count reaches wake */
+      int32_t d = (int32_t)(c->wake - now);
+      uint32_t k = (d > 0) ? (uint32_t)d - 1U : 0U;
+
+      if (k < n)
+      {
+        n = k;
+      }
+    }
+  }
+
+  if (n == 0xFFFFFFFFUL)
+  {
+    return -1;
+  }
+  *ticks = n;
+  return 0;
+}
+
+/**
+ * @brief  Take a signal's flags, or register c as its waiter.
+ * @retval 1 if flags were taken into c->value, 0 to suspend
+ */
+uint32_t coro_signal_take(coro_signal_t *s, coro_t *c)
+{
+  uint32_t me = (uint32_t)c->id + 1U;
+  uint32_t bits = atomic_and(&s->bits, 0U);
+
+  if (bits == 0U)
+  {
+    s->waiter = me;
+    /* A raise between the first look and registering saw no waiter */
+    bits = atomic_and(&s->bits, 0U);
+    if (bits == 0U)
+    {
+      return 0U;
+    }
+    /* If the raiser got in first we are also made ready, and that extra
+     * run finds us at a later suspension point, which re-checks */
+    (void)atomic_cas(&s->waiter, me, 0U);
+  }
+  c->value = bits;
+  return 1U;
+}
+
+void coro_signal_raise(coro_signal_t *s, uint32_t bits)
+{
+  uint32_t w;
+
+  atomic_or(&s->bits, bits);
+  w = s->waiter;
+  if ((w != 0U) && (atomic_cas(&s->waiter, w, 0U) != 0U))
+  {
+    coro_ready_id(w - 1U);
+  }
+}
+
+void coro_signal_cb(uint32_t bits, void *ctx)
+{
+  coro_signal_raise((coro_signal_t *)ctx, bits);
+}
+
+void coro_signal_done(void *ctx)
+{
+  coro_signal_raise((coro_signal_t *)ctx, 1U);
+}
@@ -0,0 +1,174 @@
+/**
+ ******************************************************************************
+ * @file           : crc.c
+ * @brief          : CRC calculation unit driver, CPU and DMA fed
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "atomic.h"
+#include "bitband.h"
+#include "dma.h"
+#include "crc.h"
+
+#define CRC_DMA_MAX       0xFFFFU   /* CNDTR limit per chunk */
+
+typedef struct
+{
+  const uint32_t *next;
+  size_t left;
+  crc_done_t done;
+  void *ctx;
+} crc_job_t;
+
+/* Variables */
+static volatile uint32_t crc_owned;
+static crc_job_t crc_job;
+
+/* Functions */
+static int crc_acquire(void)
+{
+  /* Test-and-set without masking anything */
+  return (atomic_cas(&crc_owned, 0U, 1U) != 0U) ? 0 : -1;
+}
+
+static void crc_release(void)
+{
+  crc_owned = 0;
+}
+
+static void crc_load(uint32_t state)
+{
+  CRC->CR = CRC_CR_RESET;
+  if (state != CRC32_NATIVE_INIT)
+  {
+    CRC->DR = crc32_preimage(state);
+  }
+}
+
+void crc_init(void)
+{
+  BB_PERIPH(RCC->AHBENR, RCC_AHBENR_CRCEN_Pos) = 1U;
+  (void)RCC->AHBENR;
+}
+
+uint32_t crc_words(uint32_t state, const uint32_t *words, size_t count)
+{
+  if (crc_acquire() != 0)
+  {
+    return crc32_sw_words(state, words, count);
+  }
+  crc_load(state);
+  while (count-- != 0U)
+  {
+    CRC->DR = *words++;
+  }
+  state = CRC->DR;
+  crc_release();
+  return state;
+}
+
+uint32_t crc_zlib(uint32_t crc, const void *buf, size_t len)
+{
+  const uint8_t *p = buf;
+  size_t head = (size_t)(-(uintptr_t)p) & 3U;
+
+  if ((len < CRC_HW_MIN_LEN) || (crc_acquire() != 0))
+  {
+    return crc32_sw(crc, p, len);
+  }
+
+  crc = crc32_sw(crc, p, head);
+  p += head;
+  len -= head;
+
+  /* The unit's register is the bit-reversed zlib register */
+  crc_load(__RBIT(~crc));
+  for (const uint32_t *w = (const uint32_t *)p; len >= 4U; len -= 4U)
+  {
+    CRC->DR = __RBIT(*w++);
+    p += 4;
+  }
+  crc = ~__RBIT(CRC->DR);
+  crc_release();
+
+  return crc32_sw(crc, p, len);
+}
+
+static void crc_dma_chunk(void)
+{
+  DMA_Channel_TypeDef *dma = dma_channel(CRC_DMA_CHANNEL);
+  uint32_t n = (crc_job.left > CRC_DMA_MAX) ? CRC_DMA_MAX : (uint32_t)crc_job.left;
+
+  dma->CCR = 0;
+  dma->CPAR = (uint32_t)&CRC->DR;
+  dma->CMAR = (uint32_t)crc_job.next;
+  dma->CNDTR = n;
+  crc_job.next += n;
+  crc_job.left -= n;
+  dma->CCR = DMA_CCR_MEM2MEM | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 |
+             DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TEIE | DMA_CCR_TCIE |
+             DMA_CCR_EN;
+}
+
+static void crc_dma_finish(int status)
+{
+  crc_done_t done = crc_job.done;
+  void *ctx = crc_job.ctx;
+  uint32_t state = CRC->DR;
+
+  dma_release(CRC_DMA_CHANNEL);
+  crc_release();
+  if (done != NULL)
+  {
+    done(status, state, ctx);
+  }
+}
+
+static void crc_dma_event(uint32_t events, void *ctx)
+{
+  (void)ctx;
+
+  if (events & DMA_EVT_TE)
+  {
+    crc_dma_finish(-1);
+  }
+  else if (events & DMA_EVT_TC)
+  {
+    if (crc_job.left != 0U)
+    {
+      crc_dma_chunk();
+    }
+    else
+    {
+      crc_dma_finish(0);
+    }
+  }
+}
+
+int crc_words_dma(uint32_t state, const uint32_t *words, size_t count,
+                  crc_done_t done, void *ctx)
+{
+  if ((count == 0U) || (crc_acquire() != 0))
+  {
+    return -1;
+  }
+  if (dma_claim(CRC_DMA_CHANNEL, crc_dma_event, NULL) != 0)
+  {
+    crc_release();
+    return -1;
+  }
+
+  crc_load(state);
+  crc_job.next = words;
+  crc_job.left = count;
+  crc_job.done = done;
+  crc_job.ctx = ctx;
+  crc_dma_chunk();
+  return 0;
+}
+
+int crc_busy(void)
+{
+  return crc_owned;
+}
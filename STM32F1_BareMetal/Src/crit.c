@@ -0,0 +1,63 @@
+/**
+ ******************************************************************************
+ * @file           : crit.c
+ * @brief          : BASEPRI critical sections with per-resource ceilings
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "crit.h"
+
+#ifdef CRIT_ASSERT
+
+#include "dwt.h"
+
+/* Variables */
+static uint32_t crit_start;
+static crit_stats_t crit_stats;
+
+/* Functions */
+void crit_assert_enter(uint32_t ceiling)
+{
+  uint32_t exc = __get_IPSR();
+
+  /* An interrupt already more urgent than the ceiling is not kept out of
+   * the resource by it: whatever it shares with can be preempted by it */
+  if ((ceiling == 0U) ||
+      ((exc >= 16U) && (NVIC_GetPriority((IRQn_Type)(exc - 16U)) < ceiling)))
+  {
+    crit_stats.violations++;
+  }
+  crit_start = dwt_cycles();
+}
+
+__attribute__((noinline)) void crit_assert_exit(void)
+{
+  uint32_t t = dwt_cycles() - crit_start;
+
+  if (t > crit_stats.max_cycles)
+  {
+    crit_stats.max_cycles = t;
+    crit_stats.max_site = (uint32_t)(uintptr_t)__builtin_return_address(0);
+  }
+}
+
+void crit_get_stats(crit_stats_t *out)
+{
+  crit_t c = crit_enter(1U);
+
+  *out = crit_stats;
+  crit_exit(c);
+}
+
+void crit_reset_stats(void)
+{
+  crit_t c = crit_enter(1U);
+
+  crit_stats.max_cycles = 0U;
+  crit_stats.max_site = 0U;
+  crit_stats.violations = 0U;
+  crit_exit(c);
+}
+
+#endif /* CRIT_ASSERT */
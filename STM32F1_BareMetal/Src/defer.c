@@ -0,0 +1,217 @@
+/**
+ ******************************************************************************
+ * @file           : defer.c
+ * @brief          : Deferred interrupt work run from PendSV
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "stm32f1xx.h"
+#include "atomic.h"
+#include "crit.h"
+#include "defer.h"
+#include "dwt.h"
+#include "ring.h"
+
+/* The Debug build would otherwise put -O0 on the post and run paths */
+#pragma GCC optimize ("O2")
+
+#define DEFER_PRIO_LOWEST   ((1UL << __NVIC_PRIO_BITS) - 1UL)
+
+typedef struct
+{
+  defer_fn_t fn;
+  uint32_t arg;
+  uint32_t stamp;           /* DWT cycles at post */
+} defer_item_t;
+
+typedef struct
+{
+  ring_mpsc_t ring;
+  volatile uint32_t seq[DEFER_QUEUE_LEN];
+  defer_item_t items[DEFER_QUEUE_LEN];
+} defer_queue_t;
+
+/* Variables */
+static defer_queue_t defer_queues[DEFER_PRIOS];
+static volatile uint32_t defer_ready;
+static defer_stats_t defer_stats[DEFER_PRIOS];
+static defer_record_t defer_records[DEFER_TRACE_LEN];
+static uint32_t defer_records_head;         /* records written, wraps */
+
+/* Functions */
+/**
+ * @brief  Clear a level's ready bit once its queue looks empty, as in
+ *         event.c: a post that lands in between is caught by the recheck.
+ */
+static void defer_settle(const defer_queue_t *q, uint32_t bit)
+{
+  atomic_and(&defer_ready, ~bit);
+  if (ring_mpsc_ready(&q->ring) != 0U)
+  {
+    atomic_or(&defer_ready, bit);
+  }
+}
+
+/**
+ * @brief  Take the oldest item of the most urgent non-empty level.
+ * @retval 0 on success, -1 if nothing is queued
+ */
+static int defer_take(defer_item_t *out, uint32_t *prio_out)
+{
+  uint32_t ready = defer_ready;
+
+  while (ready != 0U)
+  {
+    uint32_t prio = 31U - __CLZ(ready);
+    uint32_t bit = 1UL << prio;
+    defer_queue_t *q = &defer_queues[prio];
+
+    if (ring_mpsc_ready(&q->ring) != 0U)
+    {
+      atomic_fence();
+      *out = q->items[q->ring.tail & (DEFER_QUEUE_LEN - 1U)];
+      ring_mpsc_release(&q->ring, 1U);
+      if (ring_mpsc_ready(&q->ring) == 0U)
+      {
+        defer_settle(q, bit);
+      }
+      *prio_out = prio;
+      return 0;
+    }
+
+    /* Empty, or the head slot is claimed by a post still in progress */
+    defer_settle(q, bit);
+    ready &= ~bit;
+  }
+  return -1;
+}
+
+void defer_init(void)
+{
+  for (uint32_t i = 0; i < DEFER_PRIOS; i++)
+  {
+    (void)ring_mpsc_init(&defer_queues[i].ring, defer_queues[i].seq,
+                         DEFER_QUEUE_LEN);
+  }
+  defer_ready = 0U;
+  defer_reset_stats();
+  dwt_init();
+  NVIC_SetPriority(PendSV_IRQn, DEFER_PRIO_LOWEST);
+}
+
+int defer_post(uint32_t prio, defer_fn_t fn, uint32_t arg)
+{
+  defer_queue_t *q;
+  defer_item_t *item;
+  uint32_t pos;
+
+  if ((prio >= DEFER_PRIOS) || (fn == 0))
+  {
+    return -1;
+  }
+
+  q = &defer_queues[prio];
+  if (ring_mpsc_claim(&q->ring, 1U, &pos) == 0U)
+  {
+    (void)atomic_add(&defer_stats[prio].dropped, 1U);
+    return -1;
+  }
+  item = &q->items[pos & (DEFER_QUEUE_LEN - 1U)];
+  item->fn = fn;
+  item->arg = arg;
+  item->stamp = dwt_cycles();
+  ring_mpsc_publish(&q->ring, pos, 1U);
+  atomic_or(&defer_ready, 1UL << prio);
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  return 0;
+}
+
+void defer_run(void)
+{
+  for (uint32_t n = 0; n < DEFER_BATCH; n++)
+  {
+    defer_item_t item;
+    defer_stats_t *s;
+    defer_record_t *r;
+    uint32_t prio;
+    uint32_t start;
+    uint32_t run;
+
+    if (defer_take(&item, &prio) != 0)
+    {
+      return;
+    }
+
+    start = dwt_cycles();
+    item.fn(item.arg);
+    run = dwt_cycles() - start;
+
+    /* Only PendSV writes these */
+    s = &defer_stats[prio];
+    s->runs++;
+    if ((start - item.stamp) > s->delay_max)
+    {
+      s->delay_max = start - item.stamp;
+    }
+    if (run > s->run_max)
+    {
+      s->run_max = run;
+    }
+    r = &defer_records[defer_records_head & (DEFER_TRACE_LEN - 1U)];
+    r->fn = item.fn;
+    r->prio = prio;
+    r->delay = start - item.stamp;
+    r->run = run;
+    defer_records_head++;
+  }
+
+  if (defer_ready != 0U)
+  {
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  }
+}
+
+int defer_get_stats(uint32_t prio, defer_stats_t *out)
+{
+  crit_t c;
+
+  if (prio >= DEFER_PRIOS)
+  {
+    return -1;
+  }
+
+  /* Hold off PendSV for a consistent copy */
+  c = crit_enter(DEFER_PRIO_LOWEST);
+  *out = defer_stats[prio];
+  crit_exit(c);
+  return 0;
+}
+
+void defer_reset_stats(void)
+{
+  crit_t c = crit_enter(DEFER_PRIO_LOWEST);
+
+  memset(defer_stats, 0, sizeof(defer_stats));
+  defer_records_head = 0U;
+  crit_exit(c);
+}
+
+uint32_t defer_trace(defer_record_t *out, uint32_t max)
+{
+  crit_t c = crit_enter(DEFER_PRIO_LOWEST);
+  uint32_t head = defer_records_head;
+  uint32_t n = (head < DEFER_TRACE_LEN) ? head : DEFER_TRACE_LEN;
+
+  if (n > max)
+  {
+    n = max;
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    out[i] = defer_records[(head - n + i) & (DEFER_TRACE_LEN - 1U)];
+  }
+  crit_exit(c);
+  return n;
+}
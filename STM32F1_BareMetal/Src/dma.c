@@ -0,0 +1,118 @@
+/**
+ ******************************************************************************
+ * @file           : dma.c
+ * @brief          : DMA1 channel ownership and interrupt dispatch
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include "bitband.h"
+#include "dma.h"
+#include "idle.h"
+
+typedef struct
+{
+  dma_callback_t cb;
+  void *ctx;
+} dma_owner_t;
+
+/* Variables */
+static dma_owner_t dma_owner[DMA_CHANNELS];
+
+/* Functions */
+int dma_claim(uint32_t ch, dma_callback_t cb, void *ctx)
+{
+  crit_t crit;
+  int ret = -1;
+
+  if ((ch < 1U) || (ch > DMA_CHANNELS) || (cb == NULL))
+  {
+    return -1;
+  }
+
+  crit = crit_enter(DMA_IRQ_PRIO);
+  if (dma_owner[ch - 1U].cb == NULL)
+  {
+    dma_owner[ch - 1U].cb = cb;
+    dma_owner[ch - 1U].ctx = ctx;
+    ret = 0;
+  }
+  crit_exit(crit);
+
+  if (ret == 0)
+  {
+    BB_PERIPH(RCC->AHBENR, RCC_AHBENR_DMA1EN_Pos) = 1U;
+    dma_channel(ch)->CCR = 0;
+    DMA1->IFCR = 0xFUL << (4U * (ch - 1U));
+    NVIC_SetPriority((IRQn_Type)(DMA1_Channel1_IRQn + (ch - 1U)), DMA_IRQ_PRIO);
+    NVIC_ClearPendingIRQ((IRQn_Type)(DMA1_Channel1_IRQn + (ch - 1U)));
+    NVIC_EnableIRQ((IRQn_Type)(DMA1_Channel1_IRQn + (ch - 1U)));
+    idle_inhibit();
+  }
+  return ret;
+}
+
+void dma_release(uint32_t ch)
+{
+  if ((ch < 1U) || (ch > DMA_CHANNELS))
+  {
+    return;
+  }
+  NVIC_DisableIRQ((IRQn_Type)(DMA1_Channel1_IRQn + (ch - 1U)));
+  dma_channel(ch)->CCR = 0;
+  DMA1->IFCR = 0xFUL << (4U * (ch - 1U));
+  if (dma_owner[ch - 1U].cb != NULL)
+  {
+    dma_owner[ch - 1U].cb = NULL;
+    idle_allow();
+  }
+}
+
+static void dma_dispatch(uint32_t ch)
+{
+  uint32_t shift = 4U * (ch - 1U);
+  uint32_t events = (DMA1->ISR >> shift) & 0xFU;
+  dma_owner_t *o = &dma_owner[ch - 1U];
+
+  DMA1->IFCR = events << shift;
+  if (o->cb != NULL)
+  {
+    o->cb(events & (DMA_EVT_TC | DMA_EVT_HT | DMA_EVT_TE), o->ctx);
+  }
+}
+
+void DMA1_Channel1_IRQHandler(void)
+{
+  dma_dispatch(1);
+}
+
+void DMA1_Channel2_IRQHandler(void)
+{
+  dma_dispatch(2);
+}
+
+void DMA1_Channel3_IRQHandler(void)
+{
+  dma_dispatch(3);
+}
+
+void DMA1_Channel4_IRQHandler(void)
+{
+  dma_dispatch(4);
+}
+
+void DMA1_Channel5_IRQHandler(void)
+{
+  dma_dispatch(5);
+}
+
+void DMA1_Channel6_IRQHandler(void)
+{
+  dma_dispatch(6);
+}
+
+void DMA1_Channel7_IRQHandler(void)
+{
+  dma_dispatch(7);
+}
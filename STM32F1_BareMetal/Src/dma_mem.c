@@ -0,0 +1,298 @@
+/**
+ ******************************************************************************
+ * @file           : dma_mem.c
+ * @brief          : DMA-offloaded memcpy/memset
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "dma.h"
+#include "dwt.h"
+#include "dma_mem.h"
+
+#if (DMA_MEM_QUEUE_LEN & (DMA_MEM_QUEUE_LEN - 1U)) != 0U
+#error "DMA_MEM_QUEUE_LEN must be a power of two"
+#endif
+
+#define DMA_MEM_MAX         0xFFFFU   /* CNDTR limit per chunk */
+#define DMA_MEM_CAL_MIN     16U
+#define DMA_MEM_FLOOR       8U        /* leaves at least one aligned word */
+
+typedef struct
+{
+  uint8_t *buf;             /* destination as submitted */
+  const uint8_t *from;      /* source as submitted, NULL for a fill */
+  size_t len;
+  uint32_t src;             /* next source address */
+  uint32_t dst;             /* next destination address */
+  uint32_t count;           /* transfers left */
+  uint32_t width;           /* bytes per transfer, 1 or 4 */
+  uint32_t fill;            /* memset pattern, read in place by the DMA */
+  dma_mem_done_t done;
+  void *ctx;
+} dma_mem_job_t;
+
+/* Variables */
+size_t dma_mem_min_len = DMA_MEM_MIN_LEN;
+
+static dma_mem_job_t dma_mem_queue[DMA_MEM_QUEUE_LEN];
+static volatile uint32_t dma_mem_head;        /* next free slot */
+static volatile uint32_t dma_mem_tail;        /* oldest unfinished job */
+static uint8_t dma_mem_running;               /* the tail job is on the DMA */
+static uint32_t dma_mem_issued = 1;
+static volatile uint32_t dma_mem_completed = 1;
+
+/* Functions */
+static uint32_t dma_mem_next_token(uint32_t token)
+{
+  token++;
+  return (token == DMA_MEM_TOKEN_NONE) ? (token + 1U) : token;
+}
+
+static void dma_mem_start(dma_mem_job_t *job)
+{
+  DMA_Channel_TypeDef *dma = dma_channel(DMA_MEM_CHANNEL);
+  uint32_t n = (job->count > DMA_MEM_MAX) ? DMA_MEM_MAX : job->count;
+  uint32_t ccr = DMA_CCR_MEM2MEM | DMA_CCR_DIR | DMA_CCR_PINC |
+                 DMA_CCR_TEIE | DMA_CCR_TCIE | DMA_CCR_EN;
+
+  if (job->width == 4U)
+  {
+    ccr |= DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1;
+  }
+  if (job->from != NULL)
+  {
+    ccr |= DMA_CCR_MINC;
+  }
+
+  dma->CCR = 0;
+  dma->CMAR = (job->from != NULL) ? job->src : (uint32_t)&job->fill;
+  dma->CPAR = job->dst;
+  dma->CNDTR = n;
+  job->count -= n;
+  job->dst += n * job->width;
+  if (job->from != NULL)
+  {
+    job->src += n * job->width;
+  }
+  dma->CCR = ccr;
+}
+
+static int dma_mem_short(size_t len)
+{
+  return (len < dma_mem_min_len) || (len < DMA_MEM_FLOOR);
+}
+
+/* Move or fill `len` bytes of a job with the CPU, `at` bytes in */
+static void dma_mem_cpu(const dma_mem_job_t *job, size_t at, size_t len)
+{
+  if (job->from != NULL)
+  {
+    memcpy(job->buf + at, job->from + at, len);
+  }
+  else
+  {
+    memset(job->buf + at, (int)(job->fill & 0xFFU), len);
+  }
+}
+
+/**
+ * Begin the job at the tail: a short job is done by the CPU, otherwise the
+ * CPU moves the unaligned head and tail bytes and the DMA the rest. Only
+ * here, once every earlier job has finished, does the job touch memory.
+ * @retval 1 if the DMA runs, 0 if the job is already finished
+ */
+static int dma_mem_begin(dma_mem_job_t *job)
+{
+  uintptr_t d = (uintptr_t)job->buf;
+  uintptr_t s = (uintptr_t)job->from;
+  size_t head;
+  size_t tail;
+
+  if (dma_mem_short(job->len))
+  {
+    dma_mem_cpu(job, 0, job->len);
+    return 0;
+  }
+  if ((job->from != NULL) && (((d ^ s) & 3U) != 0U))
+  {
+    head = 0;
+    tail = 0;
+    job->width = 1U;
+    job->count = (uint32_t)job->len;
+  }
+  else
+  {
+    head = (size_t)(-d) & 3U;
+    tail = (job->len - head) & 3U;
+    dma_mem_cpu(job, 0, head);
+    dma_mem_cpu(job, job->len - tail, tail);
+    job->width = 4U;
+    job->count = (uint32_t)((job->len - head - tail) / 4U);
+  }
+  job->dst = (uint32_t)(d + head);
+  job->src = (uint32_t)(s + head);
+  dma_mem_running = 1U;
+  dma_mem_start(job);
+  return 1;
+}
+
+static void dma_mem_finish(const dma_mem_job_t *job)
+{
+  dma_mem_done_t done = job->done;
+  void *ctx = job->ctx;
+
+  dma_mem_completed = dma_mem_next_token(dma_mem_completed);
+  dma_mem_tail++;
+  if (done != NULL)
+  {
+    done(ctx);
+  }
+}
+
+/**
+ * Begin queued jobs in order until one is left running on the DMA. A done
+ * callback that submits runs this again, so the loop re-checks the flag.
+ */
+static void dma_mem_run(void)
+{
+  while (!dma_mem_running && (dma_mem_head != dma_mem_tail))
+  {
+    dma_mem_job_t *job =
+      &dma_mem_queue[dma_mem_tail & (DMA_MEM_QUEUE_LEN - 1U)];
+
+    if (dma_mem_begin(job) == 0)
+    {
+      dma_mem_finish(job);
+    }
+  }
+}
+
+static void dma_mem_event(uint32_t events, void *ctx)
+{
+  dma_mem_job_t *job = &dma_mem_queue[dma_mem_tail & (DMA_MEM_QUEUE_LEN - 1U)];
+
+  (void)ctx;
+  if (!(events & (DMA_EVT_TC | DMA_EVT_TE)))
+  {
+    return;
+  }
+  if (!(events & DMA_EVT_TE) && (job->count != 0U))
+  {
+    dma_mem_start(job);
+    return;
+  }
+
+  dma_channel(DMA_MEM_CHANNEL)->CCR = 0;
+  dma_mem_running = 0U;
+  dma_mem_finish(job);
+  dma_mem_run();
+}
+
+static dma_mem_token_t dma_mem_submit(void *dst, const void *src,
+                                      uint8_t value, size_t len,
+                                      dma_mem_done_t done, void *ctx)
+{
+  dma_mem_job_t *job;
+  dma_mem_token_t token;
+  crit_t crit;
+
+  /* The completion interrupt advances the queue */
+  crit = crit_enter(DMA_IRQ_PRIO);
+  if ((dma_mem_head - dma_mem_tail) == DMA_MEM_QUEUE_LEN)
+  {
+    crit_exit(crit);
+    return DMA_MEM_TOKEN_NONE;
+  }
+  job = &dma_mem_queue[dma_mem_head & (DMA_MEM_QUEUE_LEN - 1U)];
+  job->buf = dst;
+  job->from = src;
+  job->len = len;
+  job->fill = 0x01010101UL * value;
+  job->done = done;
+  job->ctx = ctx;
+
+  /* Nothing ahead of it: a short job is done here, outside the critical
+   * section, with a token that has already completed */
+  if ((dma_mem_head == dma_mem_tail) && dma_mem_short(len))
+  {
+    crit_exit(crit);
+    dma_mem_cpu(job, 0, len);
+    if (done != NULL)
+    {
+      done(ctx);
+    }
+    return dma_mem_completed;
+  }
+
+  dma_mem_issued = dma_mem_next_token(dma_mem_issued);
+  token = dma_mem_issued;
+  dma_mem_head++;
+  dma_mem_run();
+  crit_exit(crit);
+  return token;
+}
+
+int dma_mem_init(void)
+{
+  return dma_claim(DMA_MEM_CHANNEL, dma_mem_event, NULL);
+}
+
+dma_mem_token_t dma_memcpy(void *dst, const void *src, size_t len,
+                           dma_mem_done_t done, void *ctx)
+{
+  return dma_mem_submit(dst, src, 0U, len, done, ctx);
+}
+
+dma_mem_token_t dma_memset(void *dst, int value, size_t len,
+                           dma_mem_done_t done, void *ctx)
+{
+  return dma_mem_submit(dst, NULL, (uint8_t)value, len, done, ctx);
+}
+
+int dma_mem_done(dma_mem_token_t token)
+{
+  return (int32_t)(dma_mem_completed - token) >= 0;
+}
+
+size_t dma_mem_calibrate(void *scratch, size_t size)
+{
+  uint8_t *a = scratch;
+  uint8_t *b = a + size / 2U;
+  size_t saved = dma_mem_min_len;
+  size_t found = 0;
+
+  dwt_init();
+  dma_mem_min_len = 0;
+  for (size_t len = DMA_MEM_CAL_MIN; len <= size / 2U; len <<= 1)
+  {
+    dma_mem_token_t token;
+    uint32_t t_cpu;
+    uint32_t t_dma;
+    uint32_t t;
+
+    t = dwt_cycles();
+    memcpy(b, a, len);
+    t_cpu = dwt_cycles() - t;
+
+    t = dwt_cycles();
+    token = dma_memcpy(b, a, len, NULL, NULL);
+    if (token == DMA_MEM_TOKEN_NONE)
+    {
+      break;
+    }
+    while (!dma_mem_done(token))
+    {
+    }
+    t_dma = dwt_cycles() - t;
+
+    if (t_dma <= t_cpu)
+    {
+      found = len;
+      break;
+    }
+  }
+  dma_mem_min_len = (found != 0U) ? found : saved;
+  return found;
+}
@@ -0,0 +1,236 @@
+/**
+ ******************************************************************************
+ * @file           : encoder.c
+ * @brief          : Quadrature encoder interface with 64-bit position and
+ *                   M/T velocity estimation
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include <string.h>
+#include "tim.h"
+#include "encoder.h"
+
+#define ENC_COUNTS_PER_EDGE   4   /* x4 decoding, TI1 rising edges only */
+#define ENC_Q8_MAX            0x7FFFFFFFL
+
+/* Functions */
+
+/**
+ * Internal trigger (ITRx) of `slave` that carries the TRGO of `master`,
+ * RM0008 "TIMx internal trigger connection".
+ */
+static int encoder_itr(const TIM_TypeDef *slave, const TIM_TypeDef *master)
+{
+  static const TIM_TypeDef *const map[4][4] = {
+    { NULL, TIM2, TIM3, TIM4 },   /* TIM1: ITR0 is TIM5 (not on F103xB) */
+    { TIM1, NULL, TIM3, TIM4 },   /* TIM2: ITR1 is TIM8 */
+    { TIM1, TIM2, NULL, TIM4 },   /* TIM3: ITR2 is TIM5 */
+    { TIM1, TIM2, TIM3, NULL },   /* TIM4: ITR3 is TIM8 */
+  };
+  static const TIM_TypeDef *const slaves[4] = { TIM1, TIM2, TIM3, TIM4 };
+
+  for (int s = 0; s < 4; s++)
+  {
+    if (slaves[s] != slave)
+    {
+      continue;
+    }
+    for (int itr = 0; itr < 4; itr++)
+    {
+      if (map[s][itr] == master)
+      {
+        return itr;
+      }
+    }
+  }
+  return -1;
+}
+
+/**
+ * counts * hz / dt in Q24.8 using two 32-bit divisions (UDIV) in the common
+ * case, falling back to 64-bit arithmetic for large operands.
+ */
+static int32_t encoder_rate_q8(int32_t counts, uint32_t hz, uint32_t dt)
+{
+  uint32_t mag = (uint32_t)((counts < 0) ? -counts : counts);
+  uint32_t v;
+
+  if ((dt == 0U) || (mag == 0U))
+  {
+    return 0;
+  }
+  if ((hz <= 0xFFFFFFFFU / mag) && (dt < (1UL << 24)))
+  {
+    uint32_t num = mag * hz;
+    uint32_t q = num / dt;
+    uint32_t r = num - q * dt;
+
+    v = (q >= (1UL << 23)) ? (uint32_t)ENC_Q8_MAX : ((q << 8) | ((r << 8) / dt));
+  }
+  else
+  {
+    uint64_t q8 = (((uint64_t)mag * hz) << 8) / dt;
+
+    v = (q8 > (uint64_t)ENC_Q8_MAX) ? (uint32_t)ENC_Q8_MAX : (uint32_t)q8;
+  }
+  return (counts < 0) ? -(int32_t)v : (int32_t)v;
+}
+
+/**
+ * @brief  Claim and configure the encoder timer and, optionally, its
+ *         timebase timer.
+ * @retval 0 on success, -1 on an unsupported timer combination or a timer
+ *         already owned by another driver
+ */
+int encoder_init(encoder_t *e, const encoder_config_t *cfg)
+{
+  TIM_TypeDef *tim = cfg->tim;
+  TIM_TypeDef *tb = cfg->timebase;
+  uint32_t f = cfg->filter & 0xFU;
+  int itr = 0;
+
+  if ((tim != TIM1) && (tim != TIM2) && (tim != TIM3) && (tim != TIM4))
+  {
+    return -1;
+  }
+  if (tb != NULL)
+  {
+    itr = encoder_itr(tb, tim);
+    if ((itr < 0) || (cfg->timebase_hz == 0U))
+    {
+      return -1;
+    }
+  }
+  else if (cfg->sample_hz == 0U)
+  {
+    return -1;
+  }
+
+  /* No interrupts: the owner callbacks stay NULL */
+  if (tim_claim(tim, NULL, NULL) != 0)
+  {
+    return -1;
+  }
+  if ((tb != NULL) && (tim_claim(tb, NULL, NULL) != 0))
+  {
+    tim_release(tim);
+    return -1;
+  }
+
+  memset(e, 0, sizeof(*e));
+  e->tim = tim;
+  e->timebase = tb;
+  e->timebase_hz = cfg->timebase_hz;
+  e->sample_hz = cfg->sample_hz;
+
+  /* Encoder mode 3, both inputs direct; CC1 also latches CNT on TI1 rising
+   * edges and pulses TRGO (MMS = compare pulse) for the timebase capture. */
+  tim->CR1 = 0;
+  tim->SMCR = TIM_SMCR_SMS_1 | TIM_SMCR_SMS_0;
+  tim->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0 |
+               (f << TIM_CCMR1_IC1F_Pos) | (f << TIM_CCMR1_IC2F_Pos);
+  tim->CCER = TIM_CCER_CC1E;
+  tim->CR2 = TIM_CR2_MMS_1 | TIM_CR2_MMS_0;
+  tim->ARR = 0xFFFFU;
+  tim->CNT = 0;
+  tim->CR1 = TIM_CR1_CEN;
+
+  if (tb != NULL)
+  {
+    tb->CR1 = 0;
+    tb->PSC = cfg->timebase_psc;
+    tb->ARR = 0xFFFFU;
+    tb->SMCR = (uint32_t)itr << TIM_SMCR_TS_Pos;
+    tb->CCMR1 = TIM_CCMR1_CC1S;   /* IC1 mapped on TRC */
+    tb->CCER = TIM_CCER_CC1E;
+    tb->EGR = TIM_EGR_UG;
+    tb->SR = 0;
+    tb->CR1 = TIM_CR1_CEN;
+    e->last_tb = (uint16_t)tb->CNT;
+  }
+  return 0;
+}
+
+/**
+ * @brief  Stop the counters and release the timers encoder_init() claimed.
+ */
+void encoder_stop(encoder_t *e)
+{
+  e->tim->CR1 = 0;
+  tim_release(e->tim);
+  if (e->timebase != NULL)
+  {
+    e->timebase->CR1 = 0;
+    tim_release(e->timebase);
+  }
+}
+
+int32_t encoder_sample(encoder_t *e)
+{
+  int64_t pos = encoder_update(e);
+  TIM_TypeDef *tb = e->timebase;
+  uint16_t now16;
+
+  if (tb == NULL)
+  {
+    e->velocity = encoder_rate_q8((int32_t)(pos - e->sample_pos),
+                                  e->sample_hz, 1U);
+    e->sample_pos = pos;
+    return e->velocity;
+  }
+
+  now16 = (uint16_t)tb->CNT;
+  e->now += (uint16_t)(now16 - e->last_tb);
+  e->last_tb = now16;
+
+  if (tb->SR & TIM_SR_CC1IF)
+  {
+    uint16_t t16;
+    uint16_t p16;
+    uint32_t t;
+    int64_t p;
+
+    /* Reading CCR1 clears CC1IF; retry if another edge latched meanwhile so
+     * the time and position belong to the same edge. */
+    do
+    {
+      t16 = (uint16_t)tb->CCR1;
+      p16 = (uint16_t)e->tim->CCR1;
+    } while (tb->SR & TIM_SR_CC1IF);
+
+    t = e->now - (uint16_t)(now16 - t16);
+    p = pos - (int16_t)(uint16_t)(e->last_cnt - p16);
+    if (e->edge_valid)
+    {
+      e->edge_dt = t - e->edge_time;
+      e->velocity = encoder_rate_q8((int32_t)(p - e->edge_pos),
+                                    e->timebase_hz, e->edge_dt);
+    }
+    e->edge_time = t;
+    e->edge_pos = p;
+    e->edge_valid = 1;
+  }
+  else if (e->velocity != 0)
+  {
+    /* No edge yet: the shaft is at most one edge per time-since-last-edge */
+    uint32_t since = e->now - e->edge_time;
+
+    if (since > e->edge_dt)
+    {
+      int32_t bound = encoder_rate_q8(ENC_COUNTS_PER_EDGE, e->timebase_hz,
+                                      since);
+
+      if (e->velocity > bound)
+      {
+        e->velocity = bound;
+      }
+      else if (e->velocity < -bound)
+      {
+        e->velocity = -bound;
+      }
+    }
+  }
+  return e->velocity;
+}
@@ -0,0 +1,154 @@
+/**
+ ******************************************************************************
+ * @file           : event.c
+ * @brief          : Cooperative run-to-completion event loop with priorities
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "atomic.h"
+#include "event.h"
+#include "ring.h"
+
+#if defined(__arm__)
+#include "stm32f1xx.h"
+#endif
+
+/* The Debug build would otherwise put -O0 on the dispatch path */
+#pragma GCC optimize ("O2")
+
+#if defined(__arm__)
+#define EVENT_CLZ(x)        __CLZ(x)
+#define EVENT_IRQ_DISABLE() __disable_irq()
+#define EVENT_IRQ_ENABLE()  __enable_irq()
+#else
+#define EVENT_CLZ(x)        ((uint32_t)__builtin_clz(x))
+#define EVENT_IRQ_DISABLE() ((void)0)
+#define EVENT_IRQ_ENABLE()  ((void)0)
+#endif
+
+typedef struct
+{
+  event_handler_t fn;
+  uint32_t arg;
+} event_t;
+
+typedef struct
+{
+  ring_mpsc_t ring;
+  volatile uint32_t seq[EVENT_QUEUE_LEN];
+  event_t events[EVENT_QUEUE_LEN];
+} event_queue_t;
+
+/* Variables */
+static event_queue_t event_queues[EVENT_PRIOS];
+static volatile uint32_t event_ready;
+
+/* Functions */
+/**
+ * @brief  Clear a level's ready bit once its queue looks empty. A post
+ *         that publishes after the check sets the bit again itself; one
+ *         that published between the check and the clear is caught by the
+ *         second look.
+ */
+static void event_settle(const event_queue_t *q, uint32_t bit)
+{
+  atomic_and(&event_ready, ~bit);
+  if (ring_mpsc_ready(&q->ring) != 0U)
+  {
+    atomic_or(&event_ready, bit);
+  }
+}
+
+void event_init(void)
+{
+  for (uint32_t i = 0; i < EVENT_PRIOS; i++)
+  {
+    (void)ring_mpsc_init(&event_queues[i].ring, event_queues[i].seq,
+                         EVENT_QUEUE_LEN);
+  }
+  event_ready = 0U;
+}
+
+int event_post(uint32_t prio, event_handler_t fn, uint32_t arg)
+{
+  event_queue_t *q;
+  event_t *e;
+  uint32_t pos;
+
+  if ((prio >= EVENT_PRIOS) || (fn == 0))
+  {
+    return -1;
+  }
+
+  q = &event_queues[prio];
+  if (ring_mpsc_claim(&q->ring, 1U, &pos) == 0U)
+  {
+    return -1;
+  }
+  e = &q->events[pos & (EVENT_QUEUE_LEN - 1U)];
+  e->fn = fn;
+  e->arg = arg;
+  ring_mpsc_publish(&q->ring, pos, 1U);
+  atomic_or(&event_ready, 1UL << prio);
+  return 0;
+}
+
+int event_dispatch(void)
+{
+  uint32_t ready = event_ready;
+
+  while (ready != 0U)
+  {
+    uint32_t prio = 31U - EVENT_CLZ(ready);
+    uint32_t bit = 1UL << prio;
+    event_queue_t *q = &event_queues[prio];
+
+    if (ring_mpsc_ready(&q->ring) != 0U)
+    {
+      event_t e;
+
+      atomic_fence();
+      e = q->events[q->ring.tail & (EVENT_QUEUE_LEN - 1U)];
+      ring_mpsc_release(&q->ring, 1U);
+      if (ring_mpsc_ready(&q->ring) == 0U)
+      {
+        event_settle(q, bit);
+      }
+      e.fn(e.arg);
+      return 0;
+    }
+
+    /* Empty, or the head slot is claimed by a post that an interrupt
+     * preempted: that post sets the bit again when it completes */
+    event_settle(q, bit);
+    ready &= ~bit;
+  }
+  return -1;
+}
+
+void event_idle(void) __attribute__((weak));
+void event_idle(void)
+{
+#if defined(__arm__)
+  __WFI();
+#endif
+}
+
+void event_run(void)
+{
+  for (;;)
+  {
+    if (event_dispatch() != 0)
+    {
+      /* Masked, a post from an ISR between the check and WFI cannot be
+       * missed: its interrupt stays pending and ends the sleep */
+      EVENT_IRQ_DISABLE();
+      if (event_ready == 0U)
+      {
+        event_idle();
+      }
+      EVENT_IRQ_ENABLE();
+    }
+  }
+}
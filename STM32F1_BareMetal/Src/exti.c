@@ -0,0 +1,206 @@
+/**
+ ******************************************************************************
+ * @file           : exti.c
+ * @brief          : EXTI line configuration and per-line interrupt dispatch
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "bitband.h"
+#include "dwt.h"
+#include "exti.h"
+
+#define EXTI_GROUP_9_5      0x03E0UL
+#define EXTI_GROUP_15_10    0xFC00UL
+
+#ifdef EXTI_LATENCY_PROBE
+static volatile uint32_t exti_probe_stamp;
+#define EXTI_PROBE_STAMP()  (exti_probe_stamp = DWT->CYCCNT)
+#else
+#define EXTI_PROBE_STAMP()  ((void)0)
+#endif
+
+/* Functions */
+static void exti_default_handler(void)
+{
+}
+
+void exti_line0_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line1_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line2_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line3_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line4_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line5_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line6_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line7_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line8_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line9_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line10_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line11_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line12_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line13_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line14_handler(void) __attribute__((weak, alias("exti_default_handler")));
+void exti_line15_handler(void) __attribute__((weak, alias("exti_default_handler")));
+
+/* Variables */
+static const exti_handler_t exti_handlers[EXTI_LINES] = {
+  exti_line0_handler,  exti_line1_handler,  exti_line2_handler,
+  exti_line3_handler,  exti_line4_handler,  exti_line5_handler,
+  exti_line6_handler,  exti_line7_handler,  exti_line8_handler,
+  exti_line9_handler,  exti_line10_handler, exti_line11_handler,
+  exti_line12_handler, exti_line13_handler, exti_line14_handler,
+  exti_line15_handler,
+};
+
+static IRQn_Type exti_irq(uint32_t line)
+{
+  if (line < 5U)
+  {
+    return (IRQn_Type)(EXTI0_IRQn + line);
+  }
+  return (line < 10U) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+}
+
+static uint32_t exti_group(uint32_t line)
+{
+  if (line < 5U)
+  {
+    return 1UL << line;
+  }
+  return (line < 10U) ? EXTI_GROUP_9_5 : EXTI_GROUP_15_10;
+}
+
+int exti_config(gpio_pins_t pin, uint32_t flags)
+{
+  uint32_t port;
+  uint32_t m = 0;
+  uint32_t line;
+  crit_t crit;
+  __IO uint32_t *cr;
+
+  for (port = 0; port < 4U; port++)
+  {
+    m = gpio_port_mask(pin, port);
+    if (m != 0U)
+    {
+      break;
+    }
+  }
+  if ((m == 0U) || (m & (m - 1U)) || (pin != ((gpio_pins_t)m << (16U * port))))
+  {
+    return -1;
+  }
+  line = 31U - __CLZ(m);
+
+  exti_disable(line);
+
+  BB_PERIPH(RCC->APB2ENR, RCC_APB2ENR_AFIOEN_Pos) = 1U;
+  (void)RCC->APB2ENR;
+  cr = &AFIO->EXTICR[line >> 2];
+  crit = crit_enter(EXTI_IRQ_PRIO);
+  *cr = (*cr & ~(0xFUL << (4U * (line & 3U)))) | (port << (4U * (line & 3U)));
+  crit_exit(crit);
+
+  BB_PERIPH(EXTI->RTSR, line) = (flags & EXTI_RISING) ? 1U : 0U;
+  BB_PERIPH(EXTI->FTSR, line) = (flags & EXTI_FALLING) ? 1U : 0U;
+  EXTI->PR = 1UL << line;
+  BB_PERIPH(EXTI->EMR, line) = (flags & EXTI_EVENT) ? 1U : 0U;
+  if (flags & EXTI_INTERRUPT)
+  {
+    BB_PERIPH(EXTI->IMR, line) = 1U;
+    NVIC_SetPriority(exti_irq(line), EXTI_IRQ_PRIO);
+    NVIC_ClearPendingIRQ(exti_irq(line));
+    NVIC_EnableIRQ(exti_irq(line));
+  }
+  return 0;
+}
+
+void exti_disable(uint32_t line)
+{
+  if (line >= EXTI_LINES)
+  {
+    return;
+  }
+  BB_PERIPH(EXTI->IMR, line) = 0U;
+  BB_PERIPH(EXTI->EMR, line) = 0U;
+  if ((EXTI->IMR & exti_group(line)) == 0U)
+  {
+    NVIC_DisableIRQ(exti_irq(line));
+  }
+}
+
+/* Serve the pending, enabled lines of a shared vector, highest first */
+static void exti_dispatch(uint32_t group)
+{
+  uint32_t pr = EXTI->PR & EXTI->IMR & group;
+
+  while (pr != 0U)
+  {
+    uint32_t line = 31U - __CLZ(pr);
+
+    pr &= ~(1UL << line);
+    EXTI->PR = 1UL << line;
+    EXTI_PROBE_STAMP();
+    exti_handlers[line]();
+  }
+}
+
+void EXTI0_IRQHandler(void)
+{
+  EXTI->PR = EXTI_PR_PR0;
+  EXTI_PROBE_STAMP();
+  exti_line0_handler();
+}
+
+void EXTI1_IRQHandler(void)
+{
+  EXTI->PR = EXTI_PR_PR1;
+  EXTI_PROBE_STAMP();
+  exti_line1_handler();
+}
+
+void EXTI2_IRQHandler(void)
+{
+  EXTI->PR = EXTI_PR_PR2;
+  EXTI_PROBE_STAMP();
+  exti_line2_handler();
+}
+
+void EXTI3_IRQHandler(void)
+{
+  EXTI->PR = EXTI_PR_PR3;
+  EXTI_PROBE_STAMP();
+  exti_line3_handler();
+}
+
+void EXTI4_IRQHandler(void)
+{
+  EXTI->PR = EXTI_PR_PR4;
+  EXTI_PROBE_STAMP();
+  exti_line4_handler();
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+  exti_dispatch(EXTI_GROUP_9_5);
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+  exti_dispatch(EXTI_GROUP_15_10);
+}
+
+#ifdef EXTI_LATENCY_PROBE
+uint32_t exti_measure(uint32_t lines)
+{
+  uint32_t t0;
+
+  dwt_init();
+  t0 = dwt_cycles();
+  exti_probe_stamp = t0;
+  EXTI->SWIER = lines;
+  __DSB();
+  __ISB();
+  return exti_probe_stamp - t0;
+}
+#endif
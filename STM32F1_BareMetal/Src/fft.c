@@ -0,0 +1,317 @@
+/**
+ ******************************************************************************
+ * @file           : fft.c
+ * @brief          : Q15 radix-4 complex FFT and real FFT with block floating
+ *                   point scaling
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "fft.h"
+
+/* The Debug build would otherwise run the butterflies at -O0 */
+#pragma GCC optimize ("O2")
+
+#define FFT_PI              3.14159265358979323846
+#define FFT_INLINE          static inline __attribute__((always_inline))
+
+/* W^k = cos - i sin of 2 pi k / FFT_MAX_N, stored as {cos, sin} */
+#define FFT_TW1(k)          { Q15(__builtin_cos(2.0 * FFT_PI * (k) / FFT_MAX_N)), \
+                              Q15(__builtin_sin(2.0 * FFT_PI * (k) / FFT_MAX_N)) },
+#define FFT_TW2(k)          FFT_TW1(k) FFT_TW1((k) + 1)
+#define FFT_TW4(k)          FFT_TW2(k) FFT_TW2((k) + 2)
+#define FFT_TW8(k)          FFT_TW4(k) FFT_TW4((k) + 4)
+#define FFT_TW16(k)         FFT_TW8(k) FFT_TW8((k) + 8)
+#define FFT_TW32(k)         FFT_TW16(k) FFT_TW16((k) + 16)
+#define FFT_TW64(k)         FFT_TW32(k) FFT_TW32((k) + 32)
+#define FFT_TW128(k)        FFT_TW64(k) FFT_TW64((k) + 64)
+#define FFT_TW256(k)        FFT_TW128(k) FFT_TW128((k) + 128)
+
+#if FFT_MAX_N == 1024U
+#define FFT_TW_QUARTER(k)   FFT_TW256(k)
+#elif FFT_MAX_N == 512U
+#define FFT_TW_QUARTER(k)   FFT_TW128(k)
+#elif FFT_MAX_N == 256U
+#define FFT_TW_QUARTER(k)   FFT_TW64(k)
+#elif FFT_MAX_N == 128U
+#define FFT_TW_QUARTER(k)   FFT_TW32(k)
+#else
+#define FFT_TW_QUARTER(k)   FFT_TW16(k)
+#endif
+
+#if defined(__arm__)
+#define FFT_RBIT(x)         __RBIT(x)
+#else
+static inline uint32_t FFT_RBIT(uint32_t x)
+{
+  uint32_t r = 0U;
+
+  for (uint32_t i = 0; i < 32U; i++)
+  {
+    r = (r << 1) | ((x >> i) & 1U);
+  }
+  return r;
+}
+#endif
+
+/* Variables */
+/* Radix-4 stages reach W^(3k) for k < n/4: three quarters of a turn */
+static const cq15_t fft_tw[3U * FFT_MAX_N / 4U] =
+{
+  FFT_TW_QUARTER(0)
+  FFT_TW_QUARTER(FFT_MAX_N / 4U)
+  FFT_TW_QUARTER(FFT_MAX_N / 2U)
+};
+
+/* Functions */
+/**
+ * @brief  Bit length of the largest component magnitude.
+ */
+static uint32_t fft_bits(const cq15_t *x, uint32_t n)
+{
+  uint32_t acc = 0U;
+
+  /* One's complement magnitude: -2^k reads as 2^k - 1, still k bits */
+  for (uint32_t i = 0; i < n; i++)
+  {
+    int32_t re = x[i].re;
+    int32_t im = x[i].im;
+
+    acc |= (uint32_t)(re ^ (re >> 31)) | (uint32_t)(im ^ (im >> 31));
+  }
+  return 32U - FIX_CLZ(acc);
+}
+
+/**
+ * @brief  Shift that keeps a stage with the given gain in range.
+ * @param  limit Bit length the inputs may have before the stage: 12 for
+ *               radix-4 (gain up to 4 sqrt(2)), 13 for radix-2 and the real
+ *               split (2 sqrt(2))
+ */
+static uint32_t fft_scale(const cq15_t *x, uint32_t n, uint32_t limit)
+{
+  uint32_t bits = fft_bits(x, n);
+
+  return (bits > limit) ? (bits - limit) : 0U;
+}
+
+/* (re + i im) * (c - i s), rounded */
+FFT_INLINE void fft_cmul(cq15_t *out, int32_t re, int32_t im, cq15_t w)
+{
+  out->re = (q15_t)((re * w.re + im * w.im + 0x4000) >> 15);
+  out->im = (q15_t)((im * w.re - re * w.im + 0x4000) >> 15);
+}
+
+static void fft_radix2(cq15_t *x, uint32_t n, uint32_t s)
+{
+  uint32_t half = n >> 1;
+  uint32_t stride = FFT_MAX_N / n;
+  int32_t rnd = (int32_t)((1UL << s) >> 1);
+
+  for (uint32_t j = 0; j < half; j++)
+  {
+    cq15_t *p = &x[j];
+    cq15_t *q = &x[j + half];
+    int32_t dr = (p->re - q->re + rnd) >> s;
+    int32_t di = (p->im - q->im + rnd) >> s;
+
+    p->re = (q15_t)((p->re + q->re + rnd) >> s);
+    p->im = (q15_t)((p->im + q->im + rnd) >> s);
+    if (j == 0U)
+    {
+      q->re = (q15_t)dr;
+      q->im = (q15_t)di;
+    }
+    else
+    {
+      fft_cmul(q, dr, di, fft_tw[j * stride]);
+    }
+  }
+}
+
+/**
+ * @brief  One radix-4 DIF butterfly on x[g], x[g+l], x[g+2l], x[g+3l].
+ *         The W^2 and W^1 outputs trade places, which makes the stage
+ *         equal to two radix-2 stages and the final order plain
+ *         bit-reversed.
+ */
+FFT_INLINE void fft_bfly4(cq15_t *x, uint32_t g, uint32_t l, uint32_t s,
+                          int32_t rnd, const cq15_t *w)
+{
+  cq15_t *a = &x[g];
+  cq15_t *b = &x[g + l];
+  cq15_t *c = &x[g + 2U * l];
+  cq15_t *d = &x[g + 3U * l];
+  int32_t t0r = a->re + c->re, t0i = a->im + c->im;
+  int32_t t1r = a->re - c->re, t1i = a->im - c->im;
+  int32_t t2r = b->re + d->re, t2i = b->im + d->im;
+  int32_t t3r = b->re - d->re, t3i = b->im - d->im;
+  int32_t y2r = (t0r - t2r + rnd) >> s, y2i = (t0i - t2i + rnd) >> s;
+  int32_t y1r = (t1r + t3i + rnd) >> s, y1i = (t1i - t3r + rnd) >> s;
+  int32_t y3r = (t1r - t3i + rnd) >> s, y3i = (t1i + t3r + rnd) >> s;
+
+  a->re = (q15_t)((t0r + t2r + rnd) >> s);
+  a->im = (q15_t)((t0i + t2i + rnd) >> s);
+  if (w == 0)
+  {
+    b->re = (q15_t)y2r;
+    b->im = (q15_t)y2i;
+    c->re = (q15_t)y1r;
+    c->im = (q15_t)y1i;
+    d->re = (q15_t)y3r;
+    d->im = (q15_t)y3i;
+  }
+  else
+  {
+    fft_cmul(b, y2r, y2i, w[1]);
+    fft_cmul(c, y1r, y1i, w[0]);
+    fft_cmul(d, y3r, y3i, w[2]);
+  }
+}
+
+/**
+ * @brief  Radix-4 stage over sub-transforms of m points.
+ */
+static void fft_radix4(cq15_t *x, uint32_t n, uint32_t m, uint32_t s)
+{
+  uint32_t l = m >> 2;
+  uint32_t stride = FFT_MAX_N / m;
+  int32_t rnd = (int32_t)((1UL << s) >> 1);
+
+  /* j = 0 has unit twiddles: no multiplies, and the whole last stage */
+  for (uint32_t g = 0; g < n; g += m)
+  {
+    fft_bfly4(x, g, l, s, rnd, 0);
+  }
+  for (uint32_t j = 1; j < l; j++)
+  {
+    cq15_t w[3];
+
+    w[0] = fft_tw[j * stride];
+    w[1] = fft_tw[2U * j * stride];
+    w[2] = fft_tw[3U * j * stride];
+    for (uint32_t g = j; g < n; g += m)
+    {
+      fft_bfly4(x, g, l, s, rnd, w);
+    }
+  }
+}
+
+static void fft_bitrev(cq15_t *x, uint32_t n, uint32_t log2n)
+{
+  for (uint32_t i = 1; i < n - 1U; i++)
+  {
+    uint32_t j = FFT_RBIT(i) >> (32U - log2n);
+
+    if (i < j)
+    {
+      cq15_t t = x[i];
+
+      x[i] = x[j];
+      x[j] = t;
+    }
+  }
+}
+
+int fft_q15(cq15_t *x, uint32_t n, int32_t *exp)
+{
+  uint32_t log2n = 31U - FIX_CLZ(n);
+  uint32_t limit = (log2n & 1U) ? 13U : 12U;
+  uint32_t m = n;
+  uint32_t bits;
+  uint32_t s;
+  int32_t e = 0;
+
+  if ((n < FFT_MIN_N) || (n > FFT_MAX_N) || ((n & (n - 1U)) != 0U))
+  {
+    return -1;
+  }
+
+  /* Quiet input: shift up to the first stage's limit so its rounding does
+   * not swamp the signal. A block of {-1, 0} reads as 0 bits, so only an
+   * all-zero block, which shifting leaves alone, keeps its exponent */
+  bits = fft_bits(x, n);
+  if (bits < limit)
+  {
+    uint32_t nonzero = 0U;
+
+    s = limit - bits;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      nonzero |= (uint16_t)x[i].re | (uint16_t)x[i].im;
+      x[i].re = (q15_t)((uint32_t)(int32_t)x[i].re << s);
+      x[i].im = (q15_t)((uint32_t)(int32_t)x[i].im << s);
+    }
+    if (nonzero != 0U)
+    {
+      e -= (int32_t)s;
+    }
+  }
+
+  if (log2n & 1U)
+  {
+    s = fft_scale(x, n, 13U);
+    fft_radix2(x, n, s);
+    e += (int32_t)s;
+    m >>= 1;
+  }
+  for (; m >= 4U; m >>= 2)
+  {
+    s = fft_scale(x, n, 12U);
+    fft_radix4(x, n, m, s);
+    e += (int32_t)s;
+  }
+  fft_bitrev(x, n, log2n);
+  *exp = e;
+  return 0;
+}
+
+int rfft_q15(q15_t *x, uint32_t n, int32_t *exp)
+{
+  cq15_t *z = (cq15_t *)x;
+  uint32_t m = n >> 1;
+  uint32_t stride;
+  int32_t e;
+  uint32_t s;
+  int32_t rnd;
+
+  if ((n < 2U * FFT_MIN_N) || (n > FFT_MAX_N) ||
+      (fft_q15(z, m, &e) != 0))
+  {
+    return -1;
+  }
+  stride = FFT_MAX_N / n;
+
+  /* Z = FFT(x[2i] + j x[2i+1]); with a = Z[k], b = conj(Z[m-k]),
+   * e = a + b, p = W^k (a - b):
+   *   X[k]   = (e - j p) / 2
+   *   X[m-k] = conj(e + j p) / 2 */
+  s = fft_scale(z, m, 13U);
+  rnd = (int32_t)((1UL << s) >> 1);
+  {
+    int32_t re = (z[0].re + rnd) >> s;
+    int32_t im = (z[0].im + rnd) >> s;
+
+    z[0].re = (q15_t)(re + im);
+    z[0].im = (q15_t)(re - im);
+  }
+  for (uint32_t k = 1; k <= m / 2U; k++)
+  {
+    cq15_t *zk = &z[k];
+    cq15_t *zm = &z[m - k];
+    cq15_t w = fft_tw[k * stride];
+    int32_t ar = (zk->re + rnd) >> s, ai = (zk->im + rnd) >> s;
+    int32_t br = (zm->re + rnd) >> s, bi = -((zm->im + rnd) >> s);
+    int32_t er = ar + br, ei = ai + bi;
+    int32_t dr = ar - br, di = ai - bi;
+    int32_t pr = (dr * w.re + di * w.im + 0x4000) >> 15;
+    int32_t pi = (di * w.re - dr * w.im + 0x4000) >> 15;
+
+    zk->re = (q15_t)((er + pi + 1) >> 1);
+    zk->im = (q15_t)((ei - pr + 1) >> 1);
+    zm->re = (q15_t)((er - pi + 1) >> 1);
+    zm->im = (q15_t)((-ei - pr + 1) >> 1);
+  }
+  *exp = e + (int32_t)s;
+  return 0;
+}
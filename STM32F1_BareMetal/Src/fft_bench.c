@@ -0,0 +1,34 @@
+/**
+ ******************************************************************************
+ * @file           : fft_bench.c
+ * @brief          : Cycle count of the Q15 real FFT
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "dwt.h"
+#include "fft.h"
+
+/* Functions */
+uint32_t fft_bench(q15_t *buf, uint32_t n)
+{
+  uint32_t overhead;
+  uint32_t t;
+  int32_t exp;
+
+  /* Two tones at half scale, so every stage has something to scale */
+  for (uint32_t i = 0; i < n; i++)
+  {
+    buf[i] = (q15_t)((q15_sin((q15_t)(i * 0x0500U)) >> 2) +
+                     (q15_sin((q15_t)(i * 0x1A00U)) >> 2));
+  }
+
+  dwt_init();
+  t = dwt_cycles();
+  overhead = dwt_cycles() - t;
+
+  t = dwt_cycles();
+  (void)rfft_q15(buf, n, &exp);
+  t = dwt_cycles() - t;
+  return (t > overhead) ? (t - overhead) : 0U;
+}
@@ -0,0 +1,335 @@
+/**
+ ******************************************************************************
+ * @file           : filter.c
+ * @brief          : Q15/Q31 FIR, decimating FIR and cascaded biquad filters
+ ******************************************************************************
+ */
+
+/* The Debug build would otherwise run the inner loops at -O0. Ahead of
+ * the includes, so the fixmath.h helpers are optimised, and inlined, too */
+#pragma GCC optimize ("O2")
+
+/* Includes */
+#include "filter.h"
+
+/* Helpers are forced inline so nothing in a RAM function calls into flash */
+#define FILTER_INLINE       static inline __attribute__((always_inline))
+
+/* Functions */
+FILTER_INLINE q15_t filter_q15_out(int64_t acc)
+{
+  return q15_sat(q31_sat((acc + 0x4000) >> 15));
+}
+
+FILTER_INLINE int64_t fir_dot_q15(const q15_t *b, const q15_t *x,
+                                  uint32_t taps)
+{
+  int64_t acc = 0;
+  uint32_t k = taps;
+
+#if FILTER_UNROLL == 4
+  for (; k >= 4U; k -= 4U)
+  {
+    acc += (int32_t)b[0] * x[0];
+    acc += (int32_t)b[1] * x[-1];
+    acc += (int32_t)b[2] * x[-2];
+    acc += (int32_t)b[3] * x[-3];
+    b += 4;
+    x -= 4;
+  }
+#elif FILTER_UNROLL == 2
+  for (; k >= 2U; k -= 2U)
+  {
+    acc += (int32_t)b[0] * x[0];
+    acc += (int32_t)b[1] * x[-1];
+    b += 2;
+    x -= 2;
+  }
+#endif
+  for (; k != 0U; k--)
+  {
+    acc += (int32_t)*b++ * *x--;
+  }
+  return acc;
+}
+
+FILTER_INLINE int64_t fir_dot_q31(const q31_t *b, const q31_t *x,
+                                  uint32_t taps)
+{
+  int64_t acc = 0;
+  uint32_t k = taps;
+
+#if FILTER_UNROLL == 4
+  for (; k >= 4U; k -= 4U)
+  {
+    acc += (int64_t)b[0] * x[0];
+    acc += (int64_t)b[1] * x[-1];
+    acc += (int64_t)b[2] * x[-2];
+    acc += (int64_t)b[3] * x[-3];
+    b += 4;
+    x -= 4;
+  }
+#elif FILTER_UNROLL == 2
+  for (; k >= 2U; k -= 2U)
+  {
+    acc += (int64_t)b[0] * x[0];
+    acc += (int64_t)b[1] * x[-1];
+    b += 2;
+    x -= 2;
+  }
+#endif
+  for (; k != 0U; k--)
+  {
+    acc += (int64_t)*b++ * *x--;
+  }
+  return acc;
+}
+
+int fir_q15_init(fir_q15_t *f, const q15_t *coeffs, uint16_t taps,
+                 uint16_t decim, q15_t *state, uint16_t block)
+{
+  if ((coeffs == 0) || (state == 0) || (taps == 0U) || (decim == 0U) ||
+      (block == 0U))
+  {
+    return -1;
+  }
+
+  f->coeffs = coeffs;
+  f->state = state;
+  f->taps = taps;
+  f->block = block;
+  f->decim = decim;
+  f->phase = 0U;
+  for (uint32_t i = 0; i < taps - 1U; i++)
+  {
+    state[i] = 0;
+  }
+  return 0;
+}
+
+int fir_q31_init(fir_q31_t *f, const q31_t *coeffs, uint16_t taps,
+                 uint16_t decim, q31_t *state, uint16_t block)
+{
+  if ((coeffs == 0) || (state == 0) || (taps == 0U) || (decim == 0U) ||
+      (block == 0U))
+  {
+    return -1;
+  }
+
+  f->coeffs = coeffs;
+  f->state = state;
+  f->taps = taps;
+  f->block = block;
+  f->decim = decim;
+  f->phase = 0U;
+  for (uint32_t i = 0; i < taps - 1U; i++)
+  {
+    state[i] = 0;
+  }
+  return 0;
+}
+
+FILTER_RAMFUNC uint32_t fir_q15(fir_q15_t *f, const q15_t *in, q15_t *out,
+                                uint32_t n)
+{
+  q15_t *state = f->state;
+  uint32_t hist = f->taps - 1U;
+  uint32_t decim = f->decim;
+  uint32_t phase = f->phase;
+  uint32_t produced = 0U;
+
+  while (n != 0U)
+  {
+    uint32_t chunk = (n < f->block) ? n : f->block;
+    q15_t *win = state + hist;
+
+    /* The whole chunk is copied before any output is written, so out may
+     * alias in: outputs never run ahead of the inputs consumed */
+    for (uint32_t i = 0; i < chunk; i++)
+    {
+      win[i] = in[i];
+    }
+    /* Phase counts inputs since the last output */
+    for (uint32_t i = decim - 1U - phase; i < chunk; i += decim)
+    {
+      out[produced++] = filter_q15_out(fir_dot_q15(f->coeffs, &win[i],
+                                                   f->taps));
+    }
+    phase = (phase + chunk) % decim;
+
+    for (uint32_t i = 0; i < hist; i++)
+    {
+      state[i] = state[i + chunk];
+    }
+    in += chunk;
+    n -= chunk;
+  }
+
+  f->phase = (uint16_t)phase;
+  return produced;
+}
+
+FILTER_RAMFUNC uint32_t fir_q31(fir_q31_t *f, const q31_t *in, q31_t *out,
+                                uint32_t n)
+{
+  q31_t *state = f->state;
+  uint32_t hist = f->taps - 1U;
+  uint32_t decim = f->decim;
+  uint32_t phase = f->phase;
+  uint32_t produced = 0U;
+
+  while (n != 0U)
+  {
+    uint32_t chunk = (n < f->block) ? n : f->block;
+    q31_t *win = state + hist;
+
+    for (uint32_t i = 0; i < chunk; i++)
+    {
+      win[i] = in[i];
+    }
+    for (uint32_t i = decim - 1U - phase; i < chunk; i += decim)
+    {
+      out[produced++] = q31_from_acc(fir_dot_q31(f->coeffs, &win[i],
+                                                 f->taps));
+    }
+    phase = (phase + chunk) % decim;
+
+    for (uint32_t i = 0; i < hist; i++)
+    {
+      state[i] = state[i + chunk];
+    }
+    in += chunk;
+    n -= chunk;
+  }
+
+  f->phase = (uint16_t)phase;
+  return produced;
+}
+
+int biquad_q15_init(biquad_q15_t *f, const q15_t *coeffs, uint8_t stages,
+                    uint8_t shift, q15_t *state)
+{
+  if ((coeffs == 0) || (state == 0) || (stages == 0U) || (shift > 14U))
+  {
+    return -1;
+  }
+
+  f->coeffs = coeffs;
+  f->state = state;
+  f->stages = stages;
+  f->shift = shift;
+  for (uint32_t i = 0; i < 4U * stages; i++)
+  {
+    state[i] = 0;
+  }
+  return 0;
+}
+
+int biquad_q31_init(biquad_q31_t *f, const q31_t *coeffs, uint8_t stages,
+                    uint8_t shift, q31_t *state)
+{
+  if ((coeffs == 0) || (state == 0) || (stages == 0U) || (shift > 30U))
+  {
+    return -1;
+  }
+
+  f->coeffs = coeffs;
+  f->state = state;
+  f->stages = stages;
+  f->shift = shift;
+  for (uint32_t i = 0; i < 4U * stages; i++)
+  {
+    state[i] = 0;
+  }
+  return 0;
+}
+
+FILTER_RAMFUNC void biquad_q15(biquad_q15_t *f, const q15_t *in, q15_t *out,
+                               uint32_t n)
+{
+  const q15_t *c = f->coeffs;
+  q15_t *s = f->state;
+  uint32_t rshift = 15U - f->shift;
+  int64_t round = 1LL << (rshift - 1U);
+  const q15_t *src = in;
+
+  /* One stage over the whole block at a time: coefficients and state stay
+   * in registers, and later stages run in place on out */
+  for (uint32_t stage = 0; stage < f->stages; stage++)
+  {
+    int32_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+    q15_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+      q15_t x = src[i];
+      int64_t acc = round;
+      q15_t y;
+
+      acc += b0 * x;
+      acc += b1 * x1;
+      acc += b2 * x2;
+      acc += a1 * y1;
+      acc += a2 * y2;
+      y = q15_sat(q31_sat(acc >> rshift));
+
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+      out[i] = y;
+    }
+
+    s[0] = x1;
+    s[1] = x2;
+    s[2] = y1;
+    s[3] = y2;
+    c += 5;
+    s += 4;
+    src = out;
+  }
+}
+
+FILTER_RAMFUNC void biquad_q31(biquad_q31_t *f, const q31_t *in, q31_t *out,
+                               uint32_t n)
+{
+  const q31_t *c = f->coeffs;
+  q31_t *s = f->state;
+  uint32_t rshift = 31U - f->shift;
+  int64_t round = 1LL << (rshift - 1U);
+  const q31_t *src = in;
+
+  for (uint32_t stage = 0; stage < f->stages; stage++)
+  {
+    q31_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+    q31_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+      q31_t x = src[i];
+      int64_t acc = round;
+      q31_t y;
+
+      acc += (int64_t)b0 * x;
+      acc += (int64_t)b1 * x1;
+      acc += (int64_t)b2 * x2;
+      acc += (int64_t)a1 * y1;
+      acc += (int64_t)a2 * y2;
+      y = q31_sat(acc >> rshift);
+
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+      out[i] = y;
+    }
+
+    s[0] = x1;
+    s[1] = x2;
+    s[2] = y1;
+    s[3] = y2;
+    c += 5;
+    s += 4;
+    src = out;
+  }
+}
@@ -0,0 +1,472 @@
+/**
+ ******************************************************************************
+ * @file           : fixmath.c
+ * @brief          : Q31 reciprocal, division, sqrt, CORDIC and log2/exp2
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "fixmath.h"
+
+/* Plain C throughout; also built on the host for the accuracy checks */
+#pragma GCC optimize ("O2")
+
+#define FIX_CORDIC_ITER     30U
+#define FIX_CORDIC_K_Q30    652032874L    /* prod 1/sqrt(1 + 2^-2i), Q30 */
+#define FIX_CORDIC_K_Q31    1304065748UL
+#define FIX_LN2_Q32         0xB17217F8UL
+#define FIX_INV_LN2_Q30     0x5C551D95UL
+
+/* Variables */
+/* atan(2^-i) as a binary angle */
+static const int32_t fix_atan_tab[FIX_CORDIC_ITER] =
+{
+  0x20000000, 0x12E4051E, 0x09FB385B, 0x051111D4, 0x028B0D43, 0x0145D7E1,
+  0x00A2F61E, 0x00517C55, 0x0028BE53, 0x00145F2F, 0x000A2F98, 0x000517CC,
+  0x00028BE6, 0x000145F3, 0x0000A2FA, 0x0000517D, 0x000028BE, 0x0000145F,
+  0x00000A30, 0x00000518, 0x0000028C, 0x00000146, 0x000000A3, 0x00000051,
+  0x00000029, 0x00000014, 0x0000000A, 0x00000005, 0x00000003, 0x00000001,
+};
+
+/* 1/(2 sqrt(m)) at the centre of m = [i/16, (i+1)/16), i = 4..15, Q16 */
+static const uint16_t fix_rsqrt_tab[12] =
+{
+  61788, 55889, 51411, 47861, 44957, 42525,
+  40450, 38651, 37073, 35673, 34421, 33292,
+};
+
+/* log2(1 + i/64), Q31 */
+static const uint32_t fix_log2_tab[64] =
+{
+  0x00000000, 0x02DCF2D1, 0x05AEB4DD, 0x08759C50, 0x0B31FB7D, 0x0DE42120,
+  0x108C588D, 0x132AE9E2, 0x15C01A3A, 0x184C2BD0, 0x1ACF5E2E, 0x1D49EE4C,
+  0x1FBC16B9, 0x22260FB6, 0x24880F56, 0x26E2499D, 0x2934F098, 0x2B803474,
+  0x2DC4439B, 0x30014AC6, 0x32377512, 0x3466EC15, 0x368FD7EE, 0x38B25F5A,
+  0x3ACEA7C0, 0x3CE4D544, 0x3EF50AD2, 0x40FF6A2E, 0x43041403, 0x450327EB,
+  0x46FCC47A, 0x48F10751, 0x4AE00D1D, 0x4CC9F1AB, 0x4EAECFEB, 0x508EC1FA,
+  0x5269E12F, 0x5440461C, 0x5612089A, 0x57DF3FD0, 0x59A80239, 0x5B6C65AA,
+  0x5D2C7F59, 0x5EE863E5, 0x60A02757, 0x6253DD2C, 0x64039858, 0x65AF6B4B,
+  0x675767F5, 0x68FB9FCE, 0x6A9C23D6, 0x6C39049B, 0x6DD2523D, 0x6F681C73,
+  0x70FA728C, 0x72896373, 0x7414FDB5, 0x759D4F81, 0x772266AD, 0x78A450B8,
+  0x7A231ACE, 0x7B9ED1C7, 0x7D17822F, 0x7E8D3846,
+};
+
+/* 1/(1 + i/64), Q31 */
+static const uint32_t fix_log2_recip_tab[64] =
+{
+  0x7FFFFFFF, 0x7E07E07E, 0x7C1F07C2, 0x7A44C6B0, 0x78787878, 0x76B981DB,
+  0x75075075, 0x73615A24, 0x71C71C72, 0x70381C0E, 0x6EB3E453, 0x6D3A06D4,
+  0x6BCA1AF3, 0x6A63BD82, 0x69069069, 0x67B23A54, 0x66666666, 0x6522C3F3,
+  0x63E7063E, 0x62B2E43E, 0x61861862, 0x60606060, 0x5F417D06, 0x5E293206,
+  0x5D1745D1, 0x5C0B8170, 0x5B05B05B, 0x5A05A05A, 0x590B2164, 0x58160581,
+  0x572620AE, 0x563B48C2, 0x55555555, 0x54741FAC, 0x5397829D, 0x52BF5A81,
+  0x51EB851F, 0x511BE196, 0x50505050, 0x4F88B2F4, 0x4EC4EC4F, 0x4E04E04E,
+  0x4D4873ED, 0x4C8F8D29, 0x4BDA12F7, 0x4B27ED36, 0x4A7904A8, 0x49CD42E2,
+  0x49249249, 0x487EDE05, 0x47DC11F7, 0x473C1AB7, 0x469EE584, 0x46046046,
+  0x456C797E, 0x44D72045, 0x44444444, 0x43B3D5B0, 0x4325C53F, 0x429A042A,
+  0x42108421, 0x4189374C, 0x41041041, 0x40810204,
+};
+
+/* 2^(i/64), unsigned Q31 */
+static const uint32_t fix_exp2_tab[64] =
+{
+  0x80000000, 0x8164D1F4, 0x82CD8699, 0x843A28C4, 0x85AAC368, 0x871F6197,
+  0x88980E81, 0x8A14D575, 0x8B95C1E4, 0x8D1ADF5B, 0x8EA4398B, 0x9031DC43,
+  0x91C3D374, 0x935A2B2F, 0x94F4EFA9, 0x96942D37, 0x9837F052, 0x99E04593,
+  0x9B8D39BA, 0x9D3ED9A7, 0x9EF53261, 0xA0B05110, 0xA2704303, 0xA43515AE,
+  0xA5FED6AA, 0xA7CD93B5, 0xA9A15AB5, 0xAB7A39B6, 0xAD583EEA, 0xAF3B78AD,
+  0xB123F582, 0xB311C413, 0xB504F334, 0xB6FD91E3, 0xB8FBAF47, 0xBAFF5AB2,
+  0xBD08A39F, 0xBF1799B6, 0xC12C4CCA, 0xC346CCDA, 0xC5672A11, 0xC78D74C9,
+  0xC9B9BD86, 0xCBEC14FF, 0xCE248C15, 0xD06333DB, 0xD2A81D92, 0xD4F35AAC,
+  0xD744FCCB, 0xD99D15C2, 0xDBFBB798, 0xDE60F482, 0xE0CCDEEC, 0xE33F8973,
+  0xE5B906E7, 0xE8396A50, 0xEAC0C6E8, 0xED4F301F, 0xEFE4B99C, 0xF281773C,
+  0xF5257D15, 0xF7D0DF73, 0xFA83B2DB, 0xFD3E0C0D,
+};
+
+/* Functions */
+/**
+ * @brief  floor(2^62 / d) for d in [2^31, 2^32): 1/d in Q30 with d in Q32.
+ *         Linear estimate, three Newton steps, then an exact fix-up against
+ *         the remainder.
+ * @param  rem Receives 2^62 - result * d, less than d
+ */
+static uint32_t fix_recip_q30(uint32_t d, uint64_t *rem)
+{
+  uint32_t r = 3031741621UL - (uint32_t)(((uint64_t)2021161081UL * d) >> 32);
+  int64_t e;
+
+  /* r' = r (2 - d r), all in Q30 */
+  for (uint32_t i = 0; i < 3U; i++)
+  {
+    uint32_t t = 0x80000000UL - (uint32_t)(((uint64_t)d * r) >> 32);
+
+    r = (uint32_t)(((uint64_t)r * t) >> 30);
+  }
+
+  /* Truncation leaves r within a unit or two either side */
+  e = (int64_t)((1ULL << 62) - (uint64_t)r * d);
+  while (e < 0)
+  {
+    e += d;
+    r--;
+  }
+  while (e >= (int64_t)d)
+  {
+    e -= d;
+    r++;
+  }
+  *rem = (uint64_t)e;
+  return r;
+}
+
+q31_t q31_recip(q31_t x, int32_t *shift)
+{
+  uint32_t ax = (x < 0) ? -(uint32_t)x : (uint32_t)x;
+  uint32_t n;
+  uint32_t d;
+  uint32_t r;
+  uint64_t rem;
+
+  if (ax == 0U)
+  {
+    *shift = 32;
+    return Q31_MAX;
+  }
+
+  n = FIX_CLZ(ax);
+  d = ax << n;
+  r = fix_recip_q30(d, &rem);
+  if ((rem << 1) >= d)
+  {
+    r++;
+  }
+  if (r > (uint32_t)Q31_MAX)
+  {
+    /* Power of two: 1.0 is 0.5 * 2 */
+    r = 0x40000000UL;
+    n++;
+  }
+  *shift = (int32_t)n;
+  return (x < 0) ? -(q31_t)r : (q31_t)r;
+}
+
+q31_t q31_div(q31_t a, q31_t b)
+{
+  uint32_t ua = (a < 0) ? -(uint32_t)a : (uint32_t)a;
+  uint32_t ub = (b < 0) ? -(uint32_t)b : (uint32_t)b;
+  uint32_t neg = ((uint32_t)a ^ (uint32_t)b) >> 31;
+  uint32_t n;
+  uint32_t q;
+  uint64_t rem;
+
+  if (ua >= ub)
+  {
+    return neg ? Q31_MIN : Q31_MAX;
+  }
+
+  /* a/b = a * 2^n / (b << n); the product is then a unit or two low */
+  n = FIX_CLZ(ub);
+  q = (uint32_t)(((uint64_t)ua * fix_recip_q30(ub << n, &rem)) >> (31U - n));
+  rem = ((uint64_t)ua << 31) - (uint64_t)q * ub;
+  while (rem >= ub)
+  {
+    rem -= ub;
+    q++;
+  }
+  if ((rem << 1) >= ub)
+  {
+    q++;
+  }
+
+  if (neg)
+  {
+    return (q >= 0x80000000UL) ? Q31_MIN : -(q31_t)q;
+  }
+  return (q > (uint32_t)Q31_MAX) ? Q31_MAX : (q31_t)q;
+}
+
+q31_t q31_sqrt(q31_t x)
+{
+  uint32_t z;
+  uint32_t n;
+  uint32_t m;
+  uint32_t h;
+  uint32_t y;
+  uint64_t big;
+  uint64_t sq;
+
+  if (x <= 0)
+  {
+    return 0;
+  }
+
+  /* x << n with n odd lands in [2^30, 2^32): m in [0.25, 1) as Q32 */
+  z = FIX_CLZ((uint32_t)x);
+  n = (z & 1U) ? z : (z - 1U);
+  m = (uint32_t)x << n;
+
+  /* h = 1/(2 sqrt(m)) in Q32: h' = h (1.5 - 2 m h^2) */
+  h = (uint32_t)fix_rsqrt_tab[(m >> 28) - 4U] << 16;
+  for (uint32_t i = 0; i < 3U; i++)
+  {
+    uint32_t h2 = (uint32_t)(((uint64_t)h * h) >> 32);
+    uint32_t t = 0xC0000000UL - (uint32_t)(((uint64_t)m * h2) >> 32);
+    uint64_t hn = ((uint64_t)h * t) >> 31;
+
+    h = (hn > 0xFFFFFFFFULL) ? 0xFFFFFFFFUL : (uint32_t)hn;
+  }
+
+  /* sqrt(m) = 2 m h in Q32, then scale to sqrt(x * 2^31) */
+  big = ((uint64_t)m * h) >> 31;
+  if (big > 0xFFFFFFFFULL)
+  {
+    big = 0xFFFFFFFFULL;
+  }
+  y = (uint32_t)big >> ((n + 1U) >> 1);
+
+  /* Correct the last units and round to nearest */
+  big = (uint64_t)(uint32_t)x << 31;
+  sq = (uint64_t)y * y;
+  while (sq > big)
+  {
+    y--;
+    sq = (uint64_t)y * y;
+  }
+  while (sq + 2U * (uint64_t)y + 1U <= big)
+  {
+    y++;
+    sq = (uint64_t)y * y;
+  }
+  if (big - sq > y)
+  {
+    y++;
+  }
+  return (y > (uint32_t)Q31_MAX) ? Q31_MAX : (q31_t)y;
+}
+
+q15_t q15_sqrt(q15_t x)
+{
+  uint32_t big;
+  uint32_t y;
+
+  if (x <= 0)
+  {
+    return 0;
+  }
+
+  /* Rounding the Q31 root again can land on the wrong side of a half;
+   * check round(sqrt(x * 2^15)) directly: y^2 - y < X <= y^2 + y. */
+  big = (uint32_t)x << 15;
+  y = ((uint32_t)q31_sqrt(q31_from_q15(x)) + 0x8000UL) >> 16;
+  if (big > y * y + y)
+  {
+    y++;
+  }
+  else if (big <= y * y - y)
+  {
+    y--;
+  }
+  return (y > 0x7FFFU) ? Q15_MAX : (q15_t)y;
+}
+
+void q31_sincos(q31_t angle, q31_t *s, q31_t *c)
+{
+  uint32_t za = (uint32_t)angle;
+  int32_t x = FIX_CORDIC_K_Q30;
+  int32_t y = 0;
+  int32_t z;
+  uint32_t flip = 0U;
+
+  /* CORDIC converges within +-99 degrees: turn the back half-plane by pi
+   * and negate the result */
+  if ((za + 0x40000000UL) & 0x80000000UL)
+  {
+    za += 0x80000000UL;
+    flip = 1U;
+  }
+  z = (int32_t)za;
+
+  for (uint32_t i = 0; i < FIX_CORDIC_ITER; i++)
+  {
+    int32_t dx = y >> i;
+    int32_t dy = x >> i;
+
+    if (z >= 0)
+    {
+      x -= dx;
+      y += dy;
+      z -= fix_atan_tab[i];
+    }
+    else
+    {
+      x += dx;
+      y -= dy;
+      z += fix_atan_tab[i];
+    }
+  }
+
+  if (flip)
+  {
+    x = -x;
+    y = -y;
+  }
+  /* Q30 to Q31: cos(0) is one unit over the top */
+  if (s != 0)
+  {
+    *s = q31_sat((int64_t)y * 2);
+  }
+  if (c != 0)
+  {
+    *c = q31_sat((int64_t)x * 2);
+  }
+}
+
+/**
+ * @brief  CORDIC vectoring: rotate (x, y) onto the positive x axis.
+ * @param  mag Receives the rotated x, gain 1.647, scaled by 2^sh
+ * @param  sh  Receives the normalising shift applied to the inputs
+ * @retval Binary angle of the input vector
+ */
+static uint32_t fix_cordic_vector(q31_t y, q31_t x, uint32_t *mag,
+                                  int32_t *sh)
+{
+  uint32_t ax = (x < 0) ? -(uint32_t)x : (uint32_t)x;
+  uint32_t ay = (y < 0) ? -(uint32_t)y : (uint32_t)y;
+  int32_t shift = (int32_t)FIX_CLZ(ax | ay) - 3;
+  int32_t vx;
+  int32_t vy;
+  uint32_t z;
+
+  /* Largest component at bit 28: headroom for the gain times sqrt(2) */
+  if (shift >= 0)
+  {
+    ax <<= shift;
+    ay <<= shift;
+  }
+  else
+  {
+    ax >>= -shift;
+    ay >>= -shift;
+  }
+
+  /* Left half-plane: turn by pi first */
+  vx = (int32_t)ax;
+  vy = ((x < 0) != (y < 0)) ? -(int32_t)ay : (int32_t)ay;
+  z = (x < 0) ? 0x80000000UL : 0U;
+
+  for (uint32_t i = 0; i < FIX_CORDIC_ITER; i++)
+  {
+    int32_t dx = vy >> i;
+    int32_t dy = vx >> i;
+
+    if (vy > 0)
+    {
+      vx += dx;
+      vy -= dy;
+      z += (uint32_t)fix_atan_tab[i];
+    }
+    else
+    {
+      vx -= dx;
+      vy += dy;
+      z -= (uint32_t)fix_atan_tab[i];
+    }
+  }
+
+  *mag = (uint32_t)vx;
+  *sh = shift;
+  return z;
+}
+
+q31_t q31_atan2(q31_t y, q31_t x)
+{
+  uint32_t mag;
+  int32_t sh;
+
+  if ((x == 0) && (y == 0))
+  {
+    return 0;
+  }
+  return (q31_t)fix_cordic_vector(y, x, &mag, &sh);
+}
+
+q31_t q31_mag(q31_t x, q31_t y)
+{
+  uint32_t mag;
+  int32_t sh;
+  uint64_t m;
+
+  if ((x == 0) && (y == 0))
+  {
+    return 0;
+  }
+  (void)fix_cordic_vector(y, x, &mag, &sh);
+
+  /* Remove the CORDIC gain in Q31 precision, then the input scaling */
+  m = (uint64_t)mag * FIX_CORDIC_K_Q31;
+  m = (m + (1ULL << (30 + sh))) >> (31 + sh);
+  return (m > (uint64_t)Q31_MAX) ? Q31_MAX : (q31_t)m;
+}
+
+int32_t fix_log2(uint32_t x)
+{
+  uint32_t n;
+  uint32_t m;
+  uint32_t i;
+  uint32_t u;
+  uint32_t f;
+
+  if (x == 0U)
+  {
+    return INT32_MIN;
+  }
+
+  /* x = m * 2^(15 - n) with m in [1, 2) as unsigned Q31 */
+  n = FIX_CLZ(x);
+  m = x << n;
+  i = (m >> 25) & 63U;
+
+  /* log2(m) = log2(c) + log2(1 + u), c = 1 + i/64, u = (m - c)/c < 1/64,
+   * and ln(1 + u) = u - u^2/2 to within 0.12 LSB */
+  u = (uint32_t)(((uint64_t)(m & 0x01FFFFFFUL) * fix_log2_recip_tab[i]) >> 31);
+  u -= (uint32_t)(((uint64_t)u * u) >> 32);
+  f = fix_log2_tab[i] + (uint32_t)(((uint64_t)u * FIX_INV_LN2_Q30) >> 30);
+
+  return (int32_t)((uint32_t)(15 - (int32_t)n) << 16) +
+         (int32_t)((f + 0x4000UL) >> 15);
+}
+
+uint32_t fix_exp2(int32_t x)
+{
+  int32_t ip = x >> 16;
+  uint32_t i = ((uint32_t)x >> 10) & 63U;
+  uint32_t t;
+  uint32_t t2;
+  uint32_t t3;
+  uint64_t v;
+  uint32_t sh;
+
+  if (ip >= 16)
+  {
+    return 0xFFFFFFFFUL;
+  }
+  if (ip < -17)
+  {
+    return 0U;
+  }
+
+  /* 2^f = 2^(i/64) * e^t, t = r ln2 < 0.011: cubic to within 2^-30 */
+  t = (uint32_t)(((uint64_t)(((uint32_t)x & 0x3FFU) << 15) * FIX_LN2_Q32) >> 32);
+  t2 = (uint32_t)(((uint64_t)t * t) >> 32);
+  t3 = (uint32_t)(((uint64_t)t2 * t) >> 31);
+  t3 = (uint32_t)(((uint64_t)t3 * 0x55555555UL) >> 32);
+  v = ((uint64_t)fix_exp2_tab[i] * (0x80000000UL + t + t2 + t3)) >> 31;
+
+  /* v is 2^f in Q31; the result is 2^ip * 2^f in Q16 */
+  sh = (uint32_t)(15 - ip);
+  if (sh != 0U)
+  {
+    v = (v + (1ULL << (sh - 1U))) >> sh;
+  }
+  return (v > 0xFFFFFFFFULL) ? 0xFFFFFFFFUL : (uint32_t)v;
+}
@@ -0,0 +1,245 @@
+/**
+ ******************************************************************************
+ * @file           : icap.c
+ * @brief          : Frequency, period and duty measurement with timer input
+ *                   capture and DMA
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include <string.h>
+#include "dma.h"
+#include "tim.h"
+#include "icap.h"
+
+#if (ICAP_RING_LEN & (ICAP_RING_LEN - 1U)) != 0U
+#error "ICAP_RING_LEN must be a power of two"
+#endif
+
+#if TIM_IRQ_PRIO != DMA_IRQ_PRIO
+#error "icap needs TIM_IRQ_PRIO and DMA_IRQ_PRIO equal"
+#endif
+
+#define ICAP_PSC_MAX_LOG2     3U    /* input prescaler tops out at 8 edges */
+#define ICAP_RATE_HIGH        (ICAP_RING_LEN / 2U) /* captures per period */
+#define ICAP_RATE_LOW         2U
+#define ICAP_TIMEOUT_S        2U
+
+typedef struct
+{
+  TIM_TypeDef *tim;
+  uint8_t rise_ccr;   /* odd channel, direct input; fall uses the next one */
+  uint8_t rise_dma;
+  uint8_t fall_dma;
+} icap_hw_t;
+
+/* Variables */
+static const icap_hw_t icap_hw[] = {
+  { TIM2, 1, 5, 7 },
+  { TIM3, 3, 2, 3 },
+  { TIM4, 1, 1, 4 },
+};
+
+/* Functions */
+static __IO uint32_t *icap_ccmr(TIM_TypeDef *tim, uint32_t ccr)
+{
+  return (ccr <= 2U) ? &tim->CCMR1 : &tim->CCMR2;
+}
+
+static void icap_set_psc(icap_t *c, uint32_t psc_log2)
+{
+  __IO uint32_t *ccmr = icap_ccmr(c->tim, c->rise.ccr);
+  uint32_t psc = psc_log2 << TIM_CCMR1_IC1PSC_Pos;
+
+  *ccmr = (*ccmr & ~(TIM_CCMR1_IC1PSC | TIM_CCMR1_IC2PSC)) | psc | (psc << 8);
+  c->psc_log2 = (uint8_t)psc_log2;
+  icap_calc_set_div(&c->calc, 1UL << psc_log2);
+}
+
+/**
+ * Total captures written by a channel's DMA. The DMA and timer interrupts
+ * share a priority (checked above), so neither runs inside the other: the
+ * timer interrupt never sees a wrap whose TC flag dma.c has cleared but
+ * whose count is not yet taken, and a wrap whose TC interrupt is still
+ * pending is accounted for here.
+ */
+static uint32_t icap_total(const icap_chan_t *ch)
+{
+  uint32_t wraps = ch->wraps;
+  uint32_t pos = (ICAP_RING_LEN - dma_channel(ch->dma)->CNDTR) &
+                 (ICAP_RING_LEN - 1U);
+
+  if ((DMA1->ISR & (DMA_ISR_TCIF1 << (4U * (ch->dma - 1U)))) &&
+      (pos < ICAP_RING_LEN / 2U))
+  {
+    wraps++;
+  }
+  return wraps * ICAP_RING_LEN + pos;
+}
+
+static void icap_dma_event(uint32_t events, void *ctx)
+{
+  icap_chan_t *ch = ctx;
+
+  if (events & DMA_EVT_TC)
+  {
+    ch->wraps++;
+  }
+}
+
+static void icap_update(uint32_t sr, void *ctx)
+{
+  icap_t *c = ctx;
+  uint32_t rise_total;
+  uint32_t fall_total;
+  uint16_t now;
+
+  if (!(sr & TIM_SR_UIF))
+  {
+    return;
+  }
+  c->ovf++;
+  rise_total = icap_total(&c->rise);
+  fall_total = icap_total(&c->fall);
+  now = (uint16_t)c->tim->CNT;
+
+  if (fall_total != c->fall.last_total)
+  {
+    uint16_t cap = c->fall.ring[(fall_total - 1U) & (ICAP_RING_LEN - 1U)];
+
+    icap_calc_fall(&c->calc, icap_extend(cap, c->ovf, now));
+    c->fall.last_total = fall_total;
+  }
+
+  if (rise_total != c->rise.last_total)
+  {
+    uint16_t cap = c->rise.ring[(rise_total - 1U) & (ICAP_RING_LEN - 1U)];
+    uint32_t rate = rise_total - c->rise.last_total;
+
+    icap_calc_rise(&c->calc, rise_total, icap_extend(cap, c->ovf, now));
+    c->rise.last_total = rise_total;
+
+    if ((rate > ICAP_RATE_HIGH) && (c->psc_log2 < ICAP_PSC_MAX_LOG2))
+    {
+      icap_set_psc(c, c->psc_log2 + 1U);
+    }
+    else if ((rate < ICAP_RATE_LOW) && (c->psc_log2 > 0U))
+    {
+      icap_set_psc(c, c->psc_log2 - 1U);
+    }
+  }
+
+  if (icap_calc_poll(&c->calc, ((uint32_t)c->ovf << 16) | now))
+  {
+    c->seq++;
+    __DMB();
+    c->result = c->calc.result;
+    __DMB();
+    c->seq++;
+  }
+}
+
+static void icap_chan_start(icap_chan_t *ch, TIM_TypeDef *tim)
+{
+  DMA_Channel_TypeDef *dma = dma_channel(ch->dma);
+
+  ch->wraps = 0;
+  ch->last_total = 0;
+  dma->CPAR = (uint32_t)(&tim->CCR1 + (ch->ccr - 1U));
+  dma->CMAR = (uint32_t)ch->ring;
+  dma->CNDTR = ICAP_RING_LEN;
+  dma->CCR = DMA_CCR_PL_1 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 |
+             DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_TCIE | DMA_CCR_EN;
+}
+
+int icap_start(icap_t *c, TIM_TypeDef *tim, uint32_t f_tick,
+               uint32_t gate_us, uint32_t filter)
+{
+  const icap_hw_t *hw = NULL;
+  uint32_t rise;
+  uint64_t gate;
+
+  for (uint32_t i = 0; i < sizeof(icap_hw) / sizeof(icap_hw[0]); i++)
+  {
+    if (icap_hw[i].tim == tim)
+    {
+      hw = &icap_hw[i];
+    }
+  }
+  if (hw == NULL)
+  {
+    return -1;
+  }
+
+  memset(c, 0, sizeof(*c));
+  c->tim = tim;
+  c->rise.ccr = hw->rise_ccr;
+  c->rise.dma = hw->rise_dma;
+  c->fall.ccr = hw->rise_ccr + 1U;
+  c->fall.dma = hw->fall_dma;
+
+  if (tim_claim(tim, icap_update, c) != 0)
+  {
+    return -1;
+  }
+  if (dma_claim(c->rise.dma, icap_dma_event, &c->rise) != 0)
+  {
+    tim_release(tim);
+    return -1;
+  }
+  if (dma_claim(c->fall.dma, icap_dma_event, &c->fall) != 0)
+  {
+    dma_release(c->rise.dma);
+    tim_release(tim);
+    return -1;
+  }
+
+  gate = ((uint64_t)f_tick * gate_us) / 1000000U;
+  icap_calc_init(&c->calc, f_tick, (uint32_t)gate,
+                 f_tick * ICAP_TIMEOUT_S);
+
+  rise = hw->rise_ccr;
+  tim->CR1 = 0;
+  tim->PSC = 0;
+  tim->ARR = 0xFFFFU;
+  /* Rising channel on its own input, falling channel on the same (indirect) */
+  *icap_ccmr(tim, rise) = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_1 |
+                          ((filter & 0xFU) << TIM_CCMR1_IC1F_Pos) |
+                          ((filter & 0xFU) << TIM_CCMR1_IC2F_Pos);
+  tim->CCER = (TIM_CCER_CC1E << (4U * (rise - 1U))) |
+              ((TIM_CCER_CC1E | TIM_CCER_CC1P) << (4U * rise));
+  icap_set_psc(c, 0);
+
+  icap_chan_start(&c->rise, tim);
+  icap_chan_start(&c->fall, tim);
+
+  tim->EGR = TIM_EGR_UG;
+  tim->SR = 0;
+  tim->DIER = TIM_DIER_UIE | (TIM_DIER_CC1DE << (rise - 1U)) |
+              (TIM_DIER_CC1DE << rise);
+  tim->CR1 = TIM_CR1_CEN;
+  return 0;
+}
+
+void icap_stop(icap_t *c)
+{
+  c->tim->CR1 = 0;
+  c->tim->CCER = 0;
+  tim_release(c->tim);
+  dma_release(c->rise.dma);
+  dma_release(c->fall.dma);
+}
+
+void icap_read(const icap_t *c, icap_result_t *out)
+{
+  uint32_t seq;
+
+  do
+  {
+    seq = c->seq;
+    __DMB();
+    *out = c->result;
+    __DMB();
+  } while ((seq & 1U) || (seq != c->seq));
+}
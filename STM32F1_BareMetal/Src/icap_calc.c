@@ -0,0 +1,99 @@
+/**
+ ******************************************************************************
+ * @file           : icap_calc.c
+ * @brief          : Reciprocal frequency/period/duty computation from
+ *                   input capture time stamps
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "icap_calc.h"
+
+/* Functions */
+void icap_calc_init(icap_calc_t *c, uint32_t f_tick, uint32_t gate,
+                    uint32_t timeout)
+{
+  memset(c, 0, sizeof(*c));
+  c->f_tick = f_tick;
+  c->gate = gate;
+  c->timeout = timeout;
+  c->div = 1;
+}
+
+void icap_calc_set_div(icap_calc_t *c, uint32_t div)
+{
+  c->div = div;
+  c->win_open = 0;
+}
+
+void icap_calc_rise(icap_calc_t *c, uint32_t count, uint32_t ts)
+{
+  if (!c->win_open)
+  {
+    c->win_open = 1;
+    c->win_count = count;
+    c->win_time = ts;
+  }
+  c->last_count = count;
+  c->last_rise = ts;
+  c->have_rise = 1;
+}
+
+void icap_calc_fall(icap_calc_t *c, uint32_t ts)
+{
+  c->last_fall = ts;
+  c->have_fall = 1;
+}
+
+/* High time as a fraction of the period, from the latest edge pair */
+static uint16_t icap_duty(const icap_calc_t *c, uint64_t period_q16)
+{
+  int32_t d = (int32_t)(c->last_fall - c->last_rise);
+  uint64_t high_q16;
+
+  if (!c->have_fall || (period_q16 == 0U))
+  {
+    return 0;
+  }
+  if (d >= 0)
+  {
+    high_q16 = ((uint64_t)d << 16) % period_q16;
+  }
+  else
+  {
+    high_q16 = period_q16 - (((uint64_t)(-(int64_t)d) << 16) % period_q16);
+  }
+  high_q16 = (high_q16 << 16) / period_q16;
+  return (high_q16 > 0xFFFFU) ? 0xFFFFU : (uint16_t)high_q16;
+}
+
+int icap_calc_poll(icap_calc_t *c, uint32_t now)
+{
+  if (c->win_open && (c->last_count != c->win_count) &&
+      (c->last_rise - c->win_time >= c->gate))
+  {
+    uint64_t edges = (uint64_t)(c->last_count - c->win_count) * c->div;
+    uint64_t ticks = c->last_rise - c->win_time;
+    uint64_t mhz = (edges * c->f_tick * 1000U) / ticks;
+    uint64_t ns = (ticks * 1000000000ULL) / (edges * c->f_tick);
+
+    c->result.freq_mhz = mhz;
+    c->result.period_ns = (ns > 0xFFFFFFFFU) ? 0xFFFFFFFFU : (uint32_t)ns;
+    c->result.duty_q16 = icap_duty(c, (ticks << 16) / edges);
+    c->result.edges = (uint32_t)edges;
+    c->win_count = c->last_count;
+    c->win_time = c->last_rise;
+    return 1;
+  }
+
+  if (c->have_rise && (now - c->last_rise > c->timeout))
+  {
+    int changed = (c->result.freq_mhz != 0U);
+
+    memset(&c->result, 0, sizeof(c->result));
+    c->win_open = 0;
+    return changed;
+  }
+  return 0;
+}
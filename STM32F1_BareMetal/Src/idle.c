@@ -0,0 +1,350 @@
+/**
+ ******************************************************************************
+ * @file           : idle.c
+ * @brief          : Tickless idle in Sleep or Stop mode, timed by the RTC
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "stm32f1xx.h"
+#include "atomic.h"
+#include "coro.h"
+#include "dwt.h"
+#include "event.h"
+#include "exti.h"
+#include "idle.h"
+#include "wheel.h"
+
+#define IDLE_PRL            (IDLE_LSE_HZ / IDLE_RTC_HZ)  /* LSE periods per count */
+#define IDLE_LSE_TIMEOUT    0x400000UL                  /* polls, about 3 s at 8 MHz */
+#define IDLE_EXTI_RTC       (1UL << 17)
+
+/* Ticks after which the LSE difference from the anchor may have wrapped,
+ * with a margin for the HSI running fast */
+#define IDLE_ANCHOR_AGE     ((0x40000000UL / IDLE_LSE_HZ) * SYSTICK_HZ)
+
+/* Weak in the startup file; absent unless the application sets clocks */
+extern void SystemInit(void) __attribute__((weak));
+
+/* Variables */
+static uint32_t idle_ready;
+static volatile uint32_t idle_inhibits;
+static uint32_t idle_anchor_lse;
+static uint32_t idle_anchor_ticks;
+static uint32_t idle_unit_lse;              /* LSE periods, and ticks, in */
+static uint32_t idle_unit_ticks;            /* the shortest exact ratio */
+static uint32_t idle_alarm;                 /* RTC_ALR is write-only */
+static idle_stats_t idle_stats;
+
+/* Functions */
+static void idle_rtc_wait(void)
+{
+  while ((RTC->CRL & RTC_CRL_RTOFF) == 0U)
+  {
+  }
+}
+
+/**
+ * @brief  After reset or Stop, wait for the APB1 copies of the RTC
+ *         registers to be refreshed before reading them.
+ */
+static void idle_rtc_sync(void)
+{
+  RTC->CRL &= ~RTC_CRL_RSF;
+  while ((RTC->CRL & RTC_CRL_RSF) == 0U)
+  {
+  }
+}
+
+static void idle_rtc_config_enter(void)
+{
+  idle_rtc_wait();
+  RTC->CRL |= RTC_CRL_CNF;
+}
+
+static void idle_rtc_config_exit(void)
+{
+  RTC->CRL &= ~RTC_CRL_CNF;
+  idle_rtc_wait();
+}
+
+static uint32_t idle_rtc_count(void)
+{
+  uint32_t high;
+  uint32_t low;
+
+  do
+  {
+    high = RTC->CNTH;
+    low = RTC->CNTL;
+  } while (high != RTC->CNTH);
+  return (high << 16) | low;
+}
+
+/**
+ * @brief  RTC time in LSE periods, from the counter and the prescaler's
+ *         divider, which counts down to the next increment. Wraps.
+ */
+static uint32_t idle_rtc_lse(void)
+{
+  uint32_t count;
+  uint32_t div;
+
+  do
+  {
+    count = idle_rtc_count();
+    div = ((RTC->DIVH & 0xFU) << 16) | RTC->DIVL;
+  } while (count != idle_rtc_count());
+  return count * IDLE_PRL + (IDLE_PRL - 1U - div);
+}
+
+/**
+ * @brief  Move the anchor on in whole units of the exact tick to LSE
+ *         ratio, so the conversion never rounds anything away, and bring
+ *         the tick count up to the RTC. If the count is ahead, the anchor
+ *         moves to it instead, so a later Stop is measured from here.
+ * @retval Ticks advanced
+ */
+static uint32_t idle_resync(uint32_t lse)
+{
+  uint32_t now = systick_ticks();
+  uint32_t elapsed = lse - idle_anchor_lse;
+  uint32_t units;
+  uint32_t ticks;
+
+  if ((now - idle_anchor_ticks) >= IDLE_ANCHOR_AGE)
+  {
+    idle_anchor_lse = lse;
+    idle_anchor_ticks = now;
+    return 0U;
+  }
+
+  units = elapsed / idle_unit_lse;
+  idle_anchor_lse += units * idle_unit_lse;
+  idle_anchor_ticks += units * idle_unit_ticks;
+  elapsed -= units * idle_unit_lse;
+
+  ticks = idle_anchor_ticks + elapsed * SYSTICK_HZ / IDLE_LSE_HZ - now;
+  if ((int32_t)ticks > 0)
+  {
+    systick_advance(ticks);
+    return ticks;
+  }
+  if (ticks != 0U)
+  {
+    idle_anchor_lse = lse;
+    idle_anchor_ticks = now;
+  }
+  return 0U;
+}
+
+static void idle_sleep(void)
+{
+  uint32_t start = idle_rtc_lse();
+
+  __WFI();
+  idle_stats.sleep_lse += idle_rtc_lse() - start;
+  idle_stats.sleeps++;
+}
+
+static void idle_stop(uint32_t ticks)
+{
+  uint32_t counts;
+  uint32_t start;
+  uint32_t wake;
+  uint32_t t;
+
+  if (ticks > IDLE_STOP_MAX)
+  {
+    ticks = IDLE_STOP_MAX;
+  }
+  counts = (ticks / SYSTICK_HZ) * IDLE_RTC_HZ +
+           (ticks % SYSTICK_HZ) * IDLE_RTC_HZ / SYSTICK_HZ;
+
+  /* A tick already pending is counted from the RTC instead */
+  SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+
+  /* The alarm goes off as the counter reaches it, so at most one count
+   * early: never late */
+  start = idle_rtc_lse();
+  idle_alarm = idle_rtc_count() + counts;
+  idle_rtc_config_enter();
+  RTC->ALRH = idle_alarm >> 16;
+  RTC->ALRL = idle_alarm & 0xFFFFU;
+  RTC->CRL &= ~RTC_CRL_ALRF;
+  idle_rtc_config_exit();
+  EXTI->PR = IDLE_EXTI_RTC;
+  NVIC_ClearPendingIRQ(RTC_Alarm_IRQn);
+
+  PWR->CR = (PWR->CR & ~(PWR_CR_PDDS | PWR_CR_LPDS)) |
+            ((IDLE_LPDS != 0U) ? PWR_CR_LPDS : 0U) | PWR_CR_CWUF;
+  SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+  __WFI();
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+  /* Running again on the HSI */
+  t = dwt_cycles();
+  idle_rtc_sync();
+  wake = idle_rtc_lse();
+  if ((RTC->CRL & RTC_CRL_ALRF) != 0U)
+  {
+    uint32_t late = wake - idle_alarm * IDLE_PRL;
+
+    idle_stats.alarms++;
+    idle_stats.wake_lse_last = late;
+    if (late > idle_stats.wake_lse_max)
+    {
+      idle_stats.wake_lse_max = late;
+    }
+  }
+
+  if (SystemInit != 0)
+  {
+    SystemInit();
+  }
+  SysTick->VAL = 0U;
+  SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+  (void)idle_resync(wake);
+
+  t = dwt_cycles() - t;
+  if (t > idle_stats.restore_max)
+  {
+    idle_stats.restore_max = t;
+  }
+  idle_stats.stop_lse += wake - start;
+  idle_stats.stops++;
+}
+
+int idle_init(void)
+{
+  uint32_t n = IDLE_LSE_TIMEOUT;
+  uint32_t a = IDLE_LSE_HZ;
+  uint32_t b = SYSTICK_HZ;
+  crit_t crit;
+
+  RCC->APB1ENR |= RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
+  PWR->CR |= PWR_CR_DBP;
+
+  if ((RCC->BDCR & RCC_BDCR_RTCEN) == 0U)
+  {
+    RCC->BDCR |= RCC_BDCR_LSEON;
+    while ((RCC->BDCR & RCC_BDCR_LSERDY) == 0U)
+    {
+      if (--n == 0U)
+      {
+        return -1;
+      }
+    }
+    RCC->BDCR |= RCC_BDCR_RTCSEL_LSE;
+    RCC->BDCR |= RCC_BDCR_RTCEN;
+
+    idle_rtc_sync();
+    idle_rtc_config_enter();
+    RTC->PRLH = (IDLE_PRL - 1U) >> 16;
+    RTC->PRLL = (IDLE_PRL - 1U) & 0xFFFFU;
+    idle_rtc_config_exit();
+  }
+  else
+  {
+    idle_rtc_sync();
+  }
+
+  /* The alarm reaches the NVIC, and wakes Stop mode, through EXTI 17 */
+  RTC->CRH |= RTC_CRH_ALRIE;
+  crit = crit_enter(EXTI_IRQ_PRIO);
+  EXTI->IMR |= IDLE_EXTI_RTC;
+  EXTI->RTSR |= IDLE_EXTI_RTC;
+  crit_exit(crit);
+  NVIC_SetPriority(RTC_Alarm_IRQn, (1UL << __NVIC_PRIO_BITS) - 1UL);
+  NVIC_EnableIRQ(RTC_Alarm_IRQn);
+
+  /* Greatest common divisor, for the resync unit */
+  while (b != 0U)
+  {
+    uint32_t r = a % b;
+
+    a = b;
+    b = r;
+  }
+  idle_unit_lse = IDLE_LSE_HZ / a;
+  idle_unit_ticks = SYSTICK_HZ / a;
+
+  dwt_init();
+  idle_anchor_lse = idle_rtc_lse();
+  idle_anchor_ticks = systick_ticks();
+  idle_ready = 1U;
+  return 0;
+}
+
+void idle_inhibit(void)
+{
+  (void)atomic_add(&idle_inhibits, 1U);
+}
+
+void idle_allow(void)
+{
+  (void)atomic_add(&idle_inhibits, 0xFFFFFFFFUL);
+}
+
+void idle_get_stats(idle_stats_t *out)
+{
+  *out = idle_stats;
+}
+
+void idle_reset_stats(void)
+{
+  memset(&idle_stats, 0, sizeof(idle_stats));
+}
+
+/**
+ * @brief  Replaces the weak WFI in event.c. Called with PRIMASK set, so
+ *         the interrupt that ends the sleep is taken once the loop unmasks.
+ */
+void event_idle(void)
+{
+  uint32_t ticks = 0xFFFFFFFFUL;
+  uint32_t k;
+
+  if (idle_ready == 0U)
+  {
+    __WFI();
+    return;
+  }
+
+  /* Catching up may have run timers: let the loop see their work first */
+  if (idle_resync(idle_rtc_lse()) != 0U)
+  {
+    return;
+  }
+
+  if ((wheel_next(&k) == 0) && (k < ticks))
+  {
+    ticks = k;
+  }
+  if ((coro_next(&k) == 0) && (k < ticks))
+  {
+    ticks = k;
+  }
+
+  if (ticks < IDLE_STOP_MIN)
+  {
+    idle_sleep();
+  }
+  else if (idle_inhibits != 0U)
+  {
+    idle_stats.inhibited++;
+    idle_sleep();
+  }
+  else
+  {
+    idle_stop(ticks);
+  }
+}
+
+void RTCAlarm_IRQHandler(void)
+{
+  RTC->CRL &= ~RTC_CRL_ALRF;
+  EXTI->PR = IDLE_EXTI_RTC;
+}
@@ -0,0 +1,575 @@
+/**
+ ******************************************************************************
+ * @file           : kernel.c
+ * @brief          : Minimal preemptive priority kernel
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "crit.h"
+#include "kernel.h"
+#include "stm32f1xx.h"
+#include "systick.h"
+
+#define KERNEL_READY        0U
+#define KERNEL_BLOCKED      1U
+#define KERNEL_DEAD         2U
+
+#define KERNEL_XPSR_THUMB   0x01000000UL
+#define KERNEL_PRIO_LOWEST  ((1UL << __NVIC_PRIO_BITS) - 1UL)
+
+/* Variables */
+/* Not static: PendSV_Handler refers to them by name */
+kernel_task_t *volatile kernel_current;
+kernel_task_t *volatile kernel_next;
+
+static kernel_list_t kernel_ready[KERNEL_PRIOS];
+static uint32_t kernel_ready_bits;
+static kernel_task_t *kernel_delayed;       /* by wake tick, soonest first */
+static uint32_t kernel_running;
+
+static kernel_task_t kernel_idle_task;
+static uint32_t kernel_idle_stack[KERNEL_IDLE_STACK] __attribute__((aligned(8)));
+
+/* Functions */
+static inline crit_t kernel_lock(void)
+{
+  return crit_enter(KERNEL_CEILING);
+}
+
+static inline void kernel_unlock(crit_t crit)
+{
+  crit_exit(crit);
+}
+
+static void list_append(kernel_list_t *l, kernel_task_t *t)
+{
+  t->next = 0;
+  t->list = l;
+  if (l->tail != 0)
+  {
+    l->tail->next = t;
+  }
+  else
+  {
+    l->head = t;
+  }
+  l->tail = t;
+}
+
+/* After any task of the same or higher priority */
+static void list_insert_prio(kernel_list_t *l, kernel_task_t *t)
+{
+  kernel_task_t *prev = 0;
+  kernel_task_t *cur = l->head;
+
+  while ((cur != 0) && (cur->prio >= t->prio))
+  {
+    prev = cur;
+    cur = cur->next;
+  }
+  t->next = cur;
+  t->list = l;
+  if (prev != 0)
+  {
+    prev->next = t;
+  }
+  else
+  {
+    l->head = t;
+  }
+  if (cur == 0)
+  {
+    l->tail = t;
+  }
+}
+
+static void list_remove(kernel_task_t *t)
+{
+  kernel_list_t *l = t->list;
+  kernel_task_t *prev = 0;
+  kernel_task_t *cur = l->head;
+
+  while (cur != t)
+  {
+    prev = cur;
+    cur = cur->next;
+  }
+  if (prev != 0)
+  {
+    prev->next = t->next;
+  }
+  else
+  {
+    l->head = t->next;
+  }
+  if (l->tail == t)
+  {
+    l->tail = prev;
+  }
+  t->next = 0;
+  t->list = 0;
+}
+
+static void kernel_make_ready(kernel_task_t *t)
+{
+  t->state = KERNEL_READY;
+  list_append(&kernel_ready[t->prio], t);
+  kernel_ready_bits |= 1UL << t->prio;
+}
+
+static void kernel_unready(kernel_task_t *t)
+{
+  list_remove(t);
+  if (kernel_ready[t->prio].head == 0)
+  {
+    kernel_ready_bits &= ~(1UL << t->prio);
+  }
+}
+
+/**
+ * @brief  Point kernel_next at the head of the most urgent ready list and
+ *         pend PendSV if that is not the running task. The idle task keeps
+ *         the bitmap non-zero.
+ */
+static void kernel_schedule(void)
+{
+  kernel_task_t *t;
+
+  if (kernel_running == 0U)
+  {
+    return;
+  }
+
+  t = kernel_ready[31U - __CLZ(kernel_ready_bits)].head;
+  kernel_next = t;
+  if (t != kernel_current)
+  {
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  }
+}
+
+static void kernel_delay_insert(kernel_task_t *t, uint32_t wake)
+{
+  kernel_task_t **pp = &kernel_delayed;
+
+  while ((*pp != 0) && ((int32_t)((*pp)->wake - wake) <= 0))
+  {
+    pp = &(*pp)->dnext;
+  }
+  t->wake = wake;
+  t->dnext = *pp;
+  t->delayed = 1U;
+  *pp = t;
+}
+
+static void kernel_delay_remove(kernel_task_t *t)
+{
+  kernel_task_t **pp = &kernel_delayed;
+
+  while (*pp != t)
+  {
+    pp = &(*pp)->dnext;
+  }
+  *pp = t->dnext;
+  t->dnext = 0;
+  t->delayed = 0U;
+}
+
+/**
+ * @brief  Take the running task off the ready lists, onto `wait` (if any)
+ *         and the delay list (unless KERNEL_FOREVER). The switch happens
+ *         when the caller unlocks.
+ */
+static void kernel_block(kernel_list_t *wait, uint32_t timeout)
+{
+  kernel_task_t *t = kernel_current;
+
+  kernel_unready(t);
+  t->state = KERNEL_BLOCKED;
+  t->result = 0;
+  if (wait != 0)
+  {
+    list_insert_prio(wait, t);
+  }
+  if (timeout != KERNEL_FOREVER)
+  {
+    kernel_delay_insert(t, systick_ticks() + timeout);
+  }
+  kernel_schedule();
+}
+
+/* From a wait list back to ready, cancelling any timeout */
+static void kernel_wake(kernel_task_t *t)
+{
+  list_remove(t);
+  if (t->delayed != 0U)
+  {
+    kernel_delay_remove(t);
+  }
+  t->result = 0;
+  kernel_make_ready(t);
+}
+
+/* Change the effective priority, keeping t's list ordered */
+static void kernel_set_prio(kernel_task_t *t, uint32_t prio)
+{
+  kernel_list_t *l = t->list;
+
+  if (t->state == KERNEL_READY)
+  {
+    kernel_unready(t);
+    t->prio = (uint8_t)prio;
+    kernel_make_ready(t);
+  }
+  else if (l != 0)
+  {
+    list_remove(t);
+    t->prio = (uint8_t)prio;
+    list_insert_prio(l, t);
+  }
+  else
+  {
+    t->prio = (uint8_t)prio;
+  }
+}
+
+static void kernel_task_exit(void)
+{
+  crit_t crit = kernel_lock();
+  kernel_task_t *t = kernel_current;
+
+  kernel_unready(t);
+  t->state = KERNEL_DEAD;
+  kernel_schedule();
+  kernel_unlock(crit);
+  for (;;)
+  {
+  }
+}
+
+static void kernel_task_setup(kernel_task_t *t, void (*fn)(void *), void *arg,
+                              uint32_t *stack, uint32_t words, uint32_t prio)
+{
+  uint32_t *sp = (uint32_t *)((uintptr_t)(stack + words) & ~(uintptr_t)7U);
+
+  /* Hardware frame, popped on exception return, then r4-r11 for PendSV */
+  *--sp = KERNEL_XPSR_THUMB;
+  *--sp = (uint32_t)(uintptr_t)fn & ~1UL;   /* pc */
+  *--sp = (uint32_t)(uintptr_t)kernel_task_exit;
+  sp -= 4;                                  /* r12, r3, r2, r1 */
+  *--sp = (uint32_t)(uintptr_t)arg;         /* r0 */
+  sp -= 8;
+
+  t->sp = sp;
+  t->next = 0;
+  t->dnext = 0;
+  t->list = 0;
+  t->held = 0;
+  t->blocker = 0;
+  t->result = 0;
+  t->prio = (uint8_t)prio;
+  t->base = (uint8_t)prio;
+  t->delayed = 0U;
+  kernel_make_ready(t);
+}
+
+int kernel_task_create(kernel_task_t *t, void (*fn)(void *), void *arg,
+                       uint32_t *stack, uint32_t words, uint32_t prio)
+{
+  crit_t crit;
+
+  if ((t == 0) || (fn == 0) || (stack == 0) || (words < KERNEL_STACK_MIN) ||
+      (prio == 0U) || (prio >= KERNEL_PRIOS))
+  {
+    return -1;
+  }
+
+  crit = kernel_lock();
+  kernel_task_setup(t, fn, arg, stack, words, prio);
+  kernel_schedule();
+  kernel_unlock(crit);
+  return 0;
+}
+
+void kernel_idle(void) __attribute__((weak));
+void kernel_idle(void)
+{
+  __WFI();
+}
+
+static void kernel_idle_entry(void *arg)
+{
+  (void)arg;
+  for (;;)
+  {
+    kernel_idle();
+  }
+}
+
+void kernel_start(void)
+{
+  crit_t crit;
+
+  NVIC_SetPriority(PendSV_IRQn, KERNEL_PRIO_LOWEST);
+  crit = kernel_lock();
+  kernel_task_setup(&kernel_idle_task, kernel_idle_entry, 0,
+                    kernel_idle_stack, KERNEL_IDLE_STACK, 0U);
+  systick_init();
+  kernel_running = 1U;
+  kernel_schedule();
+  kernel_unlock(crit);
+
+  /* PendSV is taken here, and this thread is never resumed */
+  for (;;)
+  {
+  }
+}
+
+kernel_task_t *kernel_self(void)
+{
+  return kernel_current;
+}
+
+void kernel_yield(void)
+{
+  crit_t crit = kernel_lock();
+  kernel_task_t *t = kernel_current;
+
+  list_remove(t);
+  list_append(&kernel_ready[t->prio], t);
+  kernel_schedule();
+  kernel_unlock(crit);
+}
+
+void kernel_delay(uint32_t ticks)
+{
+  crit_t crit;
+
+  if (ticks == 0U)
+  {
+    kernel_yield();
+    return;
+  }
+
+  crit = kernel_lock();
+  kernel_block(0, ticks);
+  kernel_unlock(crit);
+}
+
+void kernel_tick(void)
+{
+  uint32_t now = systick_ticks();
+  crit_t crit = kernel_lock();
+
+  while ((kernel_delayed != 0) &&
+         ((int32_t)(now - kernel_delayed->wake) >= 0))
+  {
+    kernel_task_t *t = kernel_delayed;
+
+    kernel_delayed = t->dnext;
+    t->dnext = 0;
+    t->delayed = 0U;
+    if (t->list != 0)
+    {
+      /* Timed out on a semaphore */
+      list_remove(t);
+      t->result = -1;
+    }
+    kernel_make_ready(t);
+  }
+  kernel_schedule();
+  kernel_unlock(crit);
+}
+
+void kernel_mutex_init(kernel_mutex_t *m)
+{
+  m->owner = 0;
+  m->next = 0;
+  m->waiters.head = 0;
+  m->waiters.tail = 0;
+}
+
+static void kernel_mutex_take(kernel_mutex_t *m, kernel_task_t *t)
+{
+  m->owner = t;
+  m->next = t->held;
+  t->held = m;
+}
+
+int kernel_mutex_lock(kernel_mutex_t *m)
+{
+  crit_t crit = kernel_lock();
+  kernel_task_t *t = kernel_current;
+  kernel_task_t *owner = m->owner;
+
+  if (owner == 0)
+  {
+    kernel_mutex_take(m, t);
+    kernel_unlock(crit);
+    return 0;
+  }
+  if (owner == t)
+  {
+    kernel_unlock(crit);
+    return -1;
+  }
+
+  /* Lend our priority down the chain of owners */
+  while ((owner != 0) && (owner->prio < t->prio))
+  {
+    kernel_set_prio(owner, t->prio);
+    owner = (owner->blocker != 0) ? owner->blocker->owner : 0;
+  }
+  t->blocker = m;
+  kernel_block(&m->waiters, KERNEL_FOREVER);
+  kernel_unlock(crit);
+
+  /* kernel_mutex_unlock() made us the owner before waking us */
+  return 0;
+}
+
+int kernel_mutex_unlock(kernel_mutex_t *m)
+{
+  crit_t crit = kernel_lock();
+  kernel_task_t *t = kernel_current;
+  kernel_mutex_t **pp = &t->held;
+  kernel_task_t *w;
+  uint32_t prio;
+
+  if (m->owner != t)
+  {
+    kernel_unlock(crit);
+    return -1;
+  }
+
+  while (*pp != m)
+  {
+    pp = &(*pp)->next;
+  }
+  *pp = m->next;
+  m->next = 0;
+  m->owner = 0;
+
+  /* Keep only what the waiters of mutexes still held lend us */
+  prio = t->base;
+  for (kernel_mutex_t *h = t->held; h != 0; h = h->next)
+  {
+    if ((h->waiters.head != 0) && (h->waiters.head->prio > prio))
+    {
+      prio = h->waiters.head->prio;
+    }
+  }
+  if (prio != t->prio)
+  {
+    kernel_set_prio(t, prio);
+  }
+
+  w = m->waiters.head;
+  if (w != 0)
+  {
+    list_remove(w);
+    w->blocker = 0;
+    kernel_mutex_take(m, w);
+    w->result = 0;
+    kernel_make_ready(w);
+  }
+  kernel_schedule();
+  kernel_unlock(crit);
+  return 0;
+}
+
+void kernel_sem_init(kernel_sem_t *s, uint32_t count)
+{
+  s->count = count;
+  s->waiters.head = 0;
+  s->waiters.tail = 0;
+}
+
+int kernel_sem_take(kernel_sem_t *s, uint32_t timeout)
+{
+  crit_t crit = kernel_lock();
+  kernel_task_t *t = kernel_current;
+
+  if (s->count != 0U)
+  {
+    s->count--;
+    kernel_unlock(crit);
+    return 0;
+  }
+  if (timeout == 0U)
+  {
+    kernel_unlock(crit);
+    return -1;
+  }
+
+  kernel_block(&s->waiters, timeout);
+  kernel_unlock(crit);
+  return t->result;
+}
+
+void kernel_sem_give(kernel_sem_t *s)
+{
+  crit_t crit = kernel_lock();
+  kernel_task_t *w = s->waiters.head;
+
+  if (w != 0)
+  {
+    kernel_wake(w);
+    kernel_schedule();
+  }
+  else
+  {
+    s->count++;
+  }
+  kernel_unlock(crit);
+}
+
+static void kernel_default_hook(void)
+{
+}
+
+/* Deferred work (see defer.h) shares PendSV and runs ahead of the switch */
+void defer_run(void) __attribute__((weak, alias("kernel_default_hook")));
+
+/**
+ * @brief  Run deferred work, then switch from kernel_current to
+ *         kernel_next. With no task yet (first switch) there is nothing to
+ *         save; returning with EXC_RETURN bit 2 set resumes thread mode on
+ *         the new PSP.
+ */
+void PendSV_Handler(void) __attribute__((naked));
+void PendSV_Handler(void)
+{
+  __asm volatile
+  (
+    "  push    {r0, lr}                       \n"
+    "  bl      defer_run                      \n"
+    "  pop     {r0, lr}                       \n"
+    "  mov     r0, %0                         \n"
+    "  msr     basepri, r0                    \n"
+    "  movw    r2, #:lower16:kernel_current   \n"
+    "  movt    r2, #:upper16:kernel_current   \n"
+    "  movw    r3, #:lower16:kernel_next      \n"
+    "  movt    r3, #:upper16:kernel_next      \n"
+    "  ldr     r1, [r2]                       \n"
+    "  ldr     r3, [r3]                       \n"
+    "  cmp     r1, r3                         \n"
+    "  beq     2f                             \n"
+    "  mrs     r0, psp                        \n"
+    "  cbz     r1, 1f                         \n"
+    "  stmdb   r0!, {r4-r11}                  \n"
+    "  str     r0, [r1]                       \n"
+    "1:                                       \n"
+    "  str     r3, [r2]                       \n"
+    "  ldr     r0, [r3]                       \n"
+    "  ldmia   r0!, {r4-r11}                  \n"
+    "  msr     psp, r0                        \n"
+    "  orr     lr, lr, #4                     \n"
+    "2:                                       \n"
+    "  mov     r0, #0                         \n"
+    "  msr     basepri, r0                    \n"
+    "  bx      lr                             \n"
+    :: "i" (CRIT_BASEPRI(KERNEL_CEILING))
+  );
+}
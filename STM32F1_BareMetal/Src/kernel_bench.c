@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * @file           : kernel_bench.c
+ * @brief          : Cycle count of a kernel context switch
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "dwt.h"
+#include "kernel.h"
+
+#define KERNEL_BENCH_STACK  64U
+
+/* Variables */
+static kernel_task_t kernel_bench_task;
+static uint32_t kernel_bench_stack[KERNEL_BENCH_STACK] __attribute__((aligned(8)));
+static volatile uint32_t kernel_bench_stamp;
+static uint32_t kernel_bench_rounds;
+
+/* Functions */
+static void kernel_bench_helper(void *arg)
+{
+  (void)arg;
+  for (uint32_t i = 0; i < kernel_bench_rounds; i++)
+  {
+    kernel_bench_stamp = dwt_cycles();
+    kernel_yield();
+  }
+}
+
+uint32_t kernel_switch_bench(uint32_t rounds)
+{
+  kernel_task_t *self = kernel_self();
+  uint32_t best = 0xFFFFFFFFUL;
+  uint32_t overhead;
+  uint32_t t;
+
+  if ((self == 0) || (rounds == 0U))
+  {
+    return 0U;
+  }
+
+  dwt_init();
+  t = dwt_cycles();
+  overhead = dwt_cycles() - t;
+
+  /* The helper queues behind us at our priority; each of our yields lets
+   * it stamp the time and yield straight back */
+  kernel_bench_rounds = rounds;
+  if (kernel_task_create(&kernel_bench_task, kernel_bench_helper, 0,
+                         kernel_bench_stack, KERNEL_BENCH_STACK,
+                         self->base) != 0)
+  {
+    return 0U;
+  }
+  for (uint32_t i = 0; i < rounds; i++)
+  {
+    kernel_yield();
+    t = dwt_cycles() - kernel_bench_stamp;
+    if (t < best)
+    {
+      best = t;
+    }
+  }
+  /* Once more so the helper can return and end */
+  kernel_yield();
+
+  return (best > overhead) ? (best - overhead) : 0U;
+}
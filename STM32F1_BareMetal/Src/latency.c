@@ -0,0 +1,328 @@
+/**
+ ******************************************************************************
+ * @file           : latency.c
+ * @brief          : Interrupt latency and jitter measurement under load
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include <string.h>
+#include "crit.h"
+#include "dwt.h"
+#include "latency.h"
+#include "tim.h"
+
+/* The Debug build would otherwise put -O0 on the measuring callback */
+#pragma GCC optimize ("O2")
+
+typedef struct
+{
+  uint16_t bins[LATENCY_BINS + 1U];     /* the last for the overflow */
+  uint32_t prio;
+  uint32_t count;
+  uint32_t missed;
+  uint32_t min;
+  uint32_t max;
+  uint32_t max_pc;
+  uint32_t max_exception;
+} latency_hist_t;
+
+/* Variables */
+static latency_hist_t latency_hist[LATENCY_LEVELS];
+static const latency_config_t *latency_cfg;
+static volatile uint32_t latency_level;     /* being measured */
+static uint32_t latency_levels;             /* measured in the last run */
+static uint32_t latency_expected;           /* CYCCNT of the next compare */
+static uint32_t latency_lfsr = 1U;
+
+/* Functions */
+static IRQn_Type latency_irq(const TIM_TypeDef *tim)
+{
+  if (tim == TIM1)
+  {
+    return TIM1_UP_IRQn;
+  }
+  if (tim == TIM2)
+  {
+    return TIM2_IRQn;
+  }
+  if (tim == TIM3)
+  {
+    return TIM3_IRQn;
+  }
+  if (tim == TIM4)
+  {
+    return TIM4_IRQn;
+  }
+  return (IRQn_Type)-1;
+}
+
+static void latency_spin(uint32_t cycles)
+{
+  uint32_t t = dwt_cycles();
+
+  while ((dwt_cycles() - t) < cycles)
+  {
+  }
+}
+
+/**
+ * @brief  Set the next compare `step` cycles from now and note when it
+ *         falls due. The two reads are a few cycles apart, a constant
+ *         added to every sample.
+ */
+static void latency_anchor(TIM_TypeDef *tim, uint32_t step)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint32_t cycles;
+  uint32_t count;
+
+  __disable_irq();
+  cycles = dwt_cycles();
+  count = tim->CNT;
+  tim->CCR1 = (count + step) & 0xFFFFU;
+  latency_expected = cycles + step;
+  __set_PRIMASK(primask);
+}
+
+static void latency_cb(uint32_t sr, void *ctx)
+{
+  uint32_t now = dwt_cycles();
+  TIM_TypeDef *tim = ctx;
+  const latency_config_t *cfg = latency_cfg;
+  latency_hist_t *h = &latency_hist[latency_level];
+  const uint32_t *frame = tim_frame(tim);
+  uint32_t lat = now - latency_expected;
+  uint32_t bin = lat / LATENCY_BIN_CYCLES;
+  uint32_t step;
+  uint32_t ccr;
+
+  if ((sr & TIM_SR_CC1IF) == 0U)
+  {
+    return;
+  }
+
+  h->bins[(bin < LATENCY_BINS) ? bin : LATENCY_BINS]++;
+  h->count++;
+  if (lat < h->min)
+  {
+    h->min = lat;
+  }
+  if (lat > h->max)
+  {
+    h->max = lat;
+    h->max_pc = frame[6];
+    h->max_exception = frame[7] & 0x1FFU;
+  }
+
+  /* Galois LFSR for the dither */
+  latency_lfsr = (latency_lfsr >> 1) ^ ((0U - (latency_lfsr & 1U)) & 0xB4BCD35CU);
+  step = cfg->period + (latency_lfsr & cfg->dither);
+
+  latency_expected += step;
+  ccr = (tim->CCR1 + step) & 0xFFFFU;
+  tim->CCR1 = ccr;
+  if (((ccr - tim->CNT) & 0xFFFFU) > step)
+  {
+    /* Held off past the next compare: start afresh from now */
+    h->missed++;
+    latency_anchor(tim, step);
+  }
+
+  if (h->count >= cfg->samples)
+  {
+    uint32_t next = latency_level + 1U;
+
+    if (next < cfg->levels)
+    {
+      NVIC_SetPriority(latency_irq(tim), cfg->prios[next]);
+    }
+    else
+    {
+      tim->DIER = 0U;
+    }
+    latency_level = next;
+  }
+}
+
+static void latency_load_cb(uint32_t sr, void *ctx)
+{
+  (void)sr;
+  latency_spin(((const latency_config_t *)ctx)->load_cycles);
+}
+
+/**
+ * @brief  Free-running at the core clock, full 16-bit range.
+ */
+static void latency_tim_setup(TIM_TypeDef *tim, uint32_t arr)
+{
+  tim->CR1 = 0U;
+  tim->PSC = 0U;
+  tim->ARR = arr;
+  tim->CCMR1 &= ~(TIM_CCMR1_OC1M | TIM_CCMR1_CC1S);
+  tim->EGR = TIM_EGR_UG;
+  tim->SR = 0U;
+}
+
+static int latency_check(const latency_config_t *cfg)
+{
+  if ((latency_irq(cfg->tim) == (IRQn_Type)-1) || (cfg->tim == TIM1) ||
+      (cfg->period < LATENCY_PERIOD_MIN) ||
+      ((cfg->period + cfg->dither) > LATENCY_PERIOD_MAX) ||
+      ((cfg->dither & (cfg->dither + 1U)) != 0U) ||
+      (cfg->prios == NULL) || (cfg->levels == 0U) ||
+      (cfg->levels > LATENCY_LEVELS) ||
+      (cfg->samples == 0U) || (cfg->samples > 0xFFFFU) ||
+      (cfg->mask_prio > 15U))
+  {
+    return -1;
+  }
+  for (uint32_t i = 0; i < cfg->levels; i++)
+  {
+    if (cfg->prios[i] > 15U)
+    {
+      return -1;
+    }
+  }
+  if ((cfg->load_tim != NULL) &&
+      ((latency_irq(cfg->load_tim) == (IRQn_Type)-1) ||
+       (cfg->load_tim == cfg->tim) || (cfg->load_prio > 15U) ||
+       (cfg->load_period < 2U) || (cfg->load_period > 0x10000U)))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+int latency_run(const latency_config_t *cfg)
+{
+  TIM_TypeDef *tim = cfg->tim;
+  uint32_t prio;
+  uint32_t load_prio = 0U;
+
+  if (latency_check(cfg) != 0)
+  {
+    return -1;
+  }
+
+  memset(latency_hist, 0, sizeof(latency_hist));
+  for (uint32_t i = 0; i < cfg->levels; i++)
+  {
+    latency_hist[i].prio = cfg->prios[i];
+    latency_hist[i].min = 0xFFFFFFFFUL;
+  }
+  latency_cfg = cfg;
+  latency_level = 0U;
+  latency_levels = 0U;
+  dwt_init();
+
+  if (tim_claim(tim, latency_cb, tim) != 0)
+  {
+    return -1;
+  }
+  if ((cfg->load_tim != NULL) &&
+      (tim_claim(cfg->load_tim, latency_load_cb, (void *)cfg) != 0))
+  {
+    tim_release(tim);
+    return -1;
+  }
+
+  /* As tim_claim() left them, for the next owner */
+  prio = NVIC_GetPriority(latency_irq(tim));
+  if (cfg->load_tim != NULL)
+  {
+    load_prio = NVIC_GetPriority(latency_irq(cfg->load_tim));
+    latency_tim_setup(cfg->load_tim, cfg->load_period - 1U);
+    NVIC_SetPriority(latency_irq(cfg->load_tim), cfg->load_prio);
+    cfg->load_tim->DIER = TIM_DIER_UIE;
+    cfg->load_tim->CR1 = TIM_CR1_CEN;
+  }
+
+  latency_tim_setup(tim, 0xFFFFU);
+  NVIC_SetPriority(latency_irq(tim), cfg->prios[0]);
+  tim->CR1 = TIM_CR1_CEN;
+  latency_anchor(tim, cfg->period);
+  tim->DIER = TIM_DIER_CC1IE;
+
+  while (latency_level < cfg->levels)
+  {
+    if (cfg->mask_cycles != 0U)
+    {
+      if (cfg->mask_prio == 0U)
+      {
+        uint32_t primask = __get_PRIMASK();
+
+        __disable_irq();
+        latency_spin(cfg->mask_cycles);
+        __set_PRIMASK(primask);
+      }
+      else
+      {
+        crit_t c = crit_enter(cfg->mask_prio);
+
+        latency_spin(cfg->mask_cycles);
+        crit_exit(c);
+      }
+      latency_spin(cfg->mask_cycles);
+    }
+  }
+
+  tim->CR1 = 0U;
+  NVIC_SetPriority(latency_irq(tim), prio);
+  tim_release(tim);
+  if (cfg->load_tim != NULL)
+  {
+    cfg->load_tim->CR1 = 0U;
+    NVIC_SetPriority(latency_irq(cfg->load_tim), load_prio);
+    tim_release(cfg->load_tim);
+  }
+  latency_levels = cfg->levels;
+  return 0;
+}
+
+/**
+ * @brief  Upper edge of the bin holding the sample of rank ceil(n * q),
+ *         q in thousandths; the worst case itself past the last bin.
+ */
+static uint32_t latency_percentile(const latency_hist_t *h, uint32_t q)
+{
+  uint32_t rank = (h->count * q + 999U) / 1000U;
+  uint32_t seen = 0U;
+
+  for (uint32_t i = 0; i < LATENCY_BINS; i++)
+  {
+    seen += h->bins[i];
+    if (seen >= rank)
+    {
+      uint32_t edge = (i + 1U) * LATENCY_BIN_CYCLES - 1U;
+
+      return (edge < h->max) ? edge : h->max;
+    }
+  }
+  return h->max;
+}
+
+int latency_get_report(uint32_t level, latency_report_t *out)
+{
+  const latency_hist_t *h;
+
+  if (level >= latency_levels)
+  {
+    return -1;
+  }
+
+  h = &latency_hist[level];
+  out->prio = h->prio;
+  out->count = h->count;
+  out->missed = h->missed;
+  out->min = h->min;
+  out->p50 = latency_percentile(h, 500U);
+  out->p90 = latency_percentile(h, 900U);
+  out->p99 = latency_percentile(h, 990U);
+  out->p999 = latency_percentile(h, 999U);
+  out->max = h->max;
+  out->max_pc = h->max_pc;
+  out->max_exception = h->max_exception;
+  return 0;
+}
@@ -18,10 +18,12 @@
 
 #include <stdint.h>
 #include "stm32f1xx.h"
+#include "event.h"
 
 
 int main(void)
 {
-    /* Loop forever */
-	for(;;);
+    /* Dispatch events forever, sleeping when idle */
+	event_init();
+	event_run();
 }
@@ -0,0 +1,320 @@
+/**
+ ******************************************************************************
+ * @file           : memopt.c
+ * @brief          : Word and block optimised memcpy/memmove/memset/memcmp
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "memopt.h"
+
+#define MEMOPT_WORD_MIN     16U
+#define MEMOPT_BLOCK        32U
+
+/* Keep GCC from turning the byte loops back into calls to these functions */
+#define MEMOPT_FN           __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+typedef uint32_t __attribute__((may_alias)) memopt_word_t;
+typedef struct __attribute__((packed, may_alias))
+{
+  uint32_t v;
+} memopt_uword_t;
+
+/* Functions */
+#if defined(__thumb2__)
+
+/* r7 is left alone: it is the frame pointer in unoptimised Thumb builds */
+#define MEMOPT_REGS         "{r3-r6, r8-r10, r12}"
+#define MEMOPT_CLOBBER      "r3", "r4", "r5", "r6", "r8", "r9", "r10", "r12"
+
+static inline void memopt_blocks_fwd(uint8_t **d, const uint8_t **s,
+                                     size_t blocks)
+{
+  uint8_t *dp = *d;
+  const uint8_t *sp = *s;
+
+  __asm volatile (
+    "1:\n\t"
+    "ldmia  %1!, " MEMOPT_REGS "\n\t"
+    "stmia  %0!, " MEMOPT_REGS "\n\t"
+    "subs   %2, %2, #1\n\t"
+    "bne    1b"
+    : "+r" (dp), "+r" (sp), "+r" (blocks)
+    :
+    : MEMOPT_CLOBBER, "cc", "memory");
+  *d = dp;
+  *s = sp;
+}
+
+static inline void memopt_blocks_back(uint8_t **d, const uint8_t **s,
+                                      size_t blocks)
+{
+  uint8_t *dp = *d;
+  const uint8_t *sp = *s;
+
+  __asm volatile (
+    "1:\n\t"
+    "ldmdb  %1!, " MEMOPT_REGS "\n\t"
+    "stmdb  %0!, " MEMOPT_REGS "\n\t"
+    "subs   %2, %2, #1\n\t"
+    "bne    1b"
+    : "+r" (dp), "+r" (sp), "+r" (blocks)
+    :
+    : MEMOPT_CLOBBER, "cc", "memory");
+  *d = dp;
+  *s = sp;
+}
+
+static inline void memopt_blocks_fill(uint8_t **d, uint32_t pattern,
+                                      size_t blocks)
+{
+  uint8_t *dp = *d;
+
+  __asm volatile (
+    "mov    r3, %2\n\t"
+    "mov    r4, %2\n\t"
+    "mov    r5, %2\n\t"
+    "mov    r6, %2\n\t"
+    "mov    r8, %2\n\t"
+    "mov    r9, %2\n\t"
+    "mov    r10, %2\n\t"
+    "mov    r12, %2\n"
+    "1:\n\t"
+    "stmia  %0!, " MEMOPT_REGS "\n\t"
+    "subs   %1, %1, #1\n\t"
+    "bne    1b"
+    : "+r" (dp), "+r" (blocks)
+    : "r" (pattern)
+    : MEMOPT_CLOBBER, "cc", "memory");
+  *d = dp;
+}
+
+#else
+
+static inline void memopt_blocks_fwd(uint8_t **d, const uint8_t **s,
+                                     size_t blocks)
+{
+  memopt_word_t *dp = (memopt_word_t *)*d;
+  const memopt_word_t *sp = (const memopt_word_t *)*s;
+
+  while (blocks-- != 0U)
+  {
+    for (uint32_t i = 0; i < 8U; i++)
+    {
+      *dp++ = *sp++;
+    }
+  }
+  *d = (uint8_t *)dp;
+  *s = (const uint8_t *)sp;
+}
+
+static inline void memopt_blocks_back(uint8_t **d, const uint8_t **s,
+                                      size_t blocks)
+{
+  memopt_word_t *dp = (memopt_word_t *)*d;
+  const memopt_word_t *sp = (const memopt_word_t *)*s;
+
+  while (blocks-- != 0U)
+  {
+    memopt_word_t w[8];
+
+    for (uint32_t i = 0; i < 8U; i++)
+    {
+      w[i] = sp[(int)i - 8];
+    }
+    for (uint32_t i = 0; i < 8U; i++)
+    {
+      dp[(int)i - 8] = w[i];
+    }
+    dp -= 8;
+    sp -= 8;
+  }
+  *d = (uint8_t *)dp;
+  *s = (const uint8_t *)sp;
+}
+
+static inline void memopt_blocks_fill(uint8_t **d, uint32_t pattern,
+                                      size_t blocks)
+{
+  memopt_word_t *dp = (memopt_word_t *)*d;
+
+  while (blocks-- != 0U)
+  {
+    for (uint32_t i = 0; i < 8U; i++)
+    {
+      *dp++ = pattern;
+    }
+  }
+  *d = (uint8_t *)dp;
+}
+
+#endif
+
+MEMOPT_FN void *memopt_memcpy(void *dst, const void *src, size_t n)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+
+  if (n >= MEMOPT_WORD_MIN)
+  {
+    while ((uintptr_t)d & 3U)
+    {
+      *d++ = *s++;
+      n--;
+    }
+    if (((uintptr_t)s & 3U) == 0U)
+    {
+      if (n >= MEMOPT_BLOCK)
+      {
+        memopt_blocks_fwd(&d, &s, n / MEMOPT_BLOCK);
+        n &= MEMOPT_BLOCK - 1U;
+      }
+      for (; n >= 4U; n -= 4U, d += 4, s += 4)
+      {
+        *(memopt_word_t *)d = *(const memopt_word_t *)s;
+      }
+    }
+    else
+    {
+      for (; n >= 4U; n -= 4U, d += 4, s += 4)
+      {
+        *(memopt_word_t *)d = ((const memopt_uword_t *)s)->v;
+      }
+    }
+  }
+  while (n-- != 0U)
+  {
+    *d++ = *s++;
+  }
+  return dst;
+}
+
+MEMOPT_FN void *memopt_memmove(void *dst, const void *src, size_t n)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+
+  /* Destination below the source, or past its end: a forward copy reads
+   * every byte before overwriting it. */
+  if ((uintptr_t)d - (uintptr_t)s >= n)
+  {
+    return memopt_memcpy(dst, src, n);
+  }
+
+  d += n;
+  s += n;
+  if (n >= MEMOPT_WORD_MIN)
+  {
+    while ((uintptr_t)d & 3U)
+    {
+      *--d = *--s;
+      n--;
+    }
+    if (((uintptr_t)s & 3U) == 0U)
+    {
+      if (n >= MEMOPT_BLOCK)
+      {
+        memopt_blocks_back(&d, &s, n / MEMOPT_BLOCK);
+        n &= MEMOPT_BLOCK - 1U;
+      }
+      for (; n >= 4U; n -= 4U)
+      {
+        d -= 4;
+        s -= 4;
+        *(memopt_word_t *)d = *(const memopt_word_t *)s;
+      }
+    }
+    else
+    {
+      for (; n >= 4U; n -= 4U)
+      {
+        d -= 4;
+        s -= 4;
+        *(memopt_word_t *)d = ((const memopt_uword_t *)s)->v;
+      }
+    }
+  }
+  while (n-- != 0U)
+  {
+    *--d = *--s;
+  }
+  return dst;
+}
+
+MEMOPT_FN void *memopt_memset(void *dst, int c, size_t n)
+{
+  uint8_t *d = dst;
+  uint8_t v = (uint8_t)c;
+
+  if (n >= MEMOPT_WORD_MIN)
+  {
+    uint32_t pattern = 0x01010101UL * v;
+
+    while ((uintptr_t)d & 3U)
+    {
+      *d++ = v;
+      n--;
+    }
+    if (n >= MEMOPT_BLOCK)
+    {
+      memopt_blocks_fill(&d, pattern, n / MEMOPT_BLOCK);
+      n &= MEMOPT_BLOCK - 1U;
+    }
+    for (; n >= 4U; n -= 4U, d += 4)
+    {
+      *(memopt_word_t *)d = pattern;
+    }
+  }
+  while (n-- != 0U)
+  {
+    *d++ = v;
+  }
+  return dst;
+}
+
+MEMOPT_FN int memopt_memcmp(const void *a, const void *b, size_t n)
+{
+  const uint8_t *p = a;
+  const uint8_t *q = b;
+
+  if (n >= MEMOPT_WORD_MIN)
+  {
+    while ((uintptr_t)p & 3U)
+    {
+      if (*p != *q)
+      {
+        return (int)*p - (int)*q;
+      }
+      p++;
+      q++;
+      n--;
+    }
+    /* Skip equal words; the byte loop below locates a difference */
+    for (; n >= 4U; n -= 4U, p += 4, q += 4)
+    {
+      if (*(const memopt_word_t *)p != ((const memopt_uword_t *)q)->v)
+      {
+        break;
+      }
+    }
+  }
+  while (n-- != 0U)
+  {
+    if (*p != *q)
+    {
+      return (int)*p - (int)*q;
+    }
+    p++;
+    q++;
+  }
+  return 0;
+}
+
+void *__wrap_memcpy(void *dst, const void *src, size_t n)
+  __attribute__((alias("memopt_memcpy")));
+void *__wrap_memmove(void *dst, const void *src, size_t n)
+  __attribute__((alias("memopt_memmove")));
+void *__wrap_memset(void *dst, int c, size_t n)
+  __attribute__((alias("memopt_memset")));
+int __wrap_memcmp(const void *a, const void *b, size_t n)
+  __attribute__((alias("memopt_memcmp")));
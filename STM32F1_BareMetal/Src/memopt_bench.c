@@ -0,0 +1,40 @@
+/**
+ ******************************************************************************
+ * @file           : memopt_bench.c
+ * @brief          : Cycles-per-byte measurement of copy routines
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "dwt.h"
+#include "memopt.h"
+
+#define BENCH_MAX           4096U
+#define BENCH_DST_OFFSET    (BENCH_MAX + 8U)
+
+/* Functions */
+void memopt_bench(memopt_copy_t fn, void *scratch, uint32_t misalign,
+                  uint32_t cpb_q8[MEMOPT_BENCH_SIZES])
+{
+  uint8_t *src = (uint8_t *)scratch + (misalign & 3U);
+  uint8_t *dst = (uint8_t *)scratch + BENCH_DST_OFFSET;
+  uint32_t overhead;
+  uint32_t t;
+
+  dwt_init();
+  t = dwt_cycles();
+  overhead = dwt_cycles() - t;
+
+  for (uint32_t i = 0; i < MEMOPT_BENCH_SIZES; i++)
+  {
+    uint32_t len = 1UL << i;
+    uint32_t cycles;
+
+    fn(dst, src, len);          /* warm the flash prefetch path */
+    t = dwt_cycles();
+    fn(dst, src, len);
+    cycles = dwt_cycles() - t;
+    cycles = (cycles > overhead) ? (cycles - overhead) : 0U;
+    cpb_q8[i] = (cycles << 8) / len;
+  }
+}
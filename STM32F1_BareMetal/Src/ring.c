@@ -0,0 +1,209 @@
+/**
+ ******************************************************************************
+ * @file           : ring.c
+ * @brief          : Lock-free SPSC and MPSC ring buffer indices
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "ring.h"
+
+/* Functions */
+int ring_spsc_init(ring_spsc_t *r, uint32_t len)
+{
+  if ((len == 0U) || ((len & (len - 1U)) != 0U))
+  {
+    return -1;
+  }
+
+  r->head = 0U;
+  r->tail = 0U;
+  r->mask = len - 1U;
+  return 0;
+}
+
+int ring_mpsc_init(ring_mpsc_t *r, volatile uint32_t *seq, uint32_t len)
+{
+  if ((seq == 0) || (len == 0U) || ((len & (len - 1U)) != 0U))
+  {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < len; i++)
+  {
+    seq[i] = 0U;
+  }
+  r->head = 0U;
+  r->tail = 0U;
+  r->mask = len - 1U;
+  r->seq = seq;
+  return 0;
+}
+
+uint32_t ring_mpsc_claim(ring_mpsc_t *r, uint32_t n, uint32_t *pos)
+{
+  uint32_t mask = r->mask;
+
+  for (;;)
+  {
+    uint32_t p = r->head;
+    uint32_t lap = p & ~mask;
+    uint32_t end = mask + 1U - (p & mask);
+    uint32_t k = (n < end) ? n : end;
+    int32_t diff;
+
+    if (k == 0U)
+    {
+      return 0U;
+    }
+
+    diff = (int32_t)(r->seq[p & mask] - lap);
+    if (diff < 0)
+    {
+      /* Still holds the previous lap's element */
+      return 0U;
+    }
+    if (diff > 0)
+    {
+      /* Another producer claimed p first */
+      continue;
+    }
+
+    /* Slots are released in order, so the free ones past p are a prefix
+     * of the span; all share p's lap as the span does not wrap */
+    while ((k > 1U) && (r->seq[(p + k - 1U) & mask] != lap))
+    {
+      k--;
+    }
+    if (atomic_cas(&r->head, p, p + k) != 0U)
+    {
+      *pos = p;
+      return k;
+    }
+  }
+}
+
+uint32_t ring_mpsc_read_span(const ring_mpsc_t *r, uint32_t *index)
+{
+  uint32_t tail = r->tail;
+  uint32_t ready = (tail & ~r->mask) + 1U;
+  uint32_t end = r->mask + 1U - (tail & r->mask);
+  uint32_t k = 0U;
+
+  while ((k < end) && (r->seq[(tail + k) & r->mask] == ready))
+  {
+    k++;
+  }
+  atomic_fence();
+  *index = tail & r->mask;
+  return k;
+}
+
+/**
+ * @brief  Up to two spans each way, the second from the array start.
+ */
+uint32_t ring_spsc_push(ring_spsc_t *r, void *buf, uint32_t size,
+                        const void *src, uint32_t n)
+{
+  const uint8_t *s = src;
+  uint32_t done = 0U;
+
+  while (done < n)
+  {
+    uint32_t index;
+    uint32_t k = ring_spsc_write_span(r, &index);
+
+    if (k == 0U)
+    {
+      break;
+    }
+    if (k > n - done)
+    {
+      k = n - done;
+    }
+    memcpy((uint8_t *)buf + index * size, s + done * size, k * size);
+    ring_spsc_commit(r, k);
+    done += k;
+  }
+  return done;
+}
+
+uint32_t ring_spsc_pop(ring_spsc_t *r, const void *buf, uint32_t size,
+                       void *dst, uint32_t n)
+{
+  uint8_t *d = dst;
+  uint32_t done = 0U;
+
+  while (done < n)
+  {
+    uint32_t index;
+    uint32_t k = ring_spsc_read_span(r, &index);
+
+    if (k == 0U)
+    {
+      break;
+    }
+    if (k > n - done)
+    {
+      k = n - done;
+    }
+    memcpy(d + done * size, (const uint8_t *)buf + index * size, k * size);
+    ring_spsc_release(r, k);
+    done += k;
+  }
+  return done;
+}
+
+/**
+ * @brief  Each span is claimed separately, so when a push wraps, another
+ *         producer's elements may land between its two parts.
+ */
+uint32_t ring_mpsc_push(ring_mpsc_t *r, void *buf, uint32_t size,
+                        const void *src, uint32_t n)
+{
+  const uint8_t *s = src;
+  uint32_t done = 0U;
+
+  while (done < n)
+  {
+    uint32_t pos;
+    uint32_t k = ring_mpsc_claim(r, n - done, &pos);
+
+    if (k == 0U)
+    {
+      break;
+    }
+    memcpy((uint8_t *)buf + (pos & r->mask) * size, s + done * size,
+           k * size);
+    ring_mpsc_publish(r, pos, k);
+    done += k;
+  }
+  return done;
+}
+
+uint32_t ring_mpsc_pop(ring_mpsc_t *r, const void *buf, uint32_t size,
+                       void *dst, uint32_t n)
+{
+  uint8_t *d = dst;
+  uint32_t done = 0U;
+
+  while (done < n)
+  {
+    uint32_t index;
+    uint32_t k = ring_mpsc_read_span(r, &index);
+
+    if (k == 0U)
+    {
+      break;
+    }
+    if (k > n - done)
+    {
+      k = n - done;
+    }
+    memcpy(d + done * size, (const uint8_t *)buf + index * size, k * size);
+    ring_mpsc_release(r, k);
+    done += k;
+  }
+  return done;
+}
@@ -0,0 +1,628 @@
+/**
+ ******************************************************************************
+ * @file           : softfloat.c
+ * @brief          : Single-precision soft-float runtime using UMULL, UDIV and
+ *                   CLZ
+ ******************************************************************************
+ */
+
+#pragma GCC optimize ("O2")
+
+/* Includes */
+#include "softfloat.h"
+
+#define SF_SIGN           0x80000000UL
+#define SF_INF            0x7F800000UL
+#define SF_FRAC           0x007FFFFFUL
+#define SF_HIDDEN         0x00800000UL
+#define SF_QUIET          0x00400000UL
+#define SF_DEFAULT_NAN    0x7FC00000UL
+
+#define SF_ALIAS(f)       __attribute__((alias(#f)))
+
+typedef union
+{
+  float f;
+  uint32_t u;
+} sf_bits_t;
+
+/* Functions */
+static inline uint32_t sf_bits(float f)
+{
+  sf_bits_t v;
+
+  v.f = f;
+  return v.u;
+}
+
+static inline float sf_float(uint32_t u)
+{
+  sf_bits_t v;
+
+  v.u = u;
+  return v.f;
+}
+
+static inline int sf_isnan(uint32_t a)
+{
+  return (a & ~SF_SIGN) > SF_INF;
+}
+
+/**
+ * Round to nearest even and pack. `m` holds the significand with its
+ * leading one at bit 31, `e` the biased exponent of that leading one, and
+ * `sticky` is non-zero if any bits below `m` were lost.
+ */
+static uint32_t sf_pack(uint32_t sign, int32_t e, uint32_t m, uint32_t sticky)
+{
+  uint32_t r;
+
+  if (e >= 0xFF)
+  {
+    return sign | SF_INF;
+  }
+  if (e <= 0)
+  {
+    uint32_t shift = (uint32_t)(1 - e);
+
+    if (shift >= 32U)
+    {
+      sticky |= m;
+      m = 0;
+    }
+    else
+    {
+      sticky |= m << (32U - shift);
+      m >>= shift;
+    }
+    e = 1;
+  }
+
+  r = m & 0xFFU;
+  m >>= 8;
+  if ((r > 0x80U) || ((r == 0x80U) && ((sticky != 0U) || (m & 1U))))
+  {
+    m++;
+  }
+  /* A carry out of the significand moves into the exponent field, up to
+   * infinity; a subnormal that rounds up becomes the smallest normal. */
+  return sign | ((((uint32_t)e - 1U) << 23) + m);
+}
+
+#if SOFTFLOAT_MULDIV || SOFTFLOAT_SQRT
+/* Significand with the hidden bit at 23, subnormals normalised */
+static int32_t sf_unpack(uint32_t a, uint32_t *m)
+{
+  int32_t e = (int32_t)((a >> 23) & 0xFFU);
+
+  *m = a & SF_FRAC;
+  if (e == 0)
+  {
+    uint32_t shift = (uint32_t)__builtin_clz(*m) - 8U;
+
+    *m <<= shift;
+    return 1 - (int32_t)shift;
+  }
+  *m |= SF_HIDDEN;
+  return e;
+}
+#endif
+
+#if SOFTFLOAT_ADDSUB
+static uint32_t sf_from_u32(uint32_t sign, uint32_t u)
+{
+  uint32_t shift;
+
+  if (u == 0U)
+  {
+    return 0;
+  }
+  shift = (uint32_t)__builtin_clz(u);
+  return sf_pack(sign, 158 - (int32_t)shift, u << shift, 0);
+}
+
+static uint32_t sf_from_u64(uint32_t sign, uint64_t u)
+{
+  uint32_t shift;
+
+  if ((u >> 32) == 0U)
+  {
+    return sf_from_u32(sign, (uint32_t)u);
+  }
+  shift = (uint32_t)__builtin_clz((uint32_t)(u >> 32));
+  u <<= shift;
+  return sf_pack(sign, 190 - (int32_t)shift, (uint32_t)(u >> 32), (uint32_t)u);
+}
+
+static uint32_t sf_add(uint32_t a, uint32_t b)
+{
+  uint32_t sign;
+  uint32_t ma;
+  uint32_t mb;
+  uint32_t m;
+  int32_t ea;
+  int32_t eb;
+  int32_t d;
+  uint32_t shift;
+
+  if ((a & ~SF_SIGN) < (b & ~SF_SIGN))
+  {
+    uint32_t t = a;
+
+    a = b;
+    b = t;
+  }
+  ea = (int32_t)((a >> 23) & 0xFFU);
+  eb = (int32_t)((b >> 23) & 0xFFU);
+
+  if (ea == 0xFF)
+  {
+    if (a & SF_FRAC)
+    {
+      return a | SF_QUIET;
+    }
+    if ((eb == 0xFF) && ((a ^ b) & SF_SIGN))
+    {
+      return SF_DEFAULT_NAN;          /* inf - inf */
+    }
+    return a;
+  }
+  if ((b & ~SF_SIGN) == 0U)
+  {
+    return ((a & ~SF_SIGN) == 0U) ? (a & b) : a;
+  }
+
+  sign = a & SF_SIGN;
+  ma = a & SF_FRAC;
+  mb = b & SF_FRAC;
+  if (ea == 0)
+  {
+    ea = 1;
+  }
+  else
+  {
+    ma |= SF_HIDDEN;
+  }
+  if (eb == 0)
+  {
+    eb = 1;
+  }
+  else
+  {
+    mb |= SF_HIDDEN;
+  }
+
+  /* Seven guard bits; bits shifted out of b are jammed into bit 0 */
+  ma <<= 7;
+  mb <<= 7;
+  d = ea - eb;
+  if (d >= 31)
+  {
+    mb = 1;
+  }
+  else if (d > 0)
+  {
+    mb = (mb >> d) | ((mb << (32 - d)) != 0U);
+  }
+
+  if ((a ^ b) & SF_SIGN)
+  {
+    m = ma - mb;
+    if (m == 0U)
+    {
+      return 0;
+    }
+  }
+  else
+  {
+    m = ma + mb;
+  }
+  shift = (uint32_t)__builtin_clz(m);
+  return sf_pack(sign, ea + 1 - (int32_t)shift, m << shift, 0);
+}
+#endif
+
+#if SOFTFLOAT_MULDIV
+static uint32_t sf_mul(uint32_t a, uint32_t b)
+{
+  uint32_t sign = (a ^ b) & SF_SIGN;
+  uint32_t ma;
+  uint32_t mb;
+  int32_t ea;
+  int32_t eb;
+  uint64_t p;
+
+  if (((a & SF_INF) == SF_INF) || ((b & SF_INF) == SF_INF))
+  {
+    if (sf_isnan(a))
+    {
+      return a | SF_QUIET;
+    }
+    if (sf_isnan(b))
+    {
+      return b | SF_QUIET;
+    }
+    if (((a & ~SF_SIGN) == 0U) || ((b & ~SF_SIGN) == 0U))
+    {
+      return SF_DEFAULT_NAN;          /* inf * 0 */
+    }
+    return sign | SF_INF;
+  }
+  if (((a & ~SF_SIGN) == 0U) || ((b & ~SF_SIGN) == 0U))
+  {
+    return sign;
+  }
+
+  ea = sf_unpack(a, &ma);
+  eb = sf_unpack(b, &mb);
+  p = (uint64_t)ma * mb;            /* UMULL, 2^46 <= p < 2^48 */
+  if (p >> 47)
+  {
+    return sf_pack(sign, ea + eb - 126, (uint32_t)(p >> 16),
+                   (uint32_t)p & 0xFFFFU);
+  }
+  return sf_pack(sign, ea + eb - 127, (uint32_t)(p >> 15),
+                 (uint32_t)p & 0x7FFFU);
+}
+
+static uint32_t sf_div(uint32_t a, uint32_t b)
+{
+  uint32_t sign = (a ^ b) & SF_SIGN;
+  uint32_t ma;
+  uint32_t mb;
+  uint32_t q;
+  uint32_t r;
+  int32_t ea;
+  int32_t eb;
+
+  if (sf_isnan(a))
+  {
+    return a | SF_QUIET;
+  }
+  if (sf_isnan(b))
+  {
+    return b | SF_QUIET;
+  }
+  if ((a & SF_INF) == SF_INF)
+  {
+    return ((b & SF_INF) == SF_INF) ? SF_DEFAULT_NAN : (sign | SF_INF);
+  }
+  if ((b & SF_INF) == SF_INF)
+  {
+    return sign;
+  }
+  if ((b & ~SF_SIGN) == 0U)
+  {
+    return ((a & ~SF_SIGN) == 0U) ? SF_DEFAULT_NAN : (sign | SF_INF);
+  }
+  if ((a & ~SF_SIGN) == 0U)
+  {
+    return sign;
+  }
+
+  ea = sf_unpack(a, &ma);
+  eb = sf_unpack(b, &mb);
+  if (ma < mb)
+  {
+    ma <<= 1;
+    ea--;
+  }
+
+  /* Integer bit 1, then 24 fraction bits, eight per UDIV; the remainder
+   * stays below mb < 2^24, so each shifted dividend fits 32 bits. */
+  q = 1;
+  r = ma - mb;
+  for (uint32_t i = 0; i < 3U; i++)
+  {
+    uint32_t digit;
+
+    r <<= 8;
+    digit = r / mb;
+    r -= digit * mb;
+    q = (q << 8) | digit;
+  }
+  return sf_pack(sign, ea - eb + 127, q << 7, r);
+}
+#endif
+
+#if SOFTFLOAT_CMP
+/* Ordering: -1, 0, 1, or 2 when unordered */
+static int sf_cmp(uint32_t a, uint32_t b)
+{
+  int32_t ka;
+  int32_t kb;
+
+  if (sf_isnan(a) || sf_isnan(b))
+  {
+    return 2;
+  }
+  if (((a | b) & ~SF_SIGN) == 0U)
+  {
+    return 0;
+  }
+  ka = (a & SF_SIGN) ? (int32_t)(SF_SIGN - a) : (int32_t)a;
+  kb = (b & SF_SIGN) ? (int32_t)(SF_SIGN - b) : (int32_t)b;
+  return (ka < kb) ? -1 : (ka > kb);
+}
+#endif
+
+#if SOFTFLOAT_MULDIV
+float __aeabi_fmul(float a, float b)
+{
+  return sf_float(sf_mul(sf_bits(a), sf_bits(b)));
+}
+
+float __aeabi_fdiv(float a, float b)
+{
+  return sf_float(sf_div(sf_bits(a), sf_bits(b)));
+}
+
+float __mulsf3(float a, float b) SF_ALIAS(__aeabi_fmul);
+float __divsf3(float a, float b) SF_ALIAS(__aeabi_fdiv);
+#endif
+
+#if SOFTFLOAT_SQRT
+/* 1/sqrt(x) in Q16 at the centre of each 1/32 step of x in [1, 4) */
+static const uint16_t sf_rsqrt_table[96] = {
+  65030, 64052, 63117, 62222, 61363, 60540, 59748, 58987,
+  58254, 57548, 56867, 56210, 55574, 54960, 54366, 53791,
+  53233, 52693, 52169, 51660, 51165, 50685, 50218, 49763,
+  49321, 48890, 48470, 48061, 47663, 47273, 46894, 46523,
+  46161, 45807, 45462, 45124, 44793, 44470, 44153, 43843,
+  43540, 43243, 42951, 42666, 42386, 42112, 41843, 41579,
+  41320, 41065, 40816, 40571, 40330, 40093, 39861, 39632,
+  39408, 39187, 38970, 38756, 38546, 38340, 38136, 37936,
+  37739, 37545, 37354, 37166, 36980, 36798, 36618, 36441,
+  36266, 36093, 35924, 35756, 35591, 35428, 35267, 35109,
+  34953, 34798, 34646, 34496, 34347, 34201, 34056, 33913,
+  33772, 33633, 33496, 33360, 33225, 33093, 32962, 32832,
+};
+
+float sqrtf(float f)
+{
+  uint32_t a = sf_bits(f);
+  uint32_t m;
+  uint32_t x;
+  uint32_t r;
+  uint32_t y;
+  uint64_t target;
+  uint64_t sq;
+  int32_t e;
+
+  if (sf_isnan(a))
+  {
+    return sf_float(a | SF_QUIET);
+  }
+  if ((a & ~SF_SIGN) == 0U)
+  {
+    return f;                         /* sqrt(-0) = -0 */
+  }
+  if (a & SF_SIGN)
+  {
+    return sf_float(SF_DEFAULT_NAN);
+  }
+  if (a == SF_INF)
+  {
+    return f;
+  }
+
+  /* x = m / 2^23 in [1, 4) with an even exponent left over */
+  e = sf_unpack(a, &m) - 127;
+  if (e & 1)
+  {
+    m <<= 1;
+    e--;
+  }
+  x = m << 7;                         /* Q30 */
+
+  /* 1/sqrt(x) in Q31: about 7 bits from the table, ~26 after two Newton
+   * steps r' = r * (3 - x * r^2) / 2 */
+  r = (uint32_t)sf_rsqrt_table[(x >> 25) - 32U] << 15;
+  for (uint32_t i = 0; i < 2U; i++)
+  {
+    uint32_t r2 = (uint32_t)(((uint64_t)r * r) >> 32);              /* Q30 */
+    uint32_t xr2 = (uint32_t)(((uint64_t)x * r2) >> 30);            /* Q30 */
+
+    r = (uint32_t)(((uint64_t)r * (0xC0000000UL - xr2)) >> 31);
+  }
+
+  /* sqrt(x) = x / sqrt(x) with 24 fraction bits; fix the last unit against
+   * the exact square so y = floor(sqrt(m * 2^25)) */
+  y = (uint32_t)(((uint64_t)x * r) >> 37);
+  target = (uint64_t)m << 25;
+  sq = (uint64_t)y * y;
+  while (sq > target)
+  {
+    y--;
+    sq = (uint64_t)y * y;
+  }
+  while (sq + 2U * y + 1U <= target)
+  {
+    sq += 2U * y + 1U;
+    y++;
+  }
+  return sf_float(sf_pack(0, (e >> 1) + 127, y << 7, (uint32_t)(sq != target)));
+}
+#endif
+
+#if SOFTFLOAT_ADDSUB
+float __aeabi_fadd(float a, float b)
+{
+  return sf_float(sf_add(sf_bits(a), sf_bits(b)));
+}
+
+float __aeabi_fsub(float a, float b)
+{
+  return sf_float(sf_add(sf_bits(a), sf_bits(b) ^ SF_SIGN));
+}
+
+float __aeabi_frsub(float a, float b)
+{
+  return sf_float(sf_add(sf_bits(b), sf_bits(a) ^ SF_SIGN));
+}
+
+float __aeabi_ui2f(uint32_t x)
+{
+  return sf_float(sf_from_u32(0, x));
+}
+
+float __aeabi_i2f(int32_t x)
+{
+  return sf_float((x < 0) ? sf_from_u32(SF_SIGN, 0U - (uint32_t)x)
+                          : sf_from_u32(0, (uint32_t)x));
+}
+
+float __aeabi_ul2f(uint64_t x)
+{
+  return sf_float(sf_from_u64(0, x));
+}
+
+float __aeabi_l2f(int64_t x)
+{
+  return sf_float((x < 0) ? sf_from_u64(SF_SIGN, 0U - (uint64_t)x)
+                          : sf_from_u64(0, (uint64_t)x));
+}
+
+float __addsf3(float a, float b) SF_ALIAS(__aeabi_fadd);
+float __subsf3(float a, float b) SF_ALIAS(__aeabi_fsub);
+float __floatunsisf(uint32_t x) SF_ALIAS(__aeabi_ui2f);
+float __floatsisf(int32_t x) SF_ALIAS(__aeabi_i2f);
+float __floatundisf(uint64_t x) SF_ALIAS(__aeabi_ul2f);
+float __floatdisf(int64_t x) SF_ALIAS(__aeabi_l2f);
+#endif
+
+#if SOFTFLOAT_CMP
+int __aeabi_fcmpeq(float a, float b)
+{
+  return sf_cmp(sf_bits(a), sf_bits(b)) == 0;
+}
+
+int __aeabi_fcmplt(float a, float b)
+{
+  return sf_cmp(sf_bits(a), sf_bits(b)) == -1;
+}
+
+int __aeabi_fcmple(float a, float b)
+{
+  return (uint32_t)(sf_cmp(sf_bits(a), sf_bits(b)) + 1) <= 1U;
+}
+
+int __aeabi_fcmpge(float a, float b)
+{
+  return (uint32_t)sf_cmp(sf_bits(a), sf_bits(b)) <= 1U;
+}
+
+int __aeabi_fcmpgt(float a, float b)
+{
+  return sf_cmp(sf_bits(a), sf_bits(b)) == 1;
+}
+
+int __aeabi_fcmpun(float a, float b)
+{
+  return sf_cmp(sf_bits(a), sf_bits(b)) == 2;
+}
+
+/* GCC's libgcc2 names: unordered must make the tested relation false */
+int __lesf2(float a, float b)
+{
+  return sf_cmp(sf_bits(a), sf_bits(b));
+}
+
+int __gesf2(float a, float b)
+{
+  int c = sf_cmp(sf_bits(a), sf_bits(b));
+
+  return (c == 2) ? -1 : c;
+}
+
+int __unordsf2(float a, float b)
+{
+  return sf_cmp(sf_bits(a), sf_bits(b)) == 2;
+}
+
+int __ltsf2(float a, float b) SF_ALIAS(__lesf2);
+int __cmpsf2(float a, float b) SF_ALIAS(__lesf2);
+int __eqsf2(float a, float b) SF_ALIAS(__lesf2);
+int __nesf2(float a, float b) SF_ALIAS(__lesf2);
+int __gtsf2(float a, float b) SF_ALIAS(__gesf2);
+
+#if defined(__arm__)
+/* Flag-returning compares: Z set when equal, C clear when a < b; every core
+ * register other than ip and lr is preserved. */
+__attribute__((used, noipa)) static uint32_t sf_cmp_flags(uint32_t a, uint32_t b)
+{
+  return (uint32_t)(sf_cmp(a, b) + 1);
+}
+
+__attribute__((naked)) void __aeabi_cfcmple(void)
+{
+  __asm volatile (
+    "push   {r0-r3, r12, lr}\n\t"
+    "bl     sf_cmp_flags\n\t"
+    "cmp    r0, #1\n\t"
+    "pop    {r0-r3, r12, pc}");
+}
+
+__attribute__((naked)) void __aeabi_cfcmpeq(void)
+{
+  __asm volatile (
+    "push   {r0-r3, r12, lr}\n\t"
+    "bl     sf_cmp_flags\n\t"
+    "cmp    r0, #1\n\t"
+    "pop    {r0-r3, r12, pc}");
+}
+
+__attribute__((naked)) void __aeabi_cfrcmple(void)
+{
+  __asm volatile (
+    "push   {r0-r3, r12, lr}\n\t"
+    "mov    r2, r0\n\t"
+    "mov    r0, r1\n\t"
+    "mov    r1, r2\n\t"
+    "bl     sf_cmp_flags\n\t"
+    "cmp    r0, #1\n\t"
+    "pop    {r0-r3, r12, pc}");
+}
+#endif
+#endif
+
+#if SOFTFLOAT_FIX
+int32_t __aeabi_f2iz(float f)
+{
+  uint32_t a = sf_bits(f);
+  int32_t e = (int32_t)((a >> 23) & 0xFFU);
+  uint32_t m = (a & SF_FRAC) | SF_HIDDEN;
+  uint32_t v;
+
+  if (sf_isnan(a) || (e < 127))
+  {
+    return 0;
+  }
+  if (e >= 127 + 31)
+  {
+    return (a & SF_SIGN) ? INT32_MIN : INT32_MAX;
+  }
+  v = (e >= 150) ? (m << (e - 150)) : (m >> (150 - e));
+  return (a & SF_SIGN) ? -(int32_t)v : (int32_t)v;
+}
+
+uint32_t __aeabi_f2uiz(float f)
+{
+  uint32_t a = sf_bits(f);
+  int32_t e = (int32_t)((a >> 23) & 0xFFU);
+  uint32_t m = (a & SF_FRAC) | SF_HIDDEN;
+
+  if (sf_isnan(a) || (a & SF_SIGN) || (e < 127))
+  {
+    return 0;
+  }
+  if (e >= 127 + 32)
+  {
+    return 0xFFFFFFFFUL;
+  }
+  return (e >= 150) ? (m << (e - 150)) : (m >> (150 - e));
+}
+
+int32_t __fixsfsi(float f) SF_ALIAS(__aeabi_f2iz);
+uint32_t __fixunssfsi(float f) SF_ALIAS(__aeabi_f2uiz);
+#endif
@@ -0,0 +1,65 @@
+/**
+ ******************************************************************************
+ * @file           : systick.c
+ * @brief          : SysTick time base and tick hooks
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "stm32f1xx.h"
+#include "systick.h"
+
+/* Variables */
+static volatile uint32_t systick_count;
+
+/* Functions */
+static void systick_default_hook(void)
+{
+}
+
+static void systick_default_skip(uint32_t ticks)
+{
+  (void)ticks;
+}
+
+void kernel_tick(void) __attribute__((weak, alias("systick_default_hook")));
+void coro_tick(void) __attribute__((weak, alias("systick_default_hook")));
+void wheel_tick(void) __attribute__((weak, alias("systick_default_hook")));
+void wheel_advance(uint32_t ticks) __attribute__((weak, alias("systick_default_skip")));
+
+void systick_init(void)
+{
+  SysTick->CTRL = 0U;
+  SysTick->LOAD = (uint32_t)(SYSTICK_CORE_HZ / SYSTICK_HZ) - 1U;
+  SysTick->VAL = 0U;
+  NVIC_SetPriority(SysTick_IRQn, (1UL << __NVIC_PRIO_BITS) - 1UL);
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk |
+                  SysTick_CTRL_ENABLE_Msk;
+}
+
+uint32_t systick_ticks(void)
+{
+  return systick_count;
+}
+
+void systick_advance(uint32_t ticks)
+{
+  if (ticks == 0U)
+  {
+    return;
+  }
+
+  /* The other hooks compare against the count, so once is enough */
+  systick_count += ticks;
+  kernel_tick();
+  coro_tick();
+  wheel_advance(ticks);
+}
+
+void SysTick_Handler(void)
+{
+  systick_count++;
+  kernel_tick();
+  coro_tick();
+  wheel_tick();
+}
@@ -0,0 +1,226 @@
+/**
+ ******************************************************************************
+ * @file           : tim.c
+ * @brief          : TIM1..TIM4 interrupt ownership and dispatch
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include "bitband.h"
+#include "idle.h"
+#include "tim.h"
+
+#define TIM_COUNT         4U
+
+/* DIER bits 0-7 enable the interrupts of SR bits 0-7; above them DIER holds
+ * the DMA request enables and SR the overcapture flags */
+#define TIM_DIER_IRQ_MASK 0xFFU
+
+typedef struct
+{
+  tim_callback_t cb;
+  void *ctx;
+  const uint32_t *frame;    /* of the interrupt being dispatched */
+  uint8_t owned;
+} tim_owner_t;
+
+/* The vectors are stubs that find the frame the interrupt stacked, on the
+ * MSP or the PSP as EXC_RETURN in lr says, and branch on with it and lr
+ * untouched to the C entry, which returns from the exception */
+#define TIM_VECTOR(vector, entry) \
+  void vector(void) __attribute__((naked)); \
+  void vector(void) \
+  { \
+    __asm volatile \
+    ( \
+      "  tst     lr, #4                         \n" \
+      "  ite     eq                             \n" \
+      "  mrseq   r0, msp                        \n" \
+      "  mrsne   r0, psp                        \n" \
+      "  b       " #entry "                     \n" \
+    ); \
+  }
+
+/* Variables */
+static tim_owner_t tim_owner[TIM_COUNT];
+
+/* Functions */
+static int tim_index(const TIM_TypeDef *tim)
+{
+  if (tim == TIM1)
+  {
+    return 0;
+  }
+  if (tim == TIM2)
+  {
+    return 1;
+  }
+  if (tim == TIM3)
+  {
+    return 2;
+  }
+  if (tim == TIM4)
+  {
+    return 3;
+  }
+  return -1;
+}
+
+static void tim_irq_enable(int idx, int enable)
+{
+  static const IRQn_Type irqs[TIM_COUNT] = { TIM1_UP_IRQn, TIM2_IRQn,
+                                             TIM3_IRQn, TIM4_IRQn };
+
+  if (enable)
+  {
+    NVIC_SetPriority(irqs[idx], TIM_IRQ_PRIO);
+    NVIC_EnableIRQ(irqs[idx]);
+    if (idx == 0)
+    {
+      NVIC_SetPriority(TIM1_CC_IRQn, TIM_IRQ_PRIO);
+      NVIC_EnableIRQ(TIM1_CC_IRQn);
+    }
+  }
+  else
+  {
+    NVIC_DisableIRQ(irqs[idx]);
+    if (idx == 0)
+    {
+      NVIC_DisableIRQ(TIM1_CC_IRQn);
+    }
+  }
+}
+
+void tim_enable_clock(const TIM_TypeDef *tim)
+{
+  switch (tim_index(tim))
+  {
+    case 0:
+      BB_PERIPH(RCC->APB2ENR, RCC_APB2ENR_TIM1EN_Pos) = 1U;
+      break;
+    case 1:
+      BB_PERIPH(RCC->APB1ENR, RCC_APB1ENR_TIM2EN_Pos) = 1U;
+      break;
+    case 2:
+      BB_PERIPH(RCC->APB1ENR, RCC_APB1ENR_TIM3EN_Pos) = 1U;
+      break;
+    case 3:
+      BB_PERIPH(RCC->APB1ENR, RCC_APB1ENR_TIM4EN_Pos) = 1U;
+      break;
+    default:
+      break;
+  }
+  (void)RCC->APB1ENR;   /* let the enable settle before the first access */
+}
+
+int tim_claim(TIM_TypeDef *tim, tim_callback_t cb, void *ctx)
+{
+  int idx = tim_index(tim);
+  crit_t crit;
+  int ret = -1;
+
+  if (idx < 0)
+  {
+    return -1;
+  }
+
+  crit = crit_enter(TIM_IRQ_PRIO);
+  if (!tim_owner[idx].owned)
+  {
+    tim_owner[idx].owned = 1U;
+    tim_owner[idx].cb = cb;
+    tim_owner[idx].ctx = ctx;
+    ret = 0;
+  }
+  crit_exit(crit);
+
+  if (ret == 0)
+  {
+    tim_enable_clock(tim);
+    if (cb != NULL)
+    {
+      tim_irq_enable(idx, 1);
+    }
+    idle_inhibit();
+  }
+  return ret;
+}
+
+void tim_release(TIM_TypeDef *tim)
+{
+  int idx = tim_index(tim);
+
+  if (idx < 0)
+  {
+    return;
+  }
+  tim_irq_enable(idx, 0);
+  tim->DIER = 0;
+  if (tim_owner[idx].owned)
+  {
+    tim_owner[idx].cb = NULL;
+    tim_owner[idx].owned = 0U;
+    idle_allow();
+  }
+}
+
+const uint32_t *tim_frame(const TIM_TypeDef *tim)
+{
+  int idx = tim_index(tim);
+
+  return (idx < 0) ? NULL : tim_owner[idx].frame;
+}
+
+static void tim_dispatch(TIM_TypeDef *tim, uint32_t idx, uint32_t sources,
+                         const uint32_t *frame)
+{
+  uint32_t sr = tim->SR & (tim->DIER & TIM_DIER_IRQ_MASK) & sources;
+  tim_owner_t *o = &tim_owner[idx];
+
+  tim->SR = ~sr;
+  o->frame = frame;
+  if (o->cb != NULL)
+  {
+    o->cb(sr, o->ctx);
+  }
+}
+
+/* Not static: the vector stubs branch to them by name */
+void tim1_up_entry(const uint32_t *frame);
+void tim1_cc_entry(const uint32_t *frame);
+void tim2_entry(const uint32_t *frame);
+void tim3_entry(const uint32_t *frame);
+void tim4_entry(const uint32_t *frame);
+
+void tim1_up_entry(const uint32_t *frame)
+{
+  tim_dispatch(TIM1, 0, TIM_SR_UIF, frame);
+}
+
+void tim1_cc_entry(const uint32_t *frame)
+{
+  tim_dispatch(TIM1, 0, TIM_SR_CC1IF | TIM_SR_CC2IF | TIM_SR_CC3IF |
+                        TIM_SR_CC4IF, frame);
+}
+
+void tim2_entry(const uint32_t *frame)
+{
+  tim_dispatch(TIM2, 1, 0xFFFFU, frame);
+}
+
+void tim3_entry(const uint32_t *frame)
+{
+  tim_dispatch(TIM3, 2, 0xFFFFU, frame);
+}
+
+void tim4_entry(const uint32_t *frame)
+{
+  tim_dispatch(TIM4, 3, 0xFFFFU, frame);
+}
+
+TIM_VECTOR(TIM1_UP_IRQHandler, tim1_up_entry)
+TIM_VECTOR(TIM1_CC_IRQHandler, tim1_cc_entry)
+TIM_VECTOR(TIM2_IRQHandler, tim2_entry)
+TIM_VECTOR(TIM3_IRQHandler, tim3_entry)
+TIM_VECTOR(TIM4_IRQHandler, tim4_entry)
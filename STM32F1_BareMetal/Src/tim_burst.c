@@ -0,0 +1,276 @@
+/**
+ ******************************************************************************
+ * @file           : tim_burst.c
+ * @brief          : Timer DMA burst waveform engine (TIMx->DCR/DMAR)
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stddef.h>
+#include <string.h>
+#include "bitband.h"
+#include "dma.h"
+#include "tim_burst.h"
+
+#define BURST_IDLE        0U
+#define BURST_RUNNING     1U
+#define BURST_DRAINING    2U
+
+#define PWM3_120_DEG      0x55555555UL   /* 2^32 / 3 */
+
+/* Functions */
+static uint32_t tim_up_dma_channel(const TIM_TypeDef *tim)
+{
+  if (tim == TIM1)
+  {
+    return 5U;
+  }
+  if (tim == TIM2)
+  {
+    return 2U;
+  }
+  if (tim == TIM3)
+  {
+    return 3U;
+  }
+  if (tim == TIM4)
+  {
+    return 7U;
+  }
+  return 0U;
+}
+
+/* Produce the half buffer starting at `half`, handling end of stream;
+ * returns the frames produced */
+static uint32_t burst_refill(tim_burst_t *b, uint32_t half)
+{
+  uint32_t words = (uint32_t)b->frames * b->regs;
+  uint16_t *dst = b->buf + half * words;
+  uint32_t n = 0;
+
+  if (b->state == BURST_RUNNING)
+  {
+    n = b->fill(dst, b->frames, b->ctx);
+    if (n < b->frames)
+    {
+      /* Output the partial half, then one full half of zeros, then stop */
+      b->state = BURST_DRAINING;
+      b->drain = 3U;
+    }
+  }
+  if (n < b->frames)
+  {
+    memset(dst + n * b->regs, 0, (b->frames - n) * b->regs * sizeof(uint16_t));
+  }
+  b->blocks++;
+  return n;
+}
+
+static void burst_dma_event(uint32_t events, void *ctx)
+{
+  tim_burst_t *b = ctx;
+
+  if (events & DMA_EVT_TE)
+  {
+    tim_burst_stop(b);
+    return;
+  }
+  if ((b->state == BURST_DRAINING) && (--b->drain == 0U))
+  {
+    tim_burst_stop(b);
+    return;
+  }
+  if (events & DMA_EVT_HT)
+  {
+    (void)burst_refill(b, 0);
+  }
+  if (events & DMA_EVT_TC)
+  {
+    (void)burst_refill(b, 1);
+  }
+}
+
+/**
+ * @brief  Describe a burst stream.
+ * @param  b         Engine state
+ * @param  tim       TIM1..TIM4
+ * @param  first_reg Offset of the first register of each burst, e.g.
+ *                   TIM_BURST_CCR1
+ * @param  regs      Consecutive registers per frame
+ * @param  buf       Frame buffer of 2 * frames * regs halfwords
+ * @param  frames    Frames per half buffer
+ * @param  fill      Frame producer
+ * @param  ctx       Passed to fill
+ * @retval 0 on success, -1 on invalid arguments
+ */
+int tim_burst_init(tim_burst_t *b, TIM_TypeDef *tim, uint32_t first_reg,
+                   uint32_t regs, uint16_t *buf, uint32_t frames,
+                   tim_burst_fill_t fill, void *ctx)
+{
+  uint32_t ch = tim_up_dma_channel(tim);
+
+  if ((ch == 0U) || (regs == 0U) || (regs > 18U) || (first_reg & 3U) ||
+      (first_reg / 4U + regs > offsetof(TIM_TypeDef, DCR) / 4U) ||
+      (frames == 0U) || (2U * frames * regs > 0xFFFFU) || (fill == NULL))
+  {
+    return -1;
+  }
+
+  b->tim = tim;
+  b->dma_ch = ch;
+  b->buf = buf;
+  b->regs = (uint16_t)regs;
+  b->frames = (uint16_t)frames;
+  b->fill = fill;
+  b->ctx = ctx;
+  b->state = BURST_IDLE;
+  b->blocks = 0;
+
+  tim->DCR = ((regs - 1U) << TIM_DCR_DBL_Pos) |
+             ((first_reg / 4U) << TIM_DCR_DBA_Pos);
+  return 0;
+}
+
+/**
+ * @brief  Prefill both halves and start streaming on the next update event.
+ * @retval 0 on success, -1 if the DMA channel is owned by another driver
+ */
+int tim_burst_start(tim_burst_t *b)
+{
+  DMA_Channel_TypeDef *dma = dma_channel(b->dma_ch);
+  uint32_t first;
+
+  if (dma_claim(b->dma_ch, burst_dma_event, b) != 0)
+  {
+    return -1;
+  }
+
+  b->state = BURST_RUNNING;
+  first = burst_refill(b, 0);
+  (void)burst_refill(b, 1);
+
+  dma->CPAR = (uint32_t)&b->tim->DMAR;
+  dma->CMAR = (uint32_t)b->buf;
+  if (first < b->frames)
+  {
+    /* The whole stream fits the first half: send it and one half of zero
+     * frames straight through, and stop at the end */
+    b->drain = 1U;
+    dma->CNDTR = (first + b->frames) * b->regs;
+    dma->CCR = DMA_CCR_PL_1 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 |
+               DMA_CCR_MINC | DMA_CCR_DIR |
+               DMA_CCR_TEIE | DMA_CCR_TCIE | DMA_CCR_EN;
+  }
+  else
+  {
+    dma->CNDTR = 2U * b->frames * b->regs;
+    dma->CCR = DMA_CCR_PL_1 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 |
+               DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_DIR |
+               DMA_CCR_TEIE | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+  }
+
+  b->tim->SR = ~TIM_SR_UIF;
+  BB_PERIPH(b->tim->DIER, TIM_DIER_UDE_Pos) = 1U;
+  BB_PERIPH(b->tim->CR1, TIM_CR1_CEN_Pos) = 1U;
+  return 0;
+}
+
+/**
+ * @brief  Stop streaming and park the burst registers at zero.
+ */
+void tim_burst_stop(tim_burst_t *b)
+{
+  __IO uint32_t *reg;
+
+  if (b->state == BURST_IDLE)
+  {
+    return;
+  }
+  BB_PERIPH(b->tim->DIER, TIM_DIER_UDE_Pos) = 0U;
+  dma_release(b->dma_ch);
+
+  reg = (__IO uint32_t *)((uint32_t)b->tim +
+                          ((b->tim->DCR & TIM_DCR_DBA) >> TIM_DCR_DBA_Pos) * 4U);
+  for (uint32_t i = 0; i < b->regs; i++)
+  {
+    reg[i] = 0;
+  }
+  b->state = BURST_IDLE;
+}
+
+int tim_burst_busy(const tim_burst_t *b)
+{
+  return b->state != BURST_IDLE;
+}
+
+/**
+ * @brief  Edge-aligned PWM with preloaded compare registers, as needed for
+ *         burst updates to take effect atomically at the next period.
+ * @param  channels Bit n set enables channel n + 1
+ */
+void tim_burst_pwm_setup(TIM_TypeDef *tim, uint32_t psc, uint32_t arr,
+                         uint32_t channels)
+{
+  /* PWM mode 1 with preload, per 8-bit CCMR half */
+  const uint32_t oc = TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1PE;
+
+  tim->CR1 = TIM_CR1_ARPE;
+  tim->PSC = psc;
+  tim->ARR = arr;
+  tim->CCMR1 = ((channels & 1U) ? oc : 0U) | ((channels & 2U) ? oc << 8 : 0U);
+  tim->CCMR2 = ((channels & 4U) ? oc : 0U) | ((channels & 8U) ? oc << 8 : 0U);
+  tim->CCR1 = 0;
+  tim->CCR2 = 0;
+  tim->CCR3 = 0;
+  tim->CCR4 = 0;
+  tim->CCER = ((channels & 1U) ? TIM_CCER_CC1E : 0U) |
+              ((channels & 2U) ? TIM_CCER_CC2E : 0U) |
+              ((channels & 4U) ? TIM_CCER_CC3E : 0U) |
+              ((channels & 8U) ? TIM_CCER_CC4E : 0U);
+  if (tim == TIM1)
+  {
+    tim->BDTR |= TIM_BDTR_MOE;
+  }
+  tim->EGR = TIM_EGR_UG;
+}
+
+/**
+ * @brief  Fill callback for a tim_burst_ws2812_t stream (one register per
+ *         frame, one frame per data bit).
+ */
+uint32_t tim_burst_ws2812_fill(uint16_t *buf, uint32_t frames, void *ctx)
+{
+  tim_burst_ws2812_t *s = ctx;
+  uint32_t bits = s->len * 8U;
+  uint32_t n = 0;
+
+  while ((n < frames) && (s->pos < bits))
+  {
+    uint8_t byte = s->data[s->pos >> 3];
+
+    buf[n++] = (byte & (0x80U >> (s->pos & 7U))) ? s->t1h : s->t0h;
+    s->pos++;
+  }
+  return n;
+}
+
+/**
+ * @brief  Fill callback for a tim_burst_pwm3_t stream (three registers per
+ *         frame). Never ends the stream.
+ */
+uint32_t tim_burst_pwm3_fill(uint16_t *buf, uint32_t frames, void *ctx)
+{
+  tim_burst_pwm3_t *s = ctx;
+  uint32_t shift = 32U - s->table_log2;
+  uint32_t phase = s->phase;
+
+  for (uint32_t n = 0; n < frames; n++)
+  {
+    *buf++ = s->table[phase >> shift];
+    *buf++ = s->table[(phase + PWM3_120_DEG) >> shift];
+    *buf++ = s->table[(phase + 2U * PWM3_120_DEG) >> shift];
+    phase += s->step;
+  }
+  s->phase = phase;
+  return frames;
+}
@@ -0,0 +1,110 @@
+/**
+ ******************************************************************************
+ * @file           : vectors.c
+ * @brief          : Flash or RAM vector table, and unhandled interrupt capture
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "vectors.h"
+
+#if (VECTORS_ALIGN < (VECTORS_COUNT * 4U)) || \
+    ((VECTORS_ALIGN & (VECTORS_ALIGN - 1U)) != 0U)
+#error "VECTORS_ALIGN must be a power of two that covers the table"
+#endif
+
+/* Variables */
+volatile vectors_fault_t vectors_fault;
+
+#ifdef VECTORS_RAM
+extern const uint32_t g_pfnVectors[VECTORS_COUNT];
+
+static uint32_t vectors_ram[VECTORS_COUNT] __attribute__((aligned(VECTORS_ALIGN)));
+#endif
+
+/* Functions */
+#ifdef VECTORS_RAM
+int vectors_init(const vectors_binding_t *bindings, uint32_t n)
+{
+  int ret = 0;
+
+  for (uint32_t i = 0; i < VECTORS_COUNT; i++)
+  {
+    vectors_ram[i] = g_pfnVectors[i];
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    uint32_t index = (uint32_t)((int32_t)bindings[i].irq + 16);
+
+    if ((index < 2U) || (index >= VECTORS_COUNT))
+    {
+      ret = -1;
+      continue;
+    }
+    vectors_ram[index] = (uint32_t)bindings[i].handler;
+  }
+
+  __DSB();
+  SCB->VTOR = (uint32_t)vectors_ram;
+  __DSB();
+  __ISB();
+  return ret;
+}
+
+vectors_handler_t vectors_bind(IRQn_Type irq, vectors_handler_t handler)
+{
+  uint32_t index = (uint32_t)((int32_t)irq + 16);
+  vectors_handler_t prev;
+
+  /* Not the stack pointer or the reset vector */
+  if ((index < 2U) || (index >= VECTORS_COUNT) ||
+      (SCB->VTOR != (uint32_t)vectors_ram))
+  {
+    return 0;
+  }
+
+  prev = (vectors_handler_t)vectors_ram[index];
+  vectors_ram[index] = (uint32_t)handler;
+  __DSB();
+  return prev;
+}
+#endif
+
+/**
+ * @brief  The frame the exception stacked is on the MSP or the PSP,
+ *         whichever EXC_RETURN in lr names; Default_Handler branches here
+ *         without touching lr.
+ */
+void vectors_unhandled(void) __attribute__((naked));
+void vectors_unhandled(void)
+{
+  __asm volatile
+  (
+    "  tst     lr, #4                         \n"
+    "  ite     eq                             \n"
+    "  mrseq   r0, msp                        \n"
+    "  mrsne   r0, psp                        \n"
+    "  mrs     r1, ipsr                       \n"
+    "  b       vectors_record                 \n"
+  );
+}
+
+/* Not static: vectors_unhandled() branches to it by name */
+void vectors_record(const uint32_t *frame, uint32_t ipsr)
+  __attribute__((noreturn, used));
+void vectors_record(const uint32_t *frame, uint32_t ipsr)
+{
+  vectors_fault.exception = ipsr;
+  vectors_fault.irq = (int32_t)ipsr - 16;
+  vectors_fault.lr = frame[5];
+  vectors_fault.pc = frame[6];
+  vectors_fault.count++;
+
+  if ((CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) != 0U)
+  {
+    __BKPT(0);
+  }
+  for (;;)
+  {
+  }
+}
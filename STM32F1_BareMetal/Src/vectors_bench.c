@@ -0,0 +1,108 @@
+/**
+ ******************************************************************************
+ * @file           : vectors_bench.c
+ * @brief          : Handler entry latency from the flash and RAM tables
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "dwt.h"
+#include "vectors.h"
+
+/* An interrupt nothing in the tree uses, pended by software. The handler
+ * is weak, so an application that needs the vector keeps it (and this
+ * bench then reports 0) */
+#ifndef VECTORS_BENCH_IRQ
+#define VECTORS_BENCH_IRQ       FLASH_IRQn
+#define VECTORS_BENCH_HANDLER   FLASH_IRQHandler
+#endif
+
+#define VECTORS_BENCH_ROUNDS    64U
+
+extern const uint32_t g_pfnVectors[VECTORS_COUNT];
+
+/* Variables */
+static volatile uint32_t vectors_bench_stamp;
+
+/* Functions */
+void VECTORS_BENCH_HANDLER(void) __attribute__((weak));
+void VECTORS_BENCH_HANDLER(void)
+{
+  vectors_bench_stamp = dwt_cycles();
+}
+
+/**
+ * @brief  Pend the IRQ and take the time to the handler's stamp, which
+ *         includes the pending store and the exception entry.
+ */
+static void vectors_bench_run(uint32_t overhead, uint32_t *min, uint32_t *max)
+{
+  *min = 0xFFFFFFFFUL;
+  *max = 0U;
+
+  for (uint32_t i = 0; i < VECTORS_BENCH_ROUNDS; i++)
+  {
+    uint32_t t;
+
+    vectors_bench_stamp = 0U;
+    t = dwt_cycles();
+    NVIC->ISPR[((uint32_t)VECTORS_BENCH_IRQ) >> 5] =
+      1UL << (((uint32_t)VECTORS_BENCH_IRQ) & 0x1FU);
+    __DSB();
+    __ISB();
+    if (vectors_bench_stamp == 0U)
+    {
+      /* Another handler owns the vector */
+      *min = 0U;
+      return;
+    }
+    t = vectors_bench_stamp - t;
+    t = (t > overhead) ? (t - overhead) : 0U;
+    if (t < *min)
+    {
+      *min = t;
+    }
+    if (t > *max)
+    {
+      *max = t;
+    }
+  }
+}
+
+void vectors_bench(vectors_bench_t *out)
+{
+  uint32_t vtor = SCB->VTOR;
+  uint32_t flash = (uint32_t)g_pfnVectors;
+  uint32_t overhead;
+  uint32_t t;
+
+  out->ram_min = 0U;
+  out->ram_max = 0U;
+
+  dwt_init();
+  t = dwt_cycles();
+  overhead = dwt_cycles() - t;
+
+  /* Most urgent, so nothing else is taken in between */
+  NVIC_SetPriority(VECTORS_BENCH_IRQ, 0U);
+  NVIC_EnableIRQ(VECTORS_BENCH_IRQ);
+
+  SCB->VTOR = flash;
+  __DSB();
+  __ISB();
+  vectors_bench_run(overhead, &out->flash_min, &out->flash_max);
+
+  /* Out of reset VTOR reads 0, the flash alias, not g_pfnVectors */
+  if ((vtor & 0xE0000000UL) == SRAM_BASE)
+  {
+    SCB->VTOR = vtor;
+    __DSB();
+    __ISB();
+    vectors_bench_run(overhead, &out->ram_min, &out->ram_max);
+  }
+
+  NVIC_DisableIRQ(VECTORS_BENCH_IRQ);
+  SCB->VTOR = vtor;
+  __DSB();
+  __ISB();
+}
@@ -0,0 +1,390 @@
+/**
+ ******************************************************************************
+ * @file           : wheel.c
+ * @brief          : Hierarchical timing wheel for software timers
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "event.h"
+#include "wheel.h"
+
+#if defined(__arm__)
+#include "crit.h"
+#endif
+
+/* The Debug build would otherwise put -O0 on the tick path */
+#pragma GCC optimize ("O2")
+
+#if defined(__arm__)
+#ifndef WHEEL_CEILING
+#define WHEEL_CEILING       CRIT_LIB_PRIO
+#endif
+
+#if (WHEEL_CEILING < 1U) || (WHEEL_CEILING > 15U)
+#error "WHEEL_CEILING must be 1 to 15"
+#endif
+
+#define WHEEL_LOCK()        crit_enter(WHEEL_CEILING)
+#define WHEEL_UNLOCK(c)     crit_exit(c)
+#else
+typedef uint32_t crit_t;
+#define WHEEL_LOCK()        0U
+#define WHEEL_UNLOCK(c)     ((void)(c))
+#endif
+
+#define WHEEL_BITS          6U
+#define WHEEL_SLOTS         (1UL << WHEEL_BITS)
+#define WHEEL_MASK          (WHEEL_SLOTS - 1U)
+#define WHEEL_LEVELS        4U
+#define WHEEL_SPAN          (1UL << (WHEEL_BITS * WHEEL_LEVELS))
+#define WHEEL_CTX           1U      /* context bit of link */
+
+/* Variables */
+static wheel_timer_t *wheel_slots[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t wheel_map[WHEEL_LEVELS];    /* non-empty slots */
+static uint32_t wheel_base;                 /* next tick to run */
+static wheel_timer_t *wheel_due;            /* WHEEL_THREAD, expired */
+static uint32_t wheel_posted;
+
+/* Functions */
+/**
+ * @brief  Lists are singly linked from their head, and each timer keeps
+ *         the address of the pointer to it, so a timer leaves its list in
+ *         O(1) without knowing which list that is. The pointer is word
+ *         aligned, which leaves bit 0 for the context.
+ */
+static void wheel_link(wheel_timer_t **head, wheel_timer_t *t, uint32_t ctx)
+{
+  wheel_timer_t *next = *head;
+
+  t->next = next;
+  if (next != 0)
+  {
+    next->link = (next->link & WHEEL_CTX) | (uintptr_t)&t->next;
+  }
+  *head = t;
+  t->link = (uintptr_t)head | ctx;
+}
+
+static void wheel_unlink(wheel_timer_t *t)
+{
+  wheel_timer_t **pprev = (wheel_timer_t **)(t->link & ~(uintptr_t)WHEEL_CTX);
+  wheel_timer_t *next = t->next;
+  uintptr_t off;
+
+  *pprev = next;
+  if (next != 0)
+  {
+    next->link = (next->link & WHEEL_CTX) | (uintptr_t)pprev;
+  }
+  else
+  {
+    /* Last of a slot: clear its map bit */
+    off = (uintptr_t)pprev - (uintptr_t)&wheel_slots[0][0];
+    if ((off < sizeof(wheel_slots)) && (*pprev == 0))
+    {
+      uint32_t i = (uint32_t)(off / sizeof(wheel_slots[0][0]));
+
+      wheel_map[i >> WHEEL_BITS] &= ~(1ULL << (i & WHEEL_MASK));
+    }
+  }
+  t->link &= WHEEL_CTX;
+}
+
+/**
+ * @brief  Hang a timer in the slot for its deadline, relative to the next
+ *         tick to run. Past deadlines take that tick's slot.
+ */
+static void wheel_insert(wheel_timer_t *t, uint32_t ctx)
+{
+  uint32_t delta = t->expires - wheel_base;
+  uint32_t level = 0U;
+  uint32_t slot;
+
+  if ((int32_t)delta < 0)
+  {
+    slot = wheel_base & WHEEL_MASK;
+  }
+  else if (delta >= WHEEL_SPAN)
+  {
+    /* The last level 3 slot to come round; placed again from there */
+    level = WHEEL_LEVELS - 1U;
+    slot = ((wheel_base + WHEEL_SPAN - 1U) >> (WHEEL_BITS * level)) &
+           WHEEL_MASK;
+  }
+  else
+  {
+    while (delta >= (1UL << (WHEEL_BITS * (level + 1U))))
+    {
+      level++;
+    }
+    slot = (t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  }
+
+  wheel_link(&wheel_slots[level][slot], t, ctx);
+  wheel_map[level] |= 1ULL << slot;
+}
+
+/**
+ * @brief  Move a slot's list onto a local head, so its timers can be
+ *         handled one per critical section while others still stop them.
+ */
+static void wheel_take(uint32_t level, uint32_t slot, wheel_timer_t **local)
+{
+  wheel_timer_t *t = wheel_slots[level][slot];
+
+  *local = t;
+  if (t != 0)
+  {
+    t->link = (t->link & WHEEL_CTX) | (uintptr_t)local;
+  }
+  wheel_slots[level][slot] = 0;
+  wheel_map[level] &= ~(1ULL << slot);
+}
+
+static void wheel_cascade(uint32_t level, uint32_t slot)
+{
+  wheel_timer_t *list;
+  crit_t c = WHEEL_LOCK();
+
+  wheel_take(level, slot, &list);
+  WHEEL_UNLOCK(c);
+
+  for (;;)
+  {
+    wheel_timer_t *t;
+    uint32_t ctx;
+
+    c = WHEEL_LOCK();
+    t = list;
+    if (t == 0)
+    {
+      WHEEL_UNLOCK(c);
+      return;
+    }
+    ctx = (uint32_t)(t->link & WHEEL_CTX);
+    wheel_unlink(t);
+    wheel_insert(t, ctx);
+    WHEEL_UNLOCK(c);
+  }
+}
+
+static void wheel_run(uint32_t arg)
+{
+  crit_t c = WHEEL_LOCK();
+
+  (void)arg;
+  wheel_posted = 0U;
+  WHEEL_UNLOCK(c);
+
+  for (;;)
+  {
+    wheel_timer_t *t;
+
+    c = WHEEL_LOCK();
+    t = wheel_due;
+    if (t == 0)
+    {
+      WHEEL_UNLOCK(c);
+      return;
+    }
+    wheel_unlink(t);
+    WHEEL_UNLOCK(c);
+    t->fn(t);
+  }
+}
+
+void wheel_timer_init(wheel_timer_t *t, wheel_fn_t fn)
+{
+  t->next = 0;
+  t->link = 0U;
+  t->expires = 0U;
+  t->fn = fn;
+}
+
+void wheel_start(wheel_timer_t *t, uint32_t delay, uint32_t ctx)
+{
+  crit_t c = WHEEL_LOCK();
+
+  if ((t->link & ~(uintptr_t)WHEEL_CTX) != 0U)
+  {
+    wheel_unlink(t);
+  }
+  t->expires = wheel_base + ((delay != 0U) ? delay : 1U) - 1U;
+  wheel_insert(t, ctx & WHEEL_CTX);
+  WHEEL_UNLOCK(c);
+}
+
+void wheel_forward(wheel_timer_t *t, uint32_t period)
+{
+  crit_t c = WHEEL_LOCK();
+  uint32_t ctx = (uint32_t)(t->link & WHEEL_CTX);
+
+  if ((t->link & ~(uintptr_t)WHEEL_CTX) != 0U)
+  {
+    wheel_unlink(t);
+  }
+  t->expires += period;
+  wheel_insert(t, ctx);
+  WHEEL_UNLOCK(c);
+}
+
+void wheel_stop(wheel_timer_t *t)
+{
+  crit_t c = WHEEL_LOCK();
+
+  if ((t->link & ~(uintptr_t)WHEEL_CTX) != 0U)
+  {
+    wheel_unlink(t);
+  }
+  WHEEL_UNLOCK(c);
+}
+
+uint32_t wheel_pending(const wheel_timer_t *t)
+{
+  return ((t->link & ~(uintptr_t)WHEEL_CTX) != 0U) ? 1U : 0U;
+}
+
+uint32_t wheel_now(void)
+{
+  return wheel_base;
+}
+
+int wheel_set_now(uint32_t now)
+{
+  crit_t c = WHEEL_LOCK();
+  int ret = -1;
+
+  if (((wheel_map[0] | wheel_map[1] | wheel_map[2] | wheel_map[3]) == 0U) &&
+      (wheel_due == 0))
+  {
+    wheel_base = now;
+    ret = 0;
+  }
+  WHEEL_UNLOCK(c);
+  return ret;
+}
+
+void wheel_tick(void)
+{
+  uint32_t index = wheel_base & WHEEL_MASK;
+  wheel_timer_t *list;
+  crit_t c;
+
+  /* Each level's slot comes down as the level below wraps */
+  for (uint32_t level = 1U; (level < WHEEL_LEVELS) && (index == 0U); level++)
+  {
+    index = (wheel_base >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    wheel_cascade(level, index);
+  }
+
+  c = WHEEL_LOCK();
+  wheel_take(0U, wheel_base & WHEEL_MASK, &list);
+  wheel_base++;
+  WHEEL_UNLOCK(c);
+
+  for (;;)
+  {
+    wheel_timer_t *t;
+    uint32_t ctx;
+
+    c = WHEEL_LOCK();
+    t = list;
+    if (t == 0)
+    {
+      break;
+    }
+    ctx = (uint32_t)(t->link & WHEEL_CTX);
+    wheel_unlink(t);
+    if (ctx == WHEEL_THREAD)
+    {
+      wheel_link(&wheel_due, t, ctx);
+      WHEEL_UNLOCK(c);
+    }
+    else
+    {
+      WHEEL_UNLOCK(c);
+      t->fn(t);
+    }
+  }
+
+  /* Retried every tick if the event level was full */
+  if ((wheel_due != 0) && (wheel_posted == 0U) &&
+      (event_post(WHEEL_EVENT_PRIO, wheel_run, 0U) == 0))
+  {
+    wheel_posted = 1U;
+  }
+  WHEEL_UNLOCK(c);
+}
+
+void wheel_advance(uint32_t ticks)
+{
+  while (ticks != 0U)
+  {
+    uint32_t skip;
+    crit_t c;
+
+    /* Jump the empty stretch to the next tick with work, then run it */
+    if ((wheel_next(&skip) != 0) || (skip > ticks))
+    {
+      skip = ticks;
+    }
+    c = WHEEL_LOCK();
+    wheel_base += skip;
+    WHEEL_UNLOCK(c);
+    ticks -= skip;
+    if (ticks != 0U)
+    {
+      wheel_tick();
+      ticks--;
+    }
+  }
+}
+
+/**
+ * @brief  Ticks from the next one to run until `level`'s first non-empty
+ *         slot comes round: expires for level 0, comes down for the rest.
+ */
+static uint32_t wheel_level_next(uint32_t level)
+{
+  uint32_t shift = WHEEL_BITS * level;
+  uint32_t unit = 1UL << shift;
+  uint32_t start = (wheel_base + unit - 1U) & ~(unit - 1U);
+  uint32_t index = (start >> shift) & WHEEL_MASK;
+  uint64_t map = wheel_map[level];
+
+  /* Rotate so bit 0 is the slot due at start */
+  if (index != 0U)
+  {
+    map = (map >> index) | (map << (WHEEL_SLOTS - index));
+  }
+  return (start - wheel_base) + ((uint32_t)__builtin_ctzll(map) << shift);
+}
+
+int wheel_next(uint32_t *ticks)
+{
+  crit_t c = WHEEL_LOCK();
+  uint32_t n = 0xFFFFFFFFUL;
+
+  for (uint32_t level = 0U; level < WHEEL_LEVELS; level++)
+  {
+    if (wheel_map[level] != 0U)
+    {
+      uint32_t k = wheel_level_next(level);
+
+      if (k < n)
+      {
+        n = k;
+      }
+    }
+  }
+  WHEEL_UNLOCK(c);
+
+  if (n == 0xFFFFFFFFUL)
+  {
+    return -1;
+  }
+  *ticks = n;
+  return 0;
+}
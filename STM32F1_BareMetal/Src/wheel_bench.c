@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ * @file           : wheel_bench.c
+ * @brief          : Timing wheel start, tick and stop costs
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "wheel.h"
+
+#if defined(__arm__)
+#include "dwt.h"
+#define WHEEL_BENCH_NOW()   dwt_cycles()
+#else
+#include <time.h>
+#define WHEEL_BENCH_NOW()   wheel_bench_ns()
+#endif
+
+#define WHEEL_BENCH_TICKS   1000U
+#define WHEEL_BENCH_SPREAD  60000U
+
+/* Variables */
+static volatile uint32_t wheel_bench_fired;
+
+/* Functions */
+#if !defined(__arm__)
+static uint32_t wheel_bench_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL +
+                    (uint64_t)ts.tv_nsec);
+}
+#endif
+
+static void wheel_bench_cb(wheel_timer_t *t)
+{
+  (void)t;
+  wheel_bench_fired++;
+}
+
+static uint32_t wheel_bench_less(uint32_t t, uint32_t overhead)
+{
+  return (t > overhead) ? (t - overhead) : 0U;
+}
+
+void wheel_bench(wheel_timer_t *timers, uint32_t n, wheel_bench_t *out)
+{
+#if defined(__arm__)
+  uint32_t ctrl;
+#endif
+  uint32_t base;
+  uint32_t seed = 1U;
+  uint32_t overhead;
+  uint32_t total = 0U;
+  uint32_t t;
+
+  out->start = 0U;
+  out->tick = 0U;
+  out->tick_max = 0U;
+  out->stop = 0U;
+  out->fired = 0U;
+  if (n == 0U)
+  {
+    return;
+  }
+
+#if defined(__arm__)
+  dwt_init();
+
+  /* The SysTick hook would tick the wheel too */
+  ctrl = SysTick->CTRL;
+  SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+#endif
+  base = wheel_now();
+  t = WHEEL_BENCH_NOW();
+  overhead = WHEEL_BENCH_NOW() - t;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    wheel_timer_init(&timers[i], wheel_bench_cb);
+  }
+  wheel_bench_fired = 0U;
+
+  t = WHEEL_BENCH_NOW();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    seed = seed * 1664525U + 1013904223U;
+    wheel_start(&timers[i], 1U + (seed >> 8) % WHEEL_BENCH_SPREAD, WHEEL_ISR);
+  }
+  out->start = wheel_bench_less(WHEEL_BENCH_NOW() - t, overhead) / n;
+
+  /* Takes in about 15 level 1 cascades and whatever expires */
+  for (uint32_t i = 0; i < WHEEL_BENCH_TICKS; i++)
+  {
+    t = WHEEL_BENCH_NOW();
+    wheel_tick();
+    t = wheel_bench_less(WHEEL_BENCH_NOW() - t, overhead);
+    total += t;
+    if (t > out->tick_max)
+    {
+      out->tick_max = t;
+    }
+  }
+  out->tick = total / WHEEL_BENCH_TICKS;
+  out->fired = wheel_bench_fired;
+
+  t = WHEEL_BENCH_NOW();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    wheel_stop(&timers[i]);
+  }
+  out->stop = wheel_bench_less(WHEEL_BENCH_NOW() - t, overhead) / n;
+
+  (void)wheel_set_now(base);
+#if defined(__arm__)
+  SysTick->CTRL = ctrl;
+#endif
+}
@@ -103,14 +103,20 @@ LoopForever:
 
 /**
  * @brief  This is the code that gets called when the processor receives an
- *         unexpected interrupt.  This simply enters an infinite loop, preserving
- *         the system state for examination by a debugger.
+ *         unexpected interrupt.  It passes to vectors_unhandled() (vectors.c),
+ *         which records the exception before halting; without it, it simply
+ *         enters an infinite loop, preserving the system state for
+ *         examination by a debugger.
  *
  * @param  None
  * @retval : None
 */
   .section .text.Default_Handler,"ax",%progbits
+  .weak vectors_unhandled
 Default_Handler:
+  ldr r0, =vectors_unhandled
+  cbz r0, Infinite_Loop
+  bx r0
 Infinite_Loop:
   b Infinite_Loop
   .size Default_Handler, .-Default_Handler
@@ -0,0 +1,40 @@
+/**
+ ******************************************************************************
+ * @file           : check.h
+ * @brief          : Minimal assertions for the host tests
+ ******************************************************************************
+ * @attention
+ *
+ * CHECK() reports a failed condition with its location and carries on, so
+ * one run lists every failure; check_done() prints the summary and gives
+ * the exit status.
+ *
+ ******************************************************************************
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+
+static unsigned check_failed;
+
+#define CHECK(cond, ...)                                              \
+  do                                                                  \
+  {                                                                   \
+    if (!(cond))                                                      \
+    {                                                                 \
+      check_failed++;                                                 \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);      \
+      fprintf(stderr, __VA_ARGS__);                                   \
+      fputc('\n', stderr);                                            \
+    }                                                                 \
+  } while (0)
+
+static inline int check_done(const char *name)
+{
+  printf("%s: %s\n", name, (check_failed == 0U) ? "ok" : "FAILED");
+  return (check_failed == 0U) ? 0 : 1;
+}
+
+#endif /* CHECK_H_ */
@@ -0,0 +1,400 @@
+/**
+ ******************************************************************************
+ * @file           : test_can_filter.c
+ * @brief          : CAN filter compiler against the rules it was given
+ ******************************************************************************
+ * @attention
+ *
+ * Known rule sets must land in the bank scale and mode can_filter.h names,
+ * and invalid or oversize sets must be refused. Then CAN_ROUNDS random rule
+ * sets, clustered so that merges happen: every image is decoded bank by
+ * bank from the RM0008 register layout, independently of
+ * can_filter_match(), and frames near each rule and at random must be
+ * accepted exactly when some rule accepts them, through a filter that
+ * matches, into the FIFO and with the tag of a rule that accepts them.
+ * Merging may only ever save banks against packing the rules as given.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "check.h"
+#include "can_filter.h"
+
+#define CAN_ROUNDS        20000U
+#define CAN_FRAMES        64U     /* random frames per round */
+
+/* Variables */
+static uint64_t can_rng = 88172645463325252ULL;
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  can_rng ^= can_rng << 13;
+  can_rng ^= can_rng >> 7;
+  can_rng ^= can_rng << 17;
+  return (uint32_t)can_rng;
+}
+
+static uint32_t id_bits(uint8_t ide)
+{
+  return ide ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+}
+
+static int rule_accepts(const can_filter_rule_t *r, uint32_t id, uint8_t ide,
+                        uint8_t rtr)
+{
+  return (r->ide == ide) && (r->rtr == rtr) &&
+         (((id ^ r->id) & r->mask & id_bits(ide)) == 0U);
+}
+
+/* The frame as the 32-bit filter registers see it: STID, EXID, IDE, RTR */
+static uint32_t frame32(uint32_t id, uint8_t ide, uint8_t rtr)
+{
+  uint32_t stid = ide ? (id >> 18) : id;
+  uint32_t exid = ide ? (id & 0x3FFFFUL) : 0U;
+
+  return (stid << 21) | (exid << 3) | ((uint32_t)ide << 2) |
+         ((uint32_t)rtr << 1);
+}
+
+/* And as a 16-bit filter sees it: STID, RTR, IDE, EXID[17:15] */
+static uint32_t frame16(uint32_t id, uint8_t ide, uint8_t rtr)
+{
+  uint32_t f = frame32(id, ide, rtr);
+
+  return ((f >> 21) << 5) | ((uint32_t)rtr << 4) | ((uint32_t)ide << 3) |
+         ((f >> 18) & 0x7U);
+}
+
+/**
+ * @brief  Decode the image and test one frame against every active filter.
+ *         Filter numbers run per FIFO over every bank, active or not.
+ * @retval Bit mask of the matching filter numbers of each FIFO
+ */
+static void decode_match(const can_filter_image_t *img, uint32_t id,
+                         uint8_t ide, uint8_t rtr, uint64_t hits[2])
+{
+  uint32_t f32 = frame32(id, ide, rtr);
+  uint32_t f16 = frame16(id, ide, rtr);
+  uint32_t fmi[2] = { 0U, 0U };
+
+  hits[0] = 0U;
+  hits[1] = 0U;
+  for (uint32_t b = 0; b < CAN_FILTER_BANKS; b++)
+  {
+    uint32_t bit = 1UL << b;
+    uint32_t q = (img->ffa1r & bit) ? 1U : 0U;
+    int on = (img->fa1r & bit) != 0U;
+    uint32_t r1 = img->fr[b][0];
+    uint32_t r2 = img->fr[b][1];
+    uint32_t v[4];
+    uint32_t m[4];
+    uint32_t n;
+
+    if (img->fs1r & bit)
+    {
+      v[0] = r1;
+      v[1] = r2;
+      m[0] = m[1] = 0xFFFFFFFFUL;
+      if (!(img->fm1r & bit))
+      {
+        m[0] = r2;
+      }
+      n = (img->fm1r & bit) ? 2U : 1U;
+      for (uint32_t k = 0; k < n; k++)
+      {
+        if (on && (((f32 ^ v[k]) & m[k]) == 0U))
+        {
+          hits[q] |= 1ULL << (fmi[q] + k);
+        }
+      }
+    }
+    else
+    {
+      if (img->fm1r & bit)
+      {
+        v[0] = r1 & 0xFFFFU;
+        v[1] = r1 >> 16;
+        v[2] = r2 & 0xFFFFU;
+        v[3] = r2 >> 16;
+        m[0] = m[1] = m[2] = m[3] = 0xFFFFU;
+        n = 4U;
+      }
+      else
+      {
+        v[0] = r1 & 0xFFFFU;
+        m[0] = r1 >> 16;
+        v[1] = r2 & 0xFFFFU;
+        m[1] = r2 >> 16;
+        n = 2U;
+      }
+      for (uint32_t k = 0; k < n; k++)
+      {
+        if (on && (((f16 ^ v[k]) & m[k]) == 0U))
+        {
+          hits[q] |= 1ULL << (fmi[q] + k);
+        }
+      }
+    }
+    fmi[q] += n;
+  }
+}
+
+/* Banks the rules need packed as given, with no merging */
+static uint32_t unmerged_banks(const can_filter_rule_t *r, uint32_t count)
+{
+  uint32_t banks = 0U;
+
+  for (uint8_t q = 0; q < 2U; q++)
+  {
+    uint32_t em = 0U;
+    uint32_t el = 0U;
+    uint32_t sm = 0U;
+    uint32_t sl = 0U;
+    uint32_t spare;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      int exact = ((r[i].mask & id_bits(r[i].ide)) == id_bits(r[i].ide));
+
+      if (r[i].fifo != q)
+      {
+        continue;
+      }
+      if (r[i].ide)
+      {
+        em += exact ? 0U : 1U;
+        el += exact ? 1U : 0U;
+      }
+      else
+      {
+        sm += exact ? 0U : 1U;
+        sl += exact ? 1U : 0U;
+      }
+    }
+    spare = (el & 1U) + (sm & 1U);
+    sl = (sl > spare) ? sl - spare : 0U;
+    banks += em + (el + 1U) / 2U + (sm + 1U) / 2U + (sl + 3U) / 4U;
+  }
+  return banks;
+}
+
+static can_filter_rule_t rule(uint32_t id, uint32_t mask, uint8_t ide,
+                              uint8_t fifo, uint8_t tag)
+{
+  can_filter_rule_t r = { id, mask, ide, 0U, fifo, tag };
+
+  return r;
+}
+
+static void test_packing(void)
+{
+  can_filter_rule_t r[CAN_FILTER_MAX_RULES + 1U];
+  can_filter_image_t img;
+  uint8_t fifo;
+
+  memset(r, 0, sizeof(r));
+  CHECK(can_filter_compile(r, 0U, &img) == 0, "no rules");
+  CHECK(can_filter_match(&img, 0x123U, 0U, 0U, &fifo) == -1,
+        "no rules accepted a frame");
+
+  /* Four unrelated standard IDs: one 16-bit list bank */
+  for (uint32_t i = 0; i < 4U; i++)
+  {
+    r[i] = rule(0x111U * (i + 1U), CAN_STD_ID_MASK, 0U, 0U, (uint8_t)i);
+  }
+  CHECK(can_filter_compile(r, 4U, &img) == 1, "4 standard IDs");
+  CHECK((img.fm1r == 1U) && (img.fs1r == 0U) && (img.fa1r == 1U),
+        "4 standard IDs: fm1r %lx fs1r %lx", (unsigned long)img.fm1r,
+        (unsigned long)img.fs1r);
+
+  /* Two extended IDs: one 32-bit list bank */
+  r[0] = rule(0x1234567U, CAN_EXT_ID_MASK, 1U, 0U, 0U);
+  r[1] = rule(0x0ABCDEFU, CAN_EXT_ID_MASK, 1U, 0U, 1U);
+  CHECK(can_filter_compile(r, 2U, &img) == 1, "2 extended IDs");
+  CHECK((img.fm1r == 1U) && (img.fs1r == 1U), "2 extended IDs: mode");
+
+  /* An extended mask: one 32-bit mask bank */
+  r[0] = rule(0x1234500U, 0x1FFFFF00U, 1U, 0U, 0U);
+  CHECK(can_filter_compile(r, 1U, &img) == 1, "extended mask");
+  CHECK((img.fm1r == 0U) && (img.fs1r == 1U), "extended mask: mode");
+
+  /* Two standard masks share a 16-bit mask bank */
+  r[0] = rule(0x100U, 0x7F0U, 0U, 0U, 0U);
+  r[1] = rule(0x300U, 0x7C0U, 0U, 0U, 1U);
+  CHECK(can_filter_compile(r, 2U, &img) == 1, "2 standard masks");
+  CHECK((img.fm1r == 0U) && (img.fs1r == 0U), "2 standard masks: mode");
+
+  /* A standard ID takes the spare half of a lone extended ID's bank */
+  r[2] = rule(0x555U, CAN_STD_ID_MASK, 0U, 0U, 2U);
+  r[3] = rule(0x1234567U, CAN_EXT_ID_MASK, 1U, 0U, 3U);
+  CHECK(can_filter_compile(r, 4U, &img) == 2, "spare slot not filled");
+
+  /* Sixteen consecutive IDs of one tag merge into a single mask */
+  for (uint32_t i = 0; i < 16U; i++)
+  {
+    r[i] = rule(0x230U + i, CAN_STD_ID_MASK, 0U, 1U, 7U);
+  }
+  CHECK(can_filter_compile(r, 16U, &img) == 1, "16 IDs not merged");
+  CHECK((img.ffa1r == 1U) && (img.fm1r == 0U), "merged mask in FIFO1");
+  CHECK((can_filter_match(&img, 0x23FU, 0U, 0U, &fifo) >= 0) &&
+        (fifo == 1U), "merged mask rejects its last ID");
+  CHECK(can_filter_match(&img, 0x240U, 0U, 0U, &fifo) == -1,
+        "merge widened the mask");
+
+  /* ... but not across tags */
+  r[15].tag = 8U;
+  CHECK(can_filter_compile(r, 16U, &img) == 2, "merged across tags");
+
+  /* Fifteen unrelated extended masks need fifteen banks */
+  for (uint32_t i = 0; i < 15U; i++)
+  {
+    r[i] = rule(i << 20, 0x1FF00000U, 1U, i & 1U, (uint8_t)i);
+  }
+  CHECK(can_filter_compile(r, 14U, &img) == 14, "14 banks");
+  CHECK(can_filter_compile(r, 15U, &img) == -1, "15 banks");
+
+  r[0] = rule(0x800U, CAN_STD_ID_MASK, 0U, 0U, 0U);
+  CHECK(can_filter_compile(r, 1U, &img) == -1, "12-bit standard ID");
+  r[0] = rule(0x20000000U, CAN_EXT_ID_MASK, 1U, 0U, 0U);
+  CHECK(can_filter_compile(r, 1U, &img) == -1, "30-bit extended ID");
+  r[0] = rule(0x100U, CAN_STD_ID_MASK, 0U, 2U, 0U);
+  CHECK(can_filter_compile(r, 1U, &img) == -1, "FIFO 2");
+  CHECK(can_filter_compile(r, CAN_FILTER_MAX_RULES + 1U, &img) == -1,
+        "too many rules");
+}
+
+static void random_rule(can_filter_rule_t *r, uint32_t base)
+{
+  uint32_t bits;
+
+  r->ide = (rnd() % 3U == 0U) ? 1U : 0U;
+  r->rtr = (rnd() % 4U == 0U) ? 1U : 0U;
+  r->fifo = rnd() & 1U;
+  r->tag = rnd() % 3U;
+  bits = id_bits(r->ide);
+
+  /* Near a shared base so that rules overlap and merge */
+  r->id = (r->ide ? (base << 18) | (base & 0xFFU) : base) ^ (rnd() & 0xFU);
+  r->id &= bits;
+  switch (rnd() % 4U)
+  {
+    case 0U:
+      r->mask = bits & ~(rnd() & 0xFU);
+      break;
+    case 1U:
+      r->mask = bits & (0xFFFFFFFFUL << (rnd() % 12U));
+      break;
+    case 2U:
+      r->mask = rnd();    /* bits outside the identifier are ignored */
+      break;
+    default:
+      r->mask = bits;
+      break;
+  }
+}
+
+static void check_frame(const can_filter_image_t *img,
+                        const can_filter_rule_t *r, uint32_t count,
+                        uint32_t id, uint8_t ide, uint8_t rtr,
+                        uint32_t *wrong)
+{
+  uint64_t hits[2];
+  uint8_t fifo = 0xFFU;
+  int fmi = can_filter_match(img, id, ide, rtr, &fifo);
+  int want = 0;
+  int tag_ok = 0;
+
+  id &= id_bits(ide);
+  decode_match(img, id, ide, rtr, hits);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (rule_accepts(&r[i], id, ide, rtr))
+    {
+      want = 1;
+      tag_ok |= (fmi >= 0) && (fifo == r[i].fifo) &&
+                (img->fmi_tag[fifo][fmi] == r[i].tag);
+    }
+  }
+
+  if ((want != (fmi >= 0)) || (want != ((hits[0] | hits[1]) != 0U)) ||
+      (want && (!tag_ok || !(hits[fifo] & (1ULL << fmi)))))
+  {
+    if (*wrong == 0U)
+    {
+      CHECK(0, "frame %lx ide %u rtr %u: fmi %d fifo %u, %s",
+            (unsigned long)id, ide, rtr, fmi, fifo,
+            want ? "accepted by a rule" : "no rule");
+    }
+    (*wrong)++;
+  }
+}
+
+static void test_random(void)
+{
+  static can_filter_rule_t r[CAN_FILTER_MAX_RULES];
+  can_filter_image_t img;
+  uint32_t wrong = 0U;
+  uint32_t compiled = 0U;
+  uint32_t merged = 0U;
+
+  for (uint32_t round = 0; round < CAN_ROUNDS; round++)
+  {
+    uint32_t count = 1U + rnd() % 24U;
+    uint32_t base = rnd() & CAN_STD_ID_MASK;
+    uint32_t naive;
+    int banks;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      random_rule(&r[i], base);
+    }
+    naive = unmerged_banks(r, count);
+    banks = can_filter_compile(r, count, &img);
+    if (banks < 0)
+    {
+      CHECK(naive > CAN_FILTER_BANKS, "round %u: refused %u rules that fit "
+            "in %u banks", round, count, naive);
+      continue;
+    }
+    compiled++;
+    merged += ((uint32_t)banks < naive) ? 1U : 0U;
+    CHECK((uint32_t)banks <= naive, "round %u: %d banks, %u unmerged",
+          round, banks, naive);
+    CHECK((img.banks == banks) && (img.fa1r == (1UL << banks) - 1U),
+          "round %u: %d banks, fa1r %lx", round, banks,
+          (unsigned long)img.fa1r);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      uint32_t bits = id_bits(r[i].ide);
+      uint32_t near = (r[i].id & r[i].mask) | (rnd() & ~r[i].mask);
+
+      check_frame(&img, r, count, near, r[i].ide, r[i].rtr, &wrong);
+      check_frame(&img, r, count, near ^ (1UL << (rnd() % 11U)), r[i].ide,
+                  r[i].rtr, &wrong);
+      check_frame(&img, r, count, near, r[i].ide, !r[i].rtr, &wrong);
+      check_frame(&img, r, count, near & CAN_STD_ID_MASK, !r[i].ide,
+                  r[i].rtr, &wrong);
+      check_frame(&img, r, count, near ^ (rnd() & bits), r[i].ide, r[i].rtr,
+                  &wrong);
+    }
+    for (uint32_t i = 0; i < CAN_FRAMES; i++)
+    {
+      check_frame(&img, r, count, rnd(), rnd() & 1U, rnd() & 1U, &wrong);
+    }
+  }
+  CHECK(wrong == 0U, "%u frames filtered wrongly", wrong);
+  CHECK(compiled > CAN_ROUNDS / 2U, "only %u of %u rule sets compiled",
+        compiled, CAN_ROUNDS);
+  CHECK(merged > 0U, "merging never saved a bank");
+}
+
+int main(void)
+{
+  test_packing();
+  test_random();
+  return check_done("test_can_filter");
+}
@@ -0,0 +1,269 @@
+/**
+ ******************************************************************************
+ * @file           : test_coro.c
+ * @brief          : Coroutines on the event loop, driven from the host
+ ******************************************************************************
+ * @attention
+ *
+ * As coro.h describes: systick_ticks() is a counter here, and calls to
+ * coro_tick() and coro_signal_raise() take the place of the interrupts.
+ * Checks the wait, sleep and yield sequence, flags kept for a later wait,
+ * the pool limits, coro_next(), and a wake landing while the event level
+ * is full, which must still run the coroutine once the level drains.
+ * Then a second thread raises a signal each time the coroutine has taken
+ * the last one: a wake lost in the take/raise race stalls the exchange.
+ * The window is a few instructions, so a multi-core host is far likelier
+ * to hit it.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "check.h"
+#include "coro.h"
+#include "systick.h"
+
+#define CORO_HANDSHAKES   200000U
+#define CORO_STALL_NS     2000000000LL
+
+typedef struct
+{
+  coro_signal_t *sig;
+  uint32_t n;
+} worker_args_t;
+
+/* Variables */
+static uint32_t now;
+static uint32_t log_buf[16];
+static uint32_t log_n;
+static coro_signal_t sig_a;
+static uint32_t ran;
+static volatile uint32_t taken;
+
+/* Functions */
+uint32_t systick_ticks(void)
+{
+  return now;
+}
+
+static void note(uint32_t v)
+{
+  if (log_n < 16U)
+  {
+    log_buf[log_n] = v;
+  }
+  log_n++;
+}
+
+static void drain(void)
+{
+  while (event_dispatch() == 0)
+  {
+  }
+}
+
+static void advance(uint32_t ticks)
+{
+  while (ticks-- != 0U)
+  {
+    now++;
+    coro_tick();
+    drain();
+  }
+}
+
+/* Three rounds of: wait for flags, sleep 5 ticks, yield */
+static int worker(coro_t *c)
+{
+  worker_args_t *f = CORO_FRAME(c, worker_args_t);
+
+  CORO_BEGIN(c);
+  for (f->n = 0U; f->n < 3U; f->n++)
+  {
+    CORO_WAIT(c, f->sig);
+    note(100U + c->value);
+    CORO_SLEEP(c, 5U);
+    note(200U + now);
+    CORO_YIELD(c);
+  }
+  CORO_END(c);
+}
+
+static void test_sequence(void)
+{
+  worker_args_t a = { &sig_a, 0U };
+  uint32_t ticks = 0U;
+
+  event_init();
+  CHECK(coro_spawn(worker, &a, sizeof(a)) == 0, "spawn");
+  drain();
+  CHECK(log_n == 0U, "ran before its signal");
+  CHECK(coro_next(&ticks) == -1, "no sleeper, coro_next %u", ticks);
+
+  coro_signal_raise(&sig_a, 2U);
+  drain();
+  CHECK((log_n == 1U) && (log_buf[0] == 102U), "woken with flags 2");
+
+  /* Due once the count reaches now + 5: four ticks may pass first */
+  CHECK((coro_next(&ticks) == 0) && (ticks == 4U), "coro_next %u", ticks);
+  advance(4U);
+  CHECK(log_n == 1U, "woke early");
+  advance(1U);
+  CHECK((log_n == 2U) && (log_buf[1] == 205U), "woke at tick 5");
+
+  /* Raised while nobody waits: kept for the next CORO_WAIT */
+  coro_signal_raise(&sig_a, 8U);
+  drain();
+  CHECK((log_n == 3U) && (log_buf[2] == 108U), "kept flags 8");
+  advance(5U);
+  coro_signal_raise(&sig_a, 1U);
+  drain();
+  advance(5U);
+  CHECK(log_n == 6U, "%u of 6 steps", log_n);
+  CHECK(coro_next(&ticks) == -1, "finished coroutine still sleeping");
+}
+
+static int once(coro_t *c)
+{
+  CORO_BEGIN(c);
+  CORO_YIELD(c);
+  CORO_END(c);
+}
+
+static void test_pool(void)
+{
+  uint32_t k = 0U;
+
+  event_init();
+  CHECK(coro_spawn(once, NULL, CORO_FRAME_SIZE + 4U) == -1, "oversize");
+  CHECK(coro_spawn(NULL, NULL, 0U) == -1, "no function");
+
+  /* The first test's worker has finished and freed its slot */
+  while ((k <= CORO_POOL) && (coro_spawn(once, NULL, 0U) == 0))
+  {
+    k++;
+  }
+  CHECK(k == CORO_POOL, "%u spawned, pool of %u", k, CORO_POOL);
+  drain();
+  CHECK(coro_spawn(once, NULL, 0U) == 0, "slots not freed at CORO_END");
+  drain();
+}
+
+static void nothing(uint32_t arg)
+{
+  (void)arg;
+}
+
+static int wait_once(coro_t *c)
+{
+  CORO_BEGIN(c);
+  CORO_WAIT(c, &sig_a);
+  ran++;
+  CORO_END(c);
+}
+
+static void test_full_level(void)
+{
+  uint32_t filled = 0U;
+
+  event_init();
+  CHECK(coro_spawn(wait_once, NULL, 0U) == 0, "spawn");
+  drain();
+  while (event_post(CORO_EVENT_PRIO, nothing, 0U) == 0)
+  {
+    filled++;
+  }
+  CHECK(filled == EVENT_QUEUE_LEN, "level took %u", filled);
+
+  /* The wake cannot queue the run event: it must not be lost */
+  coro_signal_raise(&sig_a, 1U);
+  drain();
+  CHECK(ran == 0U, "ran without its event");
+  coro_tick();
+  drain();
+  CHECK(ran == 1U, "retried wake ran %u times", ran);
+}
+
+static int64_t clock_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int echo(coro_t *c)
+{
+  CORO_BEGIN(c);
+  while (taken < CORO_HANDSHAKES)
+  {
+    CORO_WAIT(c, &sig_a);
+    __atomic_add_fetch(&taken, 1U, __ATOMIC_RELEASE);
+  }
+  CORO_END(c);
+}
+
+static void *raiser(void *arg)
+{
+  (void)arg;
+  for (uint32_t i = 0; i < CORO_HANDSHAKES; i++)
+  {
+    while (__atomic_load_n(&taken, __ATOMIC_ACQUIRE) < i)
+    {
+      sched_yield();
+    }
+    coro_signal_raise(&sig_a, 1U);
+  }
+  return NULL;
+}
+
+static void test_raise_race(void)
+{
+  pthread_t th;
+  uint32_t seen = 0U;
+  int64_t last = clock_ns();
+
+  event_init();
+  sig_a.bits = 0U;
+  sig_a.waiter = 0U;
+  CHECK(coro_spawn(echo, NULL, 0U) == 0, "spawn");
+  pthread_create(&th, NULL, raiser, NULL);
+
+  while (taken < CORO_HANDSHAKES)
+  {
+    if (event_dispatch() != 0)
+    {
+      sched_yield();
+    }
+    if (taken != seen)
+    {
+      seen = taken;
+      last = clock_ns();
+    }
+    else if (clock_ns() - last > CORO_STALL_NS)
+    {
+      break;
+    }
+  }
+  CHECK(taken == CORO_HANDSHAKES, "stalled after %u of %u wakes", taken,
+        CORO_HANDSHAKES);
+  if (taken != CORO_HANDSHAKES)
+  {
+    /* Let the raiser finish so it can be joined */
+    __atomic_store_n(&taken, CORO_HANDSHAKES, __ATOMIC_RELEASE);
+  }
+  pthread_join(th, NULL);
+  drain();
+}
+
+int main(void)
+{
+  test_sequence();
+  test_pool();
+  test_full_level();
+  test_raise_race();
+  return check_done("test_coro");
+}
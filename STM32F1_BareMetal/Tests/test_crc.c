@@ -0,0 +1,159 @@
+/**
+ ******************************************************************************
+ * @file           : test_crc.c
+ * @brief          : Software CRC-32 against zlib, published vectors and a
+ *                   bit-serial reference
+ ******************************************************************************
+ * @attention
+ *
+ * crc32_sw() must equal zlib's crc32() over random lengths, alignments and
+ * chained seeds. crc32_sw_words() is the model of the CRC unit, so feeding
+ * it the way crc_zlib() feeds the unit, and holding the result to zlib too,
+ * checks the arithmetic crc.c does around the unit: resuming from a state
+ * through crc32_preimage(), and the bit reversal that turns the unit's
+ * MSB-first CRC into zlib's.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "check.h"
+#include "crc32_sw.h"
+
+#define CRC_ROUNDS        20000U
+
+/* Functions */
+static uint32_t zlib_crc(uint32_t crc, const uint8_t *p, size_t len)
+{
+  return (uint32_t)crc32(crc, p, (uInt)len);
+}
+
+static uint32_t ref_native(uint32_t state, const uint32_t *w, size_t count)
+{
+  while (count-- != 0U)
+  {
+    state ^= *w++;
+    for (uint32_t i = 0; i < 32U; i++)
+    {
+      state = (state << 1) ^ ((state & 0x80000000UL) ? 0x04C11DB7UL : 0U);
+    }
+  }
+  return state;
+}
+
+static uint32_t rbit(uint32_t x)
+{
+  uint32_t r = 0U;
+
+  for (uint32_t i = 0; i < 32U; i++)
+  {
+    r = (r << 1) | ((x >> i) & 1U);
+  }
+  return r;
+}
+
+/**
+ * @brief  What crc_zlib() computes on the unit, with crc32_sw_words() in
+ *         its place: unaligned head and tail in software, words reversed.
+ */
+static uint32_t unit_zlib(uint32_t crc, const uint8_t *p, size_t len)
+{
+  size_t head = (size_t)(-(uintptr_t)p) & 3U;
+  uint32_t state;
+  uint32_t pre;
+  uint32_t w;
+
+  head = (head > len) ? len : head;
+  crc = crc32_sw(crc, p, head);
+  p += head;
+  len -= head;
+  state = rbit(~crc);
+  pre = crc32_preimage(state);
+  state = crc32_sw_words(CRC32_NATIVE_INIT, &pre, 1U);
+  for (; len >= 4U; len -= 4U, p += 4)
+  {
+    memcpy(&w, p, 4U);
+    w = rbit(w);
+    state = crc32_sw_words(state, &w, 1U);
+  }
+  return crc32_sw(~rbit(state), p, len);
+}
+
+int main(void)
+{
+  static const char check[] = "123456789";
+  static const uint32_t word = 0x12345678UL;
+  static uint8_t buf[4096 + 8];
+  uint32_t words[64];
+  uint32_t wrong = 0U;
+
+  /* Published check values */
+  CHECK(crc32_sw(0U, check, 9U) == 0xCBF43926UL, "zlib check value");
+  CHECK(crc32_sw(0U, check, 0U) == 0U, "empty buffer");
+  CHECK(crc32_sw_words(CRC32_NATIVE_INIT, &word, 1U) == 0xDF8A8A2BUL,
+        "CRC unit value for 0x12345678");
+
+  srand(1U);
+  for (size_t i = 0; i < sizeof(buf); i++)
+  {
+    buf[i] = (uint8_t)rand();
+  }
+  for (size_t i = 0; i < 64U; i++)
+  {
+    words[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+  }
+
+  for (size_t len = 0; len <= 64U; len++)
+  {
+    uint32_t seed = words[len & 63U];
+
+    CHECK(crc32_sw_words(seed, words, len) == ref_native(seed, words, len),
+          "crc32_sw_words, %zu words", len);
+  }
+
+  /* Chaining: split anywhere, same result */
+  for (size_t cut = 0; cut <= sizeof(buf); cut += 37U)
+  {
+    CHECK(crc32_sw(crc32_sw(0U, buf, cut), buf + cut, sizeof(buf) - cut) ==
+          crc32_sw(0U, buf, sizeof(buf)), "chained at %zu", cut);
+  }
+
+  /* The preimage written after a reset resumes from any state */
+  for (size_t i = 0; i < 64U; i++)
+  {
+    uint32_t pre = crc32_preimage(words[i]);
+
+    CHECK(crc32_sw_words(CRC32_NATIVE_INIT, &pre, 1U) == words[i],
+          "preimage of 0x%08X", words[i]);
+  }
+
+  /* Software and modelled unit against zlib: any length, any alignment,
+   * seeded with the CRC of a random prefix as when chaining */
+  for (uint32_t i = 0; i < CRC_ROUNDS; i++)
+  {
+    size_t len = (i & 1U) ? (size_t)rand() % 4096U : (size_t)rand() % 80U;
+    size_t off = (size_t)rand() & 7U;
+    uint32_t seed = (i % 3U == 0U) ? 0U :
+                    zlib_crc(0U, buf + 4096 - 64, (size_t)rand() % 64U);
+    uint32_t want = zlib_crc(seed, buf + off, len);
+    uint32_t sw = crc32_sw(seed, buf + off, len);
+    uint32_t unit = unit_zlib(seed, buf + off, len);
+
+    if ((sw != want) || (unit != want))
+    {
+      if (wrong == 0U)
+      {
+        CHECK(0, "%zu bytes at offset %zu from 0x%08X: zlib 0x%08X, "
+              "crc32_sw 0x%08X, unit 0x%08X", len, off, seed, want, sw,
+              unit);
+      }
+      wrong++;
+    }
+  }
+  CHECK(wrong == 0U, "%u CRCs differ from zlib", wrong);
+
+  return check_done("test_crc");
+}
@@ -0,0 +1,192 @@
+/**
+ ******************************************************************************
+ * @file           : test_event.c
+ * @brief          : Event loop ordering, capacity and threaded posting
+ ******************************************************************************
+ * @attention
+ *
+ * Single-threaded: the most urgent level goes first, FIFO within a level,
+ * a level takes EVENT_QUEUE_LEN events and refuses the next, and a handler
+ * may post. Threaded: EVENT_PRODUCERS threads post tagged sequence numbers
+ * at every level while the main thread dispatches, standing in for
+ * interrupts posting to the loop. Every accepted event must run exactly
+ * once and in order per producer and level.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <pthread.h>
+#include <sched.h>
+#include "check.h"
+#include "event.h"
+
+#define EVENT_PRODUCERS   4U
+#define EVENT_LEVELS      4U
+#define EVENT_POSTS       400000U
+#define EVENT_ORDER_MAX   64U
+
+/* Variables */
+static uint32_t order[EVENT_ORDER_MAX];
+static uint32_t order_n;
+
+static uint32_t next_seq[EVENT_LEVELS][EVENT_PRODUCERS];
+static uint32_t run_count[EVENT_LEVELS][EVENT_PRODUCERS];
+static uint32_t posted[EVENT_LEVELS][EVENT_PRODUCERS];
+static uint32_t out_of_order;
+static volatile uint32_t producers_done;
+
+/* Functions */
+static void record(uint32_t arg)
+{
+  if (order_n < EVENT_ORDER_MAX)
+  {
+    order[order_n] = arg;
+  }
+  order_n++;
+}
+
+static void repost(uint32_t arg)
+{
+  record(arg);
+  if (arg < 3U)
+  {
+    event_post(0U, repost, arg + 1U);
+  }
+}
+
+static void drain(void)
+{
+  while (event_dispatch() == 0)
+  {
+  }
+}
+
+static void test_order(void)
+{
+  static const uint32_t expect[] = { 30U, 31U, 10U, 11U, 0U };
+  uint32_t full = 0U;
+
+  event_init();
+  CHECK(event_dispatch() == -1, "empty loop dispatched");
+
+  event_post(1U, record, 10U);
+  event_post(3U, record, 30U);
+  event_post(1U, record, 11U);
+  event_post(0U, record, 0U);
+  event_post(3U, record, 31U);
+  order_n = 0U;
+  drain();
+  CHECK(order_n == 5U, "%u of 5 ran", order_n);
+  for (uint32_t i = 0; (i < 5U) && (i < order_n); i++)
+  {
+    CHECK(order[i] == expect[i], "position %u ran %u, not %u", i, order[i],
+          expect[i]);
+  }
+
+  for (uint32_t i = 0; i < EVENT_QUEUE_LEN; i++)
+  {
+    full += (event_post(2U, record, i) != 0) ? 1U : 0U;
+  }
+  CHECK(full == 0U, "%u posts refused below capacity", full);
+  CHECK(event_post(2U, record, 99U) == -1, "post past capacity");
+  CHECK(event_post(EVENT_PRIOS, record, 0U) == -1, "prio out of range");
+  order_n = 0U;
+  drain();
+  CHECK(order_n == EVENT_QUEUE_LEN, "%u of %u ran", order_n,
+        EVENT_QUEUE_LEN);
+
+  /* A handler that posts: each runs in turn, then the loop is empty */
+  order_n = 0U;
+  event_post(0U, repost, 0U);
+  drain();
+  CHECK(order_n == 4U, "re-posting chain ran %u times", order_n);
+  CHECK(event_dispatch() == -1, "loop not empty");
+}
+
+static void tagged(uint32_t arg)
+{
+  uint32_t level = arg >> 28;
+  uint32_t t = (arg >> 24) & 0xFU;
+  uint32_t seq = arg & 0xFFFFFFU;
+
+  if (seq != next_seq[level][t])
+  {
+    out_of_order++;
+  }
+  next_seq[level][t] = seq + 1U;
+  run_count[level][t]++;
+}
+
+static void *producer(void *arg)
+{
+  uint32_t t = (uint32_t)(uintptr_t)arg;
+  uint32_t seq[EVENT_LEVELS] = { 0U };
+
+  for (uint32_t i = 0; i < EVENT_POSTS; i++)
+  {
+    uint32_t level = i % EVENT_LEVELS;
+    uint32_t tag = (level << 28) | (t << 24) | seq[level];
+
+    if (event_post(level, tagged, tag) == 0)
+    {
+      seq[level]++;
+    }
+    else
+    {
+      sched_yield();
+    }
+  }
+  for (uint32_t level = 0; level < EVENT_LEVELS; level++)
+  {
+    posted[level][t] = seq[level];
+  }
+  __atomic_add_fetch(&producers_done, 1U, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void test_threads(void)
+{
+  pthread_t th[EVENT_PRODUCERS];
+  uint32_t accepted = 0U;
+
+  event_init();
+  for (uintptr_t i = 0; i < EVENT_PRODUCERS; i++)
+  {
+    pthread_create(&th[i], NULL, producer, (void *)i);
+  }
+  while (__atomic_load_n(&producers_done, __ATOMIC_ACQUIRE) <
+         EVENT_PRODUCERS)
+  {
+    if (event_dispatch() != 0)
+    {
+      sched_yield();
+    }
+  }
+  for (uint32_t i = 0; i < EVENT_PRODUCERS; i++)
+  {
+    pthread_join(th[i], NULL);
+  }
+  drain();
+
+  CHECK(out_of_order == 0U, "%u events lost, repeated or reordered",
+        out_of_order);
+  for (uint32_t level = 0; level < EVENT_LEVELS; level++)
+  {
+    for (uint32_t t = 0; t < EVENT_PRODUCERS; t++)
+    {
+      CHECK(run_count[level][t] == posted[level][t],
+            "level %u producer %u: %u posted, %u ran", level, t,
+            posted[level][t], run_count[level][t]);
+      accepted += posted[level][t];
+    }
+  }
+  CHECK(accepted > 0U, "no post accepted");
+}
+
+int main(void)
+{
+  test_order();
+  test_threads();
+  return check_done("test_event");
+}
@@ -0,0 +1,224 @@
+/**
+ ******************************************************************************
+ * @file           : test_fft.c
+ * @brief          : Complex and real FFT against a double-precision DFT
+ ******************************************************************************
+ * @attention
+ *
+ * Every size from FFT_MIN_N to FFT_MAX_N, with random input at full scale,
+ * at low and very low levels, a pure tone, a full-scale corner (-32768 in
+ * both parts), and the quietest non-zero block, random {-1, 0}. The output
+ * times 2^exp must reach FFT_MIN_SNR against the DFT of the same input,
+ * FFT_MIN_SNR_LSB for {-1, 0}. An all-zero block must come back all zero
+ * with exponent 0.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <math.h>
+#include "check.h"
+#include "fft.h"
+
+#define FFT_MIN_SNR       62.0    /* dB, fft.h quotes 64 and up */
+#define FFT_MIN_SNR_LSB   57.0    /* for {-1, 0}, 59 at 1024 points */
+#define FFT_PI            3.14159265358979323846
+
+/* Variables */
+static uint64_t fft_rng = 88172645463325252ULL;
+
+static double in_re[FFT_MAX_N], in_im[FFT_MAX_N];
+static double cos_tab[FFT_MAX_N], sin_tab[FFT_MAX_N];
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  fft_rng ^= fft_rng << 13;
+  fft_rng ^= fft_rng >> 7;
+  fft_rng ^= fft_rng << 17;
+  return (uint32_t)fft_rng;
+}
+
+static void dft_bin(uint32_t n, uint32_t k, double *re, double *im)
+{
+  double sr = 0.0;
+  double si = 0.0;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    uint32_t j = (uint32_t)(((uint64_t)i * k) % n);
+
+    /* x * e^(-2 pi i j / n) */
+    sr += in_re[i] * cos_tab[j] + in_im[i] * sin_tab[j];
+    si += in_im[i] * cos_tab[j] - in_re[i] * sin_tab[j];
+  }
+  *re = sr;
+  *im = si;
+}
+
+static void dft_setup(uint32_t n)
+{
+  for (uint32_t j = 0; j < n; j++)
+  {
+    cos_tab[j] = cos(2.0 * FFT_PI * j / n);
+    sin_tab[j] = sin(2.0 * FFT_PI * j / n);
+  }
+}
+
+/**
+ * @brief  Fill x and the reference input with one of the test signals.
+ */
+static void fill(cq15_t *x, uint32_t n, uint32_t kind)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    int32_t re;
+    int32_t im;
+
+    switch (kind)
+    {
+      case 0U:    /* full scale */
+        re = (int16_t)rnd();
+        im = (int16_t)rnd();
+        break;
+      case 1U:    /* -50 dB */
+        re = (int32_t)(rnd() % 201U) - 100;
+        im = (int32_t)(rnd() % 201U) - 100;
+        break;
+      case 2U:    /* a few LSBs */
+        re = (int32_t)(rnd() % 9U) - 4;
+        im = (int32_t)(rnd() % 9U) - 4;
+        break;
+      case 3U:    /* tone in bin 5 */
+        re = (int32_t)lrint(32767.0 * cos(2.0 * FFT_PI * 5.0 * i / n));
+        im = (int32_t)lrint(32767.0 * sin(2.0 * FFT_PI * 5.0 * i / n));
+        break;
+      case 4U:    /* the most negative value everywhere */
+        re = -32768;
+        im = -32768;
+        break;
+      default:    /* one's complement reads these as zero bits */
+        re = -(int32_t)(rnd() & 1U);
+        im = -(int32_t)(rnd() & 1U);
+        break;
+    }
+    x[i].re = (q15_t)re;
+    x[i].im = (q15_t)im;
+    in_re[i] = re;
+    in_im[i] = im;
+  }
+}
+
+static const char *const fft_kinds[] = { "full scale", "-50 dB", "4 LSB",
+                                         "tone", "-32768", "{-1, 0}" };
+
+static void test_complex(void)
+{
+  static cq15_t x[FFT_MAX_N];
+  int32_t e;
+
+  for (uint32_t n = FFT_MIN_N; n <= FFT_MAX_N; n *= 2U)
+  {
+    dft_setup(n);
+    for (uint32_t kind = 0; kind < 6U; kind++)
+    {
+      double sig = 0.0;
+      double err = 0.0;
+
+      fill(x, n, kind);
+      CHECK(fft_q15(x, n, &e) == 0, "n %u", n);
+      for (uint32_t k = 0; k < n; k++)
+      {
+        double re;
+        double im;
+        double dr;
+        double di;
+
+        dft_bin(n, k, &re, &im);
+        dr = ldexp(x[k].re, e) - re;
+        di = ldexp(x[k].im, e) - im;
+        sig += re * re + im * im;
+        err += dr * dr + di * di;
+      }
+      CHECK(10.0 * log10(sig / err) >=
+            ((kind == 5U) ? FFT_MIN_SNR_LSB : FFT_MIN_SNR),
+            "fft_q15 n %u, %s: %.1f dB", n, fft_kinds[kind],
+            10.0 * log10(sig / err));
+    }
+  }
+
+  /* Silence stays silence, at exponent 0 */
+  for (uint32_t i = 0; i < 64U; i++)
+  {
+    x[i].re = 0;
+    x[i].im = 0;
+  }
+  CHECK(fft_q15(x, 64U, &e) == 0, "zero block");
+  CHECK(e == 0, "zero block exponent %d", e);
+  for (uint32_t i = 0; i < 64U; i++)
+  {
+    CHECK((x[i].re == 0) && (x[i].im == 0), "zero block bin %u", i);
+  }
+
+  CHECK(fft_q15(x, FFT_MIN_N / 2U, &e) == -1, "n below FFT_MIN_N");
+  CHECK(fft_q15(x, FFT_MAX_N * 2U, &e) == -1, "n above FFT_MAX_N");
+  CHECK(fft_q15(x, 48U, &e) == -1, "n not a power of two");
+}
+
+static void test_real(void)
+{
+  static q15_t r[FFT_MAX_N];
+  const cq15_t *z = (const cq15_t *)r;
+  int32_t e;
+
+  for (uint32_t n = 2U * FFT_MIN_N; n <= FFT_MAX_N; n *= 2U)
+  {
+    dft_setup(n);
+    for (uint32_t t = 0; t < 3U; t++)
+    {
+      double sig = 0.0;
+      double err = 0.0;
+      double re;
+      double im;
+      double d;
+
+      for (uint32_t i = 0; i < n; i++)
+      {
+        double ang = 2.0 * FFT_PI * 3.0 * i / n;
+        int32_t v = (t == 0U) ? (int32_t)lrint(32767.0 * sin(ang))
+                  : (t == 1U) ? -32768 : (int16_t)rnd();
+
+        r[i] = (q15_t)v;
+        in_re[i] = v;
+        in_im[i] = 0.0;
+      }
+      CHECK(rfft_q15(r, n, &e) == 0, "n %u", n);
+
+      /* Bin 0 packs DC and Nyquist, both real */
+      for (uint32_t k = 0; k <= n / 2U; k++)
+      {
+        double gr;
+        double gi;
+
+        dft_bin(n, k, &re, &im);
+        gr = (k == 0U) ? z[0].re : (k == n / 2U) ? z[0].im : z[k].re;
+        gi = ((k == 0U) || (k == n / 2U)) ? 0.0 : z[k].im;
+        d = (ldexp(gr, e) - re) * (ldexp(gr, e) - re) +
+            (ldexp(gi, e) - im) * (ldexp(gi, e) - im);
+        sig += re * re + im * im;
+        err += d;
+      }
+      CHECK(10.0 * log10(sig / err) >= FFT_MIN_SNR,
+            "rfft_q15 n %u, signal %u: %.1f dB", n, t,
+            10.0 * log10(sig / err));
+    }
+  }
+  CHECK(rfft_q15(r, FFT_MIN_N, &e) == -1, "n below 2 * FFT_MIN_N");
+}
+
+int main(void)
+{
+  test_complex();
+  test_real();
+  return check_done("test_fft");
+}
@@ -0,0 +1,393 @@
+/**
+ ******************************************************************************
+ * @file           : test_filter.c
+ * @brief          : FIR and biquad filters against reference filters
+ ******************************************************************************
+ * @attention
+ *
+ * Two references. An integer one computes each output the way filter.h
+ * specifies it: the exact sum of products, then one rounding and
+ * saturation. The filters must match it bit for bit whatever the taps,
+ * decimation, block size, feed lengths and in-place use. A double
+ * precision one runs the designed filters on a test signal and bounds
+ * how far the fixed-point output strays from the ideal.
+ *
+ * The design macros are used in static initialisers, so this also checks
+ * that they fold to constants.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <math.h>
+#include "check.h"
+#include "filter.h"
+
+#define FLT_LEN           5000U
+#define FLT_TRIALS        300U
+#define FLT_MAX_TAPS      40U
+#define FLT_MAX_BLOCK     64U
+
+/* Variables */
+static const q15_t fir_lp[7] = {
+  Q15(FIR_LPF_TAP(0, 7, 0.1)), Q15(FIR_LPF_TAP(1, 7, 0.1)),
+  Q15(FIR_LPF_TAP(2, 7, 0.1)), Q15(FIR_LPF_TAP(3, 7, 0.1)),
+  Q15(FIR_LPF_TAP(4, 7, 0.1)), Q15(FIR_LPF_TAP(5, 7, 0.1)),
+  Q15(FIR_LPF_TAP(6, 7, 0.1))
+};
+static const q31_t bq31[10] = {
+  BIQUAD_LPF(BIQUAD_Q31, 0.02, 0.7071, 1),
+  BIQUAD_NOTCH(BIQUAD_Q31, 0.1, 2.0, 1)
+};
+static const q15_t bq15[5] = { BIQUAD_HPF(BIQUAD_Q15, 0.05, 0.7071, 1) };
+
+static uint64_t flt_rng = 88172645463325252ULL;
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  flt_rng ^= flt_rng << 13;
+  flt_rng ^= flt_rng >> 7;
+  flt_rng ^= flt_rng << 17;
+  return (uint32_t)flt_rng;
+}
+
+static int64_t sat(int64_t x, int64_t lo, int64_t hi)
+{
+  return (x > hi) ? hi : ((x < lo) ? lo : x);
+}
+
+static void test_design(void)
+{
+  double w = 2.0 * FILTER_PI * 0.02;
+  double c = cos(w);
+  double alpha = sin(w) / (2.0 * 0.7071);
+  double a0 = 1.0 + alpha;
+  double ref[5] = { (1.0 - c) / 2.0 / a0, (1.0 - c) / a0,
+                    (1.0 - c) / 2.0 / a0, 2.0 * c / a0,
+                    -(1.0 - alpha) / a0 };
+  double dc = 0.0;
+
+  for (uint32_t i = 0; i < 5U; i++)
+  {
+    CHECK(fabs(ref[i] / 2.0 * 2147483648.0 - bq31[i]) <= 1.0,
+          "BIQUAD_LPF coefficient %u: %d", i, bq31[i]);
+  }
+  for (uint32_t i = 0; i < 7U; i++)
+  {
+    double t = i - 3.0;
+    double h = (t == 0.0) ? 0.2 : sin(0.2 * FILTER_PI * t) / (FILTER_PI * t);
+
+    h *= 0.54 - 0.46 * cos(2.0 * FILTER_PI * i / 6.0);
+    CHECK(fabs(h * 32768.0 - fir_lp[i]) <= 0.5, "FIR_LPF_TAP %u: %d", i,
+          fir_lp[i]);
+  }
+
+  /* From about 3 / fc taps the DC gain is within 1% of unity */
+  for (uint32_t i = 0; i < 31U; i++)
+  {
+    dc += FIR_LPF_TAP(i, 31, 0.1);
+  }
+  CHECK(fabs(dc - 1.0) < 0.01, "31-tap FIR DC gain %f", dc);
+}
+
+/**
+ * @brief  Random taps, decimation and block size; the input fed in random
+ *         lengths, half the trials in place. Every output must equal the
+ *         rounded exact sum.
+ */
+static void test_fir(void)
+{
+  static q31_t x31[FLT_LEN], y31[FLT_LEN], b31[FLT_LEN];
+  static q15_t x15[FLT_LEN], y15[FLT_LEN], b15[FLT_LEN];
+  static q31_t st31[FLT_MAX_TAPS + FLT_MAX_BLOCK];
+  static q15_t st15[FLT_MAX_TAPS + FLT_MAX_BLOCK];
+  uint32_t bad = 0U;
+
+  for (uint32_t trial = 0; trial < FLT_TRIALS; trial++)
+  {
+    uint16_t taps = 1U + rnd() % FLT_MAX_TAPS;
+    uint16_t decim = 1U + rnd() % 5U;
+    uint16_t block = 1U + rnd() % FLT_MAX_BLOCK;
+    int in_place = (int)(trial & 1U);
+    q31_t c31[FLT_MAX_TAPS];
+    q15_t c15[FLT_MAX_TAPS];
+    fir_q31_t f31;
+    fir_q15_t f15;
+    uint32_t pos = 0U;
+    uint32_t o31 = 0U;
+    uint32_t o15 = 0U;
+
+    for (uint32_t i = 0; i < taps; i++)
+    {
+      c31[i] = (int32_t)rnd() / taps;
+      c15[i] = (int16_t)rnd() / taps;
+    }
+    for (uint32_t i = 0; i < FLT_LEN; i++)
+    {
+      x31[i] = b31[i] = (int32_t)rnd();
+      x15[i] = b15[i] = (int16_t)rnd();
+    }
+    CHECK(fir_q31_init(&f31, c31, taps, decim, st31, block) == 0, "init");
+    CHECK(fir_q15_init(&f15, c15, taps, decim, st15, block) == 0, "init");
+
+    while (pos < FLT_LEN)
+    {
+      uint32_t n = rnd() % 100U;
+
+      if (n > FLT_LEN - pos)
+      {
+        n = FLT_LEN - pos;
+      }
+      if (in_place)
+      {
+        uint32_t k = fir_q31(&f31, b31 + pos, b31 + o31, n);
+
+        for (uint32_t i = 0; i < k; i++)
+        {
+          y31[o31 + i] = b31[o31 + i];
+        }
+        o31 += k;
+        k = fir_q15(&f15, b15 + pos, b15 + o15, n);
+        for (uint32_t i = 0; i < k; i++)
+        {
+          y15[o15 + i] = b15[o15 + i];
+        }
+        o15 += k;
+      }
+      else
+      {
+        o31 += fir_q31(&f31, x31 + pos, y31 + o31, n);
+        o15 += fir_q15(&f15, x15 + pos, y15 + o15, n);
+      }
+      pos += n;
+    }
+    CHECK((o31 == FLT_LEN / decim) && (o15 == FLT_LEN / decim),
+          "decim %u: %u and %u outputs", decim, o31, o15);
+
+    for (uint32_t j = 0; (j < o31) && (j < o15); j++)
+    {
+      int32_t n = (int32_t)(j * decim + decim - 1U);
+      int64_t a = 0;
+      int64_t b = 0;
+
+      /* Coefficients are below 1 / taps: the sums cannot overflow */
+      for (int32_t k = 0; (k < taps) && (k <= n); k++)
+      {
+        a += (int64_t)c31[k] * x31[n - k];
+        b += (int64_t)c15[k] * x15[n - k];
+      }
+      if ((y31[j] != sat((a + 0x40000000) >> 31, Q31_MIN, Q31_MAX)) ||
+          (y15[j] != sat((b + 0x4000) >> 15, Q15_MIN, Q15_MAX)))
+      {
+        if (bad++ < 5U)
+        {
+          CHECK(0, "FIR output %u, taps %u decim %u block %u%s", j, taps,
+                decim, block, in_place ? " in place" : "");
+        }
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief  Exact Direct Form I stage: the sum scaled back by the
+ *         coefficient shift, rounded once, saturated.
+ */
+static void ref_biquad(const int64_t *c, uint32_t shift, uint32_t bits,
+                       const int64_t *x, int64_t *y, uint32_t n)
+{
+  int64_t x1 = 0;
+  int64_t x2 = 0;
+  int64_t y1 = 0;
+  int64_t y2 = 0;
+  uint32_t s = bits - 1U - shift;
+  int64_t hi = ((int64_t)1 << (bits - 1U)) - 1;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    __int128 acc = (__int128)c[0] * x[i] + (__int128)c[1] * x1 +
+                   (__int128)c[2] * x2 + (__int128)c[3] * y1 +
+                   (__int128)c[4] * y2;
+    int64_t out = (int64_t)((acc + ((__int128)1 << (s - 1U))) >> s);
+
+    out = sat(out, -hi - 1, hi);
+    x2 = x1;
+    x1 = x[i];
+    y2 = y1;
+    y1 = out;
+    y[i] = out;
+  }
+}
+
+static void test_biquad_exact(void)
+{
+  static q31_t x31[FLT_LEN], y31[FLT_LEN];
+  static q15_t x15[FLT_LEN], y15[FLT_LEN];
+  static int64_t rx[FLT_LEN], ry[FLT_LEN];
+  q31_t st31[8];
+  q15_t st15[4];
+  biquad_q31_t f31;
+  biquad_q15_t f15;
+  int64_t c[5];
+  uint32_t bad = 0U;
+
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    x31[i] = (int32_t)rnd() >> 2;
+    x15[i] = (int16_t)rnd() >> 2;
+  }
+  CHECK(biquad_q31_init(&f31, bq31, 2U, 1U, st31) == 0, "init");
+  CHECK(biquad_q15_init(&f15, bq15, 1U, 1U, st15) == 0, "init");
+  for (uint32_t pos = 0; pos < FLT_LEN; pos += 100U)
+  {
+    biquad_q31(&f31, x31 + pos, y31 + pos, 100U);
+    biquad_q15(&f15, x15 + pos, y15 + pos, 100U);
+  }
+
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    rx[i] = x31[i];
+  }
+  for (uint32_t stage = 0; stage < 2U; stage++)
+  {
+    for (uint32_t k = 0; k < 5U; k++)
+    {
+      c[k] = bq31[stage * 5U + k];
+    }
+    ref_biquad(c, 1U, 32U, rx, ry, FLT_LEN);
+    for (uint32_t i = 0; i < FLT_LEN; i++)
+    {
+      rx[i] = ry[i];
+    }
+  }
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    bad += (y31[i] != ry[i]) ? 1U : 0U;
+  }
+  CHECK(bad == 0U, "biquad_q31: %u outputs differ", bad);
+
+  for (uint32_t k = 0; k < 5U; k++)
+  {
+    c[k] = bq15[k];
+  }
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    rx[i] = x15[i];
+  }
+  ref_biquad(c, 1U, 16U, rx, ry, FLT_LEN);
+  bad = 0U;
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    bad += (y15[i] != ry[i]) ? 1U : 0U;
+  }
+  CHECK(bad == 0U, "biquad_q15: %u outputs differ", bad);
+}
+
+/**
+ * @brief  The designed filters in double precision, on a chirp at half
+ *         scale: the fixed-point outputs must stay within a few LSBs of
+ *         the ideal, and the notch must null its frequency.
+ */
+static void test_biquad_float(void)
+{
+  static q31_t x31[FLT_LEN], y31[FLT_LEN];
+  static q15_t x15[FLT_LEN], y15[FLT_LEN];
+  static double rx[FLT_LEN], ry[FLT_LEN];
+  q31_t st31[8];
+  q15_t st15[4];
+  biquad_q31_t f31;
+  biquad_q15_t f15;
+  double worst31 = 0.0;
+  double worst15 = 0.0;
+  double tone = 0.0;
+
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    double t = (double)i / FLT_LEN;
+
+    rx[i] = 0.5 * sin(2.0 * FILTER_PI * 0.25 * FLT_LEN * t * t);
+    x31[i] = Q31(rx[i]);
+    x15[i] = Q15(rx[i]);
+  }
+
+  biquad_q31_init(&f31, bq31, 2U, 1U, st31);
+  biquad_q31(&f31, x31, y31, FLT_LEN);
+  biquad_q15_init(&f15, bq15, 1U, 1U, st15);
+  biquad_q15(&f15, x15, y15, FLT_LEN);
+
+  /* Reference with the quantised coefficients, so only the arithmetic
+   * differs */
+  for (uint32_t stage = 0; stage < 2U; stage++)
+  {
+    const q31_t *c = &bq31[stage * 5U];
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+
+    for (uint32_t i = 0; i < FLT_LEN; i++)
+    {
+      double y = (c[0] * rx[i] + c[1] * x1 + c[2] * x2 + c[3] * y1 +
+                  c[4] * y2) / 1073741824.0;
+
+      x2 = x1;
+      x1 = rx[i];
+      y2 = y1;
+      y1 = y;
+      ry[i] = y;
+    }
+    for (uint32_t i = 0; i < FLT_LEN; i++)
+    {
+      rx[i] = ry[i];
+    }
+  }
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    double e = fabs(y31[i] / 2147483648.0 - ry[i]) * 2147483648.0;
+
+    worst31 = (e > worst31) ? e : worst31;
+  }
+
+  {
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+
+    for (uint32_t i = 0; i < FLT_LEN; i++)
+    {
+      double x = x15[i] / 32768.0;
+      double y = (bq15[0] * x + bq15[1] * x1 + bq15[2] * x2 +
+                  bq15[3] * y1 + bq15[4] * y2) / 16384.0;
+      double e = fabs(y15[i] / 32768.0 - y) * 32768.0;
+
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+      worst15 = (e > worst15) ? e : worst15;
+    }
+  }
+  CHECK(worst31 <= 32.0, "biquad_q31 %.1f LSB from double", worst31);
+  CHECK(worst15 <= 8.0, "biquad_q15 %.1f LSB from double", worst15);
+
+  /* The notch at 0.1 fs after settling: a steady tone all but vanishes */
+  for (uint32_t i = 0; i < FLT_LEN; i++)
+  {
+    x31[i] = Q31(0.5 * sin(2.0 * FILTER_PI * 0.1 * i));
+  }
+  biquad_q31_init(&f31, &bq31[5], 1U, 1U, st31);
+  biquad_q31(&f31, x31, y31, FLT_LEN);
+  for (uint32_t i = FLT_LEN - 500U; i < FLT_LEN; i++)
+  {
+    double v = fabs(y31[i] / 2147483648.0);
+
+    tone = (v > tone) ? v : tone;
+  }
+  CHECK(tone < 1e-3, "notch leaves %g of the tone", tone);
+}
+
+int main(void)
+{
+  test_design();
+  test_fir();
+  test_biquad_exact();
+  test_biquad_float();
+  return check_done("test_filter");
+}
@@ -0,0 +1,249 @@
+/**
+ ******************************************************************************
+ * @file           : test_fixmath.c
+ * @brief          : Fixed-point functions against double precision
+ ******************************************************************************
+ * @attention
+ *
+ * Holds every function to the error bound in the fixmath.h table, in LSBs
+ * of the result format: the one-argument Q15 functions and fix_exp2() over
+ * every input, the rest over FIX_ITERATIONS random inputs, half of them
+ * shifted right by a random amount so small magnitudes are covered too.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "fixmath.h"
+
+#define FIX_ITERATIONS    2000000U
+#define FIX_SLACK         1e-6        /* for the double reference itself */
+
+#define Q31_SCALE         2147483648.0
+
+/* Variables */
+static uint64_t fix_rng = 88172645463325252ULL;
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  fix_rng ^= fix_rng << 13;
+  fix_rng ^= fix_rng >> 7;
+  fix_rng ^= fix_rng << 17;
+  return (uint32_t)fix_rng;
+}
+
+static int32_t operand(void)
+{
+  int32_t x = (int32_t)rnd();
+
+  return (rnd() & 1U) ? (x >> (rnd() % 31U)) : x;
+}
+
+static double clamp(double x, double lo, double hi)
+{
+  return (x > hi) ? hi : ((x < lo) ? lo : x);
+}
+
+/**
+ * @brief  Track the worst error of one function and report it against its
+ *         bound at the end.
+ */
+typedef struct
+{
+  const char *name;
+  double bound;
+  double worst;
+  int32_t at_a;
+  int32_t at_b;
+} fix_err_t;
+
+static void err_note(fix_err_t *e, double got, double want, int32_t a,
+                     int32_t b)
+{
+  double d = fabs(got - want);
+
+  if (d > e->worst)
+  {
+    e->worst = d;
+    e->at_a = a;
+    e->at_b = b;
+  }
+}
+
+static void err_check(const fix_err_t *e)
+{
+  CHECK(e->worst <= e->bound + FIX_SLACK,
+        "%s: %.3f LSB at (%d, %d), bound %.2f", e->name, e->worst, e->at_a,
+        e->at_b, e->bound);
+}
+
+static void test_q15(void)
+{
+  fix_err_t mul = { "q15_mul", 0.5, 0.0, 0, 0 };
+  fix_err_t sq = { "q15_sqrt", 0.5, 0.0, 0, 0 };
+  /* Rounding the Q31 result adds its 41 LSBs, 0.0006 here, to the 0.5 */
+  fix_err_t sc = { "q15_sin/cos", 0.5 + 41.0 / 65536.0, 0.0, 0, 0 };
+  uint32_t bad = 0U;
+
+  for (int32_t a = -32768; a < 32768; a += 7)
+  {
+    for (int32_t b = -32768; b < 32768; b += 3)
+    {
+      int32_t sum = a + b;
+      int32_t diff = a - b;
+
+      err_note(&mul, q15_mul(a, b), clamp(a * (double)b / 32768.0,
+               -32768.0, 32767.0), a, b);
+      bad += (q15_add(a, b) != clamp(sum, -32768, 32767)) ? 1U : 0U;
+      bad += (q15_sub(a, b) != clamp(diff, -32768, 32767)) ? 1U : 0U;
+    }
+  }
+  CHECK(bad == 0U, "q15_add/sub: %u wrong", bad);
+
+  for (int32_t x = -32768; x < 32768; x++)
+  {
+    double ang = x / 32768.0 * M_PI;
+
+    if (x >= 0)
+    {
+      err_note(&sq, q15_sqrt(x), clamp(sqrt(x * 32768.0), 0.0, 32767.0), x,
+               0);
+    }
+    err_note(&sc, q15_sin(x), clamp(sin(ang) * 32768.0, -32768.0, 32767.0),
+             x, 0);
+    err_note(&sc, q15_cos(x), clamp(cos(ang) * 32768.0, -32768.0, 32767.0),
+             x, 0);
+  }
+  CHECK(q15_sqrt(-1) == 0, "q15_sqrt of a negative");
+
+  err_check(&mul);
+  err_check(&sq);
+  err_check(&sc);
+}
+
+static void test_q31(void)
+{
+  fix_err_t mul = { "q31_mul", 0.5, 0.0, 0, 0 };
+  fix_err_t rec = { "q31_recip", 0.5, 0.0, 0, 0 };
+  fix_err_t div = { "q31_div", 0.5, 0.0, 0, 0 };
+  fix_err_t sq = { "q31_sqrt", 0.5, 0.0, 0, 0 };
+  fix_err_t sc = { "q31_sincos", 41.0, 0.0, 0, 0 };
+  fix_err_t at = { "q31_atan2", 22.0, 0.0, 0, 0 };
+  fix_err_t mag = { "q31_mag", 50.0, 0.0, 0, 0 };
+  uint32_t bad = 0U;
+
+  for (uint32_t i = 0; i < FIX_ITERATIONS; i++)
+  {
+    int32_t a = operand();
+    int32_t b = operand();
+    int64_t acc = (int64_t)rnd() << 20;
+    q31_t s;
+    q31_t c;
+    double sum;
+    double diff;
+    double d;
+
+    err_note(&mul, q31_mul(a, b), clamp(a * (double)b / Q31_SCALE,
+             -Q31_SCALE, Q31_MAX), a, b);
+    sum = clamp((double)a + b, Q31_MIN, Q31_MAX);
+    diff = clamp((double)a - b, Q31_MIN, Q31_MAX);
+    bad += (q31_add(a, b) != sum) ? 1U : 0U;
+    bad += (q31_sub(a, b) != diff) ? 1U : 0U;
+    bad += (q31_mac(acc, a, b) != acc + (int64_t)a * b) ? 1U : 0U;
+
+    if (b != 0)
+    {
+      int32_t shift;
+      q31_t r = q31_recip(b, &shift);
+
+      /* In LSBs of the mantissa r, 1/b = r * 2^shift */
+      err_note(&rec, r, ldexp(Q31_SCALE / b, -shift) * Q31_SCALE, b, 0);
+      if (llabs(a) < llabs(b))
+      {
+        err_note(&div, q31_div(a, b), clamp((double)a / b * Q31_SCALE,
+                 -Q31_SCALE, Q31_MAX), a, b);
+      }
+    }
+
+    if (a >= 0)
+    {
+      err_note(&sq, q31_sqrt(a), clamp(sqrt(a * Q31_SCALE), 0.0, Q31_MAX),
+               a, 0);
+    }
+
+    q31_sincos(a, &s, &c);
+    err_note(&sc, s, clamp(sin(a / Q31_SCALE * M_PI) * Q31_SCALE,
+             -Q31_SCALE, Q31_MAX), a, 0);
+    err_note(&sc, c, clamp(cos(a / Q31_SCALE * M_PI) * Q31_SCALE,
+             -Q31_SCALE, Q31_MAX), a, 0);
+
+    if ((a != 0) || (b != 0))
+    {
+      /* Binary angles wrap: the error is the shorter way round */
+      d = fabs(atan2(a, b) / M_PI * Q31_SCALE - q31_atan2(a, b));
+      if (d > Q31_SCALE)
+      {
+        d = 2.0 * Q31_SCALE - d;
+      }
+      err_note(&at, d, 0.0, a, b);
+    }
+    err_note(&mag, q31_mag(a, b), clamp(hypot(a, b), 0.0, Q31_MAX), a, b);
+  }
+  CHECK(bad == 0U, "q31_add/sub/mac: %u wrong", bad);
+  CHECK(q31_mul(Q31_MIN, Q31_MIN) == Q31_MAX, "q31_mul(-1, -1) saturates");
+  CHECK(q31_sqrt(-1) == 0, "q31_sqrt of a negative");
+  CHECK(q31_atan2(0, 0) == 0, "q31_atan2 of the origin");
+
+  err_check(&mul);
+  err_check(&rec);
+  err_check(&div);
+  err_check(&sq);
+  err_check(&sc);
+  err_check(&at);
+  err_check(&mag);
+}
+
+static void test_log_exp(void)
+{
+  fix_err_t lg = { "fix_log2", 0.62, 0.0, 0, 0 };
+  fix_err_t ex = { "fix_exp2", 0.5, 0.0, 0, 0 };
+
+  for (uint32_t i = 0; i < FIX_ITERATIONS; i++)
+  {
+    uint32_t x = (uint32_t)operand();
+
+    if (x != 0U)
+    {
+      err_note(&lg, fix_log2(x), log2(x / 65536.0) * 65536.0, (int32_t)x, 0);
+    }
+  }
+
+  /* Every exponent from -17 to 16. The bound is 0.5 LSB plus 2^-28.8 of
+   * the result: note only what goes past the relative part */
+  for (int32_t e = -(17 << 16); e < (16 << 16); e++)
+  {
+    double want = exp2(e / 65536.0) * 65536.0;
+    double over = fabs(fix_exp2(e) - want) - want * exp2(-28.8);
+
+    err_note(&ex, (over > 0.0) ? over : 0.0, 0.0, e, 0);
+  }
+  CHECK(fix_log2(0U) == INT32_MIN, "fix_log2(0)");
+  CHECK(fix_log2(65536U) == 0, "fix_log2(1.0)");
+  CHECK(fix_exp2(16 << 16) == 0xFFFFFFFFUL, "fix_exp2(16) saturates");
+  CHECK(fix_exp2(-(17 << 16) - 1) == 0U, "fix_exp2 below -17");
+
+  err_check(&lg);
+  err_check(&ex);
+}
+
+int main(void)
+{
+  test_q15();
+  test_q31();
+  test_log_exp();
+  return check_done("test_fixmath");
+}
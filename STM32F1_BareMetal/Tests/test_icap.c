@@ -0,0 +1,238 @@
+/**
+ ******************************************************************************
+ * @file           : test_icap.c
+ * @brief          : Reciprocal frequency/period/duty from synthetic captures
+ ******************************************************************************
+ * @attention
+ *
+ * icap_calc.h is fed time stamp streams made here, the way icap.c feeds it
+ * from the capture DMA rings: the latest rise and fall per captured cycle,
+ * then a poll. Frequency, period and duty must be within one tick, plus the
+ * jitter, per window of the signal that was generated; constant and
+ * jittered inputs, across the 32-bit time stamp wrap, at input prescaler
+ * ratios up to 8 and switching between them. icap_extend() must recover
+ * every capture less than a counter period old, and a signal that stops
+ * must read 0 Hz once the timeout passes.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <math.h>
+#include "check.h"
+#include "icap_calc.h"
+
+#define ICAP_GATE         10000U      /* ticks */
+#define ICAP_TIMEOUT      100000U
+
+/* Variables */
+static uint64_t icap_rng = 88172645463325252ULL;
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  icap_rng ^= icap_rng << 13;
+  icap_rng ^= icap_rng >> 7;
+  icap_rng ^= icap_rng << 17;
+  return (uint32_t)icap_rng;
+}
+
+/* Uniform in [-j, j] */
+static double jitter(double j)
+{
+  return j * ((double)rnd() / 2147483648.0 - 1.0);
+}
+
+/**
+ * @brief  A signal of `period` ticks and duty `duty`, captured every `div`
+ *         edges from tick `t` with up to `j` ticks of jitter per edge.
+ */
+typedef struct
+{
+  double period;
+  double duty;
+  double j;
+  uint32_t div;
+  double t;           /* next captured rising edge, unwrapped */
+  uint32_t count;
+} icap_signal_t;
+
+/**
+ * @brief  Feed `cycles` captures and check every result against the signal.
+ * @retval Number of results produced
+ */
+static uint32_t run(icap_calc_t *c, icap_signal_t *s, uint32_t f_tick,
+                    uint32_t cycles, const char *name)
+{
+  double f = f_tick / s->period;
+  uint32_t results = 0U;
+  uint32_t wrong = 0U;
+
+  for (uint32_t i = 0; i < cycles; i++)
+  {
+    /* The latest fall is the one after the latest rise, or on alternate
+     * cycles the one before it, as when an update sees a rise only */
+    double high = (i & 1U) ? (s->duty - 1.0) * s->period
+                           : s->duty * s->period;
+    uint32_t rise = (uint32_t)(uint64_t)llround(s->t + jitter(s->j));
+    uint32_t fall = (uint32_t)(uint64_t)llround(s->t + high + jitter(s->j));
+
+    s->count++;
+    s->t += s->period * s->div;
+    icap_calc_rise(c, s->count, rise);
+    icap_calc_fall(c, fall);
+    if (icap_calc_poll(c, rise + (uint32_t)s->period) != 0)
+    {
+      const icap_result_t *r = &c->result;
+      /* One tick of quantisation and the jitter of both window ends */
+      double rel = (2.0 * s->j + 1.0) / (r->edges * s->period);
+      double got_f = r->freq_mhz / 1000.0;
+      double want_ns = 1e9 / f;
+      double duty = r->duty_q16 / 65536.0;
+      double duty_err = (2.0 * s->j + 1.0) / s->period + rel + 2.0 / 65536.0;
+
+      results++;
+      if ((fabs(got_f - f) > f * rel + 0.001) ||
+          (fabs(r->period_ns - want_ns) > want_ns * rel + 1.0) ||
+          (fabs(duty - s->duty) > duty_err) ||
+          (r->edges < ICAP_GATE / s->period))
+      {
+        if (wrong == 0U)
+        {
+          CHECK(0, "%s: %.3f Hz for %.3f, %u ns for %.1f, duty %.4f for "
+                "%.4f, %u edges", name, got_f, f, r->period_ns, want_ns,
+                duty, s->duty, r->edges);
+        }
+        wrong++;
+      }
+    }
+  }
+  CHECK(results > 0U, "%s: no result", name);
+  return results;
+}
+
+static void test_streams(void)
+{
+  static const double periods[] = { 2.5, 7.2, 100.0, 1000.0 / 3.0, 7777.7 };
+  static const double duties[] = { 0.5, 0.1, 0.9, 0.333 };
+
+  for (uint32_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+  {
+    for (uint32_t k = 0; k < 3U; k++)
+    {
+      icap_calc_t c;
+      icap_signal_t s = { periods[p], duties[(p + k) % 4U], 0.0, 1U, 0.0,
+                          rnd() };
+      char name[64];
+
+      /* Constant, jittered, then both starting just short of the wrap */
+      s.j = (k == 1U) ? 0.5 : 0.0;
+      s.t = (k == 2U) ? 4294967296.0 - 50.0 * ICAP_GATE : 1000.0;
+      if (periods[p] < 10.0)
+      {
+        s.div = 8U;           /* the prescaler icap.c would pick */
+        s.duty = 0.5;
+        s.j = 0.0;
+      }
+      icap_calc_init(&c, 72000000U, ICAP_GATE, ICAP_TIMEOUT);
+      icap_calc_set_div(&c, s.div);
+      snprintf(name, sizeof(name), "period %.1f %s", periods[p],
+               (k == 0U) ? "constant" : (k == 1U) ? "jittered" : "wrap");
+      run(&c, &s, 72000000U, 100U * ICAP_GATE / (uint32_t)(periods[p] *
+          s.div) + 100U, name);
+    }
+  }
+}
+
+static void test_high_freq(void)
+{
+  icap_calc_t c;
+  /* 12 MHz at 72 MHz ticks: past the 4.29 MHz a 32-bit mHz count holds */
+  icap_signal_t s = { 6.0, 0.5, 0.0, 8U, 0.0, 0U };
+
+  icap_calc_init(&c, 72000000U, ICAP_GATE, ICAP_TIMEOUT);
+  icap_calc_set_div(&c, 8U);
+  run(&c, &s, 72000000U, 20U * ICAP_GATE / 48U, "12 MHz");
+  CHECK(c.result.freq_mhz == 12000000000ULL, "12 MHz read %llu mHz",
+        (unsigned long long)c.result.freq_mhz);
+}
+
+static void test_div_switch(void)
+{
+  icap_calc_t c;
+  icap_signal_t s = { 50.0, 0.25, 0.0, 1U, 1000.0, 0U };
+
+  icap_calc_init(&c, 72000000U, ICAP_GATE, ICAP_TIMEOUT);
+  for (uint32_t k = 0; k < 8U; k++)
+  {
+    uint32_t div = 1UL << (k % 4U);
+
+    /* The capture count keeps running; only the ratio changes */
+    s.div = div;
+    icap_calc_set_div(&c, div);
+    CHECK(run(&c, &s, 72000000U, 3U * ICAP_GATE / (50U * div) + 2U,
+              (div == 1U) ? "div 1" : (div == 2U) ? "div 2" :
+              (div == 4U) ? "div 4" : "div 8") >= 2U,
+          "prescaler %u: too few results", div);
+  }
+}
+
+static void test_timeout(void)
+{
+  icap_calc_t c;
+  icap_signal_t s = { 1000.0, 0.5, 0.0, 1U, 1000.0, 0U };
+  uint32_t last;
+
+  icap_calc_init(&c, 1000000U, ICAP_GATE, ICAP_TIMEOUT);
+  CHECK(icap_calc_poll(&c, 5U * ICAP_TIMEOUT) == 0, "timeout before an edge");
+  run(&c, &s, 1000000U, 50U, "before the timeout");
+  CHECK(c.result.freq_mhz == 1000000U, "1 kHz read %llu mHz",
+        (unsigned long long)c.result.freq_mhz);
+
+  last = (uint32_t)(s.t - s.period);
+  CHECK(icap_calc_poll(&c, last + ICAP_TIMEOUT) == 0, "timed out early");
+  CHECK(icap_calc_poll(&c, last + ICAP_TIMEOUT + 1U) == 1, "no timeout");
+  CHECK((c.result.freq_mhz == 0U) && (c.result.period_ns == 0U) &&
+        (c.result.duty_q16 == 0U), "stopped signal not reported as 0 Hz");
+  CHECK(icap_calc_poll(&c, last + 2U * ICAP_TIMEOUT) == 0,
+        "0 Hz reported twice");
+
+  /* The signal comes back: a fresh window, not one spanning the gap */
+  s.t += 10.0 * ICAP_TIMEOUT;
+  run(&c, &s, 1000000U, 50U, "after the timeout");
+}
+
+static void test_extend(void)
+{
+  uint32_t wrong = 0U;
+
+  for (uint32_t i = 0; i < 4000000U; i++)
+  {
+    /* Half the cases within a few periods of the 32-bit wrap */
+    uint32_t now = (i & 1U) ? rnd() : (uint32_t)(rnd() % 0x40000U) - 0x20000U;
+    uint32_t age = (i & 2U) ? rnd() & 0xFFFFU : rnd() % 4U;
+    uint32_t cap = now - age;
+    uint32_t got = icap_extend((uint16_t)cap, (uint16_t)(now >> 16),
+                               (uint16_t)now);
+
+    if (got != cap)
+    {
+      if (wrong == 0U)
+      {
+        CHECK(0, "capture %08x at %08x extended to %08x", cap, now, got);
+      }
+      wrong++;
+    }
+  }
+  CHECK(wrong == 0U, "%u captures extended wrongly", wrong);
+}
+
+int main(void)
+{
+  test_extend();
+  test_streams();
+  test_high_freq();
+  test_div_switch();
+  test_timeout();
+  return check_done("test_icap");
+}
@@ -0,0 +1,217 @@
+/**
+ ******************************************************************************
+ * @file           : test_memopt.c
+ * @brief          : Optimised copy, move, set and compare against libc
+ ******************************************************************************
+ * @attention
+ *
+ * Every size up to MEMOPT_SMALL and a few large ones, at every source and
+ * destination offset from word alignment, so each path is taken: the byte
+ * loop, the aligning head, the block loop, congruent and unaligned words
+ * and the tail. The result must equal libc's, the bytes either side of the
+ * destination must be untouched and the destination must be returned.
+ * memmove runs over overlaps in both directions, and memcmp on buffers
+ * that differ in one byte, anywhere, must agree in sign with memcmp.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <string.h>
+#include "check.h"
+#include "memopt.h"
+
+#define MEMOPT_SMALL      300U
+#define MEMOPT_OFFSETS    8U
+#define MEMOPT_GUARD      16U
+#define MEMOPT_LARGE      4096U
+#define MEMOPT_REACH      40U     /* memmove overlap either way */
+#define MEMOPT_BUF        (MEMOPT_LARGE + 2U * (MEMOPT_GUARD + MEMOPT_REACH) + \
+                           MEMOPT_OFFSETS)
+
+/* Variables */
+static uint64_t mem_rng = 88172645463325252ULL;
+
+static const uint32_t mem_large[] = { 511U, 512U, 513U, 1023U, 1024U, 1031U,
+                                    4093U, MEMOPT_LARGE };
+
+static uint8_t src[MEMOPT_BUF] __attribute__((aligned(8)));
+static uint8_t dst[MEMOPT_BUF] __attribute__((aligned(8)));
+static uint8_t ref[MEMOPT_BUF] __attribute__((aligned(8)));
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  mem_rng ^= mem_rng << 13;
+  mem_rng ^= mem_rng >> 7;
+  mem_rng ^= mem_rng << 17;
+  return (uint32_t)mem_rng;
+}
+
+static void fill(uint8_t *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    p[i] = (uint8_t)rnd();
+  }
+}
+
+static int sign(int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+/* Sizes 0 to MEMOPT_SMALL, then the large ones up to MEMOPT_LARGE */
+static int size_at(uint32_t i, uint32_t *n)
+{
+  if (i <= MEMOPT_SMALL)
+  {
+    *n = i;
+    return 1;
+  }
+  i -= MEMOPT_SMALL + 1U;
+  if (i < sizeof(mem_large) / sizeof(mem_large[0]))
+  {
+    /* Clamped so the compiler sees the buffers are large enough */
+    *n = (mem_large[i] < MEMOPT_LARGE) ? mem_large[i] : MEMOPT_LARGE;
+    return 1;
+  }
+  return 0;
+}
+
+static void test_copy_set(void)
+{
+  uint32_t wrong = 0U;
+  uint32_t n;
+
+  for (uint32_t i = 0; size_at(i, &n); i++)
+  {
+    for (uint32_t so = 0; so < MEMOPT_OFFSETS; so++)
+    {
+      for (uint32_t dof = 0; dof < MEMOPT_OFFSETS; dof++)
+      {
+        uint8_t *d = dst + MEMOPT_GUARD + dof;
+        const uint8_t *s = src + MEMOPT_GUARD + so;
+        int c = (int)(rnd() & 0x1FFU) - 0x100;   /* only the low byte counts */
+        size_t len = n + 2U * MEMOPT_GUARD + MEMOPT_OFFSETS;
+        int bad = 0;
+
+        fill(src, len);
+        fill(dst, len);
+        memcpy(ref, dst, len);
+
+        memcpy(ref + MEMOPT_GUARD + dof, s, n);
+        bad |= (memopt_memcpy(d, s, n) != d);
+        bad |= (memcmp(dst, ref, len) != 0);
+
+        memset(ref + MEMOPT_GUARD + dof, c, n);
+        bad |= (memopt_memset(d, c, n) != d) << 1;
+        bad |= (memcmp(dst, ref, len) != 0) << 1;
+
+        /* Between separate buffers memmove is a plain copy */
+        memmove(ref + MEMOPT_GUARD + dof, s, n);
+        bad |= (memopt_memmove(d, s, n) != d) << 2;
+        bad |= (memcmp(dst, ref, len) != 0) << 2;
+
+        if (bad && (wrong == 0U))
+        {
+          CHECK(0, "%s%s%s of %u bytes, offsets %u to %u",
+                (bad & 1) ? "memcpy " : "", (bad & 2) ? "memset " : "",
+                (bad & 4) ? "memmove " : "", n, so, dof);
+        }
+        wrong += bad ? 1U : 0U;
+      }
+    }
+  }
+  CHECK(wrong == 0U, "%u copies or fills wrong", wrong);
+}
+
+static void test_overlap(void)
+{
+  uint32_t wrong = 0U;
+  uint32_t n;
+
+  for (uint32_t i = 0; size_at(i, &n); i++)
+  {
+    for (uint32_t so = 0; so < MEMOPT_OFFSETS; so++)
+    {
+      /* The destination from MEMOPT_REACH bytes below the source to as far
+       * above it */
+      for (int32_t delta = -(int32_t)MEMOPT_REACH;
+           delta <= (int32_t)MEMOPT_REACH; delta++)
+      {
+        uint8_t *s = dst + MEMOPT_GUARD + MEMOPT_REACH + so;
+        uint8_t *d = s + delta;
+        size_t len = n + MEMOPT_BUF - MEMOPT_LARGE;
+
+        fill(dst, len);
+        memcpy(ref, dst, len);
+        memmove(ref + (d - dst), ref + (s - dst), n);
+        if ((memopt_memmove(d, s, n) != d) || (memcmp(dst, ref, len) != 0))
+        {
+          if (wrong == 0U)
+          {
+            CHECK(0, "memmove of %u bytes by %d, source offset %u", n,
+                  delta, so);
+          }
+          wrong++;
+        }
+      }
+    }
+  }
+  CHECK(wrong == 0U, "%u overlapping moves wrong", wrong);
+}
+
+static void test_compare(void)
+{
+  uint32_t wrong = 0U;
+  uint32_t n;
+
+  for (uint32_t i = 0; size_at(i, &n); i++)
+  {
+    for (uint32_t ao = 0; ao < MEMOPT_OFFSETS; ao++)
+    {
+      for (uint32_t bo = 0; bo < MEMOPT_OFFSETS; bo++)
+      {
+        uint8_t *a = src + MEMOPT_GUARD + ao;
+        uint8_t *b = dst + MEMOPT_GUARD + bo;
+
+        fill(a, n);
+        memcpy(b, a, n);
+        /* Equal, then one byte different, at a random place and the ends */
+        for (uint32_t k = 0; k < 4U; k++)
+        {
+          if (k != 0U)
+          {
+            uint32_t at = (k == 1U) ? 0U : (k == 2U) ? n - 1U : rnd() % n;
+
+            memcpy(b, a, n);
+            b[at] = (uint8_t)(a[at] + 1U + rnd() % 255U);
+          }
+          if (sign(memopt_memcmp(a, b, n)) != sign(memcmp(a, b, n)))
+          {
+            if (wrong == 0U)
+            {
+              CHECK(0, "memcmp of %u bytes, offsets %u and %u, case %u",
+                    n, ao, bo, k);
+            }
+            wrong++;
+          }
+          if (n == 0U)
+          {
+            break;
+          }
+        }
+      }
+    }
+  }
+  CHECK(wrong == 0U, "%u comparisons wrong", wrong);
+}
+
+int main(void)
+{
+  test_copy_set();
+  test_overlap();
+  test_compare();
+  return check_done("test_memopt");
+}
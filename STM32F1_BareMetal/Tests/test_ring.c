@@ -0,0 +1,228 @@
+/**
+ ******************************************************************************
+ * @file           : test_ring.c
+ * @brief          : Threaded stress test of the SPSC and MPSC rings
+ ******************************************************************************
+ * @attention
+ *
+ * On the host atomic.h maps onto the GCC __atomic builtins, so threads
+ * exercise the same claim/publish/release protocol as interrupts do on the
+ * target, and on a multi-core host truly in parallel.
+ *
+ * MPSC: RING_PRODUCERS threads push RING_PER_PRODUCER values each, tagged
+ * with the producer number in the top bits, into a small ring that one
+ * consumer drains. Odd producers go through ring_mpsc_claim() and publish
+ * with a yield in between, as a producer preempted mid-push would. The
+ * consumer checks each producer's values arrive in order with none missing
+ * or repeated, then that the total is right and the ring is empty.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include "check.h"
+#include "ring.h"
+
+#define RING_LEN              64U
+#define RING_PRODUCERS        4U
+#define RING_PER_PRODUCER     200000U
+#define RING_SPSC_COUNT       400000U
+#define RING_TAG_SHIFT        28U
+#define RING_VALUE_MASK       ((1UL << RING_TAG_SHIFT) - 1U)
+
+/* Variables */
+static ring_spsc_t spsc;
+static uint32_t spsc_buf[RING_LEN];
+
+static ring_mpsc_t mpsc;
+static volatile uint32_t mpsc_seq[RING_LEN];
+static uint32_t mpsc_buf[RING_LEN];
+
+/* Functions */
+static void *spsc_producer(void *arg)
+{
+  uint32_t v = 0U;
+  uint32_t tmp[7];
+
+  (void)arg;
+  while (v < RING_SPSC_COUNT)
+  {
+    uint32_t k = (v % 7U) + 1U;
+    uint32_t done;
+
+    if (k > RING_SPSC_COUNT - v)
+    {
+      k = RING_SPSC_COUNT - v;
+    }
+    for (uint32_t i = 0; i < k; i++)
+    {
+      tmp[i] = v + i;
+    }
+    done = ring_spsc_push(&spsc, spsc_buf, sizeof(uint32_t), tmp, k);
+    if (done == 0U)
+    {
+      sched_yield();
+    }
+    v += done;
+  }
+  return NULL;
+}
+
+static void test_spsc(void)
+{
+  pthread_t th;
+  uint32_t expect = 0U;
+  uint32_t bad = 0U;
+
+  CHECK(ring_spsc_init(&spsc, 48U) == -1, "length not a power of two");
+  CHECK(ring_spsc_init(&spsc, RING_LEN) == 0, "init");
+  pthread_create(&th, NULL, spsc_producer, NULL);
+
+  /* Drain in place through the span calls, a few elements at a time */
+  while (expect < RING_SPSC_COUNT)
+  {
+    uint32_t index;
+    uint32_t k = ring_spsc_read_span(&spsc, &index);
+
+    if (k > 3U)
+    {
+      k = 3U;
+    }
+    for (uint32_t i = 0; i < k; i++)
+    {
+      bad += (spsc_buf[index + i] != expect + i) ? 1U : 0U;
+    }
+    ring_spsc_release(&spsc, k);
+    if (k == 0U)
+    {
+      sched_yield();
+    }
+    expect += k;
+  }
+  pthread_join(th, NULL);
+
+  CHECK(bad == 0U, "%u values out of order", bad);
+  CHECK(ring_spsc_count(&spsc) == 0U, "ring not empty");
+}
+
+static void *mpsc_producer(void *arg)
+{
+  uint32_t tag = (uint32_t)(uintptr_t)arg << RING_TAG_SHIFT;
+  uint32_t v = 0U;
+  uint32_t tmp[5];
+
+  while (v < RING_PER_PRODUCER)
+  {
+    uint32_t k = (v % 5U) + 1U;
+    uint32_t done;
+
+    if (k > RING_PER_PRODUCER - v)
+    {
+      k = RING_PER_PRODUCER - v;
+    }
+
+    if ((tag >> RING_TAG_SHIFT) & 1U)
+    {
+      uint32_t pos;
+
+      done = ring_mpsc_claim(&mpsc, k, &pos);
+      for (uint32_t i = 0; i < done; i++)
+      {
+        mpsc_buf[(pos + i) & mpsc.mask] = tag | (v + i);
+      }
+      if ((done != 0U) && ((v & 15U) == 0U))
+      {
+        /* Hold the slots unpublished while the others carry on */
+        sched_yield();
+      }
+      ring_mpsc_publish(&mpsc, pos, done);
+    }
+    else
+    {
+      for (uint32_t i = 0; i < k; i++)
+      {
+        tmp[i] = tag | (v + i);
+      }
+      done = ring_mpsc_push(&mpsc, mpsc_buf, sizeof(uint32_t), tmp, k);
+    }
+
+    if (done == 0U)
+    {
+      sched_yield();
+    }
+    v += done;
+  }
+  return NULL;
+}
+
+static void test_mpsc(void)
+{
+  pthread_t th[RING_PRODUCERS];
+  uint32_t next[RING_PRODUCERS] = { 0U };
+  uint32_t total = RING_PRODUCERS * RING_PER_PRODUCER;
+  uint32_t got = 0U;
+  uint32_t bad_tag = 0U;
+  uint32_t out_of_order = 0U;
+  uint32_t tmp[9];
+
+  CHECK(ring_mpsc_init(&mpsc, NULL, RING_LEN) == -1, "no sequence array");
+  CHECK(ring_mpsc_init(&mpsc, mpsc_seq, RING_LEN) == 0, "init");
+  for (uintptr_t i = 0; i < RING_PRODUCERS; i++)
+  {
+    pthread_create(&th[i], NULL, mpsc_producer, (void *)i);
+  }
+
+  while (got < total)
+  {
+    uint32_t k = ring_mpsc_pop(&mpsc, mpsc_buf, sizeof(uint32_t), tmp, 9U);
+
+    for (uint32_t i = 0; i < k; i++)
+    {
+      uint32_t t = tmp[i] >> RING_TAG_SHIFT;
+      uint32_t v = tmp[i] & RING_VALUE_MASK;
+
+      if (t >= RING_PRODUCERS)
+      {
+        bad_tag++;
+        continue;
+      }
+      /* A gap is a lost value, a step back a repeated one */
+      if (v != next[t])
+      {
+        out_of_order++;
+      }
+      next[t] = v + 1U;
+    }
+    if (k == 0U)
+    {
+      sched_yield();
+    }
+    got += k;
+  }
+  for (uint32_t i = 0; i < RING_PRODUCERS; i++)
+  {
+    pthread_join(th[i], NULL);
+  }
+
+  CHECK(bad_tag == 0U, "%u values from no producer", bad_tag);
+  CHECK(out_of_order == 0U, "%u values lost, repeated or reordered",
+        out_of_order);
+  for (uint32_t i = 0; i < RING_PRODUCERS; i++)
+  {
+    CHECK(next[i] == RING_PER_PRODUCER, "producer %u ended at %u", i,
+          next[i]);
+  }
+  CHECK(ring_mpsc_ready(&mpsc) == 0U, "ring not empty");
+  CHECK(ring_mpsc_pop(&mpsc, mpsc_buf, sizeof(uint32_t), tmp, 9U) == 0U,
+        "extra values after the last");
+}
+
+int main(void)
+{
+  test_spsc();
+  test_mpsc();
+  return check_done("test_ring");
+}
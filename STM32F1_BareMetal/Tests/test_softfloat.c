@@ -0,0 +1,255 @@
+/**
+ ******************************************************************************
+ * @file           : test_softfloat.c
+ * @brief          : Soft-float helpers against the host FPU, bit for bit
+ ******************************************************************************
+ * @attention
+ *
+ * Built with every helper group enabled. The host's SSE arithmetic rounds
+ * to nearest even with subnormals, as the helpers do, so every finite or
+ * infinite result must match exactly. A NaN result must be a quieted NaN
+ * operand, its sign aside, or the default NaN when no operand was one.
+ * sqrtf() is compared with the double square root rounded to float, which
+ * is correctly rounded.
+ *
+ * Operands are random bit patterns, half of them with exponents and
+ * significands drawn from the edges: zero, subnormal, the overflow limit,
+ * infinity and NaN, all-zero and all-one fractions.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "check.h"
+#include "softfloat.h"
+
+#define SF_ITERATIONS     2000000U
+#define SF_DEFAULT_NAN    0x7FC00000UL
+#define SF_QUIET          0x00400000UL
+
+/* libgcc2 names softfloat.c also defines, not declared in softfloat.h */
+int __lesf2(float a, float b);
+int __gesf2(float a, float b);
+
+/* Variables */
+static uint64_t sf_rng = 0x9E3779B97F4A7C15ULL;
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  /* xorshift64* */
+  sf_rng ^= sf_rng >> 12;
+  sf_rng ^= sf_rng << 25;
+  sf_rng ^= sf_rng >> 27;
+  return (uint32_t)((sf_rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint32_t bits(float f)
+{
+  uint32_t u;
+
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+static float flt(uint32_t u)
+{
+  float f;
+
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+static int is_nan(uint32_t u)
+{
+  return (u & 0x7FFFFFFFUL) > 0x7F800000UL;
+}
+
+static uint32_t operand(void)
+{
+  static const uint32_t exps[] = { 0U, 1U, 2U, 126U, 127U, 128U, 253U, 254U,
+                                   255U };
+  uint32_t r = rnd();
+  uint32_t e;
+  uint32_t f;
+
+  if ((r & 1U) == 0U)
+  {
+    return rnd();
+  }
+  e = ((r >> 1) & 3U) ? ((r >> 3) & 0xFFU) : exps[(r >> 3) % 9U];
+  switch ((r >> 12) & 3U)
+  {
+    case 0U:
+      f = 0U;
+      break;
+    case 1U:
+      f = 0x7FFFFFUL;
+      break;
+    default:
+      f = rnd() & 0x7FFFFFUL;
+      break;
+  }
+  return (r & 0x80000000UL) | (e << 23) | f;
+}
+
+/**
+ * @brief  Non-zero if `got` is the right result for operands a, b (b
+ *         unused when 0 for unary operations) given the host's `want`.
+ */
+static int same(uint32_t got, uint32_t want, uint32_t a, uint32_t b)
+{
+  if (!is_nan(want))
+  {
+    return got == want;
+  }
+  if (is_nan(a) || is_nan(b))
+  {
+    /* Sign aside: subtraction may propagate the negated operand */
+    got &= 0x7FFFFFFFUL;
+    return (is_nan(a) && (got == ((a | SF_QUIET) & 0x7FFFFFFFUL))) ||
+           (is_nan(b) && (got == ((b | SF_QUIET) & 0x7FFFFFFFUL)));
+  }
+  return got == SF_DEFAULT_NAN;
+}
+
+#define SF_CHECK_BIN(name, expr, host)                                    \
+  do                                                                      \
+  {                                                                       \
+    uint32_t got_ = bits(expr);                                           \
+    uint32_t want_ = bits(host);                                          \
+    if (!same(got_, want_, a, b) && (fails_##name++ < 5U))                \
+    {                                                                     \
+      CHECK(0, #name "(0x%08X, 0x%08X) = 0x%08X, host 0x%08X", a, b,     \
+            got_, want_);                                                 \
+    }                                                                     \
+  } while (0)
+
+static void test_arith(void)
+{
+  unsigned fails_fmul = 0U;
+  unsigned fails_fdiv = 0U;
+  unsigned fails_fadd = 0U;
+  unsigned fails_fsub = 0U;
+  unsigned fails_frsub = 0U;
+  unsigned fails_sqrtf = 0U;
+
+  for (uint32_t i = 0; i < SF_ITERATIONS; i++)
+  {
+    uint32_t a = operand();
+    uint32_t b = operand();
+    float fa = flt(a);
+    float fb = flt(b);
+
+    SF_CHECK_BIN(fmul, __aeabi_fmul(fa, fb), fa * fb);
+    SF_CHECK_BIN(fdiv, __aeabi_fdiv(fa, fb), fa / fb);
+    SF_CHECK_BIN(fadd, __aeabi_fadd(fa, fb), fa + fb);
+    SF_CHECK_BIN(fsub, __aeabi_fsub(fa, fb), fa - fb);
+    SF_CHECK_BIN(frsub, __aeabi_frsub(fa, fb), fb - fa);
+    b = 0U;
+    SF_CHECK_BIN(sqrtf, sqrtf(fa), (float)sqrt((double)fa));
+  }
+}
+
+static void test_compare(void)
+{
+  unsigned fails = 0U;
+
+  for (uint32_t i = 0; i < SF_ITERATIONS; i++)
+  {
+    uint32_t a = operand();
+    uint32_t b = ((i & 7U) == 0U) ? a ^ ((i & 8U) ? 0x80000000UL : 0U)
+                                  : operand();
+    float fa = flt(a);
+    float fb = flt(b);
+    int un = isunordered(fa, fb);
+    int lt = (fa < fb);
+    int gt = (fa > fb);
+    int eq = (fa == fb);
+    int ok;
+
+    ok = (__aeabi_fcmpeq(fa, fb) == eq) &&
+         (__aeabi_fcmplt(fa, fb) == lt) &&
+         (__aeabi_fcmple(fa, fb) == (lt || eq)) &&
+         (__aeabi_fcmpge(fa, fb) == (gt || eq)) &&
+         (__aeabi_fcmpgt(fa, fb) == gt) &&
+         (__aeabi_fcmpun(fa, fb) == un) &&
+         (un ? (__lesf2(fa, fb) > 0) && (__gesf2(fa, fb) < 0)
+             : (__lesf2(fa, fb) == gt - lt) &&
+               (__gesf2(fa, fb) == gt - lt));
+    if (!ok && (fails++ < 5U))
+    {
+      CHECK(0, "compare(0x%08X, 0x%08X)", a, b);
+    }
+  }
+}
+
+static int32_t ref_f2iz(double d)
+{
+  if (isnan(d))
+  {
+    return 0;
+  }
+  if (d >= 2147483648.0)
+  {
+    return INT32_MAX;
+  }
+  if (d <= -2147483649.0)
+  {
+    return INT32_MIN;
+  }
+  return (int32_t)d;
+}
+
+static uint32_t ref_f2uiz(double d)
+{
+  if (isnan(d) || (d <= -1.0))
+  {
+    return 0U;
+  }
+  if (d >= 4294967296.0)
+  {
+    return UINT32_MAX;
+  }
+  return (uint32_t)d;
+}
+
+static void test_convert(void)
+{
+  unsigned fails = 0U;
+
+  for (uint32_t i = 0; i < SF_ITERATIONS; i++)
+  {
+    uint32_t a = operand();
+    uint32_t u = rnd() >> (rnd() & 31U);
+    uint64_t l = ((uint64_t)rnd() << 32 | rnd()) >> (rnd() & 63U);
+    int32_t n = (int32_t)(0U - u);
+    float fa = flt(a);
+    int ok;
+
+    ok = (bits(__aeabi_ui2f(u)) == bits((float)u)) &&
+         (bits(__aeabi_i2f((int32_t)u)) == bits((float)(int32_t)u)) &&
+         (bits(__aeabi_i2f(n)) == bits((float)n)) &&
+         (bits(__aeabi_ul2f(l)) == bits((float)l)) &&
+         (bits(__aeabi_l2f((int64_t)l)) == bits((float)(int64_t)l)) &&
+         (__aeabi_f2iz(fa) == ref_f2iz(fa)) &&
+         (__aeabi_f2uiz(fa) == ref_f2uiz(fa));
+    if (!ok && (fails++ < 5U))
+    {
+      CHECK(0, "convert(0x%08X, %u, %llu)", a, u, (unsigned long long)l);
+    }
+  }
+  CHECK(bits(__aeabi_i2f(INT32_MIN)) == 0xCF000000UL, "i2f(INT32_MIN)");
+  CHECK(bits(__aeabi_l2f(INT64_MIN)) == 0xDF000000UL, "l2f(INT64_MIN)");
+}
+
+int main(void)
+{
+  test_arith();
+  test_compare();
+  test_convert();
+  return check_done("test_softfloat");
+}
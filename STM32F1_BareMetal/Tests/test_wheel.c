@@ -0,0 +1,269 @@
+/**
+ ******************************************************************************
+ * @file           : test_wheel.c
+ * @brief          : Timing wheel expiry, cancel, cascades and wrap-around
+ ******************************************************************************
+ * @attention
+ *
+ * Timers are started at delays on every level, past the 2^24-tick span and
+ * across the 32-bit tick wrap, some of them stopped or restarted on the
+ * way. Each survivor must run exactly once, on the tick it was due, in its
+ * own context; a stopped one never. The wheel is driven by single ticks
+ * and by wheel_advance() over the gaps wheel_next() reports, which must
+ * never skip a due timer. A periodic timer kept by wheel_forward() must not
+ * drift, and wheel_bench() over 1000 timers must leave the wheel as it
+ * found it.
+ *
+ ******************************************************************************
+ */
+
+/* Includes */
+#include "check.h"
+#include "event.h"
+#include "wheel.h"
+
+#define WHEEL_TEST_N      600U
+#define WHEEL_TEST_BENCH  1000U
+
+typedef struct
+{
+  wheel_timer_t t;          /* first, so a callback finds its entry */
+  uint32_t due;             /* tick count after the tick it runs on */
+  uint32_t ctx;
+  uint32_t runs;
+  uint32_t late;
+  uint8_t live;
+} entry_t;
+
+/* Variables */
+static uint64_t wheel_rng = 88172645463325252ULL;
+
+static entry_t entries[WHEEL_TEST_N];
+static wheel_timer_t bench_timers[WHEEL_TEST_BENCH];
+static uint32_t wrong_ctx;
+
+/* Functions */
+static uint32_t rnd(void)
+{
+  wheel_rng ^= wheel_rng << 13;
+  wheel_rng ^= wheel_rng >> 7;
+  wheel_rng ^= wheel_rng << 17;
+  return (uint32_t)wheel_rng;
+}
+
+static void drain(void)
+{
+  while (event_dispatch() == 0)
+  {
+  }
+}
+
+static void expire(entry_t *e, uint32_t ctx)
+{
+  e->runs++;
+  if (!e->live || (wheel_now() != e->due))
+  {
+    e->late++;
+  }
+  if (e->ctx != ctx)
+  {
+    wrong_ctx++;
+  }
+}
+
+/* The tick has run and the thread callbacks are dispatched straight after,
+ * so both see wheel_now() one past the deadline */
+static void on_isr(wheel_timer_t *t)
+{
+  expire((entry_t *)t, WHEEL_ISR);
+}
+
+static void on_thread(wheel_timer_t *t)
+{
+  expire((entry_t *)t, WHEEL_THREAD);
+}
+
+/* A delay on `level`, or past the span for level 4 */
+static uint32_t delay_on(uint32_t level)
+{
+  switch (level)
+  {
+    case 0:
+      return 1U + rnd() % 63U;
+    case 1:
+      return 64U + rnd() % (4096U - 64U);
+    case 2:
+      return 4096U + rnd() % (262144U - 4096U);
+    case 3:
+      return 262144U + rnd() % (16777216U - 262144U);
+    default:
+      return 16777216U + rnd() % 8000000U;
+  }
+}
+
+static void start(entry_t *e, uint32_t delay, uint32_t ctx)
+{
+  e->due = wheel_now() + delay;
+  e->ctx = ctx;
+  e->live = 1U;
+  wheel_start(&e->t, delay, ctx);
+}
+
+/**
+ * @brief  Start every entry, stop or restart some, then run the wheel
+ *         until the last deadline has passed.
+ * @param  skip Move over idle gaps with wheel_advance()
+ */
+static void run_wheel(uint32_t now, uint32_t skip, const char *name)
+{
+  uint32_t end = 0U;
+  uint32_t halfway = 0U;
+  uint32_t late = 0U;
+  uint32_t left = 0U;
+
+  event_init();
+  CHECK(wheel_set_now(now) == 0, "%s: wheel not empty", name);
+  wrong_ctx = 0U;
+  for (uint32_t i = 0; i < WHEEL_TEST_N; i++)
+  {
+    entry_t *e = &entries[i];
+    /* Thread callbacks only where every tick is dispatched */
+    uint32_t ctx = (!skip && (i & 1U)) ? WHEEL_THREAD : WHEEL_ISR;
+
+    wheel_timer_init(&e->t, (ctx == WHEEL_THREAD) ? on_thread : on_isr);
+    e->runs = 0U;
+    e->late = 0U;
+    start(e, delay_on(i % (skip ? 5U : 4U)), ctx);
+  }
+
+  /* Stop a few, restart a few others on another level */
+  for (uint32_t i = 0; i < WHEEL_TEST_N; i += 7U)
+  {
+    wheel_stop(&entries[i].t);
+    entries[i].live = 0U;
+    CHECK(!wheel_pending(&entries[i].t), "%s: stopped timer pending", name);
+  }
+  for (uint32_t i = 3U; i < WHEEL_TEST_N; i += 7U)
+  {
+    start(&entries[i], delay_on(rnd() % (skip ? 5U : 4U)),
+          entries[i].ctx);
+  }
+  for (uint32_t i = 0; i < WHEEL_TEST_N; i++)
+  {
+    if (entries[i].live && ((entries[i].due - now) > end))
+    {
+      end = entries[i].due - now;
+    }
+  }
+
+  while ((wheel_now() - now) < end)
+  {
+    uint32_t gap;
+
+    if (skip && (wheel_next(&gap) == 0) && (gap > 0U))
+    {
+      /* Every tick of the gap must be idle; advance over part of it */
+      for (uint32_t i = 0; i < WHEEL_TEST_N; i++)
+      {
+        if (entries[i].live && !entries[i].runs &&
+            ((entries[i].due - 1U - wheel_now()) < gap))
+        {
+          late++;
+        }
+      }
+      wheel_advance(1U + rnd() % gap);
+    }
+    else
+    {
+      wheel_tick();
+    }
+    drain();
+
+    /* Halfway, stop some of the ones still waiting */
+    if (!halfway && ((wheel_now() - now) >= end / 2U))
+    {
+      halfway = 1U;
+      for (uint32_t i = 5U; i < WHEEL_TEST_N; i += 11U)
+      {
+        wheel_stop(&entries[i].t);
+        if (!entries[i].runs)
+        {
+          entries[i].live = 0U;
+        }
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < WHEEL_TEST_N; i++)
+  {
+    late += entries[i].late;
+    left += entries[i].live && (entries[i].runs != 1U);
+  }
+  CHECK(late == 0U, "%s: %u timers ran off their tick", name, late);
+  CHECK(left == 0U, "%s: %u timers did not run once", name, left);
+  CHECK(wrong_ctx == 0U, "%s: %u ran in the wrong context", name, wrong_ctx);
+  CHECK(wheel_next(&end) == -1, "%s: timers left on the wheel", name);
+}
+
+static uint32_t periodic_runs;
+static uint32_t periodic_drift;
+static uint32_t periodic_base;
+
+static void on_periodic(wheel_timer_t *t)
+{
+  periodic_runs++;
+  if (wheel_now() != periodic_base + 100U * periodic_runs)
+  {
+    periodic_drift++;
+  }
+  if (periodic_runs < 200U)
+  {
+    wheel_forward(t, 100U);
+  }
+}
+
+static void test_periodic(void)
+{
+  wheel_timer_t t;
+
+  /* Across the wrap, and restarted from its own callback */
+  CHECK(wheel_set_now(0xFFFFFFFFUL - 7000U) == 0, "periodic: wheel not empty");
+  periodic_base = wheel_now();
+  wheel_timer_init(&t, on_periodic);
+  wheel_start(&t, 100U, WHEEL_ISR);
+  for (uint32_t i = 0; i < 25000U; i++)
+  {
+    wheel_tick();
+  }
+  CHECK(periodic_runs == 200U, "periodic: %u of 200 runs", periodic_runs);
+  CHECK(periodic_drift == 0U, "periodic: %u runs off period", periodic_drift);
+  CHECK(!wheel_pending(&t), "periodic: still pending");
+}
+
+static void test_bench(void)
+{
+  wheel_bench_t b;
+  uint32_t base;
+
+  CHECK(wheel_set_now(12345U) == 0, "bench: wheel not empty");
+  base = wheel_now();
+  wheel_bench(bench_timers, WHEEL_TEST_BENCH, &b);
+  /* Delays 1 to 60000, 1000 ticks: about one in sixty runs */
+  CHECK((b.fired > 0U) && (b.fired < WHEEL_TEST_BENCH / 10U),
+        "bench: %u of %u fired", b.fired, WHEEL_TEST_BENCH);
+  CHECK(b.tick_max >= b.tick, "bench: tick max %u below mean %u",
+        b.tick_max, b.tick);
+  CHECK(wheel_now() == base, "bench: wheel not set back");
+  CHECK(wheel_next(&base) == -1, "bench: timers left on the wheel");
+}
+
+int main(void)
+{
+  run_wheel(0U, 0U, "ticked");
+  run_wheel(0xFFFFFFFFUL - 3000U, 0U, "ticked across the wrap");
+  run_wheel(1000U, 1U, "advanced");
+  run_wheel(0xFFFFFFFFUL - 20000000UL, 1U, "advanced across the wrap");
+  test_periodic();
+  test_bench();
+  return check_done("test_wheel");
+}
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Compare two benchmark reports from bench_run() (see Inc/bench.h).
+
+Each input is a raw console capture; the binary report is found by its
+"BNCH" magic, wherever it sits among other output, and its CRC checked.
+
+    bench_diff.py base.bin new.bin [--threshold 5]
+
+Prints every case with its median in both runs and the change, marks
+medians that grew by more than the threshold (percent) as REGRESSION, and
+exits with 1 if there was any, 2 if a report could not be read.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"BNCH"
+VERSION = 1
+FLAG_NO_CYCCNT = 0x01
+
+
+class ReportError(Exception):
+    pass
+
+
+def parse(data):
+    """Return (flags, core_hz, {name: (repeats, min, median, max)})."""
+    start = data.rfind(MAGIC)
+    if start < 0:
+        raise ReportError("no report found")
+    pos = start + len(MAGIC)
+
+    def take(fmt):
+        nonlocal pos
+        size = struct.calcsize(fmt)
+        if pos + size > len(data):
+            raise ReportError("report truncated")
+        values = struct.unpack_from(fmt, data, pos)
+        pos += size
+        return values
+
+    version, flags, core_hz = take("<BBI")
+    if version != VERSION:
+        raise ReportError("report version %d, expected %d" % (version, VERSION))
+
+    cases = {}
+    while True:
+        (tag,) = take("<B")
+        if tag == ord("C"):
+            (length,) = take("<B")
+            (name,) = take("<%ds" % length)
+            cases[name.decode("ascii", "replace")] = take("<HIII")
+        elif tag == ord("E"):
+            end = pos
+            count, crc = take("<HI")
+            if count != len(cases):
+                raise ReportError("%d cases, trailer says %d" % (len(cases), count))
+            if zlib.crc32(data[start:end + 2]) != crc:
+                raise ReportError("CRC mismatch")
+            return flags, core_hz, cases
+        else:
+            raise ReportError("bad record tag 0x%02x" % tag)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        flags, core_hz, cases = parse(f.read())
+    if flags & FLAG_NO_CYCCNT:
+        print("%s: no cycle counter, figures are 0" % path, file=sys.stderr)
+    return core_hz, cases
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("base")
+    ap.add_argument("new")
+    ap.add_argument("--threshold", type=float, default=5.0,
+                    help="allowed growth of a median, percent (default 5)")
+    args = ap.parse_args()
+
+    try:
+        base_hz, base = load(args.base)
+        new_hz, new = load(args.new)
+    except (OSError, ReportError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 2
+    if base_hz != new_hz:
+        print("note: core clock %d Hz vs %d Hz" % (base_hz, new_hz))
+
+    regressions = 0
+    print("%-32s %10s %10s %8s" % ("case", "base", "new", "change"))
+    for name in list(base) + [n for n in new if n not in base]:
+        if name not in new:
+            print("%-32s %10d %10s %8s" % (name, base[name][2], "-", "gone"))
+            continue
+        if name not in base:
+            print("%-32s %10s %10d %8s" % (name, "-", new[name][2], "new"))
+            continue
+        b = base[name][2]
+        n = new[name][2]
+        change = (n - b) * 100.0 / b if b else (0.0 if n == 0 else float("inf"))
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        print("%-32s %10d %10d %+7.1f%%%s" % (name, b, n, change, mark))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())